@@ -1,88 +1,169 @@
-#include<math.h>
-
-#include "headers/Quaternion.h"
-
-Quaternion::Quaternion(float w, float x, float y, float z)
-{
-  q[0] = w;
-  q[1] = x;
-  q[2] = y;
-  q[3] = z;
-}
-
-float Quaternion::operator [] (int i) const
-{
-  return q[i];
-}
-
-float &Quaternion::operator [] (int i)
-{
-  return q[i];
-}
-
-Quaternion& Quaternion::operator =(const Quaternion& a)
-{
-  q[0] = a[0];
-  q[1] = a[1];
-  q[2] = a[2];
-  q[3] = a[3];
-  return *this;
-}
-
-Quaternion &Quaternion::operator +=(const Quaternion &a)
-{
-  for(int i = 0; i < 4; ++i){
-    q[i] += a[i];
-  }
-  return *this;
-}
-
-Quaternion &Quaternion::negative()
-{
-  for(int i = 0; i < 4; ++i){
-    q[i] = -q[i];
-  }
-  return *this;
-}
-
-
-Quaternion &Quaternion::operator *=(const Quaternion &a)
-{
-  return *this = *this * a;
-}
-
-Quaternion &Quaternion::inverse()
-{
-  float n = norm(*this);
-  q[0] /= n;
-  for(int i = 0; i < 4; ++i){
-    q[i] /= -n;
-  }
-  return *this;
-}
-
-Quaternion operator *(const Quaternion &a, const Quaternion &b)
-{
-  Quaternion r(0, 0, 0, 0);
-  r[0] = a[0] * b[0] - a[1] * b[1] - a[2] * b[2] - a[3] * b[3];
-  r[1] = a[0] * b[1] + a[1] * b[0] + a[2] * b[3] - a[3] * b[2];
-  r[2] = a[0] * b[2] - a[1] * b[3] + a[2] * b[0] + a[3] * b[1];
-  r[3] = a[0] * b[3] + a[1] * b[2] - a[2] * b[1] + a[3] * b[0];
-  return r;
-}
-
-
-Quaternion conj( const Quaternion &a )
-{
-  return Quaternion( a[0], -a[1], -a[2], -a[3] );
-}
-
-float norm(const Quaternion &a)
-{
-  return a[0] * a[0] + a[1] * a[1] + a[2] * a[2] + a[3] * a[3];
-}
-
-float abs( const Quaternion &a )
-{
-  return sqrt(norm(a));
-}
+#include<math.h>
+
+#include "headers/Quaternion.h"
+
+Quaternion &Quaternion::operator +=(const Quaternion &a)
+{
+  for(int i = 0; i < 4; ++i){
+    q[i] += a[i];
+  }
+  return *this;
+}
+
+Quaternion &Quaternion::negative()
+{
+  for(int i = 0; i < 4; ++i){
+    q[i] = -q[i];
+  }
+  return *this;
+}
+
+
+Quaternion &Quaternion::operator *=(const Quaternion &a)
+{
+  return *this = *this * a;
+}
+
+Quaternion &Quaternion::inverse()
+{
+  float n = norm(*this);
+  q[0] /= n;
+  for(int i = 0; i < 4; ++i){
+    q[i] /= -n;
+  }
+  return *this;
+}
+
+float norm(const Quaternion &a)
+{
+  return a[0] * a[0] + a[1] * a[1] + a[2] * a[2] + a[3] * a[3];
+}
+
+float abs( const Quaternion &a )
+{
+  return sqrt(norm(a));
+}
+
+void ToMatrix(const Quaternion &q, float m[16])
+{
+  float x2 = q[1] * q[1] * 2.0f;
+  float y2 = q[2] * q[2] * 2.0f;
+  float z2 = q[3] * q[3] * 2.0f;
+  float xy = q[1] * q[2] * 2.0f;
+  float yz = q[2] * q[3] * 2.0f;
+  float zx = q[3] * q[1] * 2.0f;
+  float xw = q[1] * q[0] * 2.0f;
+  float yw = q[2] * q[0] * 2.0f;
+  float zw = q[3] * q[0] * 2.0f;
+
+  m[0] = 1.0f - y2 - z2;
+  m[1] = xy + zw;
+  m[2] = zx - yw;
+  m[3] = 0.0f;
+
+  m[4] = xy - zw;
+  m[5] = 1.0f - z2 - x2;
+  m[6] = yz + xw;
+  m[7] = 0.0f;
+
+  m[8] = zx + yw;
+  m[9] = yz - xw;
+  m[10] = 1.0f - x2 - y2;
+  m[11] = 0.0f;
+
+  m[12] = 0.0f;
+  m[13] = 0.0f;
+  m[14] = 0.0f;
+  m[15] = 1.0f;
+}
+
+PointTransform MakePointTransform(const Quaternion &q
+                                , const float pre_offset[3])
+{
+  float m[16];
+  ToMatrix(q, m);
+  PointTransform transform;
+  for(int row = 0; row < 3; ++row){
+    for(int column = 0; column < 3; ++column){
+      transform.rotation[row * 3 + column] = m[column * 4 + row];
+    }
+  }
+  transform.translation[0] = 0.0f;
+  transform.translation[1] = 0.0f;
+  transform.translation[2] = 0.0f;
+  TransformPoint(transform, pre_offset, transform.translation);
+  return transform;
+}
+
+void TransformPoints(const PointTransform &transform
+                   , const float *in, float *out, size_t count)
+{
+  const float *m = transform.rotation;
+  const float *t = transform.translation;
+  size_t i = 0;
+#if defined(QUATERNION_SSE)
+  // Four points at a time: unpack 12 floats into x, y and z lanes,
+  // transform, and pack them back.
+  for(; i + 4 <= count; i += 4){
+    const float *src = in + i * 3;
+    const __m128 a = _mm_loadu_ps(src);
+    const __m128 b = _mm_loadu_ps(src + 4);
+    const __m128 c = _mm_loadu_ps(src + 8);
+    const __m128 z0z1 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 1, 3, 2));
+    const __m128 x2x3 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 0, 3, 2));
+    const __m128 x = _mm_shuffle_ps(a, x2x3, _MM_SHUFFLE(3, 0, 3, 0));
+    const __m128 y = _mm_shuffle_ps(
+                        _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1))
+                      , _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3))
+                      , _MM_SHUFFLE(2, 0, 2, 0));
+    const __m128 z = _mm_shuffle_ps(z0z1, c, _MM_SHUFFLE(3, 0, 2, 0));
+
+    const __m128 rx = _mm_add_ps(_mm_add_ps(
+                        _mm_mul_ps(_mm_set1_ps(m[0]), x)
+                      , _mm_mul_ps(_mm_set1_ps(m[1]), y))
+                      , _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[2]), z)
+                                 , _mm_set1_ps(t[0])));
+    const __m128 ry = _mm_add_ps(_mm_add_ps(
+                        _mm_mul_ps(_mm_set1_ps(m[3]), x)
+                      , _mm_mul_ps(_mm_set1_ps(m[4]), y))
+                      , _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[5]), z)
+                                 , _mm_set1_ps(t[1])));
+    const __m128 rz = _mm_add_ps(_mm_add_ps(
+                        _mm_mul_ps(_mm_set1_ps(m[6]), x)
+                      , _mm_mul_ps(_mm_set1_ps(m[7]), y))
+                      , _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[8]), z)
+                                 , _mm_set1_ps(t[2])));
+
+    float *dest = out + i * 3;
+    _mm_storeu_ps(dest, _mm_shuffle_ps(
+                        _mm_shuffle_ps(rx, ry, _MM_SHUFFLE(0, 0, 0, 0))
+                      , _mm_shuffle_ps(rz, rx, _MM_SHUFFLE(1, 1, 0, 0))
+                      , _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(dest + 4, _mm_shuffle_ps(
+                        _mm_shuffle_ps(ry, rz, _MM_SHUFFLE(1, 1, 1, 1))
+                      , _mm_shuffle_ps(rx, ry, _MM_SHUFFLE(2, 2, 2, 2))
+                      , _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(dest + 8, _mm_shuffle_ps(
+                        _mm_shuffle_ps(rz, rx, _MM_SHUFFLE(3, 3, 2, 2))
+                      , _mm_shuffle_ps(ry, rz, _MM_SHUFFLE(3, 3, 3, 3))
+                      , _MM_SHUFFLE(2, 0, 2, 0)));
+  }
+#elif defined(QUATERNION_NEON)
+  for(; i + 4 <= count; i += 4){
+    float32x4x3_t p = vld3q_f32(in + i * 3);
+    float32x4x3_t r;
+    for(int row = 0; row < 3; ++row){
+      float32x4_t v = vdupq_n_f32(t[row]);
+      v = vmlaq_n_f32(v, p.val[0], m[row * 3]);
+      v = vmlaq_n_f32(v, p.val[1], m[row * 3 + 1]);
+      v = vmlaq_n_f32(v, p.val[2], m[row * 3 + 2]);
+      r.val[row] = v;
+    }
+    vst3q_f32(out + i * 3, r);
+  }
+#endif
+  for(; i < count; ++i){
+    float point[3] = { in[i * 3], in[i * 3 + 1], in[i * 3 + 2] };
+    TransformPoint(transform, point, out + i * 3);
+  }
+}
@@ -30,6 +30,22 @@ void FieldLine::draw() {
   return;
 }
 
+void FieldLine::record(std::vector<draw_batch::DrawBatch> *batches) const {
+  draw_batch::DrawBatch batch;
+  batch.mode = GL_LINE_STRIP;
+  batch.buffer_id = buffer_id_;
+  batch.stride = 0;
+  batch.color_offset = -1;
+  batch.color[0] = 0.0f;
+  batch.color[1] = 0.8f;
+  batch.color[2] = 0.0f;
+  batch.line_width = 1.5f;
+  batch.first_indexes = first_indexes_;
+  batch.count_indexes = count_indexes_;
+  batch.draw_count = line_count_;
+  batches->push_back(batch);
+}
+
 void FieldLine::set_line_vertexes_() {
   int index_position = 0;
   int vertex_position = 0;
@@ -0,0 +1,222 @@
+// Copyright 2015 Makoto Yano
+//
+// Runs frames through the hand processor twice: as it used to trace,
+// with the raw tip and an eleven frame dwell, and with the One-Euro tip
+// filter and the timed dwell.  Reports for each:
+//   start latency  from the frame a pointing finger shows up to the frame
+//                  its stroke starts, over every such appearance
+//   jitter         RMS distance of each drawn tip sample from the middle
+//                  of its neighbours, which a smooth path keeps near 0
+//   path error     RMS distance from the true tip path, made up frames
+//                  only since they have one
+// Fails when the filtered run is not both steadier and quicker.
+//
+//   fingertip_bench [--replay FILE] [--strokes N] [--noise MM]
+//                   [--start-delay-ms MS] [--min-cutoff HZ] [--beta B]
+//
+// Without --replay the frames are made up at about 110 Hz with uneven
+// spacing: the hand shows up, holds the finger still, draws a circle and
+// leaves, with Gaussian noise of --noise mm on every axis of the tip.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "headers/bench_frames.h"
+#include "headers/bench_util.h"
+#include "headers/fingertip_filter.h"
+#include "headers/frame_record.h"
+#include "headers/hand_input_processor.h"
+
+namespace {
+
+// How many frames the old dwell counted before a stroke started.
+const int kOldDwellFrames = 11;
+
+struct Run {
+  std::vector<double> latencies;
+  int missed_starts;
+  double jitter;
+  double path_error;
+};
+
+int64_t MedianFrameStep(
+                    const std::vector<frame_record::FrameRecord> &frames) {
+  std::vector<int64_t> steps;
+  for (size_t i = 1; i < frames.size(); i++) {
+    steps.push_back(frames[i].timestamp - frames[i - 1].timestamp);
+  }
+  if (steps.empty()) {
+    return bench_frames::kFrameMicros;
+  }
+  std::nth_element(steps.begin(), steps.begin() + steps.size() / 2
+                 , steps.end());
+  return steps[steps.size() / 2];
+}
+
+Run Measure(const std::vector<frame_record::FrameRecord> &frames
+          , const std::vector<frame_record::FrameRecord> &clean
+          , const fingertip_filter::Params &params
+          , int64_t start_delay) {
+  Run run;
+  run.missed_starts = 0;
+  hand_listener::HandInputProcessor processor;
+  processor.tip_filter_params = params;
+  processor.stroke_start_delay = start_delay;
+
+  // Start latency, through the processor.
+  int pointing_id = -1;
+  int64_t shown_at = 0;
+  bool waiting = false;
+  for (size_t i = 0; i < frames.size(); i++) {
+    processor.process_frame(frames[i]);
+    const frame_record::FingerRecord *finger =
+                                  bench_frames::PointingFinger(frames[i]);
+    if (!finger || finger->id != pointing_id) {
+      if (waiting) {
+        ++run.missed_starts;
+      }
+      waiting = finger != NULL;
+      pointing_id = finger ? finger->id : -1;
+      shown_at = frames[i].timestamp;
+    }
+    if (!waiting) {
+      continue;
+    }
+    std::map<int, pen_line::TracingLine>::const_iterator line
+                              = processor.tracing_lines.find(pointing_id);
+    if (line != processor.tracing_lines.end() && (*line).second.drawing) {
+      run.latencies.push_back((frames[i].timestamp - shown_at) / 1000.0);
+      waiting = false;
+    }
+  }
+  if (waiting) {
+    ++run.missed_starts;
+  }
+
+  // Jitter and path error, on the tip samples the processor draws with.
+  fingertip_filter::OneEuroFilter filter(params);
+  std::vector<Leap::Vector> samples;
+  int sampled_id = -1;
+  double jitter_sum = 0.0;
+  size_t jitter_count = 0;
+  double error_sum = 0.0;
+  size_t error_count = 0;
+  for (size_t i = 0; i <= frames.size(); i++) {
+    const frame_record::FingerRecord *finger = NULL;
+    if (i < frames.size()) {
+      finger = bench_frames::PointingFinger(frames[i]);
+    }
+    if (!finger || finger->id != sampled_id) {
+      for (size_t j = 1; j + 1 < samples.size(); j++) {
+        jitter_sum += (samples[j]
+                       - (samples[j - 1] + samples[j + 1]) * 0.5f)
+                      .magnitudeSquared();
+        ++jitter_count;
+      }
+      samples.clear();
+      filter.reset();
+      sampled_id = finger ? finger->id : -1;
+    }
+    if (!finger) {
+      continue;
+    }
+    const float *tip = finger->tip_position;
+    samples.push_back(filter.filter(Leap::Vector(tip[0], tip[1], tip[2])
+                                  , frames[i].timestamp));
+    if (!clean.empty()) {
+      const float *truth = clean[i].hands[0].fingers[1].tip_position;
+      error_sum += (samples.back()
+                    - Leap::Vector(truth[0], truth[1], truth[2]))
+                   .magnitudeSquared();
+      ++error_count;
+    }
+  }
+  run.jitter = jitter_count ? sqrt(jitter_sum / jitter_count) : 0.0;
+  run.path_error = error_count ? sqrt(error_sum / error_count) : 0.0;
+  return run;
+}
+
+void Print(const char *name, const Run &run, bool has_truth) {
+  printf("%-8s start latency mean %6.1f  p95 %6.1f ms (%lu starts, %d"
+         " missed)  jitter %.3f mm"
+        , name, bench_util::Mean(run.latencies)
+        , bench_util::Percentile(run.latencies, 0.95)
+        , static_cast<unsigned long>(run.latencies.size())  // NOLINT
+        , run.missed_starts, run.jitter);
+  if (has_truth) {
+    printf("  path error %.3f mm", run.path_error);
+  }
+  printf("\n");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const char *replay_path = NULL;
+  bench_frames::Script script = bench_frames::DefaultScript();
+  script.strokes = 40;
+  script.absent_frames = 30;
+  script.present_frames = 260;
+  script.path = bench_frames::kHeldCircle;
+  fingertip_filter::Params params = fingertip_filter::DefaultParams();
+  int64_t start_delay = STROKE_START_DELAY;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      replay_path = argv[++i];
+    } else if (strcmp(argv[i], "--strokes") == 0 && i + 1 < argc) {
+      script.strokes = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--noise") == 0 && i + 1 < argc) {
+      script.noise = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--start-delay-ms") == 0 && i + 1 < argc) {
+      start_delay = static_cast<int64_t>(atof(argv[++i]) * 1000.0);
+    } else if (strcmp(argv[i], "--min-cutoff") == 0 && i + 1 < argc) {
+      params.min_cutoff = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--beta") == 0 && i + 1 < argc) {
+      params.beta = atof(argv[++i]);
+    } else {
+      printf("Unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  std::vector<frame_record::FrameRecord> frames;
+  std::vector<frame_record::FrameRecord> clean;
+  if (replay_path) {
+    frame_record::FrameReplay replay;
+    if (!replay.Open(replay_path)) {
+      return 2;
+    }
+    frames.resize(replay.frame_count());
+    for (size_t i = 0; i < frames.size(); i++) {
+      replay.Read(i, &frames[i]);
+    }
+  } else {
+    bench_frames::MakeFrames(script, &frames, &clean);
+  }
+  const int64_t frame_step = MedianFrameStep(frames);
+  printf("%lu frames, %s, median frame step %.2f ms\n"
+        , static_cast<unsigned long>(frames.size())  // NOLINT
+        , replay_path ? "replayed" : "made up", frame_step / 1000.0);
+
+  fingertip_filter::Params unfiltered = params;
+  unfiltered.min_cutoff = 0.0f;
+  Run before = Measure(frames, clean, unfiltered
+                     , kOldDwellFrames * frame_step);
+  Run after = Measure(frames, clean, params, start_delay);
+  Print("before", before, !clean.empty());
+  Print("after", after, !clean.empty());
+
+  if (after.jitter >= before.jitter
+      || bench_util::Mean(after.latencies) >= bench_util::Mean(before.latencies)
+      || after.latencies.size() < before.latencies.size()) {
+    printf("the filtered run is not steadier and quicker\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,857 @@
+// Copyright 2015 Makoto Yano
+//
+// Runs the per frame pipeline of main.cc without a window, an HMD or a
+// Leap device: input frame -> processor -> snapshot -> view -> scene
+// render for both eyes -> end of frame, on an offscreen EGL context and
+// the simulated HMD.  Mesa's software rasterizer is enough, so it runs on
+// machines without a GPU.
+//
+//   frame_bench [--frames N] [--replay FILE] [--two-pass-stereo]
+//               [--width W] [--height H] [--max-p99-ms MS]
+//               [--vsync] [--refresh-hz HZ] [--tracking-latency-ms MS]
+//               [--trajectory still|look|turns] [--no-cull] [--no-lod]
+//               [--scene-strokes N] [--load SCENE] [--save SCENE]
+//               [--hands N] [--no-hands] [--check-hands]
+//               [--no-prediction] [--trace FILE]
+//               [--check-gpu-timers] [--no-gpu-timer-queries]
+//               [--early-pose] [--spline-tolerance-mm MM]
+//               [--stroke-style lines|ribbon|tube] [--stroke-radius-mm MM]
+//               [--tube-sides N] [--check-draw-calls]
+//
+// Frames run back to back unless --vsync paces them to the refresh rate
+// like the headset would.
+// Without --replay the hands are scripted: one finger draws a loop,
+// lifts, and starts the next one, so the scene keeps growing the way a
+// drawing session does.  --scene-strokes starts the session with N
+// finished loops scattered through a large volume in front of the
+// viewer, most of them far away.  --load starts it with a saved scene
+// and --save writes the completed strokes out at the end.  --hands adds
+// scripted fists next to the drawing hand, up to four hands in all.
+// With --max-p99-ms the exit status is 1 when the 99th percentile CPU
+// frame time goes over it.
+//
+// The live stroke ends and the hands are predicted up to the display time
+// of each frame unless --no-prediction is given.
+// The head pose is sampled after the scene is prepared, predicted to the
+// display time.  --early-pose samples it before, for the current time,
+// the way frames used to be put together.
+// Strokes are drawn as curves through their points within
+// --spline-tolerance-mm of the curve, 0 drawing straight lines.
+// --stroke-style picks what is built around the curve: tubes of
+// --tube-sides sides, the default, ribbons or plain lines.
+// --stroke-radius-mm is the radius of a tube or half a ribbon's width.
+// Straight lines drawn as lines are copied out of the stream ring when
+// their strokes end, so a lines run with --spline-tolerance-mm 0 fails
+// when it finishes strokes and copies none of them.
+// --trace times the stages of every frame, prints their histograms and
+// writes the Chrome trace of the last frames to FILE.  The GPU time of
+// each eye and pass is traced along with them when the context has timer
+// queries.
+// --check-gpu-timers traces and fails the run unless the GPU stages of
+// every frame but the last few were read back, none later than the
+// frame after, or, without timer queries, there are no GPU stages at
+// all.  --no-gpu-timer-queries runs without them as if the context had
+// none.
+// --check-hands renders the first frame that has hands a second time
+// without them and fails the run unless every hand's wrist shows up in
+// both eyes and all of them took one draw call.
+// --check-draw-calls draws the scene once more after the run with every
+// stroke in view, again with 1000 more strokes, and fails the run when
+// the strokes added take more than one draw call for every 10 of them.
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#elif __linux__
+#include <GL/gl.h>
+#endif
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "headers/Quaternion.h"
+#include "headers/bench_util.h"
+#include "headers/field_line.h"
+#include "headers/frame_trace.h"
+#include "headers/frame_record.h"
+#include "headers/gpu_timer.h"
+#include "headers/hand_input_processor.h"
+#include "headers/hand_renderer.h"
+#include "headers/hmd_backend.h"
+#include "headers/motion_predictor.h"
+#include "headers/scene_file.h"
+#include "headers/scene_renderer.h"
+#include "headers/scene_snapshot.h"
+#include "headers/simulated_hmd.h"
+#include "headers/stroke_mesh.h"
+#include "headers/stroke_spline.h"
+
+namespace {
+
+// Leap runs at about 90 Hz.
+const int64_t kScriptFrameMicros = 11111;
+// Frames per scripted stroke: the finger holds still for the dwell,
+// draws, then the hand leaves for a few frames.
+const int kScriptDwellFrames = 30;
+const int kScriptDrawFrames = 360;
+const int kScriptLiftFrames = 10;
+// Strokes --check-draw-calls adds, and how many of them may take a draw
+// call; strokes are batched by the page, so it is far fewer.
+const int kCheckDrawCallStrokes = 1000;
+const int kStrokesPerDrawCall = 10;
+
+// Finished loops of about the size the script draws, anywhere up to
+// 40 m in front of the default camera.
+void SeedStrokes(int count, pen_line::StrokeStore *store) {
+  const int kLoopPoints = 200;
+  std::minstd_rand random(1);
+  std::uniform_real_distribution<float> across(-10000.0f, 10000.0f);
+  std::uniform_real_distribution<float> height(-3000.0f, 3000.0f);
+  std::uniform_real_distribution<float> depth(-40000.0f, 0.0f);
+  std::uniform_real_distribution<float> radius(30.0f, 150.0f);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  for (int i = 0; i < count; i++) {
+    pen_line::Color color = { unit(random), unit(random), unit(random) };
+    Leap::Vector center(across(random), height(random), depth(random));
+    float r = radius(random);
+    float wobble = unit(random) * 6.0f;
+    unsigned int id = store->begin_stroke(color);
+    for (int j = 0; j < kLoopPoints; j++) {
+      float angle = 2.0f * M_PI * j / kLoopPoints;
+      store->append(id, center + Leap::Vector(r * cos(angle)
+                                            , r * sin(angle)
+                                            , wobble * sin(5.0f * angle)));
+    }
+    store->finish(id);
+  }
+}
+
+void ScriptFrame(int index, int hand_count
+               , frame_record::FrameRecord *record) {
+  memset(record, 0, sizeof(*record));
+  record->id = index;
+  record->timestamp = index * kScriptFrameMicros;
+
+  const int period = kScriptDwellFrames + kScriptDrawFrames
+                   + kScriptLiftFrames;
+  const int stroke = index / period;
+  const int step = index % period;
+  if (step >= kScriptDwellFrames + kScriptDrawFrames) {
+    record->hand_count = 0;
+    return;
+  }
+  frame_record::HandRecord &hand = record->hands[0];
+  hand.id = 1;
+  hand.extended_finger_count = 1;
+  hand.pointable_count = 5;
+  hand.confidence = 1.0f;
+  hand.basis[0] = 1.0f;
+  hand.basis[4] = 1.0f;
+  hand.basis[8] = 1.0f;
+  hand.direction[2] = -1.0f;
+  hand.palm_normal[1] = -1.0f;
+  hand.palm_position[1] = 200.0f;
+  hand.elbow_position[1] = 150.0f;
+  hand.elbow_position[2] = 250.0f;
+
+  // A wobbly loop, placed differently for each stroke.
+  const float t = std::max(0, step - kScriptDwellFrames) * 0.02f;
+  const float cx = (stroke % 7) * 40.0f - 120.0f;
+  const float cy = 150.0f + (stroke % 5) * 30.0f;
+  const float radius = 40.0f + (stroke % 3) * 20.0f;
+  for (int j = 0; j < frame_record::kFingerCount; j++) {
+    frame_record::FingerRecord &finger = hand.fingers[j];
+    finger.id = 10 + j;
+    finger.valid = 1;
+    finger.extended = (j == 1);
+    finger.tip_position[0] = cx + radius * cosf(t) + j * 15.0f;
+    finger.tip_position[1] = cy + radius * sinf(t * 1.3f);
+    finger.tip_position[2] = 20.0f * sinf(t * 0.7f) - j * 5.0f;
+    for (int k = 0; k < frame_record::kBoneCount; k++) {
+      for (int axis = 0; axis < 3; axis++) {
+        finger.bones[k].prev_joint[axis] =
+                    finger.tip_position[axis] - (4 - k) * 10.0f;
+        finger.bones[k].next_joint[axis] =
+                    finger.tip_position[axis] - (3 - k) * 10.0f;
+      }
+    }
+  }
+
+  // The other hands are fists on either side, which draw nothing.
+  for (int h = 1; h < hand_count; h++) {
+    const float shift = (h % 2 ? 1.0f : -1.0f) * ((h + 1) / 2) * 90.0f;
+    frame_record::HandRecord &fist = record->hands[h];
+    fist = hand;
+    fist.id = 1 + h;
+    fist.extended_finger_count = 0;
+    fist.palm_position[0] += shift;
+    fist.elbow_position[0] += shift;
+    for (int j = 0; j < frame_record::kFingerCount; j++) {
+      frame_record::FingerRecord &finger = fist.fingers[j];
+      finger.id = 10 * (h + 1) + j;
+      finger.extended = 0;
+      finger.tip_position[0] += shift;
+      for (int k = 0; k < frame_record::kBoneCount; k++) {
+        finger.bones[k].prev_joint[0] += shift;
+        finger.bones[k].next_joint[0] += shift;
+      }
+    }
+  }
+  record->hand_count = hand_count;
+}
+
+bool CreateContext(int width, int height) {
+  EGLDisplay display = EGL_NO_DISPLAY;
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+  PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+          reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+              eglGetProcAddress("eglGetPlatformDisplayEXT"));
+  if (get_platform_display) {
+    display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA
+                                  , EGL_DEFAULT_DISPLAY, NULL);
+  }
+#endif
+  if (display == EGL_NO_DISPLAY) {
+    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  }
+  EGLint major, minor;
+  if (!eglInitialize(display, &major, &minor)) {
+    printf("Cannot initialize EGL.\n");
+    return false;
+  }
+  if (!eglBindAPI(EGL_OPENGL_API)) {
+    printf("EGL has no desktop OpenGL.\n");
+    return false;
+  }
+  const EGLint config_attributes[] = {
+    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+    EGL_DEPTH_SIZE, 24,
+    EGL_NONE
+  };
+  EGLConfig config;
+  EGLint config_count = 0;
+  if (!eglChooseConfig(display, config_attributes, &config, 1, &config_count)
+      || config_count == 0) {
+    printf("No EGL config for an offscreen OpenGL context.\n");
+    return false;
+  }
+  // The scene still uses the fixed function pipeline.
+  const EGLint context_attributes[] = {
+    EGL_CONTEXT_MAJOR_VERSION, 4,
+    EGL_CONTEXT_MINOR_VERSION, 5,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK,
+    EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+    EGL_NONE
+  };
+  EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT
+                                      , context_attributes);
+  if (context == EGL_NO_CONTEXT) {
+    // Older drivers, take whatever compatibility context there is.
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT, NULL);
+  }
+  const EGLint surface_attributes[] = {
+    EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE
+  };
+  EGLSurface surface = eglCreatePbufferSurface(display, config
+                                              , surface_attributes);
+  if (context == EGL_NO_CONTEXT || surface == EGL_NO_SURFACE
+      || !eglMakeCurrent(display, surface, surface, context)) {
+    printf("Cannot create an offscreen OpenGL context.\n");
+    return false;
+  }
+  printf("GL: %s, %s\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+  return true;
+}
+
+// The same state init_opengl() in main.cc sets up.
+void InitOpenGL() {
+  glEnable(GL_DEPTH_TEST);
+
+  GLfloat mat_specular[] = { 1.0, 1.0, 1.0, 1.0 };
+  GLfloat mat_shininess[] = { 100.0 };
+  GLfloat light_position[] = { 1.0, 1.0, 1.0, 0.0 };
+  GLfloat white_light[] = { 1.0, 1.0, 1.0, 0.0 };
+  GLfloat lmodel_ambient[] = { 0.1, 0.1, 0.1, 1.0 };
+  glClearColor(0, 0, 0, 1.0f);
+  glMaterialfv(GL_FRONT, GL_SPECULAR, mat_specular);
+  glMaterialfv(GL_FRONT, GL_SHININESS, mat_shininess);
+  glLightfv(GL_LIGHT0, GL_POSITION, light_position);
+  glLightfv(GL_LIGHT0, GL_DIFFUSE, white_light);
+  glLightfv(GL_LIGHT0, GL_SPECULAR, white_light);
+  glLightModelfv(GL_LIGHT_MODEL_AMBIENT, lmodel_ambient);
+  glShadeModel(GL_SMOOTH);
+
+  glEnable(GL_LIGHTING);
+  glEnable(GL_LIGHT0);
+  glEnable(GL_COLOR_MATERIAL);
+}
+
+// out = m * in, m column major.
+void MultiplyPoint(const GLfloat m[16], const float in[4], float out[4]) {
+  for (int row = 0; row < 4; row++) {
+    out[row] = 0.0f;
+    for (int k = 0; k < 4; k++) {
+      out[row] += m[k * 4 + row] * in[k];
+    }
+  }
+}
+
+// Draws the scene without and with the hands and compares the pixel
+// under each wrist in both eyes.  Expects the scene prepared and the
+// HMD's framebuffer bound.
+bool CheckHands(const scene_snapshot::SceneSnapshot &scene
+              , field_line::FieldLine *bg_line
+              , const Quaternion &head_orientation
+              , const stereo_renderer::EyeViewport eye_viewport[2]
+              , scene_renderer::SceneRenderer *renderer) {
+  std::vector<unsigned char> pixels[2];
+  int draw_calls[2];
+  GLint viewport[4];
+  for (int pass = 0; pass < 2; pass++) {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    renderer->SetHands(pass == 1);
+    renderer->Render(bg_line, head_orientation, eye_viewport, 2);
+    draw_calls[pass] = renderer->stats().draw_calls;
+    glFinish();
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    pixels[pass].resize(viewport[2] * viewport[3] * 4);
+    glReadPixels(viewport[0], viewport[1], viewport[2], viewport[3]
+                , GL_RGBA, GL_UNSIGNED_BYTE, &pixels[pass][0]);
+  }
+  if (renderer->stats().hand_instances
+      != static_cast<size_t>(scene.skeleton_hands.count
+                             * hand_renderer::kInstancesPerHand)
+      || draw_calls[1] - draw_calls[0] != 1) {
+    printf("%d hands took %d draw calls for %lu instances\n"
+          , scene.skeleton_hands.count
+          , draw_calls[1] - draw_calls[0]
+          , static_cast<unsigned long>(  // NOLINT
+                              renderer->stats().hand_instances));
+    return false;
+  }
+  for (int h = 0; h < scene.skeleton_hands.count; h++) {
+    const Eigen::Vector4f &joint = scene.skeleton_hands.joints[h][20];
+    const float wrist[3] = { joint.x(), joint.y(), joint.z() };
+    float world[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    TransformPoint(scene.hand_to_world, wrist, world);
+    float view[4];
+    float clip[4];
+    MultiplyPoint(renderer->view().modelview, world, view);
+    MultiplyPoint(renderer->view().projection, view, clip);
+    if (clip[3] <= 0.0f || fabs(clip[0]) > clip[3]
+        || fabs(clip[1]) > clip[3]) {
+      printf("hand %d is out of view\n", h);
+      return false;
+    }
+    for (int eye = 0; eye < 2; eye++) {
+      int x = eye_viewport[eye].x - viewport[0] + static_cast<int>(
+                  (clip[0] / clip[3] + 1.0f) / 2.0f * eye_viewport[eye].width);
+      int y = eye_viewport[eye].y - viewport[1] + static_cast<int>(
+                  (clip[1] / clip[3] + 1.0f) / 2.0f * eye_viewport[eye].height);
+      size_t offset = (static_cast<size_t>(y) * viewport[2] + x) * 4;
+      if (memcmp(&pixels[0][offset], &pixels[1][offset], 3) == 0) {
+        printf("hand %d is missing from eye %d at %d, %d\n", h, eye, x, y);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Draws the scene with every stroke in view, adds strokes and draws it
+// again.  Run after the last frame, as it changes the scene.
+bool CheckDrawCalls(int frame_index, const Quaternion &head_orientation
+                  , const stereo_renderer::EyeViewport eye_viewport[2]
+                  , float aspect, field_line::FieldLine *bg_line
+                  , hand_listener::HandInputProcessor *processor
+                  , scene_renderer::SceneRenderer *renderer) {
+  renderer->SetFrustumCulling(false);
+  frame_record::FrameRecord record;
+  int draw_calls[2];
+  size_t strokes[2];
+  for (int pass = 0; pass < 2; pass++) {
+    if (pass == 1) {
+      SeedStrokes(kCheckDrawCallStrokes, &processor->strokes);
+    }
+    // A frame without hands publishes the strokes.
+    memset(&record, 0, sizeof(record));
+    record.id = frame_index + pass;
+    record.timestamp = record.id * kScriptFrameMicros;
+    processor->process_frame(record);
+    const scene_snapshot::SceneSnapshot &scene = processor->acquire_snapshot();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    renderer->Prepare(scene, aspect);
+    renderer->Render(bg_line, head_orientation, eye_viewport, 2);
+    glFinish();
+    draw_calls[pass] = renderer->stats().draw_calls;
+    strokes[pass] = renderer->stats().visible_strokes;
+  }
+  const int added_calls = draw_calls[1] - draw_calls[0];
+  const size_t added_strokes = strokes[1] - strokes[0];
+  printf("%lu strokes took %d draw calls, %lu more took %d more\n"
+        , static_cast<unsigned long>(strokes[0]), draw_calls[0]  // NOLINT
+        , static_cast<unsigned long>(added_strokes), added_calls);  // NOLINT
+  if (added_strokes != static_cast<size_t>(kCheckDrawCallStrokes)) {
+    printf("%d strokes were added but %lu more were drawn\n"
+          , kCheckDrawCallStrokes
+          , static_cast<unsigned long>(added_strokes));  // NOLINT
+    return false;
+  }
+  if (added_calls * kStrokesPerDrawCall > kCheckDrawCallStrokes) {
+    printf("draw calls grow with the stroke count\n");
+    return false;
+  }
+  return true;
+}
+
+bool IsGpuStage(const std::string &name) {
+  return name.compare(0, 4, "gpu ") == 0;
+}
+
+// Run after the last frame was collected.
+bool CheckGpuTimers(const gpu_timer::GpuTimer &timer, int frames
+                  , scene_renderer::StereoMode stereo_mode, bool hands) {
+  std::vector<frame_trace::StageStats> stats;
+  frame_trace::GetStageStats(&stats);
+  if (!timer.supported()) {
+    for (size_t i = 0; i < stats.size(); i++) {
+      if (IsGpuStage(stats[i].name)) {
+        printf("GPU stage %s without timer queries\n"
+              , stats[i].name.c_str());
+        return false;
+      }
+    }
+    printf("no timer queries, no GPU stages\n");
+    return true;
+  }
+  const unsigned long expected =  // NOLINT
+          std::max(0, frames - gpu_timer::kFrameSlots);
+  if (timer.resolved_frame_count() < expected) {
+    printf("%lu of %d frames had their GPU times read back\n"
+          , timer.resolved_frame_count(), frames);
+    return false;
+  }
+  if (timer.last_readback_latency() < 1) {
+    printf("GPU times were read back in the frame that issued them\n");
+    return false;
+  }
+  std::vector<const char *> stages;
+  stages.push_back("gpu frame");
+  stages.push_back("gpu end frame");
+  if (stereo_mode == scene_renderer::kStereoSinglePass) {
+    stages.push_back("gpu both eyes");
+  } else {
+    stages.push_back("gpu left eye");
+    stages.push_back("gpu right eye");
+    stages.push_back("gpu grid");
+    stages.push_back("gpu strokes");
+  }
+  if (hands) {
+    stages.push_back("gpu hands");
+  }
+  for (size_t i = 0; i < stages.size(); i++) {
+    bool found = false;
+    for (size_t j = 0; j < stats.size(); j++) {
+      if (stats[j].name == stages[i] && stats[j].total_count > 0) {
+        found = true;
+      }
+    }
+    if (!found) {
+      printf("no GPU times for %s\n", stages[i]);
+      return false;
+    }
+  }
+  return true;
+}
+
+void PrintTimes(const char *name, std::vector<double> times) {
+  std::sort(times.begin(), times.end());
+  printf("%-20s p50 %7.3f  p95 %7.3f  p99 %7.3f  max %7.3f ms\n"
+        , name
+        , bench_util::Percentile(times, 0.50)
+        , bench_util::Percentile(times, 0.95)
+        , bench_util::Percentile(times, 0.99)
+        , times.empty() ? 0.0 : times.back());
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  int frames = 2000;
+  double max_p99_ms = 0.0;
+  simulated_hmd::Config config = simulated_hmd::DefaultConfig();
+  config.vsync = false;
+  const char *replay_path = NULL;
+  const char *load_path = NULL;
+  const char *save_path = NULL;
+  scene_renderer::StereoMode stereo_mode = scene_renderer::kStereoSinglePass;
+  bool frustum_culling = true;
+  bool level_of_detail = true;
+  int scene_strokes = 0;
+  int hand_count = 1;
+  bool hands = true;
+  bool check_hands = false;
+  bool check_draw_calls = false;
+  bool prediction = true;
+  const char *trace_path = NULL;
+  bool check_gpu_timers = false;
+  bool early_pose = false;
+  bool gpu_timer_queries = true;
+  float spline_tolerance = stroke_spline::kDefaultTolerance;
+  stroke_mesh::Shape stroke_shape = stroke_mesh::DefaultShape();
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+      frames = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      replay_path = argv[++i];
+    } else if (strcmp(argv[i], "--load") == 0 && i + 1 < argc) {
+      load_path = argv[++i];
+    } else if (strcmp(argv[i], "--save") == 0 && i + 1 < argc) {
+      save_path = argv[++i];
+    } else if (strcmp(argv[i], "--two-pass-stereo") == 0) {
+      stereo_mode = scene_renderer::kStereoTwoPass;
+    } else if (strcmp(argv[i], "--width") == 0 && i + 1 < argc) {
+      config.width = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--height") == 0 && i + 1 < argc) {
+      config.height = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--vsync") == 0) {
+      config.vsync = true;
+    } else if (strcmp(argv[i], "--refresh-hz") == 0 && i + 1 < argc) {
+      config.refresh_hz = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--tracking-latency-ms") == 0 && i + 1 < argc) {
+      config.tracking_latency = atof(argv[++i]) / 1000.0;
+    } else if (strcmp(argv[i], "--trajectory") == 0 && i + 1 < argc) {
+      const char *name = argv[++i];
+      if (strcmp(name, "still") == 0) {
+        config.trajectory = simulated_hmd::kTrajectoryStill;
+      } else if (strcmp(name, "turns") == 0) {
+        config.trajectory = simulated_hmd::kTrajectoryQuickTurns;
+      } else {
+        config.trajectory = simulated_hmd::kTrajectoryLookAround;
+      }
+    } else if (strcmp(argv[i], "--no-cull") == 0) {
+      frustum_culling = false;
+    } else if (strcmp(argv[i], "--no-lod") == 0) {
+      level_of_detail = false;
+    } else if (strcmp(argv[i], "--scene-strokes") == 0 && i + 1 < argc) {
+      scene_strokes = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--hands") == 0 && i + 1 < argc) {
+      hand_count = std::max(1, std::min(frame_record::kMaxHands
+                                      , atoi(argv[++i])));
+    } else if (strcmp(argv[i], "--no-hands") == 0) {
+      hands = false;
+    } else if (strcmp(argv[i], "--check-hands") == 0) {
+      check_hands = true;
+    } else if (strcmp(argv[i], "--check-draw-calls") == 0) {
+      check_draw_calls = true;
+    } else if (strcmp(argv[i], "--no-prediction") == 0) {
+      prediction = false;
+    } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+      trace_path = argv[++i];
+    } else if (strcmp(argv[i], "--early-pose") == 0) {
+      early_pose = true;
+    } else if (strcmp(argv[i], "--check-gpu-timers") == 0) {
+      check_gpu_timers = true;
+    } else if (strcmp(argv[i], "--no-gpu-timer-queries") == 0) {
+      gpu_timer_queries = false;
+    } else if (strcmp(argv[i], "--spline-tolerance-mm") == 0
+               && i + 1 < argc) {
+      spline_tolerance = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--stroke-style") == 0 && i + 1 < argc) {
+      const char *name = argv[++i];
+      if (strcmp(name, "lines") == 0) {
+        stroke_shape.style = stroke_mesh::kLines;
+      } else if (strcmp(name, "ribbon") == 0) {
+        stroke_shape.style = stroke_mesh::kRibbon;
+      } else if (strcmp(name, "tube") == 0) {
+        stroke_shape.style = stroke_mesh::kTube;
+      } else {
+        printf("Unknown stroke style %s\n", name);
+        return 2;
+      }
+    } else if (strcmp(argv[i], "--stroke-radius-mm") == 0 && i + 1 < argc) {
+      stroke_shape.radius = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--tube-sides") == 0 && i + 1 < argc) {
+      stroke_shape.sides = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--max-p99-ms") == 0 && i + 1 < argc) {
+      max_p99_ms = atof(argv[++i]);
+    } else {
+      printf("Unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  frame_record::FrameReplay replay;
+  if (replay_path) {
+    if (!replay.Open(replay_path)) {
+      return 2;
+    }
+    if (replay.frame_count() == 0) {
+      printf("%s has no frames.\n", replay_path);
+      return 2;
+    }
+  }
+  if (!CreateContext(config.width, config.height)) {
+    return 2;
+  }
+  InitOpenGL();
+
+  hand_listener::HandInputProcessor processor;
+  if (load_path && !scene_file::Load(load_path, &processor.strokes)) {
+    return 2;
+  }
+  SeedStrokes(scene_strokes, &processor.strokes);
+  const size_t seeded_strokes = processor.strokes.completed().size();
+  field_line::FieldLine background_line;
+  scene_renderer::SceneRenderer renderer;
+  renderer.SetStereoMode(stereo_mode);
+  renderer.SetFrustumCulling(frustum_culling);
+  renderer.SetLevelOfDetail(level_of_detail);
+  renderer.SetHands(hands);
+  renderer.SetSplineTolerance(spline_tolerance);
+  renderer.SetStrokeShape(stroke_shape);
+  simulated_hmd::SimulatedHmd hmd(config);
+  hmd.SetupRendering();
+  gpu_timer::GpuTimer gpu_timing;
+  if (gpu_timer_queries && gpu_timing.Initialize()) {
+    renderer.SetGpuTimer(&gpu_timing);
+  } else {
+    printf("No GPU timer queries.\n");
+  }
+
+  hmd_backend::EyeDesc eye_desc[hmd_backend::kEyeCount];
+  stereo_renderer::EyeViewport eye_viewport[hmd_backend::kEyeCount];
+  hmd.GetEyeDescs(eye_desc);
+  for (int eye = 0; eye < hmd_backend::kEyeCount; eye++) {
+    eye_viewport[eye] = eye_desc[eye].viewport;
+  }
+  const float aspect = eye_viewport[0].width
+                     / static_cast<float>(eye_viewport[0].height);
+
+  std::vector<double> cpu_times;
+  std::vector<double> frame_times;
+  std::vector<double> pose_ages;
+  std::vector<double> submit_pose_ages;
+  std::vector<double> pose_errors;
+  std::vector<double> horizons;
+  cpu_times.reserve(frames);
+  frame_times.reserve(frames);
+  pose_ages.reserve(frames);
+  submit_pose_ages.reserve(frames);
+  pose_errors.reserve(frames);
+  horizons.reserve(frames);
+  unsigned long long draw_calls = 0;  // NOLINT
+  unsigned long long vertices = 0;  // NOLINT
+  int max_draw_calls = 0;
+  unsigned long max_vertices = 0;  // NOLINT
+  unsigned long long visible_strokes = 0;  // NOLINT
+  unsigned long long hand_instances = 0;  // NOLINT
+  // What building the instance buffer costs, on frames with hands.
+  std::vector<double> hand_build_times;
+  std::vector<hand_renderer::HandInstance> instances;
+  bool hands_checked = false;
+
+  const bool tracing = trace_path || check_gpu_timers;
+  if (tracing) {
+    frame_trace::SetThreadName("render");
+    frame_trace::SetEnabled(true);
+  }
+  frame_record::FrameRecord record;
+  for (int i = 0; i < frames; i++) {
+    // Input runs on its own thread in the app; it is kept out of the
+    // frame time here.
+    if (replay_path) {
+      replay.Read(i % replay.frame_count(), &record);
+    } else {
+      ScriptFrame(i, hand_count, &record);
+    }
+    processor.process_frame(record);
+
+    std::chrono::steady_clock::time_point start =
+                                      std::chrono::steady_clock::now();
+    const scene_snapshot::SceneSnapshot &scene = processor.acquire_snapshot();
+    hmd_backend::FrameTiming timing;
+    hmd.BeginFrame(&timing);
+    gpu_timing.BeginFrame();
+    gpu_timing.Begin("gpu frame");
+    if (prediction) {
+      const float horizon = motion_predictor::Horizon(
+                              scene.received_time
+                            , timing.display_time - hmd.Now()
+                            , motion_predictor::kDefaultTrackingLatency);
+      renderer.SetPredictionHorizon(horizon);
+      horizons.push_back(horizon * 1000.0);
+    }
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    hmd_backend::Pose pose;
+    if (early_pose) {
+      hmd.Track(hmd.Now(), &pose);
+    }
+    renderer.Prepare(scene, aspect);
+    if (!early_pose) {
+      hmd.Track(timing.display_time, &pose);
+    }
+    renderer.Render(&background_line, conj(pose.orientation)
+                  , eye_viewport, hmd_backend::kEyeCount);
+    glFlush();
+    std::chrono::steady_clock::time_point submitted =
+                                      std::chrono::steady_clock::now();
+    if (check_hands && !hands_checked && scene.skeleton_hands.count > 0) {
+      if (!CheckHands(scene, &background_line, conj(pose.orientation)
+                    , eye_viewport, &renderer)) {
+        return 1;
+      }
+      printf("%d hands drawn in both eyes with one draw call\n"
+            , scene.skeleton_hands.count);
+      hands_checked = true;
+    }
+    gpu_timing.End();
+    // Waits for the rasterizer, and for the refresh with --vsync.
+    {
+      FRAME_TRACE_SCOPE("end frame");
+      GPU_TIMER_SCOPE(&gpu_timing, "gpu end frame");
+      hmd.EndFrame();
+    }
+    gpu_timing.EndFrame();
+    std::chrono::steady_clock::time_point finished =
+                                      std::chrono::steady_clock::now();
+    pose_ages.push_back(hmd.last_pose_age() * 1000.0);
+    submit_pose_ages.push_back(hmd.last_submit_pose_age() * 1000.0);
+    pose_errors.push_back(hmd.last_pose_error());
+
+    cpu_times.push_back(std::chrono::duration<double, std::milli>(
+                                      submitted - start).count());
+    frame_times.push_back(std::chrono::duration<double, std::milli>(
+                                      finished - start).count());
+    const scene_renderer::FrameStats &stats = renderer.stats();
+    draw_calls += stats.draw_calls;
+    vertices += stats.vertices;
+    max_draw_calls = std::max(max_draw_calls, stats.draw_calls);
+    max_vertices = std::max(max_vertices, stats.vertices);
+    visible_strokes += stats.visible_strokes;
+    hand_instances += stats.hand_instances;
+
+    if (scene.skeleton_hands.count > 0) {
+      std::chrono::steady_clock::time_point build =
+                                      std::chrono::steady_clock::now();
+      hand_renderer::BuildInstances(scene.skeleton_hands
+                                  , scene.hand_to_world, &instances);
+      hand_build_times.push_back(std::chrono::duration<double, std::micro>(
+                                      std::chrono::steady_clock::now()
+                                      - build).count());
+    }
+    if (tracing) {
+      frame_trace::Collect();
+    }
+  }
+
+  if (check_hands && !hands_checked) {
+    printf("no frame had hands to check\n");
+    return 1;
+  }
+  if (glGetError() != GL_NO_ERROR) {
+    printf("GL error during the run.\n");
+    return 2;
+  }
+  if (save_path
+      && !scene_file::Save(save_path, processor.acquire_snapshot().strokes)) {
+    return 2;
+  }
+
+  printf("frames %d, %dx%d, %s stereo, %s input\n"
+        , frames, config.width, config.height
+        , stereo_mode == scene_renderer::kStereoSinglePass
+            ? "single pass" : "two pass"
+        , replay_path ? "replayed" : "scripted");
+  const size_t drawn_strokes =
+                    processor.strokes.completed().size() - seeded_strokes;
+  printf("strokes %lu, stored points %lu, sampled points %lu\n"
+        , static_cast<unsigned long>(processor.strokes.completed().size())  // NOLINT
+        , static_cast<unsigned long>(processor.strokes.point_count())  // NOLINT
+        , processor.sampled_point_count());
+  printf("strokes drawn %lu, copied out of the stream ring %lu\n"
+        , static_cast<unsigned long>(drawn_strokes)  // NOLINT
+        , static_cast<unsigned long>(renderer.migrated_stroke_count()));  // NOLINT
+  PrintTimes("cpu frame time", cpu_times);
+  PrintTimes("frame + end frame", frame_times);
+  PrintTimes("pose age at submit", submit_pose_ages);
+  PrintTimes("pose age at scanout", pose_ages);
+  std::sort(pose_errors.begin(), pose_errors.end());
+  printf("%-20s p50 %7.3f  p95 %7.3f  p99 %7.3f  max %7.3f deg\n"
+        , "head pose error"
+        , bench_util::Percentile(pose_errors, 0.50)
+        , bench_util::Percentile(pose_errors, 0.95)
+        , bench_util::Percentile(pose_errors, 0.99)
+        , pose_errors.empty() ? 0.0 : pose_errors.back());
+  if (prediction) {
+    PrintTimes("prediction horizon", horizons);
+  }
+  printf("refresh %.0f Hz%s, missed refreshes %lu\n"
+        , config.refresh_hz, config.vsync ? " paced" : ""
+        , hmd.missed_frame_count());
+  printf("draw calls / frame  mean %.1f  max %d\n"
+        , frames > 0 ? draw_calls / static_cast<double>(frames) : 0.0
+        , max_draw_calls);
+  printf("vertices / frame    mean %.0f  max %lu\n"
+        , frames > 0 ? vertices / static_cast<double>(frames) : 0.0
+        , max_vertices);
+  printf("visible strokes     mean %.0f%s%s\n"
+        , frames > 0 ? visible_strokes / static_cast<double>(frames) : 0.0
+        , frustum_culling ? "" : ", culling off"
+        , level_of_detail ? "" : ", level of detail off");
+  std::sort(hand_build_times.begin(), hand_build_times.end());
+  printf("hand instances      mean %.0f%s, build p50 %.2f  p99 %.2f us\n"
+        , frames > 0 ? hand_instances / static_cast<double>(frames) : 0.0
+        , hands ? "" : " (hands off)"
+        , bench_util::Percentile(hand_build_times, 0.50)
+        , bench_util::Percentile(hand_build_times, 0.99));
+  if (tracing) {
+    frame_trace::PrintStageStats();
+    if (gpu_timing.supported()) {
+      printf("gpu frames read back %lu, dropped %lu, %d frames late\n"
+            , gpu_timing.resolved_frame_count()
+            , gpu_timing.dropped_frame_count()
+            , gpu_timing.last_readback_latency());
+    }
+  }
+  if (trace_path && !frame_trace::WriteChromeTrace(trace_path)) {
+    return 2;
+  }
+  if (stroke_shape.style == stroke_mesh::kLines && spline_tolerance <= 0.0f
+      && drawn_strokes > 0 && renderer.migrated_stroke_count() == 0) {
+    printf("no stroke was copied out of the stream ring\n");
+    return 1;
+  }
+  if (check_gpu_timers
+      && !CheckGpuTimers(gpu_timing, frames, stereo_mode, hands)) {
+    return 1;
+  }
+  if (check_draw_calls) {
+    hmd_backend::Pose pose;
+    hmd.Track(hmd.Now(), &pose);
+    if (!CheckDrawCalls(frames, conj(pose.orientation), eye_viewport, aspect
+                      , &background_line, &processor, &renderer)) {
+      return 1;
+    }
+  }
+
+  std::sort(cpu_times.begin(), cpu_times.end());
+  if (max_p99_ms > 0.0
+      && bench_util::Percentile(cpu_times, 0.99) > max_p99_ms) {
+    printf("p99 cpu frame time is over %.3f ms\n", max_p99_ms);
+    return 1;
+  }
+  return 0;
+}
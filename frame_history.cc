@@ -0,0 +1,136 @@
+// Copyright 2015 Makoto Yano
+
+#include <math.h>
+#include <string.h>
+
+#include "headers/frame_history.h"
+
+namespace frame_history {
+
+namespace {
+
+void Lerp(const float *a, const float *b, float t, int count, float *out) {
+  for (int i = 0; i < count; i++) {
+    out[i] = a[i] + (b[i] - a[i]) * t;
+  }
+}
+
+void Normalize(float v[3]) {
+  const float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+  if (length > 0.0f) {
+    v[0] /= length;
+    v[1] /= length;
+    v[2] /= length;
+  }
+}
+
+const frame_record::HandRecord *FindHand(
+                                  const frame_record::FrameRecord &frame
+                                , int32_t id) {
+  for (int i = 0; i < frame.hand_count; i++) {
+    if (frame.hands[i].id == id) {
+      return &frame.hands[i];
+    }
+  }
+  return NULL;
+}
+
+}  // namespace
+
+void BlendHand(const frame_record::HandRecord &a
+             , const frame_record::HandRecord &b, float t
+             , frame_record::HandRecord *out) {
+  *out = t < 0.5f ? a : b;
+  out->confidence = a.confidence + (b.confidence - a.confidence) * t;
+  out->grab_strength = a.grab_strength
+                     + (b.grab_strength - a.grab_strength) * t;
+  Lerp(a.palm_position, b.palm_position, t, 3, out->palm_position);
+  Lerp(a.palm_normal, b.palm_normal, t, 3, out->palm_normal);
+  Normalize(out->palm_normal);
+  Lerp(a.direction, b.direction, t, 3, out->direction);
+  Normalize(out->direction);
+  // Frames are a few milliseconds apart, so the blended basis is only
+  // slightly off orthogonal; each axis is kept unit length.
+  Lerp(a.basis, b.basis, t, 9, out->basis);
+  Normalize(out->basis);
+  Normalize(out->basis + 3);
+  Normalize(out->basis + 6);
+  Lerp(a.elbow_position, b.elbow_position, t, 3, out->elbow_position);
+  Lerp(a.wrist_position, b.wrist_position, t, 3, out->wrist_position);
+  for (int i = 0; i < frame_record::kFingerCount; i++) {
+    const frame_record::FingerRecord &finger_a = a.fingers[i];
+    const frame_record::FingerRecord &finger_b = b.fingers[i];
+    if (!finger_a.valid || !finger_b.valid || finger_a.id != finger_b.id) {
+      continue;
+    }
+    frame_record::FingerRecord &finger = out->fingers[i];
+    Lerp(finger_a.tip_position, finger_b.tip_position, t, 3
+       , finger.tip_position);
+    for (int j = 0; j < frame_record::kBoneCount; j++) {
+      Lerp(finger_a.bones[j].prev_joint, finger_b.bones[j].prev_joint, t, 3
+         , finger.bones[j].prev_joint);
+      Lerp(finger_a.bones[j].next_joint, finger_b.bones[j].next_joint, t, 3
+         , finger.bones[j].next_joint);
+    }
+  }
+}
+
+FrameHistory::FrameHistory()
+  : first_(0), count_(0) {
+  memset(frames_, 0, sizeof(frames_));
+}
+
+void FrameHistory::Add(const frame_record::FrameRecord &frame) {
+  if (count_ > 0 && frame.timestamp <= newest().timestamp) {
+    return;
+  }
+  if (count_ < kHistoryFrames) {
+    frames_[(first_ + count_++) % kHistoryFrames] = frame;
+  } else {
+    frames_[first_] = frame;
+    first_ = (first_ + 1) % kHistoryFrames;
+  }
+}
+
+bool FrameHistory::Sample(int64_t timestamp
+                        , frame_record::FrameRecord *out) const {
+  if (count_ == 0) {
+    return false;
+  }
+  if (timestamp >= newest().timestamp) {
+    *out = newest();
+    return true;
+  }
+  if (timestamp <= frame(0).timestamp) {
+    *out = frame(0);
+    return true;
+  }
+  int after = count_ - 1;
+  while (frame(after - 1).timestamp >= timestamp) {
+    --after;
+  }
+  const frame_record::FrameRecord &a = frame(after - 1);
+  const frame_record::FrameRecord &b = frame(after);
+  const float t = static_cast<float>(timestamp - a.timestamp)
+                / static_cast<float>(b.timestamp - a.timestamp);
+  const frame_record::FrameRecord &nearer = t < 0.5f ? a : b;
+  out->id = nearer.id;
+  out->timestamp = timestamp;
+  out->hand_count = nearer.hand_count;
+  out->padding = 0;
+  for (int i = 0; i < nearer.hand_count; i++) {
+    const frame_record::HandRecord &hand = nearer.hands[i];
+    const frame_record::HandRecord *other =
+                                FindHand(t < 0.5f ? b : a, hand.id);
+    if (!other) {
+      out->hands[i] = hand;
+    } else if (t < 0.5f) {
+      BlendHand(hand, *other, t, &out->hands[i]);
+    } else {
+      BlendHand(*other, hand, t, &out->hands[i]);
+    }
+  }
+  return true;
+}
+
+}  // namespace frame_history
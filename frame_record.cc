@@ -0,0 +1,163 @@
+// Copyright 2015 Makoto Yano
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <thread>
+
+#include "headers/frame_record.h"
+
+namespace frame_record {
+
+namespace {
+
+const char kMagic[4] = { 'O', 'W', 'L', 'F' };
+const size_t kFrameHeaderSize = offsetof(FrameRecord, hands);
+
+}  // namespace
+
+FrameRecorder::FrameRecorder() : file_(NULL), frame_count_(0) {
+}
+
+FrameRecorder::~FrameRecorder() {
+  Close();
+}
+
+bool FrameRecorder::Open(const char *path) {
+  Close();
+  file_ = fopen(path, "wb");
+  if (!file_) {
+    printf("Cannot open %s for recording.\n", path);
+    return false;
+  }
+  FileHeader header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kFileVersion;
+  header.frame_header_size = kFrameHeaderSize;
+  header.hand_record_size = sizeof(HandRecord);
+  fwrite(&header, sizeof(header), 1, file_);
+  frame_count_ = 0;
+  return true;
+}
+
+void FrameRecorder::Close() {
+  if (file_) {
+    fclose(file_);
+    file_ = NULL;
+  }
+}
+
+void FrameRecorder::Write(const FrameRecord &record) {
+  if (!file_) {
+    return;
+  }
+  fwrite(&record, kFrameHeaderSize, 1, file_);
+  fwrite(record.hands, sizeof(HandRecord), record.hand_count, file_);
+  ++frame_count_;
+}
+
+FrameReplay::FrameReplay() : data_(NULL), size_(0) {
+}
+
+FrameReplay::~FrameReplay() {
+  Close();
+}
+
+bool FrameReplay::Open(const char *path) {
+  Close();
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    printf("Cannot open recording %s.\n", path);
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0
+      || static_cast<size_t>(file_stat.st_size) < sizeof(FileHeader)) {
+    printf("Recording %s is too short.\n", path);
+    close(fd);
+    return false;
+  }
+  size_ = file_stat.st_size;
+  void *mapped = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    printf("Cannot map recording %s.\n", path);
+    size_ = 0;
+    return false;
+  }
+  data_ = static_cast<const unsigned char *>(mapped);
+
+  FileHeader header;
+  memcpy(&header, data_, sizeof(header));
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0
+      || header.version != kFileVersion
+      || header.frame_header_size != kFrameHeaderSize
+      || header.hand_record_size != sizeof(HandRecord)) {
+    printf("%s is not a recording this build can read.\n", path);
+    Close();
+    return false;
+  }
+
+  // A recording cut short by a crash just ends at the last whole frame.
+  size_t offset = sizeof(FileHeader);
+  while (offset + kFrameHeaderSize <= size_) {
+    FrameRecord frame_header;
+    memcpy(&frame_header, data_ + offset, kFrameHeaderSize);
+    if (frame_header.hand_count < 0 || frame_header.hand_count > kMaxHands) {
+      break;
+    }
+    size_t frame_size = kFrameHeaderSize
+                        + frame_header.hand_count * sizeof(HandRecord);
+    if (offset + frame_size > size_) {
+      break;
+    }
+    offsets_.push_back(offset);
+    offset += frame_size;
+  }
+  return true;
+}
+
+void FrameReplay::Close() {
+  if (data_) {
+    munmap(const_cast<unsigned char *>(data_), size_);
+    data_ = NULL;
+  }
+  size_ = 0;
+  offsets_.clear();
+}
+
+void FrameReplay::Read(size_t index, FrameRecord *record) const {
+  const unsigned char *frame = data_ + offsets_[index];
+  memcpy(record, frame, kFrameHeaderSize);
+  memcpy(record->hands, frame + kFrameHeaderSize
+        , record->hand_count * sizeof(HandRecord));
+}
+
+void FrameReplay::Play(
+              const std::function<bool(const FrameRecord &)> &on_frame
+            , bool realtime) const {
+  FrameRecord record;
+  std::chrono::steady_clock::time_point start =
+                                      std::chrono::steady_clock::now();
+  int64_t first_timestamp = 0;
+  for (size_t i = 0; i < frame_count(); i++) {
+    Read(i, &record);
+    if (i == 0) {
+      first_timestamp = record.timestamp;
+    }
+    if (realtime) {
+      std::this_thread::sleep_until(start + std::chrono::microseconds(
+                                    record.timestamp - first_timestamp));
+    }
+    if (!on_frame(record)) {
+      return;
+    }
+  }
+}
+
+}  // namespace frame_record
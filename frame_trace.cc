@@ -0,0 +1,269 @@
+// Copyright 2015 Makoto Yano
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+#include "headers/frame_trace.h"
+
+namespace frame_trace {
+
+std::atomic<bool> enabled_flag(false);
+
+struct Event {
+  const char *name;
+  int64_t begin;
+  int64_t duration;
+};
+
+// Events one thread, or one track, has recorded.
+struct Ring {
+  Ring() : name(NULL), id(0), head(0), collected(0) {}
+
+  const char *name;
+  int id;
+  // Events written so far; the writer is the only one to move it.
+  std::atomic<uint64_t> head;
+  // Collect() side: events already folded into the histograms.
+  uint64_t collected;
+  Event events[kRingEvents];
+};
+
+namespace {
+
+// Four buckets per power of two of nanoseconds, up to 2^48 ns.
+const int kBucketCount = 4 * 48;
+
+// Rings are never freed, so the events of a thread that ended still make
+// it into the trace.
+std::mutex registry_mutex;
+std::vector<Ring *> rings;
+thread_local Ring *thread_ring = NULL;
+
+Ring *NewRing() {
+  Ring *ring = new Ring();
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  ring->id = rings.size() + 1;
+  rings.push_back(ring);
+  return ring;
+}
+
+Ring *CurrentRing() {
+  if (!thread_ring) {
+    thread_ring = NewRing();
+  }
+  return thread_ring;
+}
+
+void GetRings(std::vector<Ring *> *out) {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  *out = rings;
+}
+
+// Appends the events of ring from index first on to out, oldest first,
+// and returns the index after the last one.  The writer doesn't wait for
+// readers, so events it may have overwritten during the copy are dropped
+// again.
+uint64_t ReadRing(const Ring &ring, uint64_t first
+                , std::vector<Event> *out) {
+  const uint64_t head = ring.head.load(std::memory_order_acquire);
+  if (head > kRingEvents) {
+    first = std::max<uint64_t>(first, head - kRingEvents);
+  }
+  const size_t start = out->size();
+  for (uint64_t i = first; i < head; i++) {
+    out->push_back(ring.events[i % kRingEvents]);
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const uint64_t after = ring.head.load(std::memory_order_relaxed);
+  if (after > kRingEvents && after - kRingEvents > first) {
+    const uint64_t lost = std::min(after - kRingEvents - first
+                                 , head - first);
+    out->erase(out->begin() + start, out->begin() + start + lost);
+  }
+  return head;
+}
+
+int Bucket(int64_t nanoseconds) {
+  if (nanoseconds < 4) {
+    return nanoseconds < 0 ? 0 : static_cast<int>(nanoseconds);
+  }
+  const int msb = 63 - __builtin_clzll(nanoseconds);
+  const int quarter = static_cast<int>((nanoseconds >> (msb - 2)) & 3);
+  return std::min(kBucketCount - 1, msb * 4 + quarter);
+}
+
+// Largest duration that falls in bucket, in nanoseconds.
+int64_t BucketLimit(int bucket) {
+  if (bucket < 4) {
+    return bucket;
+  }
+  const int msb = bucket / 4;
+  return ((static_cast<int64_t>(4 + bucket % 4 + 1)) << (msb - 2)) - 1;
+}
+
+// Bucket counts of the latest kHistogramWindow durations of one stage.
+struct Histogram {
+  Histogram() : next(0), total(0) {
+    std::fill(buckets, buckets + kBucketCount, 0);
+  }
+
+  void add(int64_t duration) {
+    const int bucket = Bucket(duration);
+    if (window.size() < static_cast<size_t>(kHistogramWindow)) {
+      window.push_back(bucket);
+    } else {
+      --buckets[window[next]];
+      window[next] = bucket;
+      next = (next + 1) % kHistogramWindow;
+    }
+    ++buckets[bucket];
+    ++total;
+  }
+
+  // Milliseconds.
+  double percentile(double p) const {
+    if (window.empty()) {
+      return 0.0;
+    }
+    const unsigned int rank = static_cast<unsigned int>(
+                                  p * (window.size() - 1) + 0.5) + 1;
+    unsigned int seen = 0;
+    for (int bucket = 0; bucket < kBucketCount; bucket++) {
+      seen += buckets[bucket];
+      if (seen >= rank) {
+        return BucketLimit(bucket) / 1e6;
+      }
+    }
+    return 0.0;
+  }
+
+  unsigned int buckets[kBucketCount];
+  std::vector<unsigned char> window;
+  size_t next;
+  unsigned long total;  // NOLINT
+};
+
+std::map<std::string, Histogram> histograms;
+std::vector<Event> collected_events;
+
+}  // namespace
+
+void SetEnabled(bool enabled) {
+  enabled_flag.store(enabled, std::memory_order_relaxed);
+}
+
+void SetThreadName(const char *name) {
+  CurrentRing()->name = name;
+}
+
+Ring *AddTrack(const char *name) {
+  Ring *ring = NewRing();
+  ring->name = name;
+  return ring;
+}
+
+void Record(const char *name, int64_t begin, int64_t end) {
+  Record(CurrentRing(), name, begin, end);
+}
+
+void Record(Ring *ring, const char *name, int64_t begin, int64_t end) {
+  const uint64_t head = ring->head.load(std::memory_order_relaxed);
+  Event &event = ring->events[head % kRingEvents];
+  event.name = name;
+  event.begin = begin;
+  event.duration = end - begin;
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+void Collect() {
+  std::vector<Ring *> current_rings;
+  GetRings(&current_rings);
+  for (size_t i = 0; i < current_rings.size(); i++) {
+    Ring *ring = current_rings[i];
+    collected_events.clear();
+    ring->collected = ReadRing(*ring, ring->collected, &collected_events);
+    for (size_t j = 0; j < collected_events.size(); j++) {
+      const Event &event = collected_events[j];
+      histograms[event.name].add(event.duration);
+    }
+  }
+}
+
+void GetStageStats(std::vector<StageStats> *stats) {
+  stats->clear();
+  for (std::map<std::string, Histogram>::const_iterator histogram
+          = histograms.begin()
+      ; histogram != histograms.end()
+      ; histogram++) {
+    const Histogram &h = (*histogram).second;
+    StageStats stage;
+    stage.name = (*histogram).first;
+    stage.window_count = h.window.size();
+    stage.total_count = h.total;
+    stage.p50 = h.percentile(0.50);
+    stage.p95 = h.percentile(0.95);
+    stage.p99 = h.percentile(0.99);
+    stage.max = h.percentile(1.0);
+    stats->push_back(stage);
+  }
+}
+
+void PrintStageStats() {
+  std::vector<StageStats> stats;
+  GetStageStats(&stats);
+  for (size_t i = 0; i < stats.size(); i++) {
+    printf("%-20s p50 %7.3f  p95 %7.3f  p99 %7.3f  max %7.3f ms"
+           "  (%lu scopes)\n"
+          , stats[i].name.c_str(), stats[i].p50, stats[i].p95
+          , stats[i].p99, stats[i].max, stats[i].total_count);
+  }
+}
+
+bool WriteChromeTrace(const char *path) {
+  FILE *file = fopen(path, "w");
+  if (!file) {
+    printf("Can't write the trace to %s.\n", path);
+    return false;
+  }
+  std::vector<Ring *> current_rings;
+  GetRings(&current_rings);
+  std::vector<std::vector<Event> > events(current_rings.size());
+  int64_t origin = INT64_MAX;
+  for (size_t i = 0; i < current_rings.size(); i++) {
+    ReadRing(*current_rings[i], 0, &events[i]);
+    if (!events[i].empty()) {
+      origin = std::min(origin, events[i].front().begin);
+    }
+  }
+
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  const char *separator = "\n";
+  for (size_t i = 0; i < current_rings.size(); i++) {
+    const Ring &ring = *current_rings[i];
+    if (ring.name) {
+      fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1"
+                    ",\"tid\":%d,\"args\":{\"name\":\"%s\"}}"
+             , separator, ring.id, ring.name);
+      separator = ",\n";
+    }
+    for (size_t j = 0; j < events[i].size(); j++) {
+      const Event &event = events[i][j];
+      fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d"
+                    ",\"ts\":%.3f,\"dur\":%.3f}"
+             , separator, event.name, ring.id
+             , (event.begin - origin) / 1000.0, event.duration / 1000.0);
+      separator = ",\n";
+    }
+  }
+  fprintf(file, "\n]}\n");
+  if (fclose(file) != 0) {
+    printf("Can't write the trace to %s.\n", path);
+    return false;
+  }
+  return true;
+}
+
+}  // namespace frame_trace
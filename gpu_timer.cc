@@ -0,0 +1,192 @@
+// Copyright 2015 Makoto Yano
+
+#include <stdio.h>
+#include <string.h>
+
+#include "headers/frame_trace.h"
+#include "headers/gpu_timer.h"
+
+namespace gpu_timer {
+
+namespace {
+
+// The GPU and CPU clocks drift apart slowly; they are lined up again
+// this often.
+const uint64_t kCalibrationFrames = 512;
+
+}  // namespace
+
+GpuTimer::GpuTimer()
+  : track_(NULL), current_(NULL), frame_number_(0), open_count_(0)
+  , clock_offset_(0), calibrated_frame_(0)
+  , resolved_frames_(0), dropped_frames_(0), last_readback_latency_(0) {
+  memset(frames_, 0, sizeof(frames_));
+}
+
+GpuTimer::~GpuTimer() {
+#ifdef GL_TIMESTAMP
+  if (track_) {
+    for (int i = 0; i < kFrameSlots; i++) {
+      glDeleteQueries(2 * kMaxScopes, frames_[i].queries);
+    }
+  }
+#endif
+}
+
+bool GpuTimer::Initialize() {
+#ifdef GL_TIMESTAMP
+  int major = 0;
+  int minor = 0;
+  const char *version =
+              reinterpret_cast<const char *>(glGetString(GL_VERSION));
+  if (!version || sscanf(version, "%d.%d", &major, &minor) != 2) {
+    return false;
+  }
+  if (major < 3 || (major == 3 && minor < 3)) {
+    const char *extensions =
+              reinterpret_cast<const char *>(glGetString(GL_EXTENSIONS));
+    if (!extensions || !strstr(extensions, "GL_ARB_timer_query")) {
+      return false;
+    }
+  }
+  // Zero bits means the counter is there but never counts.
+  GLint bits = 0;
+  glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+  if (glGetError() != GL_NO_ERROR || bits == 0) {
+    return false;
+  }
+  for (int i = 0; i < kFrameSlots; i++) {
+    glGenQueries(2 * kMaxScopes, frames_[i].queries);
+  }
+  track_ = frame_trace::AddTrack("gpu");
+  Calibrate_();
+  return true;
+#else
+  return false;
+#endif
+}
+
+void GpuTimer::BeginFrame() {
+  if (!track_) {
+    return;
+  }
+  ReadBack_();
+  current_ = NULL;
+  if (!frame_trace::Enabled()) {
+    return;
+  }
+  if (frame_number_ - calibrated_frame_ >= kCalibrationFrames) {
+    Calibrate_();
+  }
+  Frame &frame = frames_[frame_number_ % kFrameSlots];
+  if (frame.pending) {
+    frame.pending = false;
+    ++dropped_frames_;
+  }
+  frame.number = frame_number_++;
+  frame.query_count = 0;
+  frame.interval_count = 0;
+  current_ = &frame;
+  open_count_ = 0;
+}
+
+void GpuTimer::EndFrame() {
+  if (!current_) {
+    return;
+  }
+  current_->pending = current_->interval_count > 0;
+  current_ = NULL;
+}
+
+void GpuTimer::Begin(const char *name) {
+#ifdef GL_TIMESTAMP
+  if (!current_) {
+    return;
+  }
+  // Deeper than kMaxScopes there can't be an interval left anyway.
+  if (open_count_ < kMaxScopes) {
+    int index = -1;
+    if (current_->interval_count < kMaxScopes) {
+      index = current_->interval_count++;
+      Interval &interval = current_->intervals[index];
+      interval.name = name;
+      interval.begin_query = current_->query_count;
+      interval.end_query = -1;
+      glQueryCounter(current_->queries[current_->query_count++]
+                   , GL_TIMESTAMP);
+    }
+    open_[open_count_] = index;
+  }
+  ++open_count_;
+#endif
+}
+
+void GpuTimer::End() {
+#ifdef GL_TIMESTAMP
+  if (!current_ || open_count_ == 0) {
+    return;
+  }
+  --open_count_;
+  if (open_count_ >= kMaxScopes || open_[open_count_] < 0) {
+    return;
+  }
+  current_->intervals[open_[open_count_]].end_query = current_->query_count;
+  glQueryCounter(current_->queries[current_->query_count++], GL_TIMESTAMP);
+#endif
+}
+
+void GpuTimer::ReadBack_() {
+  // Oldest first; the GPU finishes frames in order, so the first one that
+  // isn't done yet means the newer ones aren't either.
+  for (int i = 0; i < kFrameSlots; i++) {
+    Frame &frame = frames_[(frame_number_ + i) % kFrameSlots];
+    if (frame.pending && !Resolve_(&frame)) {
+      break;
+    }
+  }
+}
+
+bool GpuTimer::Resolve_(Frame *frame) {
+#ifdef GL_TIMESTAMP
+  // Timestamps are written in order, so the last one being there means
+  // all of them are.
+  GLint available = GL_FALSE;
+  glGetQueryObjectiv(frame->queries[frame->query_count - 1]
+                   , GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available) {
+    return false;
+  }
+  for (int i = 0; i < frame->interval_count; i++) {
+    const Interval &interval = frame->intervals[i];
+    if (interval.end_query < 0) {
+      continue;
+    }
+    GLuint64 begin = 0;
+    GLuint64 end = 0;
+    glGetQueryObjectui64v(frame->queries[interval.begin_query]
+                        , GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(frame->queries[interval.end_query]
+                        , GL_QUERY_RESULT, &end);
+    frame_trace::Record(track_, interval.name
+                      , static_cast<int64_t>(begin) + clock_offset_
+                      , static_cast<int64_t>(end) + clock_offset_);
+  }
+  frame->pending = false;
+  ++resolved_frames_;
+  last_readback_latency_ = static_cast<int>(frame_number_ - frame->number);
+#endif
+  return true;
+}
+
+void GpuTimer::Calibrate_() {
+#ifdef GL_TIMESTAMP
+  // What the GPU clock reads once the commands so far have been
+  // submitted; close enough to now for lining up the trace.
+  GLint64 gpu_time = 0;
+  glGetInteger64v(GL_TIMESTAMP, &gpu_time);
+  clock_offset_ = frame_trace::Now() - gpu_time;
+  calibrated_frame_ = frame_number_;
+#endif
+}
+
+}  // namespace gpu_timer
@@ -0,0 +1,305 @@
+// Copyright 2015 Makoto Yano
+//
+// Builds hand skeletons from frames with virtual_hand::BuildHands() and
+// with the per hand Eigen::Vector3f code it replaced, checks that both
+// give the same joints and reports ns per hand and heap allocations per
+// frame once warmed up.
+//
+//   hand_bench [--replay FILE] [--frames N] [--passes N]
+//
+// Without --replay the frames are made up at about 110 Hz: one or two
+// hands sweeping figure eights, with the bones of a relaxed hand.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <random>
+#include <vector>
+
+#include "headers/bench_frames.h"
+#include "headers/bench_util.h"
+#include "headers/frame_record.h"
+#include "headers/virtual_hand.h"
+
+namespace {
+
+unsigned long allocation_count = 0;  // NOLINT
+
+}  // namespace
+
+void *operator new(size_t size) {
+  ++allocation_count;
+  void *memory = malloc(size ? size : 1);
+  if (!memory) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void operator delete(void *memory) noexcept {
+  free(memory);
+}
+
+namespace {
+
+// The skeleton the processor used to build, one struct per hand.
+struct SkeletonHand {
+  int id;
+  float confidence;
+  float grabStrength;
+  Eigen::Vector3f center;
+  Eigen::Matrix3f rotationButNotReally;
+  Eigen::Vector3f joints[23];
+  Eigen::Vector3f jointConnections[23];
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+inline Eigen::Vector3f ToEigen(const float v[3]) {
+  return Eigen::Vector3f(v[0], v[1], v[2]);
+}
+
+// The previous code from HandInputProcessor::process_frame.
+BENCH_NOINLINE void BuildSkeletonHands(
+                          const frame_record::FrameRecord &frame
+                        , std::vector<SkeletonHand> *skeleton_hands) {
+  skeleton_hands->clear();
+  for (int i=0; i<frame.hand_count; i++) {
+      const frame_record::HandRecord &hand = frame.hands[i];
+      SkeletonHand out_hand;
+      out_hand.id = hand.id;
+      out_hand.confidence = hand.confidence;
+      out_hand.grabStrength = hand.grab_strength;
+
+      const Eigen::Vector3f palm = ToEigen(hand.palm_position);
+      const Eigen::Vector3f palmDir = ToEigen(hand.direction).normalized();
+      const Eigen::Vector3f palmNormal = ToEigen(hand.palm_normal).normalized();
+      const Eigen::Vector3f palmSide = palmDir.cross(palmNormal).normalized();
+
+      Eigen::Matrix3f palmBasis = Eigen::Map<const Eigen::Matrix3f>(hand.basis);
+
+      // Remove scale from palmBasis
+      const float basisScale = (palmBasis * Eigen::Vector3f::UnitX()).norm();
+      palmBasis *= 1.0f / basisScale;
+
+      out_hand.center = palm;
+      out_hand.rotationButNotReally = palmBasis;
+
+      for (int j = 0; j < 5; j++) {
+        const frame_record::FingerRecord& finger = hand.fingers[j];
+
+        for (int k = 0; k < 3; k++) {
+          const frame_record::BoneRecord &bone = finger.bones[k + 1];
+          out_hand.joints[j*3 + k] = ToEigen(bone.next_joint);
+          out_hand.jointConnections[j*3 + k] = ToEigen(bone.prev_joint);
+        }
+      }
+
+      const float thumbDist = (out_hand.jointConnections[0] - palm).norm();
+      const Eigen::Vector3f wrist = palm - thumbDist*(palmDir*0.8f + static_cast<float>(hand.is_left ? -1 : 1)*palmSide*0.5f);
+
+      for (int j = 0; j < 4; j++) {
+        out_hand.joints[15 + j] = out_hand.jointConnections[3 * j];
+        out_hand.jointConnections[15 + j] = out_hand.jointConnections[3 * (j + 1)];
+      }
+      out_hand.joints[19] = out_hand.jointConnections[12];
+      out_hand.jointConnections[19] = wrist;
+      out_hand.joints[20] = wrist;
+      out_hand.jointConnections[20] = out_hand.jointConnections[0];
+
+      // Arm
+      const Eigen::Vector3f elbow = ToEigen(hand.elbow_position);
+      out_hand.joints[21] = elbow - thumbDist*(hand.is_left ? -1 : 1)*palmSide*0.5;
+      out_hand.jointConnections[21] = wrist;
+      out_hand.joints[22] = elbow + thumbDist*(hand.is_left ? -1 : 1)*palmSide*0.5;
+      out_hand.jointConnections[22] = out_hand.jointConnections[0];
+
+      skeleton_hands->push_back(out_hand);
+  }
+}
+
+BENCH_NOINLINE void BuildHandBuffer(const frame_record::FrameRecord &frame
+                                  , virtual_hand::HandBuffer *hands) {
+  virtual_hand::BuildHands(frame, hands);
+}
+
+void SetPoint(float out[3], float x, float y, float z) {
+  out[0] = x;
+  out[1] = y;
+  out[2] = z;
+}
+
+// The scripted frames of bench_frames, every other stroke with a second
+// hand mirroring the first, and the fingers given the bones of a relaxed
+// hand around the palm.
+void MakeFrames(int count, std::vector<frame_record::FrameRecord> *frames) {
+  const int kStrokeFrames = 200;
+  bench_frames::Script script = bench_frames::DefaultScript();
+  script.strokes = (count + kStrokeFrames - 1) / kStrokeFrames;
+  script.absent_frames = 0;
+  script.present_frames = kStrokeFrames;
+  script.noise = 0.0f;
+  bench_frames::MakeFrames(script, frames);
+  frames->resize(count);
+  std::minstd_rand random(1);
+  std::uniform_real_distribution<float> jitter(-1.0f, 1.0f);
+  for (int i = 0; i < count; i++) {
+    frame_record::FrameRecord &frame = (*frames)[i];
+    frame.hand_count = 1 + (i / kStrokeFrames) % 2;
+    const frame_record::HandRecord first = frame.hands[0];
+    for (int h = 0; h < frame.hand_count; h++) {
+      frame_record::HandRecord &hand = frame.hands[h];
+      const float side = h == 0 ? 1.0f : -1.0f;
+      hand = first;
+      hand.id = first.id + 1000 * h;
+      hand.is_left = h;
+      hand.extended_finger_count = 5;
+      SetPoint(hand.palm_position, side * first.palm_position[0]
+             , first.palm_position[1], first.palm_position[2]);
+      SetPoint(hand.direction, 0.1f * jitter(random), 0.1f, -1.0f);
+      SetPoint(hand.palm_normal, 0.1f * jitter(random), -1.0f, -0.1f);
+      for (int b = 0; b < 9; b++) {
+        hand.basis[b] = (b % 4 == 0) ? 1.05f : 0.02f * jitter(random);
+      }
+      SetPoint(hand.elbow_position, hand.palm_position[0] + 20.0f * side
+             , hand.palm_position[1] - 60.0f, hand.palm_position[2] + 250.0f);
+      for (int j = 0; j < frame_record::kFingerCount; j++) {
+        frame_record::FingerRecord &finger = hand.fingers[j];
+        finger.id = 10 * hand.id + j;
+        finger.extended = 1;
+        float x = hand.palm_position[0] + side * (j - 2) * 18.0f;
+        float y = hand.palm_position[1];
+        float z = hand.palm_position[2] + 40.0f;
+        for (int k = 0; k < frame_record::kBoneCount; k++) {
+          frame_record::BoneRecord &bone = finger.bones[k];
+          SetPoint(bone.prev_joint, x, y, z);
+          z -= (k == 0 ? 45.0f : 30.0f - 5.0f * k) + jitter(random);
+          y -= 2.0f * k;
+          SetPoint(bone.next_joint, x, y, z);
+        }
+        SetPoint(finger.tip_position, x, y, z);
+      }
+    }
+  }
+}
+
+float MaxDifference(const std::vector<SkeletonHand> &expected
+                  , const virtual_hand::HandBuffer &hands) {
+  if (static_cast<int>(expected.size()) != hands.count) {
+    return INFINITY;
+  }
+  float difference = 0.0f;
+  for (int h = 0; h < hands.count; h++) {
+    for (int i = 0; i < virtual_hand::kJointCount; i++) {
+      difference = std::max(difference
+              , (hands.joints[h][i].head<3>() - expected[h].joints[i]).norm());
+      difference = std::max(difference
+              , (hands.joint_connections[h][i].head<3>()
+                 - expected[h].jointConnections[i]).norm());
+    }
+    difference = std::max(difference
+              , (hands.basis[h] - expected[h].rotationButNotReally).norm());
+  }
+  return difference;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const char *replay_path = NULL;
+  int frame_count = 10000;
+  int passes = 20;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      replay_path = argv[++i];
+    } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+      frame_count = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--passes") == 0 && i + 1 < argc) {
+      passes = std::max(1, atoi(argv[++i]));
+    } else {
+      printf("Unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  std::vector<frame_record::FrameRecord> frames;
+  if (replay_path) {
+    frame_record::FrameReplay replay;
+    if (!replay.Open(replay_path)) {
+      return 2;
+    }
+    frames.resize(replay.frame_count());
+    for (size_t i = 0; i < frames.size(); i++) {
+      replay.Read(i, &frames[i]);
+    }
+  } else {
+    MakeFrames(frame_count, &frames);
+  }
+  unsigned long hand_count = 0;  // NOLINT
+  for (size_t i = 0; i < frames.size(); i++) {
+    hand_count += frames[i].hand_count;
+  }
+  if (hand_count == 0) {
+    printf("The frames have no hands.\n");
+    return 2;
+  }
+
+  // Same joints from both, frame by frame.
+  std::vector<SkeletonHand> skeleton_hands;
+  virtual_hand::HandBuffer hands;
+  float difference = 0.0f;
+  for (size_t i = 0; i < frames.size(); i++) {
+    BuildSkeletonHands(frames[i], &skeleton_hands);
+    BuildHandBuffer(frames[i], &hands);
+    difference = std::max(difference, MaxDifference(skeleton_hands, hands));
+  }
+
+  // Warmed up by the pass above, so any allocation left is per frame.
+  double vector_ns = 0.0;
+  double buffer_ns = 0.0;
+  unsigned long vector_allocations = 0;  // NOLINT
+  unsigned long buffer_allocations = 0;  // NOLINT
+  float sink = 0.0f;
+  for (int pass = 0; pass < passes; pass++) {
+    unsigned long allocations = allocation_count;  // NOLINT
+    std::chrono::steady_clock::time_point start =
+                                      std::chrono::steady_clock::now();
+    for (size_t i = 0; i < frames.size(); i++) {
+      BuildSkeletonHands(frames[i], &skeleton_hands);
+      sink += skeleton_hands.empty() ? 0.0f : skeleton_hands[0].joints[20].x();
+    }
+    vector_ns += bench_util::Seconds(start) * 1e9;
+    vector_allocations += allocation_count - allocations;
+
+    allocations = allocation_count;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < frames.size(); i++) {
+      BuildHandBuffer(frames[i], &hands);
+      sink += hands.count == 0 ? 0.0f : hands.joints[0][20].x();
+    }
+    buffer_ns += bench_util::Seconds(start) * 1e9;
+    buffer_allocations += allocation_count - allocations;
+  }
+
+  const double total_hands = static_cast<double>(hand_count) * passes;
+  const double total_frames = static_cast<double>(frames.size()) * passes;
+  printf("%lu frames, %lu hands, %s, %d passes\n"
+        , static_cast<unsigned long>(frames.size()), hand_count  // NOLINT
+        , replay_path ? "replayed" : "made up", passes);
+  printf("vector<SkeletonHand>  %7.1f ns/hand  %.2f allocations/frame\n"
+        , vector_ns / total_hands, vector_allocations / total_frames);
+  printf("HandBuffer            %7.1f ns/hand  %.2f allocations/frame\n"
+        , buffer_ns / total_hands, buffer_allocations / total_frames);
+  printf("largest joint difference %g mm (checksum %g)\n"
+        , difference, sink);
+  if (!(difference < 1e-3f) || buffer_allocations != 0) {
+    printf("HandBuffer does not match the old skeleton or allocates\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,346 @@
+#include <math.h>
+#include <stdlib.h>
+#include <map>
+
+#include <LeapMath.h>
+
+#include "headers/Quaternion.h"
+#include "headers/frame_record.h"
+#include "headers/frame_trace.h"
+#include "headers/hand_input_processor.h"
+#include "headers/pen_line.h"
+#include "headers/stroke_simplifier.h"
+
+using namespace Leap;
+
+namespace hand_listener{
+
+namespace {
+
+inline Vector ToVector(const float v[3]) {
+  return Vector(v[0], v[1], v[2]);
+}
+
+}  // namespace
+
+HandInputProcessor::HandInputProcessor()
+  : rotating(false)
+  , world_x_quaternion(1.0f, 0.0f, 0.0f, 0.0f)
+  , world_y_quaternion(1.0f, 0.0f, 0.0f, 0.0f)
+  , camera_x_position(DEFAULT_CAMERA_X)
+  , camera_y_position(DEFAULT_CAMERA_Y)
+  , camera_z_position(DEFAULT_CAMERA_Z)
+  , simplify_tolerance(STROKE_SIMPLIFY_TOLERANCE)
+  , tip_filter_params(fingertip_filter::DefaultParams())
+  , stroke_start_delay(STROKE_START_DELAY)
+  , snapshot_sequence_(0)
+  , sampled_point_count_(0)
+  , color_random_(COLOR_RANDOM_SEED)
+  , received_time_(0.0) {
+}
+
+void HandInputProcessor::process_frame(const frame_record::FrameRecord &frame) {
+  process_frame(frame, motion_predictor::MonotonicSeconds());
+}
+
+void HandInputProcessor::process_frame(const frame_record::FrameRecord &frame
+                                     , double received_time) {
+  FRAME_TRACE_SCOPE("process frame");
+  received_time_ = received_time;
+  update_world_transform_();
+  int open_hand_index = open_hand_index_(frame);
+  if (frame.hand_count == 0) {
+    for (std::map<int,pen_line::TracingLine>::iterator tracing_line_map = tracing_lines.begin()
+        ; tracing_line_map != tracing_lines.end()
+        ; tracing_line_map++) {
+      finish_tracing_line_((*tracing_line_map).second);
+    }
+    tracing_lines.clear();
+  } else if (open_hand_index < 0) {
+    for (int i=0; i<frame.hand_count; i++) {
+      trace_finger_(frame.hands[i], frame.timestamp);
+    }
+  } else {
+    rotate_camera_(frame.hands[open_hand_index]);
+  }
+
+  virtual_hand::BuildHands(frame, &skeleton_hands);
+  track_palms_(frame);
+  FRAME_TRACE_SCOPE("publish snapshot");
+  publish_snapshot_();
+}
+
+const scene_snapshot::SceneSnapshot &HandInputProcessor::acquire_snapshot() {
+  snapshots_.update();
+  return snapshots_.front();
+}
+
+unsigned long HandInputProcessor::published_snapshot_count() const {  // NOLINT
+  return snapshots_.published_count();
+}
+
+unsigned long HandInputProcessor::dropped_snapshot_count() const {  // NOLINT
+  return snapshots_.overwritten_count();
+}
+
+void HandInputProcessor::publish_snapshot_() {
+  scene_snapshot::SceneSnapshot &snapshot = snapshots_.back();
+  snapshot.sequence = ++snapshot_sequence_;
+  snapshot.received_time = received_time_;
+  snapshot.world_x_quaternion = world_x_quaternion;
+  snapshot.world_y_quaternion = world_y_quaternion;
+  snapshot.camera_x_position = camera_x_position;
+  snapshot.camera_y_position = camera_y_position;
+  snapshot.camera_z_position = camera_z_position;
+
+  // Completed strokes are immutable, so a slot only needs the ones that
+  // were finished since it was last handed out.
+  const std::vector<unsigned int> &completed = strokes.completed();
+  for (size_t i = snapshot.strokes.size(); i < completed.size(); i++) {
+    snapshot.strokes.push_back(strokes.view(completed[i]));
+  }
+
+  snapshot.tracing_lines.clear();
+  snapshot.tracing_tails.clear();
+  snapshot.tracing_motion.clear();
+  for (std::map<int, pen_line::TracingLine>::const_iterator tracing_line_map
+          = tracing_lines.begin()
+      ; tracing_line_map != tracing_lines.end()
+      ; tracing_line_map++) {
+    const pen_line::TracingLine &tracing_line = (*tracing_line_map).second;
+    if (tracing_line.stroke != pen_line::kNoStroke) {
+      pen_line::StrokeView view = strokes.view(tracing_line.stroke);
+      snapshot.tracing_lines.push_back(view);
+      snapshot.tracing_tails.push_back(tracing_line.simplifier.has_tail()
+                                      ? tracing_line.simplifier.tail()
+                                      : view.points[view.count - 1]);
+      // A line that lost its tip keeps its end where it is.
+      const Leap::Vector &tail = snapshot.tracing_tails.back();
+      snapshot.tracing_motion.push_back(tracing_line.drawing
+                                      ? tracing_line.motion.motion()
+                                      : motion_predictor::Still(tail));
+    }
+  }
+  snapshot.skeleton_hands = skeleton_hands;
+  snapshot.hand_to_world = world_transform_;
+  for (int i = 0; i < skeleton_hands.count; i++) {
+    snapshot.hand_motion[i] = palm_trackers_[skeleton_hands.id[i]].motion();
+  }
+
+  snapshots_.publish();
+}
+
+void HandInputProcessor::initialize_world_position() {
+  camera_x_position = DEFAULT_CAMERA_X;
+  camera_y_position = DEFAULT_CAMERA_Y;
+  camera_z_position = DEFAULT_CAMERA_Z;
+  world_x_quaternion = Quaternion(1.0f, 0.0f, 0.0f, 0.0f);
+  world_y_quaternion = Quaternion(1.0f, 0.0f, 0.0f, 0.0f);
+}
+
+void HandInputProcessor::update_world_transform_() {
+  // conj(y) * (conj(x) * v * x) * y is one rotation by conj(x * y).
+  const float offset[3] = { DEFAULT_CAMERA_X - camera_x_position
+                          , camera_y_position - DEFAULT_CAMERA_Y
+                          , camera_z_position - DEFAULT_CAMERA_Z };
+  world_transform_ = MakePointTransform(
+                          conj(world_x_quaternion * world_y_quaternion)
+                        , offset);
+}
+
+Vector HandInputProcessor::convert_to_world_position_(const Vector &input_vector) {
+  const float in[3] = { input_vector.x, input_vector.y, input_vector.z };
+  float out[3];
+  TransformPoint(world_transform_, in, out);
+  return Vector(out[0], out[1], out[2]);
+}
+
+int HandInputProcessor::open_hand_index_(
+                              const frame_record::FrameRecord& frame) {
+  for (int i=0; i<frame.hand_count; i++) {
+    if (frame.hands[i].extended_finger_count > 3) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void HandInputProcessor::trace_finger_(const frame_record::HandRecord& hand
+                                    , int64_t now) {
+  if (hand.extended_finger_count == 0) {
+    return;
+  }
+  // The index finger does the drawing.
+  const frame_record::FingerRecord &tracing_object = hand.fingers[1];
+  int id = tracing_object.id;
+  if (hand.pointable_count == 0) {
+    finish_tracing_line_(tracing_lines[id]);
+    tracing_lines.erase(id);
+    return;
+  }
+  rotating = false;
+  pen_line::TracingLine &tracing_line = tracing_lines[id];
+  if (!tracing_object.valid) {
+    // The next stroke waits for the tip to settle again.
+    tracing_line.drawing = false;
+    tracing_line.dwell_start = -1;
+    tracing_line.filter.reset();
+    tracing_line.motion.reset();
+    return;
+  }
+  tracing_line.filter.set_params(tip_filter_params);
+  Vector tip_position = convert_to_world_position_(tracing_line.filter.filter(
+                            ToVector(tracing_object.tip_position), now));
+  tracing_line.motion.update(tip_position, now);
+  if (tracing_line.drawing) {
+    if (tip_position.distanceTo(tracing_line.previous_position) > 1) {
+      tracing_line.previous_position = tip_position;
+      ++tracing_line.sampled;
+      ++sampled_point_count_;
+      Vector vertex;
+      if (tracing_line.simplifier.add(tip_position, &vertex)) {
+        strokes.append(tracing_line.stroke, vertex);
+      }
+    }
+    return;
+  }
+
+  if (tracing_line.dwell_start < 0
+      || tracing_line.filter.speed() > STROKE_START_MAX_SPEED) {
+    tracing_line.dwell_start = now;
+  }
+  if (now - tracing_line.dwell_start < stroke_start_delay) {
+    return;
+  }
+  pen_line::Color color = { (color_random_() % 11) / 10.0f
+                          , (color_random_() % 11) / 10.0f
+                          , (color_random_() % 11) / 10.0f };
+  if (tracing_line.stroke != pen_line::kNoStroke) {
+    strokes.discard(tracing_line.stroke);
+  }
+  tracing_line.stroke = strokes.begin_stroke(color);
+  strokes.append(tracing_line.stroke, tip_position);
+  tracing_line.drawing = true;
+  tracing_line.previous_position = tip_position;
+  tracing_line.sampled = 1;
+  ++sampled_point_count_;
+  // Half the budget for the streaming pass and half for the last one
+  // (see finish_tracing_line_), so both together stay within it.
+  tracing_line.simplifier.set_tolerance(simplify_tolerance / 2.0f);
+  tracing_line.simplifier.reset(tip_position);
+}
+
+void HandInputProcessor::track_palms_(
+                              const frame_record::FrameRecord& frame) {
+  // Hands that left take their tracker with them.
+  for (std::map<int, motion_predictor::MotionTracker>::iterator tracker
+          = palm_trackers_.begin()
+      ; tracker != palm_trackers_.end()
+      ; ) {
+    bool present = false;
+    for (int i = 0; i < skeleton_hands.count; i++) {
+      present = present || skeleton_hands.id[i] == (*tracker).first;
+    }
+    if (present) {
+      ++tracker;
+    } else {
+      palm_trackers_.erase(tracker++);
+    }
+  }
+  for (int i = 0; i < skeleton_hands.count; i++) {
+    palm_trackers_[skeleton_hands.id[i]].update(
+                  ToVector(frame.hands[i].palm_position), frame.timestamp);
+  }
+}
+
+void HandInputProcessor::rotate_camera_(const frame_record::HandRecord& hand) {
+  int id = hand.id;
+  const Vector parm_position = ToVector(hand.palm_position);
+  if (parm_position == Vector(0,0,0)) {
+    return;
+  }
+  if (!rotating) {
+    rotating = true;
+    for (std::map<int,pen_line::TracingLine>::iterator tracing_line_map = tracing_lines.begin()
+        ; tracing_line_map != tracing_lines.end()
+        ; tracing_line_map++) {
+      finish_tracing_line_((*tracing_line_map).second);
+    }
+    tracing_lines.clear();
+    tracing_lines[id].previous_position = parm_position;
+  } else if (parm_position.distanceTo(tracing_lines[id].previous_position) > 0.3) {
+    Vector move_vector(parm_position - tracing_lines[id].previous_position);
+    float hard = move_vector.x / 200;
+    float s = sin(hard);
+    Quaternion rotate_quaternion(cos(hard)
+        , 0*s
+        , 1*s
+        , 0*s);
+    world_y_quaternion = world_y_quaternion * rotate_quaternion;
+    hard = move_vector.y / 200;
+    s = sin(hard);
+    rotate_quaternion = Quaternion(cos(hard)
+        , 1*s
+        , 0*s
+        , 0*s);
+    world_x_quaternion = world_x_quaternion * rotate_quaternion;
+    camera_z_position += move_vector.z * 6;
+    tracing_lines[id].previous_position = parm_position;
+  }
+}
+
+void HandInputProcessor::clean_line_map_(const frame_record::FrameRecord& frame) {
+  return;
+  for (std::map<int,pen_line::TracingLine>::iterator tracing_line_map = tracing_lines.begin()
+      ; tracing_line_map != tracing_lines.end()
+      ; tracing_line_map++) {
+    int id = (*tracing_line_map).first;
+    if (!pointable_valid_(frame, id)) {
+      finish_tracing_line_(tracing_lines[id]);
+      tracing_lines.erase(id);
+    }
+  }
+}
+
+bool HandInputProcessor::pointable_valid_(
+                    const frame_record::FrameRecord& frame, int id) const {
+  for (int i = 0; i < frame.hand_count; i++) {
+    for (int j = 0; j < frame_record::kFingerCount; j++) {
+      if (frame.hands[i].fingers[j].id == id) {
+        return frame.hands[i].fingers[j].valid;
+      }
+    }
+  }
+  return false;
+}
+
+void HandInputProcessor::finish_tracing_line_(
+                          const pen_line::TracingLine &tracing_line) {
+  if (tracing_line.stroke == pen_line::kNoStroke) {
+    return;
+  }
+  if (tracing_line.sampled <= 2) {
+    strokes.discard(tracing_line.stroke);
+    return;
+  }
+  if (tracing_line.simplifier.has_tail()) {
+    strokes.append(tracing_line.stroke, tracing_line.simplifier.tail());
+  }
+  // The streaming pass only looks a window ahead, a last pass over the
+  // whole stroke usually drops a few more points.  It works on points
+  // that already stray up to half the tolerance from the samples, so it
+  // only gets the other half.
+  pen_line::StrokeView view = strokes.view(tracing_line.stroke);
+  stroke_simplifier::Simplify(view.points, view.count
+                            , simplify_tolerance / 2.0f
+                            , &simplified_points_);
+  if (simplified_points_.size() < view.count) {
+    // Only drops points, so what the renderer streamed of the stroke
+    // still stands for it.
+    strokes.thin(tracing_line.stroke, &simplified_points_[0]
+               , simplified_points_.size());
+  }
+  strokes.finish(tracing_line.stroke);
+}
+
+} // namespace hand_listener
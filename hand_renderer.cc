@@ -0,0 +1,328 @@
+// Copyright 2015 Makoto Yano
+
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "headers/hand_renderer.h"
+
+#define BUFFER_OFFSET(bytes) ((GLubyte*) NULL + (bytes))
+
+namespace hand_renderer {
+
+namespace {
+
+const GLfloat kJointRadius = 7.0f;
+const GLfloat kBoneRadius = 4.5f;
+const GLfloat kJointColor[3] = { 0.95f, 0.95f, 0.9f };
+const GLfloat kBoneColor[3] = { 0.85f, 0.7f, 0.6f };
+
+// The capsule mesh is a unit sphere split at the equator.  Around its z
+// axis: kSlices segments, kHemisphereStacks rings per half.
+const int kSlices = 10;
+const int kHemisphereStacks = 3;
+
+// Attribute locations, bound before linking.
+enum Attribute {
+  // xyz on the unit sphere, w 0 for the start half and 1 for the end.
+  kPositionAttribute = 0,
+  kStartRadiusAttribute,
+  kEndAttribute,
+  kColorAttribute
+};
+
+// The capsule frame is built around the bone; the radius pushes each
+// sphere point out from whichever end its half belongs to.
+const char *kVertexShader =
+  "#version 150 compatibility\n"
+  "uniform mat4 eye_view_projection[2];\n"
+  "uniform vec4 eye_viewport[2];\n"
+  "uniform int eye_count;\n"
+  "in vec4 position;\n"
+  "in vec4 start_radius;\n"
+  "in vec3 end;\n"
+  "in vec3 color;\n"
+  "out vec4 vertex_color;\n"
+  "void main() {\n"
+  "  int eye = gl_InstanceID % eye_count;\n"
+  "  vec3 start = start_radius.xyz;\n"
+  "  vec3 axis = end - start;\n"
+  "  float bone_length = length(axis);\n"
+  "  vec3 z = bone_length > 0.001 ? axis / bone_length\n"
+  "                              : vec3(0.0, 0.0, 1.0);\n"
+  "  vec3 x = normalize(cross(abs(z.x) < 0.9 ? vec3(1.0, 0.0, 0.0)\n"
+  "                                          : vec3(0.0, 1.0, 0.0), z));\n"
+  "  vec3 normal = mat3(x, cross(z, x), z) * position.xyz;\n"
+  "  vec3 point = mix(start, end, position.w) + start_radius.w * normal;\n"
+  "  vec4 clip = eye_view_projection[eye] * vec4(point, 1.0);\n"
+  "  gl_ClipDistance[0] = clip.w - clip.x;\n"
+  "  gl_ClipDistance[1] = clip.w + clip.x;\n"
+  "  gl_ClipDistance[2] = clip.w - clip.y;\n"
+  "  gl_ClipDistance[3] = clip.w + clip.y;\n"
+  "  clip.xy = clip.xy * eye_viewport[eye].xy\n"
+  "          + eye_viewport[eye].zw * clip.w;\n"
+  "  gl_Position = clip;\n"
+  "  float light = 0.45 + 0.55 * max(dot(normal\n"
+  "                                   , vec3(0.26, 0.86, 0.43)), 0.0);\n"
+  "  vertex_color = vec4(color * light, 1.0);\n"
+  "}\n";
+
+const char *kFragmentShader =
+  "#version 150 compatibility\n"
+  "in vec4 vertex_color;\n"
+  "void main() {\n"
+  "  gl_FragColor = vertex_color;\n"
+  "}\n";
+
+const int kClipDistanceCount = 4;
+
+GLuint CompileShader(GLenum type, const char *source) {
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 1, &source, NULL);
+  glCompileShader(shader);
+  GLint compiled = GL_FALSE;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+  if (!compiled) {
+    char log[1024];
+    glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+    printf("Hand shader compile failed: %s\n", log);
+    glDeleteShader(shader);
+    return 0;
+  }
+  return shader;
+}
+
+void SetInstance(const float *start, const float *end, GLfloat radius
+               , const GLfloat color[3], HandInstance *instance) {
+  for (int axis = 0; axis < 3; axis++) {
+    instance->start[axis] = start[axis];
+    instance->end[axis] = end[axis];
+    instance->color[axis] = color[axis];
+  }
+  instance->radius = radius;
+}
+
+}  // namespace
+
+void BuildInstances(const virtual_hand::HandBuffer &hands
+                  , const PointTransform &hand_to_world
+                  , std::vector<HandInstance> *instances) {
+  const int joint_count = virtual_hand::kJointCount;
+  instances->resize(hands.count * kInstancesPerHand);
+  HandInstance *instance = instances->empty() ? NULL : &(*instances)[0];
+  // joints then joint_connections, packed for one TransformPoints() call.
+  float points[2 * joint_count * 3];
+  for (int h = 0; h < hands.count; h++) {
+    for (int i = 0; i < joint_count; i++) {
+      for (int axis = 0; axis < 3; axis++) {
+        points[i * 3 + axis] = hands.joints[h][i][axis];
+        points[(joint_count + i) * 3 + axis] =
+                                    hands.joint_connections[h][i][axis];
+      }
+    }
+    TransformPoints(hand_to_world, points, points, 2 * joint_count);
+    for (int i = 0; i < joint_count; i++) {
+      const float *joint = &points[i * 3];
+      const float *connection = &points[(joint_count + i) * 3];
+      SetInstance(joint, joint, kJointRadius, kJointColor, instance++);
+      SetInstance(joint, connection, kBoneRadius, kBoneColor, instance++);
+    }
+  }
+}
+
+HandRenderer::HandRenderer()
+  : program_(0), mesh_buffer_(0), index_buffer_(0), instance_buffer_(0)
+  , index_count_(0), eye_view_projection_location_(-1)
+  , eye_viewport_location_(-1), eye_count_location_(-1)
+  , draw_calls_(0), vertices_(0) {
+}
+
+HandRenderer::~HandRenderer() {
+  if (program_) {
+    glDeleteProgram(program_);
+    glDeleteBuffers(1, &mesh_buffer_);
+    glDeleteBuffers(1, &index_buffer_);
+    glDeleteBuffers(1, &instance_buffer_);
+  }
+}
+
+bool HandRenderer::Initialize() {
+#ifdef GL_VERSION_3_3
+  int major = 0;
+  int minor = 0;
+  const char *version =
+              reinterpret_cast<const char *>(glGetString(GL_VERSION));
+  if (!version || sscanf(version, "%d.%d", &major, &minor) != 2
+      || major < 3 || (major == 3 && minor < 3)) {
+    return false;
+  }
+
+  GLuint vertex_shader = CompileShader(GL_VERTEX_SHADER, kVertexShader);
+  GLuint fragment_shader = CompileShader(GL_FRAGMENT_SHADER
+                                        , kFragmentShader);
+  if (!vertex_shader || !fragment_shader) {
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+    return false;
+  }
+  program_ = glCreateProgram();
+  glAttachShader(program_, vertex_shader);
+  glAttachShader(program_, fragment_shader);
+  glBindAttribLocation(program_, kPositionAttribute, "position");
+  glBindAttribLocation(program_, kStartRadiusAttribute, "start_radius");
+  glBindAttribLocation(program_, kEndAttribute, "end");
+  glBindAttribLocation(program_, kColorAttribute, "color");
+  glLinkProgram(program_);
+  glDeleteShader(vertex_shader);
+  glDeleteShader(fragment_shader);
+  GLint linked = GL_FALSE;
+  glGetProgramiv(program_, GL_LINK_STATUS, &linked);
+  if (!linked) {
+    printf("Hand shader link failed.\n");
+    glDeleteProgram(program_);
+    program_ = 0;
+    return false;
+  }
+  eye_view_projection_location_ =
+                  glGetUniformLocation(program_, "eye_view_projection");
+  eye_viewport_location_ = glGetUniformLocation(program_, "eye_viewport");
+  eye_count_location_ = glGetUniformLocation(program_, "eye_count");
+  glGenBuffers(1, &mesh_buffer_);
+  glGenBuffers(1, &index_buffer_);
+  glGenBuffers(1, &instance_buffer_);
+  BuildMesh_();
+  return true;
+#else
+  return false;
+#endif
+}
+
+void HandRenderer::BuildMesh_() {
+  // Rings from the start pole to the end pole.  The equator ring is there
+  // twice, once for each half, and the band between the two copies is
+  // the cylinder once the halves are pulled apart.
+  const int ring_vertices = kSlices + 1;
+  const int ring_count = 2 * (kHemisphereStacks + 1);
+  std::vector<GLfloat> vertices;
+  vertices.reserve(ring_count * ring_vertices * 4);
+  for (int half = 0; half < 2; half++) {
+    for (int stack = 0; stack <= kHemisphereStacks; stack++) {
+      float latitude = (half - 1 + stack / static_cast<float>(
+                                              kHemisphereStacks)) * M_PI / 2;
+      for (int slice = 0; slice <= kSlices; slice++) {
+        float longitude = 2.0f * M_PI * slice / kSlices;
+        vertices.push_back(cos(latitude) * cos(longitude));
+        vertices.push_back(cos(latitude) * sin(longitude));
+        vertices.push_back(sin(latitude));
+        vertices.push_back(half);
+      }
+    }
+  }
+  std::vector<GLushort> indexes;
+  for (int ring = 0; ring + 1 < ring_count; ring++) {
+    for (int slice = 0; slice < kSlices; slice++) {
+      GLushort a = ring * ring_vertices + slice;
+      GLushort b = a + 1;
+      GLushort c = a + ring_vertices;
+      GLushort d = c + 1;
+      GLushort triangles[6] = { a, c, b, b, c, d };
+      indexes.insert(indexes.end(), triangles, triangles + 6);
+    }
+  }
+  index_count_ = indexes.size();
+
+  glBindBuffer(GL_ARRAY_BUFFER, mesh_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat)
+              , &vertices[0], GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexes.size() * sizeof(GLushort)
+              , &indexes[0], GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void HandRenderer::Update(const virtual_hand::HandBuffer &hands
+                  , const PointTransform &hand_to_world) {
+  BuildInstances(hands, hand_to_world, &instances_);
+  if (!program_ || instances_.empty()) {
+    return;
+  }
+  // A new store every frame lets the driver hand out fresh memory instead
+  // of waiting for last frame's draw.
+  glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, instances_.size() * sizeof(HandInstance)
+              , &instances_[0], GL_STREAM_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void HandRenderer::Render(const GLfloat eye_view_projection[2][16]
+                        , const stereo_renderer::EyeViewport *eye_viewport
+                        , int eye_count) {
+  draw_calls_ = 0;
+  vertices_ = 0;
+#ifdef GL_VERSION_3_3
+  if (!program_ || instances_.empty()) {
+    return;
+  }
+  GLfloat viewport_transform[2][4] = { { 1.0f, 1.0f, 0.0f, 0.0f }
+                                     , { 1.0f, 1.0f, 0.0f, 0.0f } };
+  if (eye_count == 2) {
+    stereo_renderer::EyeViewport combined;
+    stereo_renderer::CombineEyeViewports(eye_viewport, &combined
+                                       , viewport_transform);
+    glViewport(combined.x, combined.y, combined.width, combined.height);
+  } else {
+    eye_count = 1;
+  }
+
+  glUseProgram(program_);
+  glUniformMatrix4fv(eye_view_projection_location_, eye_count, GL_FALSE
+                    , &eye_view_projection[0][0]);
+  glUniform4fv(eye_viewport_location_, eye_count, &viewport_transform[0][0]);
+  glUniform1i(eye_count_location_, eye_count);
+  for (int i = 0; i < kClipDistanceCount; i++) {
+    glEnable(GL_CLIP_DISTANCE0 + i);
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, mesh_buffer_);
+  glEnableVertexAttribArray(kPositionAttribute);
+  glVertexAttribPointer(kPositionAttribute, 4, GL_FLOAT, GL_FALSE, 0
+                       , BUFFER_OFFSET(0));
+  // Each instance is read eye_count times in a row, once for each eye.
+  glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+  const GLint instance_attributes[] = { kStartRadiusAttribute
+                                      , kEndAttribute, kColorAttribute };
+  const GLint sizes[] = { 4, 3, 3 };
+  const size_t offsets[] = { offsetof(HandInstance, start)
+                           , offsetof(HandInstance, end)
+                           , offsetof(HandInstance, color) };
+  for (int i = 0; i < 3; i++) {
+    glEnableVertexAttribArray(instance_attributes[i]);
+    glVertexAttribPointer(instance_attributes[i], sizes[i], GL_FLOAT
+                         , GL_FALSE, sizeof(HandInstance)
+                         , BUFFER_OFFSET(offsets[i]));
+    glVertexAttribDivisor(instance_attributes[i], eye_count);
+  }
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+  glDrawElementsInstanced(GL_TRIANGLES, index_count_, GL_UNSIGNED_SHORT
+                        , BUFFER_OFFSET(0), instances_.size() * eye_count);
+  ++draw_calls_;
+  vertices_ = static_cast<unsigned long>(index_count_)  // NOLINT
+            * instances_.size() * eye_count;
+
+  // The fixed function arrays share these slots, so leave them as found.
+  for (int i = 0; i < 3; i++) {
+    glVertexAttribDivisor(instance_attributes[i], 0);
+    glDisableVertexAttribArray(instance_attributes[i]);
+  }
+  glDisableVertexAttribArray(kPositionAttribute);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  for (int i = 0; i < kClipDistanceCount; i++) {
+    glDisable(GL_CLIP_DISTANCE0 + i);
+  }
+  glUseProgram(0);
+#endif
+}
+
+}  // namespace hand_renderer
@@ -1,24 +1,124 @@
-#ifndef QUATERNION_H
-#define QUATERNION_H
-
-
-class Quaternion {
-protected:
-  float q[4];
-public:
-  Quaternion(float w = 1.0f, float x = 0.0f, float y = 0.0f, float z = 0.0f);
-  float operator [] (int i) const;
-  float &operator [] (int i);
-  Quaternion& operator=(const Quaternion& q);
-  Quaternion &operator += (const Quaternion &);
-  Quaternion &negative();
-  Quaternion &operator *= (const Quaternion &);
-  Quaternion &inverse();
-};
-
-Quaternion operator * (const Quaternion &a, const Quaternion &b);
-Quaternion conj( const Quaternion &a );
-float norm(const Quaternion &a);
-float abs( const Quaternion &a );
-
-#endif
+#ifndef QUATERNION_H
+#define QUATERNION_H
+
+#include <stddef.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define QUATERNION_SSE
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define QUATERNION_NEON
+#include <arm_neon.h>
+#endif
+
+// Stored as (w, x, y, z).  The products used every frame are inline and
+// use SSE or NEON when the target has them.
+class Quaternion {
+protected:
+  float q[4];
+public:
+  Quaternion(float w = 1.0f, float x = 0.0f, float y = 0.0f, float z = 0.0f) {
+    q[0] = w;
+    q[1] = x;
+    q[2] = y;
+    q[3] = z;
+  }
+  float operator [] (int i) const { return q[i]; }
+  float &operator [] (int i) { return q[i]; }
+  const float *data() const { return q; }
+  float *data() { return q; }
+  Quaternion& operator=(const Quaternion& a) {
+    q[0] = a.q[0];
+    q[1] = a.q[1];
+    q[2] = a.q[2];
+    q[3] = a.q[3];
+    return *this;
+  }
+  Quaternion &operator += (const Quaternion &);
+  Quaternion &negative();
+  Quaternion &operator *= (const Quaternion &);
+  Quaternion &inverse();
+};
+
+inline Quaternion operator * (const Quaternion &a, const Quaternion &b) {
+  Quaternion r;
+#if defined(QUATERNION_SSE)
+  // r = a.w * b + a.x * (-bx, bw, -bz, by) + a.y * (-by, bz, bw, -bx)
+  //   + a.z * (-bz, -by, bx, bw)
+  const __m128 vb = _mm_loadu_ps(b.data());
+  const __m128 sign_x = _mm_set_ps(0.0f, -0.0f, 0.0f, -0.0f);
+  const __m128 sign_y = _mm_set_ps(-0.0f, 0.0f, 0.0f, -0.0f);
+  const __m128 sign_z = _mm_set_ps(0.0f, 0.0f, -0.0f, -0.0f);
+  __m128 result = _mm_mul_ps(_mm_set1_ps(a[0]), vb);
+  result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(a[1])
+            , _mm_xor_ps(_mm_shuffle_ps(vb, vb, _MM_SHUFFLE(2, 3, 0, 1))
+                       , sign_x)));
+  result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(a[2])
+            , _mm_xor_ps(_mm_shuffle_ps(vb, vb, _MM_SHUFFLE(1, 0, 3, 2))
+                       , sign_y)));
+  result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(a[3])
+            , _mm_xor_ps(_mm_shuffle_ps(vb, vb, _MM_SHUFFLE(0, 1, 2, 3))
+                       , sign_z)));
+  _mm_storeu_ps(r.data(), result);
+#elif defined(QUATERNION_NEON)
+  static const float kSignX[4] = { -1.0f, 1.0f, -1.0f, 1.0f };
+  static const float kSignY[4] = { -1.0f, 1.0f, 1.0f, -1.0f };
+  static const float kSignZ[4] = { -1.0f, -1.0f, 1.0f, 1.0f };
+  const float32x4_t vb = vld1q_f32(b.data());
+  const float32x4_t swap_pairs = vrev64q_f32(vb);
+  const float32x4_t swap_halves = vextq_f32(vb, vb, 2);
+  float32x4_t result = vmulq_n_f32(vb, a[0]);
+  result = vmlaq_n_f32(result, vmulq_f32(swap_pairs, vld1q_f32(kSignX)), a[1]);
+  result = vmlaq_n_f32(result, vmulq_f32(swap_halves, vld1q_f32(kSignY)), a[2]);
+  result = vmlaq_n_f32(result
+            , vmulq_f32(vrev64q_f32(swap_halves), vld1q_f32(kSignZ)), a[3]);
+  vst1q_f32(r.data(), result);
+#else
+  r[0] = a[0] * b[0] - a[1] * b[1] - a[2] * b[2] - a[3] * b[3];
+  r[1] = a[0] * b[1] + a[1] * b[0] + a[2] * b[3] - a[3] * b[2];
+  r[2] = a[0] * b[2] - a[1] * b[3] + a[2] * b[0] + a[3] * b[1];
+  r[3] = a[0] * b[3] + a[1] * b[2] - a[2] * b[1] + a[3] * b[0];
+#endif
+  return r;
+}
+
+inline Quaternion conj( const Quaternion &a ) {
+  return Quaternion( a[0], -a[1], -a[2], -a[3] );
+}
+
+float norm(const Quaternion &a);
+float abs( const Quaternion &a );
+
+// Column major 4x4 matrix of the rotation q v conj(q), the layout
+// glMultMatrixf() takes.
+void ToMatrix(const Quaternion &q, float m[16]);
+
+// out = rotation * in + translation, for packed xyz points.  Building it
+// once and running a batch through it replaces the two quaternion
+// sandwiches per point.
+struct PointTransform {
+  // Row major.
+  float rotation[9];
+  float translation[3];
+};
+
+// Rotation by q v conj(q), after moving the point by pre_offset.
+PointTransform MakePointTransform(const Quaternion &q
+                                , const float pre_offset[3]);
+
+inline void TransformPoint(const PointTransform &transform
+                         , const float in[3], float out[3]) {
+  const float *m = transform.rotation;
+  const float x = in[0];
+  const float y = in[1];
+  const float z = in[2];
+  out[0] = m[0] * x + m[1] * y + m[2] * z + transform.translation[0];
+  out[1] = m[3] * x + m[4] * y + m[5] * z + transform.translation[1];
+  out[2] = m[6] * x + m[7] * y + m[8] * z + transform.translation[2];
+}
+
+// in and out hold count packed xyz points and may be the same array.
+void TransformPoints(const PointTransform &transform
+                   , const float *in, float *out, size_t count);
+
+#endif
@@ -0,0 +1,152 @@
+// Copyright 2015 Makoto Yano
+
+#ifndef HEADERS_BENCH_FRAMES_H_
+#define HEADERS_BENCH_FRAMES_H_
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <random>
+#include <vector>
+
+#include "./frame_record.h"
+
+// Made up Leap frames for the benches that work on whole frames.
+namespace bench_frames {
+
+// About 110 Hz, as the Leap sends frames.
+static const int64_t kFrameMicros = 9091;
+
+// How the tip moves while the hand is in view.
+enum TipPath {
+  // Figure eights whose speed swings between about 50 and 400 mm/s.
+  kFigureEight,
+  // Held still for about 0.36 s, then about 200 mm/s around a 60 mm
+  // circle.
+  kHeldCircle
+};
+
+struct Script {
+  int strokes;
+  // Frames without a hand before each stroke, and with one.
+  int absent_frames;
+  int present_frames;
+  TipPath path;
+  // Gaussian noise in mm on every axis of the tip and the palm.
+  float noise;
+};
+
+inline Script DefaultScript() {
+  Script script;
+  script.strokes = 20;
+  script.absent_frames = 20;
+  script.present_frames = 600;
+  script.path = kFigureEight;
+  script.noise = 0.4f;
+  return script;
+}
+
+// Where path puts the tip t seconds after the hand showed up, around
+// center.
+inline void Tip(TipPath path, float t, const float center[3]
+              , float out[3]) {
+  if (path == kFigureEight) {
+    const float phase = 2.0f * t + 0.8f * sinf(1.3f * t);
+    out[0] = center[0] + 70.0f * sinf(phase);
+    out[1] = center[1] + 40.0f * sinf(2.0f * phase);
+    out[2] = center[2] + 15.0f * cosf(phase);
+  } else {
+    const float angle = t < 0.36f ? 0.0f : (t - 0.36f) * 3.3f;
+    out[0] = center[0] + 60.0f * cosf(angle);
+    out[1] = center[1] + 60.0f * sinf(angle);
+    out[2] = center[2] + 5.0f * sinf(3.0f * angle);
+  }
+}
+
+// Appends the frames of script to frames at about 110 Hz with uneven
+// spacing: for every stroke absent_frames with no hand, then
+// present_frames with one hand pointing its index finger along path,
+// its palm behind the tip.  clean, when given, gets the same frames
+// without the noise.
+inline void MakeFrames(const Script &script
+                     , std::vector<frame_record::FrameRecord> *frames
+                     , std::vector<frame_record::FrameRecord> *clean
+                                                                = NULL) {
+  std::minstd_rand random(1);
+  std::normal_distribution<float> jitter(0.0f
+                                       , script.noise > 0.0f ? script.noise
+                                                             : 1.0f);
+  std::uniform_int_distribution<int> spacing(-kFrameMicros / 10
+                                            , kFrameMicros / 10);
+  int64_t timestamp = 0;
+  int64_t shown_at = 0;
+  const int period = script.absent_frames + script.present_frames;
+  for (int i = 0; i < script.strokes * period; i++) {
+    frame_record::FrameRecord frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.id = i;
+    timestamp += kFrameMicros + spacing(random);
+    frame.timestamp = timestamp;
+    const int stroke = i / period;
+    const int step = i % period - script.absent_frames;
+    if (step == 0) {
+      shown_at = timestamp;
+    }
+    if (step >= 0) {
+      frame.hand_count = 1;
+      frame_record::HandRecord &hand = frame.hands[0];
+      hand.id = 1 + stroke;
+      hand.extended_finger_count = 1;
+      hand.pointable_count = 5;
+      hand.confidence = 1.0f;
+      for (int j = 0; j < frame_record::kFingerCount; j++) {
+        hand.fingers[j].id = 10 * (stroke + 1) + j;
+        hand.fingers[j].valid = 1;
+      }
+      hand.fingers[1].extended = 1;
+      const float center[3] = { (stroke % 5) * 30.0f - 60.0f, 200.0f, 0.0f };
+      float *tip = hand.fingers[1].tip_position;
+      Tip(script.path, (timestamp - shown_at) * 1e-6f, center, tip);
+      hand.palm_position[0] = tip[0];
+      hand.palm_position[1] = tip[1] - 30.0f;
+      hand.palm_position[2] = tip[2] + 70.0f;
+    }
+    if (clean) {
+      clean->push_back(frame);
+    }
+    if (step >= 0 && script.noise > 0.0f) {
+      frame_record::HandRecord &hand = frame.hands[0];
+      for (int k = 0; k < 3; k++) {
+        hand.fingers[1].tip_position[k] += jitter(random);
+      }
+      for (int k = 0; k < 3; k++) {
+        hand.palm_position[k] += jitter(random);
+      }
+    }
+    frames->push_back(frame);
+  }
+}
+
+// The pointing finger the hand processor would trace, or NULL.
+inline const frame_record::FingerRecord *PointingFinger(
+                                const frame_record::FrameRecord &frame) {
+  for (int h = 0; h < frame.hand_count; h++) {
+    const frame_record::HandRecord &hand = frame.hands[h];
+    if (hand.extended_finger_count > 3) {
+      return NULL;
+    }
+  }
+  for (int h = 0; h < frame.hand_count; h++) {
+    const frame_record::HandRecord &hand = frame.hands[h];
+    if (hand.extended_finger_count > 0 && hand.pointable_count > 0
+        && hand.fingers[1].valid) {
+      return &hand.fingers[1];
+    }
+  }
+  return NULL;
+}
+
+}  // namespace bench_frames
+
+#endif  // HEADERS_BENCH_FRAMES_H_
@@ -0,0 +1,49 @@
+// Copyright 2015 Makoto Yano
+
+#ifndef HEADERS_BENCH_STROKES_H_
+#define HEADERS_BENCH_STROKES_H_
+
+#include <math.h>
+
+#include <vector>
+
+#include <LeapMath.h>
+
+#include "./pen_line.h"
+
+// Made up strokes for the benches that work on stroke points.
+namespace bench_strokes {
+
+// Tip samples per second, as the Leap sends them, and how long a stroke
+// lasts.
+static const float kSampleHz = 110.0f;
+static const float kStrokeSeconds = 2.0f;
+static const int kStrokeSamples = static_cast<int>(kSampleHz * kStrokeSeconds);
+
+// Where the tip of stroke is t seconds into it: a figure eight whose
+// speed swings between about 50 and 400 mm/s, with a different size and
+// place for every stroke.
+inline Leap::Vector Path(float t, int stroke) {
+  const float scale = 0.6f + 0.1f * (stroke % 5);
+  const float phase = 2.0f * t + 0.8f * sinf(1.3f * t + stroke);
+  return Leap::Vector((stroke % 7) * 40.0f - 120.0f
+                    , 200.0f + (stroke % 3) * 30.0f
+                    , (stroke % 4) * -20.0f)
+       + Leap::Vector(70.0f * sinf(phase), 40.0f * sinf(2.0f * phase)
+                    , 15.0f * cosf(phase)) * scale;
+}
+
+// Views of the completed strokes of store, oldest first.
+inline std::vector<pen_line::StrokeView> Completed(
+                                    const pen_line::StrokeStore &store) {
+  std::vector<pen_line::StrokeView> strokes;
+  const std::vector<unsigned int> &completed = store.completed();
+  for (size_t i = 0; i < completed.size(); i++) {
+    strokes.push_back(store.view(completed[i]));
+  }
+  return strokes;
+}
+
+}  // namespace bench_strokes
+
+#endif  // HEADERS_BENCH_STROKES_H_
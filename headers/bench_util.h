@@ -0,0 +1,65 @@
+// Copyright 2015 Makoto Yano
+
+#ifndef HEADERS_BENCH_UTIL_H_
+#define HEADERS_BENCH_UTIL_H_
+
+#include <math.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+// Keeps a function out of line so the compiler can't fold what is
+// measured into the loop around it.
+#if defined(__GNUC__)
+#define BENCH_NOINLINE __attribute__((noinline))
+#else
+#define BENCH_NOINLINE
+#endif
+
+// Timing and statistics the *_bench programs share.
+namespace bench_util {
+
+inline double Seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(
+                  std::chrono::steady_clock::now() - start).count();
+}
+
+inline double Mean(const std::vector<double> &values) {
+  double sum = 0.0;
+  for (size_t i = 0; i < values.size(); i++) {
+    sum += values[i];
+  }
+  return values.empty() ? 0.0 : sum / values.size();
+}
+
+inline double StandardDeviation(const std::vector<double> &values) {
+  const double mean = Mean(values);
+  double sum = 0.0;
+  for (size_t i = 0; i < values.size(); i++) {
+    sum += (values[i] - mean) * (values[i] - mean);
+  }
+  return values.empty() ? 0.0 : sqrt(sum / values.size());
+}
+
+inline double Rms(const std::vector<double> &values) {
+  double sum = 0.0;
+  for (size_t i = 0; i < values.size(); i++) {
+    sum += values[i] * values[i];
+  }
+  return values.empty() ? 0.0 : sqrt(sum / values.size());
+}
+
+// The value a fraction p of the way through the sorted values, 0 when
+// there are none.
+inline double Percentile(std::vector<double> values, double p) {
+  if (values.empty()) {
+    return 0.0;
+  }
+  std::sort(values.begin(), values.end());
+  return values[static_cast<size_t>(p * (values.size() - 1) + 0.5)];
+}
+
+}  // namespace bench_util
+
+#endif  // HEADERS_BENCH_UTIL_H_
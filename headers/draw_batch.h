@@ -0,0 +1,33 @@
+// Copyright 2015 Makoto Yano
+
+#ifndef HEADERS_DRAW_BATCH_H_
+#define HEADERS_DRAW_BATCH_H_
+
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#elif __linux__
+#include <GL/gl.h>
+#endif
+
+namespace draw_batch {
+
+// Everything needed to issue one glMultiDrawArrays over a vertex buffer.
+// Geometry owners record batches once per frame so that a renderer can
+// replay the same scene for both eyes without walking it again.
+struct DrawBatch {
+  GLenum mode;
+  GLuint buffer_id;
+  GLsizei stride;
+  // Byte offset of the per vertex color, or -1 to draw with color.
+  GLint color_offset;
+  GLfloat color[3];
+  GLfloat line_width;
+  // Owned by the recorder, valid until it changes its geometry.
+  const GLint *first_indexes;
+  const GLsizei *count_indexes;
+  GLsizei draw_count;
+};
+
+}  // namespace draw_batch
+
+#endif  // HEADERS_DRAW_BATCH_H_
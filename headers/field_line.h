@@ -8,6 +8,10 @@
 #include <GL/gl.h>
 #endif
 
+#include <vector>
+
+#include "draw_batch.h"
+
 namespace field_line {
 
 class FieldLine {
@@ -15,6 +19,7 @@ public:
   FieldLine();
   ~FieldLine();
   void draw();
+  void record(std::vector<draw_batch::DrawBatch> *batches) const;
 private:
   static const int span_ = 50;
   static const int width_ = 1000;
@@ -0,0 +1,62 @@
+// Copyright 2015 Makoto Yano
+
+#ifndef HEADERS_FINGERTIP_FILTER_H_
+#define HEADERS_FINGERTIP_FILTER_H_
+
+#include <stdint.h>
+
+#include <LeapMath.h>
+
+namespace fingertip_filter {
+
+struct Params {
+  // Cutoff in Hz while the tip is still.  0 turns the smoothing off and
+  // only the speed is tracked.
+  float min_cutoff;
+  // Added cutoff per mm/s of speed, so a fast tip lags less.
+  float beta;
+  // Cutoff in Hz of the speed estimate the adaptation uses.
+  float derivative_cutoff;
+};
+
+Params DefaultParams();
+
+// Smoothing factor of a first order low-pass at cutoff Hz for a step of
+// dt seconds.
+float SmoothingFactor(float cutoff, float dt);
+
+// One-Euro filter (Casiez et al.) of a fingertip: a low-pass whose
+// cutoff rises with the tip's speed.  A slow tip gets a low cutoff and
+// loses its jitter, a fast one a high cutoff and little lag.  Runs on
+// the Leap frame timestamps, so the rate it sees is the tracking rate
+// whatever thread or clock delivers the frames.
+class OneEuroFilter {
+ public:
+  // A sample further than this after the previous one restarts the
+  // filter instead of being smoothed towards a stale position.
+  static const int64_t kMaxGap = 100 * 1000;
+
+  explicit OneEuroFilter(const Params &params = DefaultParams());
+
+  void set_params(const Params &params) { params_ = params; }
+  void reset() { primed_ = false; }
+
+  // Filters a sample taken at timestamp, in microseconds.  A sample with
+  // the timestamp of the previous one returns the previous output.
+  Leap::Vector filter(const Leap::Vector &sample, int64_t timestamp);
+
+  const Leap::Vector &value() const { return value_; }
+  // Smoothed speed of the tip in mm/s.
+  float speed() const { return derivative_.magnitude(); }
+
+ private:
+  Params params_;
+  bool primed_;
+  int64_t timestamp_;
+  Leap::Vector value_;
+  Leap::Vector derivative_;
+};
+
+}  // namespace fingertip_filter
+
+#endif  // HEADERS_FINGERTIP_FILTER_H_
@@ -0,0 +1,62 @@
+// Copyright 2015 Makoto Yano
+
+#ifndef HEADERS_FRAME_HISTORY_H_
+#define HEADERS_FRAME_HISTORY_H_
+
+#include <stdint.h>
+
+#include "./frame_record.h"
+
+namespace frame_history {
+
+// About 70 ms of Leap frames, more than a sample ever reaches back.
+static const int kHistoryFrames = 8;
+// How long before the display a polled frame is sampled, in seconds.
+static const double kDefaultPollLead = 0.008;
+// How far behind the Leap clock's now a polled frame is sampled, in
+// seconds: the tracking latency and a 110 Hz frame, so the two frames
+// around the sample time have nearly always arrived.
+static const double kDefaultSampleDelay = 0.025;
+
+// Blends two records of the same hand, t = 0 being a and 1 being b.
+// Positions and directions are interpolated, fingers only when both
+// records have them; what can't be blended comes from the nearer one.
+void BlendHand(const frame_record::HandRecord &a
+             , const frame_record::HandRecord &b, float t
+             , frame_record::HandRecord *out);
+
+// The last few frames, for sampling the hands at any time between them
+// instead of taking whichever frame happens to be the newest.
+class FrameHistory {
+ public:
+  FrameHistory();
+
+  void clear() { count_ = 0; }
+  // Frames come oldest first; one no newer than the newest is ignored.
+  void Add(const frame_record::FrameRecord &frame);
+
+  int size() const { return count_; }
+  // Oldest first.
+  const frame_record::FrameRecord &frame(int index) const {
+    return frames_[(first_ + index) % kHistoryFrames];
+  }
+  const frame_record::FrameRecord &newest() const { return frame(count_ - 1); }
+  // -1 while empty.
+  int64_t newest_id() const { return count_ > 0 ? newest().id : -1; }
+
+  // The hands as they were at timestamp, on the Leap clock in
+  // microseconds.  Hands in both frames around timestamp are blended,
+  // the others come from the nearer frame.  Outside the history the
+  // nearest end is returned as it is, timestamp included.  False while
+  // empty.
+  bool Sample(int64_t timestamp, frame_record::FrameRecord *out) const;
+
+ private:
+  frame_record::FrameRecord frames_[kHistoryFrames];
+  int first_;
+  int count_;
+};
+
+}  // namespace frame_history
+
+#endif  // HEADERS_FRAME_HISTORY_H_
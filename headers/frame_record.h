@@ -0,0 +1,119 @@
+// Copyright 2015 Makoto Yano
+
+#ifndef HEADERS_FRAME_RECORD_H_
+#define HEADERS_FRAME_RECORD_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <functional>
+#include <vector>
+
+namespace frame_record {
+
+static const int kMaxHands = 4;
+static const int kFingerCount = 5;
+static const int kBoneCount = 4;
+
+// Plain copies of the parts of a Leap::Frame the hand processing uses.
+// Nothing in here needs the Leap SDK, so recorded frames can be replayed
+// on machines without it.  Positions are in Leap millimeters.
+struct BoneRecord {
+  float prev_joint[3];
+  float next_joint[3];
+};
+
+struct FingerRecord {
+  int32_t id;
+  uint8_t valid;
+  uint8_t extended;
+  uint8_t padding[2];
+  float tip_position[3];
+  // Metacarpal, proximal, intermediate and distal.
+  BoneRecord bones[kBoneCount];
+};
+
+struct HandRecord {
+  int32_t id;
+  uint8_t is_left;
+  uint8_t padding[3];
+  int32_t extended_finger_count;
+  int32_t pointable_count;
+  float confidence;
+  float grab_strength;
+  float palm_position[3];
+  float palm_normal[3];
+  float direction[3];
+  // x, y and z basis vectors one after the other.
+  float basis[9];
+  float elbow_position[3];
+  float wrist_position[3];
+  // Thumb to pinky.
+  FingerRecord fingers[kFingerCount];
+};
+
+struct FrameRecord {
+  int64_t id;
+  // Leap timestamp in microseconds.
+  int64_t timestamp;
+  int32_t hand_count;
+  int32_t padding;
+  HandRecord hands[kMaxHands];
+};
+
+// File layout, native byte order:
+//   FileHeader, then per frame the first offsetof(FrameRecord, hands)
+//   bytes of the FrameRecord followed by hand_count HandRecords.
+struct FileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t frame_header_size;
+  uint32_t hand_record_size;
+};
+
+static const uint32_t kFileVersion = 1;
+
+// Appends frames to a recording.
+class FrameRecorder {
+ public:
+  FrameRecorder();
+  ~FrameRecorder();
+
+  bool Open(const char *path);
+  void Close();
+  bool is_open() const { return file_ != NULL; }
+  void Write(const FrameRecord &record);
+  unsigned long frame_count() const { return frame_count_; }  // NOLINT
+
+ private:
+  FILE *file_;
+  unsigned long frame_count_;  // NOLINT
+};
+
+// Read only view of a recording through mmap.  Opening only walks the
+// frame headers to index them; frames are copied out on demand.
+class FrameReplay {
+ public:
+  FrameReplay();
+  ~FrameReplay();
+
+  bool Open(const char *path);
+  void Close();
+  size_t frame_count() const { return offsets_.size(); }
+  void Read(size_t index, FrameRecord *record) const;
+
+  // Feeds every frame to on_frame, in order, until it returns false.
+  // With realtime the original spacing of the Leap timestamps is kept,
+  // otherwise frames are fed as fast as on_frame returns.
+  void Play(const std::function<bool(const FrameRecord &)> &on_frame
+          , bool realtime) const;
+
+ private:
+  const unsigned char *data_;
+  size_t size_;
+  std::vector<size_t> offsets_;
+};
+
+}  // namespace frame_record
+
+#endif  // HEADERS_FRAME_RECORD_H_
@@ -0,0 +1,103 @@
+// Copyright 2015 Makoto Yano
+
+#ifndef HEADERS_FRAME_TRACE_H_
+#define HEADERS_FRAME_TRACE_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Times the rest of the enclosing block as the stage name, a string
+// literal, when tracing is on.
+#define FRAME_TRACE_SCOPE(name) \
+    frame_trace::Scope FRAME_TRACE_JOIN_(frame_trace_scope_, __LINE__)(name)
+#define FRAME_TRACE_JOIN_(a, b) FRAME_TRACE_JOIN2_(a, b)
+#define FRAME_TRACE_JOIN2_(a, b) a##b
+
+namespace frame_trace {
+
+// Scoped timers for the stages of a frame.  Each thread records into its
+// own ring of the last kRingEvents scopes, so recording takes no lock and
+// never waits for a reader; a reader that falls a ring behind loses the
+// oldest events.  Off until SetEnabled(true), and then a scope costs two
+// clock reads and a store.
+static const int kRingEvents = 8192;
+// How many of the latest durations each stage histogram covers.
+static const int kHistogramWindow = 1024;
+
+extern std::atomic<bool> enabled_flag;
+
+inline bool Enabled() {
+  return enabled_flag.load(std::memory_order_relaxed);
+}
+void SetEnabled(bool enabled);
+
+// Names the calling thread in the trace.  name must outlive the trace.
+void SetThreadName(const char *name);
+
+// Nanoseconds on the steady clock.
+inline int64_t Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Appends one finished scope to the calling thread's ring.
+void Record(const char *name, int64_t begin, int64_t end);
+
+// A ring that belongs to no thread, for work timed somewhere else and
+// recorded later, like the GPU's.  It shows up as its own row in the
+// trace and its stages go into the same histograms.  Only one thread at
+// a time may record on it.
+struct Ring;
+Ring *AddTrack(const char *name);
+void Record(Ring *track, const char *name, int64_t begin, int64_t end);
+
+class Scope {
+ public:
+  explicit Scope(const char *name)
+    : name_(name), begin_(Enabled() ? Now() : -1) {}
+  ~Scope() {
+    if (begin_ >= 0) {
+      Record(name_, begin_, Now());
+    }
+  }
+
+ private:
+  Scope(const Scope &);
+  Scope &operator=(const Scope &);
+
+  const char *name_;
+  int64_t begin_;
+};
+
+struct StageStats {
+  std::string name;
+  // Scopes in the window, and every scope collected so far.
+  unsigned long window_count;  // NOLINT
+  unsigned long total_count;  // NOLINT
+  // Milliseconds, upper bounds of the histogram bucket they fall in.
+  double p50;
+  double p95;
+  double p99;
+  double max;
+};
+
+// Folds the scopes recorded since the last call into the rolling
+// histograms of their stages.  Collect() and the reports run on one
+// thread, usually the render thread once a frame.
+void Collect();
+// Stats of every stage seen so far, by name.
+void GetStageStats(std::vector<StageStats> *stats);
+void PrintStageStats();
+
+// Writes what the rings hold as Chrome trace event JSON, for
+// chrome://tracing or Perfetto.  Returns false when the file can't be
+// written.
+bool WriteChromeTrace(const char *path);
+
+}  // namespace frame_trace
+
+#endif  // HEADERS_FRAME_TRACE_H_
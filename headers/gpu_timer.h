@@ -0,0 +1,123 @@
+// Copyright 2015 Makoto Yano
+
+#ifndef HEADERS_GPU_TIMER_H_
+#define HEADERS_GPU_TIMER_H_
+
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#elif __linux__
+#include <GL/gl.h>
+#endif
+
+#include <stdint.h>
+
+#include "./frame_trace.h"
+
+// Times the GL commands issued in the rest of the enclosing block as the
+// stage name, a string literal.  timer may be NULL.
+#define GPU_TIMER_SCOPE(timer, name) \
+    gpu_timer::Scope FRAME_TRACE_JOIN_(gpu_timer_scope_, __LINE__)( \
+        timer, name)
+
+namespace gpu_timer {
+
+// Frames in flight: a frame's queries are read back when their results
+// are there, at the latest when the frame this many frames later begins.
+static const int kFrameSlots = 4;
+// Scopes per frame; later ones in the same frame are not timed.
+static const int kMaxScopes = 16;
+
+// Measures how long the GPU spends on parts of a frame with timestamp
+// queries, which unlike GL_TIME_ELAPSED may nest.  Results are never
+// waited for: each BeginFrame() reads back the older frames whose
+// queries are done, and a frame that is still not done when its slot
+// comes round again is dropped.  Stages go to the frame_trace "gpu"
+// track, moved onto the CPU clock, so they land in the same histograms
+// and Chrome trace as the CPU stages.  Times only while frame_trace is
+// enabled.  Needs GL 3.3 or ARB_timer_query; Initialize() returns false
+// otherwise and every call is a no-op.
+class GpuTimer {
+ public:
+  GpuTimer();
+  ~GpuTimer();
+
+  // Needs a current GL context.
+  bool Initialize();
+  bool supported() const { return track_ != NULL; }
+
+  void BeginFrame();
+  void EndFrame();
+  // Scopes nest and must close in reverse order, within the frame.
+  void Begin(const char *name);
+  void End();
+
+  // Frames whose timings were recorded, and frames given up on because
+  // the GPU was still on them kFrameSlots frames later.
+  unsigned long resolved_frame_count() const { return resolved_frames_; }  // NOLINT
+  unsigned long dropped_frame_count() const { return dropped_frames_; }  // NOLINT
+  // Frames from issuing the queries to reading them back, of the last
+  // frame read back.
+  int last_readback_latency() const { return last_readback_latency_; }
+
+ private:
+  struct Interval {
+    const char *name;
+    // Indexes of the begin and end queries, -1 while still open.
+    int begin_query;
+    int end_query;
+  };
+
+  struct Frame {
+    // Whether the frame has queries that were not read back yet.
+    bool pending;
+    uint64_t number;
+    int query_count;
+    int interval_count;
+    Interval intervals[kMaxScopes];
+    GLuint queries[2 * kMaxScopes];
+  };
+
+  void ReadBack_();
+  bool Resolve_(Frame *frame);
+  void Calibrate_();
+
+  frame_trace::Ring *track_;
+  Frame frames_[kFrameSlots];
+  // The frame being recorded, or NULL between frames and while tracing
+  // is off.
+  Frame *current_;
+  uint64_t frame_number_;
+  // Open scopes of the current frame, innermost last.
+  int open_[kMaxScopes];
+  int open_count_;
+  // CPU clock minus GPU clock, nanoseconds.
+  int64_t clock_offset_;
+  uint64_t calibrated_frame_;
+  unsigned long resolved_frames_;  // NOLINT
+  unsigned long dropped_frames_;  // NOLINT
+  int last_readback_latency_;
+};
+
+class Scope {
+ public:
+  Scope(GpuTimer *timer, const char *name) : timer_(timer) {
+    if (timer_) {
+      timer_->Begin(name);
+    }
+  }
+  ~Scope() {
+    if (timer_) {
+      timer_->End();
+    }
+  }
+
+ private:
+  Scope(const Scope &);
+  Scope &operator=(const Scope &);
+
+  GpuTimer *timer_;
+};
+
+}  // namespace gpu_timer
+
+#endif  // HEADERS_GPU_TIMER_H_
@@ -5,46 +5,59 @@
 
 #include <Leap.h>
 
-#include <map>
-#include <vector>
-
-#include "./Quaternion.h"
-#include "./pen_line.h"
-#include "./virtual_hand.h"
-
-#define DEFAULT_CAMERA_X 0
-#define DEFAULT_CAMERA_Y 300
-#define DEFAULT_CAMERA_Z 600
-#define MAX_TRACABLE_POINT_COUNT 10
+#include "./frame_history.h"
+#include "./frame_record.h"
+#include "./input_thread.h"
 
 namespace hand_listener {
 
+// Copies the parts of frame the hand processing uses into record.
+void CaptureFrame(const Leap::Frame& frame
+                , frame_record::FrameRecord *record);
+
+// Copies each Leap frame into a FrameRecord straight in the input
+// thread's queue and returns.  Everything else about the frame happens
+// on the input thread, so the Leap thread is never held up.
 class HandInputListener : public Leap::Listener {
  public:
-  virtual void onInit(const Leap::Controller& controller);
+  explicit HandInputListener(InputThread *input);
+
   virtual void onFrame(const Leap::Controller& controller);
-  void initialize_world_position();
 
-  void lock();
-  void unlock();
-  bool rotating;
-  Quaternion world_x_quaternion;
-  Quaternion world_y_quaternion;
-  pen_line::LineList penline_list;
-  std::map<int, pen_line::TracingLine> tracing_lines;
-  std::vector<virtual_hand::SkeletonHand> skeleton_hands;
+ private:
+  InputThread *input_;
+};
+
+// The other way round: the render loop asks the controller for its
+// frame history when it wants hands, at the same point of every frame,
+// and samples them for a fixed time.  Nothing runs on the Leap thread
+// and nothing is shared with it.
+class InputPoller {
+ public:
+  explicit InputPoller(const Leap::Controller *controller);
+
+  // Copies the frames that came in since the last call into history()
+  // and returns the Leap clock's now, in microseconds.
+  int64_t Poll();
+  const frame_history::FrameHistory &history() const { return history_; }
+  // New frames are written to recorder while it is set and open.
+  void set_recorder(frame_record::FrameRecorder *recorder) {
+    recorder_ = recorder;
+  }
 
-  float camera_x_position;
-  float camera_y_position;
-  float camera_z_position;
+  unsigned long poll_count() const { return poll_count_; }  // NOLINT
+  unsigned long frame_count() const { return frame_count_; }  // NOLINT
+  // Frames that fell out of the controller's history between two polls.
+  unsigned long missed_frame_count() const { return missed_frame_count_; }  // NOLINT
 
  private:
-  Leap::Vector convert_to_world_position_(const Leap::Vector &input_vector);
-  bool _lock;
-  int open_hand_id_(const Leap::Frame& frame);
-  void trace_finger_(const Leap::Hand& hand);
-  void rotate_camera_(const Leap::Hand& hand);
-  void clean_line_map_(const Leap::Frame& frame);
+  const Leap::Controller *controller_;
+  frame_record::FrameRecorder *recorder_;
+  frame_history::FrameHistory history_;
+  frame_record::FrameRecord record_;
+  unsigned long poll_count_;  // NOLINT
+  unsigned long frame_count_;  // NOLINT
+  unsigned long missed_frame_count_;  // NOLINT
 };
 
 }  // namespace hand_listener
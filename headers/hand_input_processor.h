@@ -0,0 +1,103 @@
+// Copyright 2015 Makoto Yano
+
+#ifndef HEADERS_HAND_INPUT_PROCESSOR_H_
+#define HEADERS_HAND_INPUT_PROCESSOR_H_
+
+#include <stdint.h>
+#include <LeapMath.h>
+
+#include <map>
+#include <random>
+#include <vector>
+
+#include "./Quaternion.h"
+#include "./fingertip_filter.h"
+#include "./frame_record.h"
+#include "./motion_predictor.h"
+#include "./pen_line.h"
+#include "./scene_snapshot.h"
+#include "./triple_buffer.h"
+#include "./virtual_hand.h"
+
+#define DEFAULT_CAMERA_X 0
+#define DEFAULT_CAMERA_Y 300
+#define DEFAULT_CAMERA_Z 600
+#define MAX_TRACABLE_POINT_COUNT 10
+// Max distance a simplified stroke may stray from the traced samples.
+#define STROKE_SIMPLIFY_TOLERANCE 0.5f
+// A stroke starts once the fingertip has been tracked for this many
+// microseconds without moving faster than STROKE_START_MAX_SPEED mm/s.
+#define STROKE_START_DELAY 40000
+#define STROKE_START_MAX_SPEED 1000.0f
+// Stroke colors come from a fixed seed so a replayed recording draws
+// the same picture every time.
+#define COLOR_RANDOM_SEED 1
+
+namespace hand_listener {
+
+// Turns hand frames into strokes, camera motion and skeleton hands.
+// It only sees frame_record::FrameRecord, so live Leap input and
+// recorded frames go through exactly the same code.  process_frame()
+// is called from one thread, acquire_snapshot() from the render thread.
+class HandInputProcessor {
+ public:
+  HandInputProcessor();
+
+  void process_frame(const frame_record::FrameRecord &frame);
+  // received_time is when the frame came in, on the clock of
+  // motion_predictor::MonotonicSeconds(), when it waited to be processed.
+  void process_frame(const frame_record::FrameRecord &frame
+                   , double received_time);
+  void initialize_world_position();
+
+  // Render thread side.  Returns the latest published frame without
+  // waiting for the input thread.  The reference stays valid until the
+  // next call.
+  const scene_snapshot::SceneSnapshot &acquire_snapshot();
+  unsigned long published_snapshot_count() const;  // NOLINT
+  unsigned long dropped_snapshot_count() const;  // NOLINT
+  // Raw fingertip samples taken for strokes, before simplification.
+  unsigned long sampled_point_count() const { return sampled_point_count_; }  // NOLINT
+
+  bool rotating;
+  Quaternion world_x_quaternion;
+  Quaternion world_y_quaternion;
+  pen_line::StrokeStore strokes;
+  std::map<int, pen_line::TracingLine> tracing_lines;
+  virtual_hand::HandBuffer skeleton_hands;
+
+  float camera_x_position;
+  float camera_y_position;
+  float camera_z_position;
+  float simplify_tolerance;
+  fingertip_filter::Params tip_filter_params;
+  int64_t stroke_start_delay;
+
+ private:
+  // Folds the camera position and world rotation into world_transform_.
+  // They only change between frames, so once per frame is enough.
+  void update_world_transform_();
+  Leap::Vector convert_to_world_position_(const Leap::Vector &input_vector);
+  void publish_snapshot_();
+  int open_hand_index_(const frame_record::FrameRecord& frame);
+  void trace_finger_(const frame_record::HandRecord& hand, int64_t now);
+  void track_palms_(const frame_record::FrameRecord& frame);
+  void rotate_camera_(const frame_record::HandRecord& hand);
+  void clean_line_map_(const frame_record::FrameRecord& frame);
+  bool pointable_valid_(const frame_record::FrameRecord& frame, int id) const;
+  void finish_tracing_line_(const pen_line::TracingLine &tracing_line);
+
+  triple_buffer::TripleBuffer<scene_snapshot::SceneSnapshot> snapshots_;
+  unsigned long snapshot_sequence_;  // NOLINT
+  unsigned long sampled_point_count_;  // NOLINT
+  std::minstd_rand color_random_;
+  PointTransform world_transform_;
+  std::vector<Leap::Vector> simplified_points_;
+  double received_time_;
+  // Palm motion by hand id, of the hands in the last frame.
+  std::map<int, motion_predictor::MotionTracker> palm_trackers_;
+};
+
+}  // namespace hand_listener
+
+#endif  // HEADERS_HAND_INPUT_PROCESSOR_H_
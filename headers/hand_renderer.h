@@ -0,0 +1,84 @@
+// Copyright 2015 Makoto Yano
+
+#ifndef HEADERS_HAND_RENDERER_H_
+#define HEADERS_HAND_RENDERER_H_
+
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#elif __linux__
+#include <GL/gl.h>
+#endif
+
+#include <vector>
+
+#include "./Quaternion.h"
+#include "./stereo_renderer.h"
+#include "./virtual_hand.h"
+
+namespace hand_renderer {
+
+// One capsule from start to end.  A joint is a capsule with both ends on
+// the same point, which makes it a sphere.
+struct HandInstance {
+  GLfloat start[3];
+  GLfloat radius;
+  GLfloat end[3];
+  GLfloat color[3];
+};
+
+// Per hand: a sphere on each joint, then a capsule along each bone.
+static const int kInstancesPerHand = 2 * virtual_hand::kJointCount;
+
+// Fills instances for hands, with the joints moved by hand_to_world.
+void BuildInstances(const virtual_hand::HandBuffer &hands
+                  , const PointTransform &hand_to_world
+                  , std::vector<HandInstance> *instances);
+
+// Draws the joints and bones of every hand with one instanced draw of a
+// capsule mesh, for one eye or for both at once.  The instances of a
+// frame go to the GPU in one buffer, so the draw call count stays the
+// same however many hands there are.  Needs GL 3.3 (instanced arrays);
+// Initialize() returns false otherwise and the hands are not drawn.
+class HandRenderer {
+ public:
+  HandRenderer();
+  ~HandRenderer();
+
+  bool Initialize();
+  bool supported() const { return program_ != 0; }
+
+  // Builds and uploads this frame's instances.
+  void Update(const virtual_hand::HandBuffer &hands
+            , const PointTransform &hand_to_world);
+
+  // With two eye viewports both eyes are drawn in the one call, each
+  // with its own matrix; otherwise eye_view_projection[0] is drawn into
+  // the current viewport.  Matrices are column major.
+  void Render(const GLfloat eye_view_projection[2][16]
+            , const stereo_renderer::EyeViewport *eye_viewport
+            , int eye_count);
+
+  size_t instance_count() const { return instances_.size(); }
+  int draw_call_count() const { return draw_calls_; }
+  // Vertices submitted by the last Render(), counted once per eye.
+  unsigned long vertex_count() const { return vertices_; }  // NOLINT
+
+ private:
+  void BuildMesh_();
+
+  GLuint program_;
+  GLuint mesh_buffer_;
+  GLuint index_buffer_;
+  GLuint instance_buffer_;
+  GLsizei index_count_;
+  GLint eye_view_projection_location_;
+  GLint eye_viewport_location_;
+  GLint eye_count_location_;
+  std::vector<HandInstance> instances_;
+  int draw_calls_;
+  unsigned long vertices_;  // NOLINT
+};
+
+}  // namespace hand_renderer
+
+#endif  // HEADERS_HAND_RENDERER_H_
@@ -0,0 +1,84 @@
+// Copyright 2015 Makoto Yano
+
+#ifndef HEADERS_HMD_BACKEND_H_
+#define HEADERS_HMD_BACKEND_H_
+
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#elif __linux__
+#include <GL/gl.h>
+#endif
+
+#include "./Quaternion.h"
+#include "./stereo_renderer.h"
+
+namespace hmd_backend {
+
+enum Eye {
+  kEyeLeft,
+  kEyeRight,
+  kEyeCount
+};
+
+// Times are in seconds on the backend's own clock, see Now().
+struct Pose {
+  // Head orientation, HMD space to world space.
+  Quaternion orientation;
+  // Meters.
+  float position[3];
+  // When the head is, or is predicted to be, in this pose.
+  double time;
+  // When the sensors were read for it.
+  double sample_time;
+};
+
+struct EyeDesc {
+  // Where the eye is drawn inside the render target.
+  stereo_renderer::EyeViewport viewport;
+  // From the center of the head to the eye, meters.
+  float view_offset[3];
+};
+
+struct FrameTiming {
+  double begin_time;
+  // When the frame is expected to reach the display.
+  double display_time;
+};
+
+// What the app needs from a headset: tracking, how each eye is laid out
+// in the render target, the frame begin/end around rendering and the
+// render target itself.  The render loop only talks to this, so it runs
+// the same on a real device and on SimulatedHmd.
+class HmdBackend {
+ public:
+  virtual ~HmdBackend() {}
+
+  // False when there is no device; the scene is then drawn once into the
+  // window and eye related calls must not be used.
+  virtual bool connected() const = 0;
+  // Creates the render target.  Needs a current GL context.
+  virtual void SetupRendering() = 0;
+  virtual double Now() const = 0;
+
+  // Samples the head now and predicts its pose at display_time, usually
+  // FrameTiming::display_time.  False when tracking is lost.  Call it as
+  // late as possible before drawing: the frame is rendered with, and
+  // handed back for time warp with, the poses of the last call.
+  virtual bool Track(double display_time, Pose *pose) = 0;
+  virtual void GetEyeDescs(EyeDesc eye_desc[kEyeCount]) const = 0;
+  // The eye poses of the last Track(), without sampling again.
+  virtual void GetEyePoses(Pose eye_pose[kEyeCount]) = 0;
+
+  // Binds the render target.  Rendering for the frame goes between
+  // these two.
+  virtual void BeginFrame(FrameTiming *timing) = 0;
+  virtual void EndFrame() = 0;
+  virtual GLuint framebuffer() const = 0;
+  // True when EndFrame() puts the frame on the display itself and the
+  // caller must not swap the window.
+  virtual bool presents_frame() const = 0;
+};
+
+}  // namespace hmd_backend
+
+#endif  // HEADERS_HMD_BACKEND_H_
@@ -0,0 +1,107 @@
+// Copyright 2015 Makoto Yano
+
+#ifndef HEADERS_INPUT_THREAD_H_
+#define HEADERS_INPUT_THREAD_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "./frame_record.h"
+#include "./spsc_queue.h"
+
+namespace hand_listener {
+
+// About 130 ms of Leap frames.
+static const size_t kInputQueueFrames = 16;
+
+struct InputStats {
+  // Frames waiting right now, and the most that ever waited.
+  size_t queue_depth;
+  size_t max_queue_depth;
+  unsigned long received;  // NOLINT
+  // Frames thrown away because the queue was full.
+  unsigned long dropped;  // NOLINT
+  unsigned long processed;  // NOLINT
+  // Microseconds on_frame took per frame.
+  double last_process_us;
+  double mean_process_us;
+  double max_process_us;
+  // Microseconds frames waited in the queue, on average.
+  double mean_queue_wait_us;
+};
+
+// Runs the hand processing on a thread of its own.  The Leap thread only
+// copies each frame into a bounded single-producer / single-consumer
+// queue and returns; the worker takes the frames out in order, writes
+// them to the recorder when there is one and hands them to on_frame
+// with the time they were received.  When the worker is a whole queue
+// behind, new frames are dropped and counted instead of making the Leap
+// thread wait.
+class InputThread {
+ public:
+  typedef std::function<void(const frame_record::FrameRecord &
+                           , double received_time)> FrameHandler;
+
+  explicit InputThread(const FrameHandler &on_frame);
+  // Stops the worker.
+  ~InputThread();
+
+  void Start();
+  // Processes the frames still queued and joins the worker.
+  void Stop();
+  // Frames are written to recorder while it is set and open.  Set it
+  // before Start().
+  void set_recorder(frame_record::FrameRecorder *recorder) {
+    recorder_ = recorder;
+  }
+
+  // Producer side, from one thread at a time.  BeginPush() returns the
+  // slot to fill in, or NULL when the queue is full and the frame is
+  // dropped; a filled slot is queued by EndPush().
+  frame_record::FrameRecord *BeginPush();
+  void EndPush();
+
+  // From any thread.
+  void GetStats(InputStats *stats) const;
+
+ private:
+  struct QueuedFrame {
+    double received_time;
+    frame_record::FrameRecord record;
+  };
+
+  void Run_();
+
+  FrameHandler on_frame_;
+  frame_record::FrameRecorder *recorder_;
+  spsc_queue::SpscQueue<QueuedFrame, kInputQueueFrames> queue_;
+  QueuedFrame *pushing_;
+
+  // The worker polls the queue for a while before it sleeps, and sleeps
+  // on wake_ only after setting sleeping_, so the producer takes the
+  // mutex only when there is someone to wake.
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::atomic<bool> sleeping_;
+  std::atomic<bool> stopping_;
+  std::thread worker_;
+
+  std::atomic<unsigned long> received_;  // NOLINT
+  std::atomic<unsigned long> dropped_;  // NOLINT
+  std::atomic<unsigned long> processed_;  // NOLINT
+  std::atomic<size_t> max_queue_depth_;
+  // Nanoseconds.
+  std::atomic<int64_t> last_process_time_;
+  std::atomic<int64_t> max_process_time_;
+  std::atomic<int64_t> total_process_time_;
+  std::atomic<int64_t> total_queue_wait_;
+};
+
+}  // namespace hand_listener
+
+#endif  // HEADERS_INPUT_THREAD_H_
@@ -0,0 +1,74 @@
+// Copyright 2015 Makoto Yano
+
+#ifndef HEADERS_MOTION_PREDICTOR_H_
+#define HEADERS_MOTION_PREDICTOR_H_
+
+#include <stdint.h>
+
+#include <LeapMath.h>
+
+namespace motion_predictor {
+
+// Predictions never reach further ahead than this many seconds; past it
+// the acceleration term does more harm than good.
+static const float kMaxHorizon = 0.06f;
+// Seconds from the Leap capturing a frame to the frame reaching the
+// listener.  The SDK does not report it, this is about a frame and a half
+// of the 110 Hz HMD mode.
+static const float kDefaultTrackingLatency = 0.014f;
+
+// Where a tracked point was at its last sample and how it was moving, in
+// mm, mm/s and mm/s^2.
+struct Motion {
+  Leap::Vector position;
+  Leap::Vector velocity;
+  Leap::Vector acceleration;
+};
+
+// A point that holds still at position.
+Motion Still(const Leap::Vector &position);
+
+// Where the point will be horizon seconds after its last sample, with
+// horizon clamped to [0, kMaxHorizon].
+Leap::Vector Predict(const Motion &motion, float horizon);
+
+// Seconds on a monotonic clock, for the input and the render thread to
+// agree on how old a frame is.
+double MonotonicSeconds();
+
+// How far ahead to predict a frame received at received_time, on the
+// MonotonicSeconds() clock, to show it display_delay seconds from now.
+float Horizon(double received_time, double display_delay
+            , float tracking_latency);
+
+// Tracks the velocity and the acceleration of one point from its samples,
+// each smoothed by a low-pass on the Leap frame timestamps.  Runs on the
+// input thread; only the Motion it ends up with is handed on.
+class MotionTracker {
+ public:
+  // A sample further than this after the previous one restarts the
+  // tracking from a still point.
+  static const int64_t kMaxGap = 100 * 1000;
+  // Cutoffs in Hz of the velocity and of the acceleration estimate.
+  static const float kVelocityCutoff;
+  static const float kAccelerationCutoff;
+
+  MotionTracker();
+
+  void reset() { primed_ = false; }
+  // Adds a sample taken at timestamp, in microseconds.  A sample with the
+  // timestamp of the previous one is ignored.
+  void update(const Leap::Vector &position, int64_t timestamp);
+
+  bool primed() const { return primed_; }
+  const Motion &motion() const { return motion_; }
+
+ private:
+  bool primed_;
+  int64_t timestamp_;
+  Motion motion_;
+};
+
+}  // namespace motion_predictor
+
+#endif  // HEADERS_MOTION_PREDICTOR_H_
@@ -20,28 +20,37 @@
 #include <GLFW/glfw3.h>
 #include <GLFW/glfw3native.h>
 #include <OVR_CAPI_GL.h>
-#include <boost/optional.hpp>
 
-#include "field_line.h"
-#include "hand_input_listener.h"
+#include "hmd_backend.h"
 
 namespace oculus_vr {
 
 bool Initialize();
 void Shutdown();
 
-class OculusHmd {
+// HmdBackend over the OVR 0.4 C API with SDK distortion rendering.
+// Without a device it reports not connected and renders nothing itself.
+class OculusHmd : public hmd_backend::HmdBackend {
  public:
   OculusHmd();
-  ~OculusHmd();
+  virtual ~OculusHmd();
 
-  boost::optional<ovrPoseStatef> Track();
-  void SetupOvrConfig();
+  virtual bool connected() const { return hmd_ != NULL; }
+  virtual void SetupRendering();
+  virtual double Now() const;
+
+  virtual bool Track(double display_time, hmd_backend::Pose *pose);
+  virtual void GetEyeDescs(
+                hmd_backend::EyeDesc eye_desc[hmd_backend::kEyeCount]) const;
+  virtual void GetEyePoses(hmd_backend::Pose eye_pose[hmd_backend::kEyeCount]);
+
+  virtual void BeginFrame(hmd_backend::FrameTiming *timing);
+  virtual void EndFrame();
+  virtual GLuint framebuffer() const { return frameBuffer_; }
+  virtual bool presents_frame() const { return rendering_; }
+
+  // The monitor the HMD shows up as, when it runs as an extended display.
   GLFWmonitor *Monitor();
-  void FrameInit();
-  void FrameRender(field_line::FieldLine *bg_line
-                    , hand_listener::HandInputListener &listener_for_draw); // NOLINT
-  void FrameEnd();
 
  private:
   void InitializeHmd_();
@@ -52,6 +61,10 @@ class OculusHmd {
   ovrEyeRenderDesc eye_render_desc_[2];
   ovrRecti eyeRenderViewport_[2];
   ovrGLTexture eyeTexture_[2];
+  // Poses the frame is rendered with, handed back for time warp.
+  ovrPosef eyeRenderPose_[2];
+  double sample_time_;
+  bool rendering_;
 
   // Vertex Array Object用
   GLuint frameBuffer_;
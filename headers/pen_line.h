@@ -1,21 +1,138 @@
 #ifndef PEN_LINE_H_
 #define PEN_LINE_H_
 
-#include <list>
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
 
-#include <Leap.h>
 #include <LeapMath.h>
 
+#include "./fingertip_filter.h"
+#include "./motion_predictor.h"
+#include "./stroke_simplifier.h"
+
 namespace pen_line {
 
-typedef std::list<Leap::Vector> Line;
-typedef std::list<Line> LineList;
+struct Color {
+  float r;
+  float g;
+  float b;
+};
+
+// Read only window onto the points of one stroke.  The points live in a
+// StrokeStore chunk that is never moved or freed while the store lives, so
+// a view can be handed to another thread and read after the writer has
+// moved on.  Only points [0, count) are guaranteed to be written.
+struct StrokeView {
+  unsigned int id;
+  Color color;
+  const Leap::Vector *points;
+  unsigned int count;
+  // Bumped every time rewrite() replaces the stroke's points.  Within a
+  // revision points are only appended, or thinned out by thin(), so what
+  // was read of the stroke under its revision still stands for it.
+  unsigned int revision;
+};
+
+// Stroke storage that keeps points in large contiguous chunks instead of
+// one heap node per point.  Each stroke owns a reserved run inside a chunk
+// and grows in place while it can; when it can't, the run is relocated to
+// a bigger reservation at the end of the arena, so appends stay amortized
+// O(1) even with several strokes traced at the same time.  Old runs are
+// left untouched, which keeps views taken before the move valid.
+class StrokeStore {
+ public:
+  static const unsigned int kChunkPoints = 64 * 1024;
+  static const unsigned int kMinReserve = 64;
+
+  StrokeStore();
+
+  unsigned int begin_stroke(const Color &color);
+  void append(unsigned int id, const Leap::Vector &point);
+  // Replaces the points of a live stroke and bumps its revision.  They go
+  // to a new reservation so views of the old points stay intact.
+  void rewrite(unsigned int id, const Leap::Vector *points
+              , unsigned int count);
+  // Replaces the points of a live stroke with some of them, kept in
+  // order, like a simplification pass leaves them.  Views of the old
+  // points stay intact, and the revision stays too.
+  void thin(unsigned int id, const Leap::Vector *points
+          , unsigned int count);
+  // Hands a live stroke over to the completed list.  No points are copied.
+  void finish(unsigned int id);
+  // Drops a live stroke that is too short to keep.
+  void discard(unsigned int id);
+
+  // Makes count points that live outside the store, like a mapped scene
+  // file, usable by add_finished().  They are never copied or written;
+  // owner is held until the store goes away.
+  unsigned int add_external_chunk(const Leap::Vector *points
+                                , unsigned int count
+                                , std::shared_ptr<const void> owner);
+  // Adds a completed stroke made of points already in a chunk.
+  unsigned int add_finished(unsigned int chunk, unsigned int offset
+                          , unsigned int count, const Color &color);
+
+  StrokeView view(unsigned int id) const;
+  unsigned int size(unsigned int id) const { return headers_[id].count; }
+  // Ids of completed strokes in completion order.  Only ever appended to.
+  const std::vector<unsigned int> &completed() const { return completed_; }
+
+  size_t point_count() const;
+  size_t reserved_bytes() const;
+
+ private:
+  struct Header {
+    unsigned int chunk;
+    unsigned int offset;
+    unsigned int count;
+    unsigned int capacity;
+    unsigned int revision;
+    Color color;
+  };
+  struct Chunk {
+    // Empty for external chunks, which are full from the start.
+    std::unique_ptr<Leap::Vector[]> storage;
+    std::shared_ptr<const void> owner;
+    const Leap::Vector *points;
+    unsigned int size;
+    unsigned int capacity;
+  };
+
+  void grow_(Header *header);
+  void replace_(Header *header, const Leap::Vector *points
+              , unsigned int count);
+  void allocate_(unsigned int count, unsigned int *chunk, unsigned int *offset);
+
+  std::vector<Header> headers_;
+  std::vector<Chunk> chunks_;
+  std::vector<unsigned int> completed_;
+};
+
+static const int kNoStroke = -1;
 
 struct TracingLine {
-  int counter;
+  TracingLine()
+    : drawing(false), dwell_start(-1), stroke(kNoStroke), sampled(0) {
+  }
+
+  // The tip has dwelt and its samples go into the stroke.
+  bool drawing;
   Leap::Vector previous_position;
-  struct timeval time_buffer;
-  Line line;
+  // Frame timestamp in microseconds since when the tip has been tracked
+  // and slow, -1 while it is not tracked.
+  int64_t dwell_start;
+  // Id of the live stroke in the processor's StrokeStore.
+  int stroke;
+  // Raw samples taken for the stroke, before simplification.
+  unsigned int sampled;
+  stroke_simplifier::StreamingSimplifier simplifier;
+  // Smooths the tip before the dwell and the stroke see it.
+  fingertip_filter::OneEuroFilter filter;
+  // How the filtered tip moves in world space, for the display to show
+  // it where it will be rather than where it was.
+  motion_predictor::MotionTracker motion;
 };
 
 }
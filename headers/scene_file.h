@@ -0,0 +1,72 @@
+// Copyright 2015 Makoto Yano
+
+#ifndef HEADERS_SCENE_FILE_H_
+#define HEADERS_SCENE_FILE_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <LeapMath.h>
+
+#include "./pen_line.h"
+
+namespace scene_file {
+
+// File layout, native byte order:
+//   FileHeader, stroke_count StrokeEntries, then at points_offset the
+//   points of all strokes back to back as packed Leap::Vectors.  The
+//   points start on a 16 byte boundary so a mapping can be used as is.
+struct FileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t point_size;
+  uint32_t stroke_count;
+  uint64_t point_count;
+  uint64_t points_offset;
+};
+
+struct StrokeEntry {
+  uint64_t first_point;
+  uint32_t point_count;
+  float color[3];
+};
+
+static const uint32_t kFileVersion = 1;
+
+// Writes the strokes to path.  The file is written next to it and
+// renamed over it, so a crash never leaves half a scene behind.
+bool Save(const char *path, const std::vector<pen_line::StrokeView> &strokes);
+
+// Read only view of a scene file through mmap.  Opening checks the header
+// and the stroke table; the points are not read.
+class SceneFile {
+ public:
+  SceneFile();
+  ~SceneFile();
+
+  bool Open(const char *path);
+  void Close();
+
+  size_t stroke_count() const { return stroke_count_; }
+  const StrokeEntry &stroke(size_t index) const { return strokes_[index]; }
+  size_t point_count() const { return point_count_; }
+  const Leap::Vector *points() const { return points_; }
+
+ private:
+  const unsigned char *data_;
+  size_t size_;
+  const StrokeEntry *strokes_;
+  size_t stroke_count_;
+  const Leap::Vector *points_;
+  size_t point_count_;
+};
+
+// Adds every stroke in path to store as a completed stroke.  The points
+// stay in the mapping, which the store keeps open.  Must be called from
+// the thread that writes to the store.
+bool Load(const char *path, pen_line::StrokeStore *store);
+
+}  // namespace scene_file
+
+#endif  // HEADERS_SCENE_FILE_H_
@@ -0,0 +1,162 @@
+// Copyright 2015 Makoto Yano
+
+#ifndef HEADERS_SCENE_RENDERER_H_
+#define HEADERS_SCENE_RENDERER_H_
+
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#elif __linux__
+#include <GL/gl.h>
+#endif
+
+#include <vector>
+
+#include "./Quaternion.h"
+#include "./draw_batch.h"
+#include "./field_line.h"
+#include "./gpu_timer.h"
+#include "./hand_renderer.h"
+#include "./motion_predictor.h"
+#include "./scene_snapshot.h"
+#include "./stereo_renderer.h"
+#include "./stroke_buffer.h"
+#include "./stroke_mesh.h"
+#include "./stroke_stream.h"
+#include "./virtual_hand.h"
+
+namespace scene_renderer {
+
+enum StereoMode {
+  // Walk the scene once per eye.
+  kStereoTwoPass,
+  // Record the scene once and draw both eyes with instancing, falling
+  // back to kStereoTwoPass when the context can't do it.
+  kStereoSinglePass
+};
+
+// What the last Render() handed to GL.
+struct FrameStats {
+  int draw_calls;
+  // Vertices submitted, counted once per eye.
+  unsigned long vertices;  // NOLINT
+  // Completed strokes left after frustum culling.
+  size_t visible_strokes;
+  // Joint and bone instances of the tracked hands.
+  size_t hand_instances;
+};
+
+// The matrices of a view of the scene, column major.
+struct View {
+  GLfloat projection[16];
+  GLfloat modelview[16];
+  GLfloat view_projection[16];
+};
+
+// The projection every view of the scene uses.
+void ProjectionMatrix(float aspect, GLfloat out[16]);
+// The part of the modelview that doesn't depend on the head: where the
+// camera is and how the world is turned.
+void WorldMatrix(const scene_snapshot::SceneSnapshot &scene, GLfloat out[16]);
+// The view from a head with the given orientation, which goes in front
+// of world.
+void MakeView(const GLfloat projection[16], const GLfloat world[16]
+            , const Quaternion &head_orientation, View *view);
+
+// Owns the GPU side of the scene and draws it.  Knows nothing about the
+// HMD, so it runs the same with an Oculus, on a desktop window or on an
+// offscreen context.  Needs a current GL context for its whole life.
+class SceneRenderer {
+ public:
+  SceneRenderer();
+
+  void SetStereoMode(StereoMode mode) { stereo_mode_ = mode; }
+  // Completed strokes outside the view are skipped unless this is off.
+  void SetFrustumCulling(bool enabled) { frustum_culling_ = enabled; }
+  // Far completed strokes are drawn simplified unless this is off.
+  void SetLevelOfDetail(bool enabled) { level_of_detail_ = enabled; }
+  // Strokes are drawn as curves through their points, with lines that
+  // stay within tolerance Leap millimeters of the curve; 0 draws straight
+  // lines between the points.  Set it before the first Prepare().
+  void SetSplineTolerance(float tolerance) {
+    stroke_buffer_.set_spline_tolerance(tolerance);
+    stroke_stream_.set_spline_tolerance(tolerance);
+  }
+  // Strokes are drawn as meshes of this shape around their curve, or as
+  // lines.  Set it before the first Prepare().
+  void SetStrokeShape(const stroke_mesh::Shape &shape) {
+    stroke_buffer_.set_stroke_shape(shape);
+    stroke_stream_.set_stroke_shape(shape);
+  }
+  // The tracked hands are drawn unless this is off.
+  void SetHands(bool enabled) { hands_ = enabled; }
+  // Seconds from the capture of the snapshot's frame to when the next
+  // Render() reaches the display, see motion_predictor::Horizon().  The
+  // live stroke ends and the hands are drawn where they are predicted to
+  // be by then.  0 draws them where the frame left them.
+  void SetPredictionHorizon(float seconds) { prediction_horizon_ = seconds; }
+  // Times the GPU side of each eye and pass on timer, NULL for none.
+  // The grid and the strokes are one pass with single pass stereo.
+  void SetGpuTimer(gpu_timer::GpuTimer *timer) { gpu_timer_ = timer; }
+
+  // A frame is drawn in two steps so the head pose can be sampled as
+  // late as possible.  Prepare() does everything that doesn't depend on
+  // where the head is: it uploads the new strokes, streams the live ones
+  // and builds the hands.  scene must stay alive until Render().
+  void Prepare(const scene_snapshot::SceneSnapshot &scene, float aspect);
+  // Culls and draws the prepared scene as seen from head_orientation.
+  // The view only goes into shader uniforms, or one matrix load per
+  // frame on the fixed function path.  With two eye viewports both eyes
+  // are drawn, with none the scene is drawn once into the current
+  // viewport.
+  void Render(field_line::FieldLine *bg_line
+            , const Quaternion &head_orientation
+            , const stereo_renderer::EyeViewport *eye_viewport
+            , int eye_count);
+
+  const FrameStats &stats() const { return stats_; }
+  // Completed strokes copied out of the stream ring rather than uploaded.
+  size_t migrated_stroke_count() const {
+    return stroke_buffer_.migrated_stroke_count();
+  }
+  // The view of the last Render().
+  const View &view() const { return view_; }
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+ private:
+  bool SinglePassReady_();
+  bool HandsReady_();
+  void LoadFixedFunctionView_();
+  void Draw_(field_line::FieldLine *bg_line);
+  unsigned long RecordedVertexCount_() const;  // NOLINT
+
+  // Completed strokes, uploaded once and kept on the GPU.
+  stroke_buffer::StrokeBufferPool stroke_buffer_;
+  // Strokes that are still being traced.
+  stroke_stream::StrokeStreamRing stroke_stream_;
+
+  StereoMode stereo_mode_;
+  bool stereo_initialized_;
+  bool frustum_culling_;
+  bool level_of_detail_;
+  bool hands_;
+  bool hands_initialized_;
+  float prediction_horizon_;
+  // Set by Prepare() for the next Render().
+  GLfloat projection_[16];
+  GLfloat world_[16];
+  bool hands_prepared_;
+  View view_;
+  gpu_timer::GpuTimer *gpu_timer_;
+  // What was drawn of the snapshot's live state after the prediction.
+  std::vector<Leap::Vector> display_tails_;
+  virtual_hand::HandBuffer display_hands_;
+  stereo_renderer::StereoRenderer stereo_renderer_;
+  hand_renderer::HandRenderer hand_renderer_;
+  std::vector<draw_batch::DrawBatch> batches_;
+  FrameStats stats_;
+};
+
+}  // namespace scene_renderer
+
+#endif  // HEADERS_SCENE_RENDERER_H_
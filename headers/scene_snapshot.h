@@ -0,0 +1,54 @@
+// Copyright 2015 Makoto Yano
+
+#ifndef HEADERS_SCENE_SNAPSHOT_H_
+#define HEADERS_SCENE_SNAPSHOT_H_
+
+#include <vector>
+
+#include "./Quaternion.h"
+#include "./motion_predictor.h"
+#include "./pen_line.h"
+#include "./virtual_hand.h"
+
+namespace scene_snapshot {
+
+// Everything the renderer needs from one Leap frame.  Snapshots are
+// filled by the Leap thread and handed to the render thread through a
+// triple buffer, so the renderer never touches the listener's live state.
+struct SceneSnapshot {
+  SceneSnapshot();
+
+  // Incremented for every published frame.  The renderer can compare it
+  // between frames to see how many Leap frames it skipped.
+  unsigned long sequence;  // NOLINT
+  // When the frame reached the processor, on the
+  // motion_predictor::MonotonicSeconds() clock.
+  double received_time;
+
+  Quaternion world_x_quaternion;
+  Quaternion world_y_quaternion;
+  float camera_x_position;
+  float camera_y_position;
+  float camera_z_position;
+
+  // Completed strokes only grow, so each slot just appends the strokes
+  // finished since it was last published.
+  std::vector<pen_line::StrokeView> strokes;
+  std::vector<pen_line::StrokeView> tracing_lines;
+  // Newest fingertip sample of each tracing line, not yet part of the
+  // stroke because the simplifier is still deciding on it.
+  std::vector<Leap::Vector> tracing_tails;
+  // How the tip of each tracing line moves, for display only; the
+  // strokes never see the prediction.
+  std::vector<motion_predictor::Motion> tracing_motion;
+  // Joints are in Leap space; hand_to_world moves them to where the
+  // strokes they draw end up.
+  virtual_hand::HandBuffer skeleton_hands;
+  PointTransform hand_to_world;
+  // How each hand's palm moves, in Leap space.
+  motion_predictor::Motion hand_motion[virtual_hand::kMaxHands];
+};
+
+}  // namespace scene_snapshot
+
+#endif  // HEADERS_SCENE_SNAPSHOT_H_
@@ -0,0 +1,110 @@
+// Copyright 2015 Makoto Yano
+
+#ifndef HEADERS_SIMULATED_HMD_H_
+#define HEADERS_SIMULATED_HMD_H_
+
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#elif __linux__
+#include <GL/gl.h>
+#endif
+
+#include <chrono>
+
+#include "./hmd_backend.h"
+
+namespace simulated_hmd {
+
+enum Trajectory {
+  kTrajectoryStill,
+  // Slow sweeps left and right while nodding a little.
+  kTrajectoryLookAround,
+  // Holds still, then turns 60 degrees in a quarter second, and back.
+  kTrajectoryQuickTurns
+};
+
+struct Config {
+  // Render target, both eyes side by side.
+  int width;
+  int height;
+  double refresh_hz;
+  // Between the head moving and the pose reporting it.
+  double tracking_latency;
+  // EndFrame() waits for the next refresh like a synced swap does.
+  bool vsync;
+  Trajectory trajectory;
+  // Meters.
+  float ipd;
+};
+
+// DK2 like: 1920x1080 at 75 Hz, 2 ms tracking latency, looking around.
+Config DefaultConfig();
+
+// A headset made of a script.  Head poses follow a trajectory in time,
+// frames are paced to a fixed refresh rate and rendered into an offscreen
+// target that EndFrame() copies to the default framebuffer.  Track()
+// reads the script tracking_latency in the past and predicts from there
+// with the head's angular velocity, like the runtime does.  Every frame
+// it records how old the head pose it was rendered with is when the
+// frame is submitted and when it reaches the display, how far off the
+// prediction was, and whether it missed a refresh.
+class SimulatedHmd : public hmd_backend::HmdBackend {
+ public:
+  explicit SimulatedHmd(const Config &config);
+  virtual ~SimulatedHmd();
+
+  virtual bool connected() const { return true; }
+  virtual void SetupRendering();
+  virtual double Now() const;
+
+  virtual bool Track(double display_time, hmd_backend::Pose *pose);
+  virtual void GetEyeDescs(
+                hmd_backend::EyeDesc eye_desc[hmd_backend::kEyeCount]) const;
+  virtual void GetEyePoses(hmd_backend::Pose eye_pose[hmd_backend::kEyeCount]);
+
+  virtual void BeginFrame(hmd_backend::FrameTiming *timing);
+  virtual void EndFrame();
+  virtual GLuint framebuffer() const { return framebuffer_; }
+  virtual bool presents_frame() const { return false; }
+
+  // Where the scripted head is at time t.
+  hmd_backend::Pose PoseAt(double t) const;
+
+  const Config &config() const { return config_; }
+  unsigned long frame_count() const { return frame_count_; }  // NOLINT
+  // Refreshes that went by without a new frame.
+  unsigned long missed_frame_count() const { return missed_frames_; }  // NOLINT
+  // Display time of the last frame minus the sample time of the newest
+  // pose used for it, seconds.
+  double last_pose_age() const { return last_pose_age_; }
+  // The same at the start of EndFrame(), when the frame is submitted.
+  double last_submit_pose_age() const { return last_submit_pose_age_; }
+  // Angle between the last pose Track() handed out and where the head
+  // really was at the last frame's display time, degrees.
+  double last_pose_error() const { return last_pose_error_; }
+
+ private:
+  // First refresh at or after t.
+  double NextRefresh_(double t) const;
+
+  Config config_;
+  std::chrono::steady_clock::time_point start_;
+  double frame_period_;
+
+  GLuint framebuffer_;
+  GLuint texture_;
+  GLuint depth_buffer_;
+
+  hmd_backend::Pose latched_pose_;
+  double latest_pose_time_;
+  double last_display_time_;
+  double last_pose_age_;
+  double last_submit_pose_age_;
+  double last_pose_error_;
+  unsigned long frame_count_;  // NOLINT
+  unsigned long missed_frames_;  // NOLINT
+};
+
+}  // namespace simulated_hmd
+
+#endif  // HEADERS_SIMULATED_HMD_H_
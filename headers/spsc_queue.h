@@ -0,0 +1,93 @@
+// Copyright 2015 Makoto Yano
+
+#ifndef HEADERS_SPSC_QUEUE_H_
+#define HEADERS_SPSC_QUEUE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+namespace spsc_queue {
+
+// Bounded lock-free single-producer / single-consumer FIFO.  Items are
+// written and read in place: the producer fills reserve() and calls
+// commit(), the consumer reads front() and calls pop().  Neither side
+// ever waits; reserve() returns NULL when the queue is full and front()
+// when it is empty.  Capacity must be a power of two.
+template <typename T, size_t Capacity>
+class SpscQueue {
+ public:
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0
+              , "SpscQueue capacity must be a power of two");
+
+  SpscQueue() : head_(0), cached_tail_(0), tail_(0), cached_head_(0) {}
+
+  // Producer side.
+  T *reserve() {
+    const uint64_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - cached_head_ >= Capacity) {
+      // Only look at the consumer's index when it looks full.
+      cached_head_ = head_.load(std::memory_order_acquire);
+      if (tail - cached_head_ >= Capacity) {
+        return NULL;
+      }
+    }
+    return &slots_[tail & (Capacity - 1)];
+  }
+  void commit() {
+    tail_.store(tail_.load(std::memory_order_relaxed) + 1
+              , std::memory_order_release);
+  }
+
+  // Consumer side.
+  T *front() {
+    const uint64_t head = head_.load(std::memory_order_relaxed);
+    if (head == cached_tail_) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (head == cached_tail_) {
+        return NULL;
+      }
+    }
+    return &slots_[head & (Capacity - 1)];
+  }
+  void pop() {
+    head_.store(head_.load(std::memory_order_relaxed) + 1
+              , std::memory_order_release);
+  }
+
+  // Items queued, exact on either side for what that side has done and
+  // a snapshot of the other's.
+  size_t size() const {
+    return static_cast<size_t>(tail_.load(std::memory_order_acquire)
+                             - head_.load(std::memory_order_acquire));
+  }
+  static size_t capacity() { return Capacity; }
+
+ private:
+  // Each side's index shares a cache line with that side's copy of the
+  // other index, so a side only ever writes to its own line.
+  static const size_t kCacheLine = 64;
+
+  T slots_[Capacity];
+  char padding0_[kCacheLine];
+  // Items popped; the consumer is the only one to move it.
+  std::atomic<uint64_t> head_;
+  // Consumer side copy of tail_.
+  uint64_t cached_tail_;
+  char padding1_[kCacheLine - sizeof(std::atomic<uint64_t>)
+               - sizeof(uint64_t)];
+  // Items committed; the producer is the only one to move it.
+  std::atomic<uint64_t> tail_;
+  // Producer side copy of head_.
+  uint64_t cached_head_;
+  char padding2_[kCacheLine - sizeof(std::atomic<uint64_t>)
+               - sizeof(uint64_t)];
+
+  SpscQueue(const SpscQueue &);
+  SpscQueue &operator=(const SpscQueue &);
+};
+
+}  // namespace spsc_queue
+
+#endif  // HEADERS_SPSC_QUEUE_H_
@@ -0,0 +1,71 @@
+// Copyright 2015 Makoto Yano
+
+#ifndef HEADERS_STEREO_RENDERER_H_
+#define HEADERS_STEREO_RENDERER_H_
+
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#elif __linux__
+#include <GL/gl.h>
+#endif
+
+#include <vector>
+
+#include "./draw_batch.h"
+
+namespace stereo_renderer {
+
+struct EyeViewport {
+  GLint x;
+  GLint y;
+  GLsizei width;
+  GLsizei height;
+};
+
+// The smallest viewport covering both eyes, and for each eye the xy scale
+// and offset that squeeze its clip space into its own part of it.
+void CombineEyeViewports(const EyeViewport eye_viewport[2]
+                       , EyeViewport *combined
+                       , GLfloat viewport_transform[2][4]);
+
+// Renders recorded batches for both eyes in a single pass.  Every draw is
+// instanced twice; the vertex shader picks the eye's view/projection from
+// gl_InstanceID, squeezes the result into that eye's part of the render
+// target and clips it there with gl_ClipDistance, which does the job of a
+// per instance viewport on contexts without viewport arrays in the vertex
+// stage.  Needs GL 4.3 (multi draw indirect); Initialize() returns false
+// otherwise and callers keep using the two pass path.
+class StereoRenderer {
+ public:
+  StereoRenderer();
+  ~StereoRenderer();
+
+  bool Initialize();
+  bool supported() const { return program_ != 0; }
+
+  // eye_view_projection holds two column major 4x4 matrices.
+  void Render(const std::vector<draw_batch::DrawBatch> &batches
+            , const GLfloat eye_view_projection[2][16]
+            , const EyeViewport eye_viewport[2]);
+
+  int draw_call_count() const { return draw_calls_; }
+
+ private:
+  struct DrawCommand {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first;
+    GLuint base_instance;
+  };
+
+  GLuint program_;
+  GLuint indirect_buffer_;
+  GLint eye_view_projection_location_;
+  GLint eye_viewport_location_;
+  std::vector<DrawCommand> commands_;
+  int draw_calls_;
+};
+
+}  // namespace stereo_renderer
+
+#endif  // HEADERS_STEREO_RENDERER_H_
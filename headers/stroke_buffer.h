@@ -0,0 +1,151 @@
+// Copyright 2015 Makoto Yano
+
+#ifndef HEADERS_STROKE_BUFFER_H_
+#define HEADERS_STROKE_BUFFER_H_
+
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#elif __linux__
+#include <GL/gl.h>
+#endif
+
+#include <vector>
+
+#include "./draw_batch.h"
+#include "./pen_line.h"
+#include "./stroke_bvh.h"
+#include "./stroke_mesh.h"
+
+namespace stroke_stream {
+class StrokeStreamRing;
+}  // namespace stroke_stream
+
+namespace stroke_buffer {
+
+// Interleaved vertex layout used for strokes on the GPU.
+struct StrokeVertex {
+  GLfloat position[3];
+  GLfloat color[3];
+};
+
+// Where the strokes are seen from, for picking their level of detail.
+struct LodView {
+  float eye[3];
+  // Pixels one world unit spans at distance one in front of the eye.
+  float pixel_scale;
+};
+
+// Append-only pool of vertex buffers holding completed strokes.  Each
+// stroke is tessellated into the curve through its points, built into
+// its mesh and uploaded once when it first shows up in the snapshot, and
+// the whole pool is drawn with one glMultiDrawArrays per page, so the per
+// frame cost no longer grows with the number of points drawn so far.
+// Every stroke's bounding box goes into a BVH at upload, and cull() limits
+// the following draws to the strokes inside the view.  Coarser copies of
+// each stroke are uploaded with it, and cull() also picks the copy to
+// draw from how far the stroke is from the eye.
+class StrokeBufferPool {
+ public:
+  static const GLsizei kPageVertices = 256 * 1024;
+  // Levels of detail per stroke, the traced stroke included.
+  static const int kLodLevels = 4;
+
+  StrokeBufferPool();
+  ~StrokeBufferPool();
+
+  // How closely lines follow the curve through the points, in Leap
+  // millimeters; 0 draws straight lines between the points.  Set it
+  // before the first sync(), and to what the stream ring uses.
+  void set_spline_tolerance(float tolerance) { tolerance_ = tolerance; }
+  // What the strokes are drawn as.  Set it before the first sync(), and
+  // to what the stream ring uses.
+  void set_stroke_shape(const stroke_mesh::Shape &shape) { shape_ = shape; }
+
+  // Uploads strokes[uploaded_stroke_count(), strokes.size()).  The list
+  // must only ever grow, like SceneSnapshot::strokes.  What the ring
+  // streamed of a stroke while it was traced is copied out of it on the
+  // GPU instead of being uploaded again, and only the rest is uploaded;
+  // only straight lines drawn as lines are.
+  void sync(const std::vector<pen_line::StrokeView> &strokes
+          , stroke_stream::StrokeStreamRing *stream = nullptr);
+  void draw();
+  void record(std::vector<draw_batch::DrawBatch> *batches) const;
+
+  // Until the next cull() or uncull(), draw() and record() only cover the
+  // strokes whose box touches at least one of the frusta, or all strokes
+  // when frustum_count is 0.  With lod, far strokes are drawn with one of
+  // their coarser levels.
+  void cull(const stroke_bvh::Frustum *frusta, int frustum_count
+          , const LodView *lod = nullptr);
+  void uncull();
+  // Strokes and vertices draw() covers right now.
+  size_t visible_stroke_count() const;
+  size_t visible_vertex_count() const;
+
+  size_t uploaded_stroke_count() const { return uploaded_strokes_; }
+  size_t uploaded_vertex_count() const { return uploaded_vertices_; }
+  // Vertices of the coarser levels, on top of uploaded_vertex_count().
+  size_t lod_vertex_count() const { return lod_vertices_; }
+  size_t migrated_stroke_count() const { return migrated_strokes_; }
+  // glMultiDrawArrays calls issued by the last draw().
+  int draw_call_count() const { return draw_calls_; }
+
+ private:
+  struct Page {
+    GLuint buffer_id;
+    GLsizei capacity;
+    GLsizei size;
+    std::vector<GLint> first_indexes;
+    std::vector<GLsizei> count_indexes;
+    // The culled subset of the above.
+    std::vector<GLint> visible_first_indexes;
+    std::vector<GLsizei> visible_count_indexes;
+  };
+
+  struct Location {
+    unsigned int page;
+    stroke_bvh::Aabb box;
+    // A level that would not be much smaller repeats the finer one.
+    GLint first[kLodLevels];
+    GLsizei count[kLodLevels];
+  };
+
+  const std::vector<GLint> &drawn_firsts_(const Page &page) const {
+    return culled_ ? page.visible_first_indexes : page.first_indexes;
+  }
+  const std::vector<GLsizei> &drawn_counts_(const Page &page) const {
+    return culled_ ? page.visible_count_indexes : page.count_indexes;
+  }
+
+  // Fills lod_meshes_ and returns the vertices it adds.
+  GLsizei build_levels_(const pen_line::StrokeView &stroke);
+  GLenum mode_() const {
+    return shape_.style == stroke_mesh::kLines ? GL_LINE_STRIP
+                                               : GL_TRIANGLE_STRIP;
+  }
+  Page *new_page_(GLsizei vertex_count);
+  void flush_(Page *page, GLsizei first);
+
+  float tolerance_;
+  stroke_mesh::Shape shape_;
+  std::vector<Page> pages_;
+  std::vector<StrokeVertex> staging_;
+  std::vector<Leap::Vector> curve_;
+  std::vector<StrokeVertex> mesh_;
+  std::vector<Leap::Vector> lod_points_[kLodLevels];
+  std::vector<StrokeVertex> lod_meshes_[kLodLevels];
+  std::vector<Location> locations_;
+  stroke_bvh::StrokeBvh bvh_;
+  std::vector<int> visible_;
+  size_t uploaded_strokes_;
+  size_t uploaded_vertices_;
+  size_t migrated_strokes_;
+  size_t lod_vertices_;
+  int draw_calls_;
+  bool culled_;
+  size_t visible_vertices_;
+};
+
+}  // namespace stroke_buffer
+
+#endif  // HEADERS_STROKE_BUFFER_H_
@@ -0,0 +1,89 @@
+// Copyright 2015 Makoto Yano
+
+#ifndef HEADERS_STROKE_BVH_H_
+#define HEADERS_STROKE_BVH_H_
+
+#include <vector>
+
+namespace stroke_bvh {
+
+struct Aabb {
+  float min[3];
+  float max[3];
+};
+
+// Box around count packed xyz points.
+Aabb PointBounds(const float *points, size_t count);
+
+// The six clip planes of a view projection matrix, pointing inwards.
+struct Frustum {
+  // a, b, c, d with a*x + b*y + c*z + d >= 0 inside.
+  float planes[6][4];
+};
+
+// view_projection is column major, as glGetFloatv returns it.
+Frustum FrustumFromMatrix(const float view_projection[16]);
+
+// Dynamic AABB tree over items, one leaf per item.  Items are inserted as
+// they come; each insert walks down to the sibling that grows the tree's
+// surface area the least and rebalances on the way back up, so the tree
+// stays usable without ever being rebuilt.  Queries walk a depth first
+// copy of the tree in which every subtree is one run of nodes and one run
+// of items.  Copying touches the whole tree, so it is only redone once a
+// good number of leaves were inserted since the last copy.
+class StrokeBvh {
+ public:
+  StrokeBvh();
+
+  void insert(const Aabb &box, int item);
+  void clear();
+
+  // Appends the items whose box may be inside any of the frusta.  Whole
+  // subtrees inside one frustum are taken without testing their leaves.
+  void query(const Frustum *frusta, int frustum_count
+           , std::vector<int> *items) const;
+
+  size_t size() const { return leaf_count_; }
+  int height() const;
+
+ private:
+  struct Node {
+    Aabb box;
+    int parent;
+    int left;
+    int right;
+    // Leaves only, -1 on inner nodes.
+    int item;
+    int height;
+  };
+
+  // Inserts the depth first copy may lag behind before a query refreshes
+  // it.  Until then their leaves are tested one by one.
+  static const size_t kMaxPendingLeaves = 1024;
+
+  // A node of the depth first copy.  The subtree is [this, skip) in
+  // flat_ and holds items [first_item, first_item + item_count).
+  struct FlatNode {
+    Aabb box;
+    int skip;
+    int first_item;
+    int item_count;
+  };
+
+  int allocate_();
+  int balance_(int index);
+  void flatten_() const;
+
+  std::vector<Node> nodes_;
+  int root_;
+  size_t leaf_count_;
+  mutable std::vector<FlatNode> flat_;
+  mutable std::vector<int> flat_items_;
+  // Leaves inserted since flat_ was made.
+  mutable std::vector<int> pending_;
+  mutable std::vector<int> stack_;
+};
+
+}  // namespace stroke_bvh
+
+#endif  // HEADERS_STROKE_BVH_H_
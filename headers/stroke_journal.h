@@ -0,0 +1,107 @@
+// Copyright 2015 Makoto Yano
+
+#ifndef HEADERS_STROKE_JOURNAL_H_
+#define HEADERS_STROKE_JOURNAL_H_
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "./pen_line.h"
+
+namespace stroke_journal {
+
+// File layout, native byte order:
+//   JournalHeader, then one record per completed stroke: a RecordHeader
+//   followed by point_count packed Leap::Vectors.  crc covers everything
+//   after it up to the end of the points.  Records are numbered in the
+//   order the strokes were completed, starting at 0 for the scene.
+struct JournalHeader {
+  char magic[4];
+  uint32_t version;
+};
+
+struct RecordHeader {
+  uint32_t crc;
+  uint32_t point_count;
+  uint64_t sequence;
+  float color[3];
+  uint32_t padding;
+};
+
+static const uint32_t kJournalVersion = 1;
+
+// CRC-32 (IEEE) of size bytes, continuing from crc.
+uint32_t Crc32(const void *data, size_t size, uint32_t crc = 0);
+
+// Rebuilds the scene in store from the checkpoint and the journal, when
+// they exist, and cuts the journal back to its last whole record.  A
+// record that was torn by a crash, and everything after it, is dropped.
+// Returns false only when the files exist but cannot be used.
+bool Recover(const char *journal_path, const char *checkpoint_path
+           , pen_line::StrokeStore *store);
+
+// Writes completed strokes to an append-only journal from a background
+// thread.  Append() only queues the views, so the threads producing
+// strokes never wait for the disk.  The writer sends everything queued
+// since its last write in one write and one fdatasync.  Every
+// kCheckpointRecords records the whole scene is written to the checkpoint
+// scene file and the journal starts over, which keeps recovery short.
+class StrokeJournal {
+ public:
+  static const size_t kCheckpointRecords = 4096;
+
+  StrokeJournal();
+  ~StrokeJournal();
+
+  // durable_count strokes of the scene are already in the checkpoint or
+  // the journal, usually the ones Recover() restored.
+  bool Open(const char *journal_path, const char *checkpoint_path
+          , size_t durable_count);
+  // Writes out what is queued and stops the writer.
+  void Close();
+  bool is_open() const { return writer_.joinable(); }
+
+  // Queues strokes[queued, strokes.size()).  strokes is the completed
+  // list, which only ever grows, like SceneSnapshot::strokes.
+  void Append(const std::vector<pen_line::StrokeView> &strokes);
+
+  // Writer side counters, for the benchmark.
+  size_t written_record_count() const;
+  size_t checkpoint_count() const;
+
+ private:
+  void Run_();
+  // Adds *records for the records written.
+  bool Write_(const std::vector<pen_line::StrokeView> &strokes
+            , size_t *records);
+  bool Checkpoint_();
+
+  std::string journal_path_;
+  std::string checkpoint_path_;
+  int fd_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  std::vector<pen_line::StrokeView> queue_;
+  bool stopping_;
+  size_t queued_;
+  size_t written_;
+  size_t checkpoints_;
+  std::thread writer_;
+
+  // Writer thread only.
+  size_t durable_count_;
+  // Every stroke of the scene, for the checkpoint.
+  std::vector<pen_line::StrokeView> scene_;
+  std::vector<unsigned char> buffer_;
+  size_t records_since_checkpoint_;
+};
+
+}  // namespace stroke_journal
+
+#endif  // HEADERS_STROKE_JOURNAL_H_
@@ -0,0 +1,112 @@
+// Copyright 2015 Makoto Yano
+
+#ifndef HEADERS_STROKE_MESH_H_
+#define HEADERS_STROKE_MESH_H_
+
+#include <vector>
+
+#include <LeapMath.h>
+
+#include "./pen_line.h"
+
+namespace stroke_buffer {
+struct StrokeVertex;
+}  // namespace stroke_buffer
+
+namespace stroke_mesh {
+
+enum Style {
+  // GL_LINE_STRIP through the points, as wide as glLineWidth gets it.
+  kLines,
+  // A flat band, facing the viewer where the stroke starts.
+  kRibbon,
+  // A tube around the points.
+  kTube
+};
+
+static const int kMaxTubeSides = 16;
+
+// How strokes are drawn.  Both meshes are GL_TRIANGLE_STRIPs whose
+// lighting is baked into the vertex colors, so they go through the same
+// interleaved StrokeVertex buffers and draws as the lines.
+struct Shape {
+  Style style;
+  // Half the width of a ribbon or the radius of a tube, in Leap
+  // millimeters.
+  float radius;
+  // Sides around a tube, at most kMaxTubeSides.
+  int sides;
+};
+
+Shape DefaultShape();
+// Vertices the shape takes for every point of a long stroke.
+int VerticesPerPoint(const Shape &shape);
+
+// Turns the points of a stroke into vertices as they come in.  Every
+// point gets a frame that is carried over from the one before it by the
+// smallest rotation that follows the stroke (parallel transport), so a
+// mesh never twists around the stroke or flips where it goes straight.
+// The ring of vertices around a point is only written once the point
+// after it is known, since the stroke's direction there depends on it.
+// A tube goes out one band between two rings at a time, the bands
+// zig-zagging around it so consecutive ones join without a seam.
+//
+// A builder is a small value: the stream ring keeps one per live stroke
+// and continues a copy of it for the part that still changes.
+class MeshBuilder {
+ public:
+  MeshBuilder();
+
+  // Starts a new stroke.
+  void Reset(const Shape &shape, const pen_line::Color &color);
+  void Add(const Leap::Vector *points, unsigned int count
+         , std::vector<stroke_buffer::StrokeVertex> *out);
+  // Writes what the last point still holds back.  Only Reset() may
+  // follow.
+  void Finish(std::vector<stroke_buffer::StrokeVertex> *out);
+  // The following vertices go into a new strip, which picks up where the
+  // ones written so far left off.
+  void Restart();
+
+  // True until the first point is added.
+  bool empty() const { return point_count_ == 0; }
+
+ private:
+  void add_point_(const Leap::Vector &point
+                , std::vector<stroke_buffer::StrokeVertex> *out);
+  void ring_(const Leap::Vector &tangent
+           , std::vector<stroke_buffer::StrokeVertex> *out);
+  void write_ring_(std::vector<stroke_buffer::StrokeVertex> *out);
+  void write_band_(std::vector<stroke_buffer::StrokeVertex> *out);
+
+  Shape shape_;
+  pen_line::Color color_;
+  // cos and sin of each side's angle.
+  float cosines_[kMaxTubeSides + 1];
+  float sines_[kMaxTubeSides + 1];
+  unsigned int point_count_;
+  // The point whose ring waits for the next point, and the one before.
+  Leap::Vector pending_;
+  Leap::Vector before_;
+  // Frame of the last ring.
+  bool has_ring_;
+  Leap::Vector ring_point_;
+  Leap::Vector tangent_;
+  Leap::Vector normal_;
+  // The last two rings, lit, one vertex per side and the seam again.
+  Leap::Vector rings_[2][kMaxTubeSides + 1];
+  float shades_[2][kMaxTubeSides + 1];
+  int newest_ring_;
+  bool restart_;
+  // Bands in the current strip, which decides which way the next goes.
+  unsigned int strip_bands_;
+};
+
+// The whole mesh of a stroke into out, which is cleared first.
+void BuildMesh(const Shape &shape, const Leap::Vector *points
+             , unsigned int count, const pen_line::Color &color
+             , std::vector<stroke_buffer::StrokeVertex> *out);
+
+}  // namespace stroke_mesh
+
+#endif  // HEADERS_STROKE_MESH_H_
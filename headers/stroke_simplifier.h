@@ -0,0 +1,52 @@
+// Copyright 2015 Makoto Yano
+
+#ifndef HEADERS_STROKE_SIMPLIFIER_H_
+#define HEADERS_STROKE_SIMPLIFIER_H_
+
+#include <vector>
+
+#include <LeapMath.h>
+
+namespace stroke_simplifier {
+
+// Error bounded simplifier that runs while a stroke is traced (opening
+// window).  Points are held in a window behind the last committed vertex
+// (the anchor) for as long as the segment from the anchor to the newest
+// point stays within tolerance of all of them.  When a new point breaks
+// that, the previous point becomes a vertex and the next anchor.  The
+// window is capped so the per point cost stays bounded.
+class StreamingSimplifier {
+ public:
+  explicit StreamingSimplifier(float tolerance = 0.5f
+                              , unsigned int max_window = 64);
+
+  void set_tolerance(float tolerance) { tolerance_ = tolerance; }
+
+  // Starts a new stroke.  The first point is always a vertex.
+  void reset(const Leap::Vector &first);
+  // Feeds the next sample.  Returns true when a point was committed as a
+  // vertex, which is then stored in *committed.
+  bool add(const Leap::Vector &point, Leap::Vector *committed);
+
+  // Newest sample, not yet committed.  Only for display, and it has to be
+  // appended to the stroke when the stroke ends.
+  bool has_tail() const { return !window_.empty(); }
+  const Leap::Vector &tail() const { return window_.back(); }
+
+ private:
+  bool window_fits_(const Leap::Vector &end) const;
+
+  float tolerance_;
+  unsigned int max_window_;
+  Leap::Vector anchor_;
+  std::vector<Leap::Vector> window_;
+};
+
+// Douglas-Peucker over a finished polyline.  The first and last points
+// are always kept.
+void Simplify(const Leap::Vector *points, unsigned int count
+            , float tolerance, std::vector<Leap::Vector> *out);
+
+}  // namespace stroke_simplifier
+
+#endif  // HEADERS_STROKE_SIMPLIFIER_H_
@@ -0,0 +1,58 @@
+// Copyright 2015 Makoto Yano
+
+#ifndef HEADERS_STROKE_SPLINE_H_
+#define HEADERS_STROKE_SPLINE_H_
+
+#include <vector>
+
+#include <LeapMath.h>
+
+namespace stroke_spline {
+
+// Largest distance in Leap millimeters the drawn lines may stray from
+// the curve.
+static const float kDefaultTolerance = 0.1f;
+// Lines per segment however sharp it bends.
+static const int kMaxSubdivisions = 32;
+
+// One segment of the curve as c0 + c1 t + c2 t^2 + c3 t^3 per axis,
+// t going from 0 at its start to 1 at its end.
+struct Cubic {
+  float x[4];
+  float y[4];
+  float z[4];
+};
+
+// The centripetal Catmull-Rom segment from p1 to p2, p0 and p3 being the
+// control points on either side.  Unlike the uniform one it never loops
+// or overshoots where the control points bunch up.
+Cubic SegmentCubic(const Leap::Vector &p0, const Leap::Vector &p1
+                 , const Leap::Vector &p2, const Leap::Vector &p3);
+
+// Lines the segment needs to stay within tolerance of the curve, from
+// how sharply it bends: 1 for a straight one.  A tolerance of 0 or less
+// gives 1, which draws the control points as they are.
+int Subdivisions(const Cubic &cubic, float tolerance);
+
+// Writes the points at t = 1 / n, 2 / n, ... (n - 1) / n for n
+// subdivisions into out, which needs room for n - 1 of them.
+void EvaluateCubic(const Cubic &cubic, int subdivisions, Leap::Vector *out);
+
+// Segment i of the curve through points[0, count) runs from points[i] to
+// points[i + 1]; the ends are continued straight for the segments at
+// either end.  Appends segments [first, end) to out, each as the points
+// after its start up to and including its end, which is the control
+// point itself.  A segment only depends on the control points next to
+// it, so a stroke can be tessellated a few segments at a time as it
+// grows and comes out the same as in one go.
+void TessellateSegments(const Leap::Vector *points, unsigned int count
+                      , unsigned int first, unsigned int end
+                      , float tolerance, std::vector<Leap::Vector> *out);
+
+// The whole curve into out, starting with points[0].
+void Tessellate(const Leap::Vector *points, unsigned int count
+              , float tolerance, std::vector<Leap::Vector> *out);
+
+}  // namespace stroke_spline
+
+#endif  // HEADERS_STROKE_SPLINE_H_
@@ -0,0 +1,158 @@
+// Copyright 2015 Makoto Yano
+
+#ifndef HEADERS_STROKE_STREAM_H_
+#define HEADERS_STROKE_STREAM_H_
+
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#elif __linux__
+#include <GL/gl.h>
+#endif
+
+#include <deque>
+#include <map>
+#include <vector>
+
+#include "./draw_batch.h"
+#include "./pen_line.h"
+#include "./stroke_buffer.h"
+#include "./stroke_mesh.h"
+
+namespace stroke_stream {
+
+// Ring buffer that streams the strokes that are still being traced.
+// Only the points added since the last frame are written, straight into a
+// persistently mapped buffer when the context has ARB_buffer_storage and
+// through glBufferSubData of the new range otherwise.  Space is handed
+// back once a stroke is gone and the GPU has passed the fence of the frame
+// that released it; the fences are only ever polled, so the CPU never waits
+// on the GPU.  When the ring is full the new points are simply streamed on
+// a later frame.  Strokes are streamed as the curve through their points
+// (see stroke_spline), a segment at a time once it can't change any more.
+// The last segment, which still bends towards the next point, and the
+// not yet committed tail change every frame, so they are drawn from a
+// small orphaned buffer instead.  Meshes are extended the same way: each
+// stroke keeps the stroke_mesh::MeshBuilder its streamed part came out
+// of, and a copy of it carries on through the end of the stroke every
+// frame.
+class StrokeStreamRing {
+ public:
+  static const GLsizei kRingVertices = 64 * 1024;
+
+  StrokeStreamRing();
+  ~StrokeStreamRing();
+
+  // How closely lines follow the curve through the points, in Leap
+  // millimeters; 0 draws straight lines between the points.  Set it
+  // before the first stream().
+  void set_spline_tolerance(float tolerance) { tolerance_ = tolerance; }
+  // What the strokes are drawn as.  Set it before the first stream().
+  void set_stroke_shape(const stroke_mesh::Shape &shape) { shape_ = shape; }
+
+  // Streams the new points of every live stroke and releases the strokes
+  // that are no longer live.  Call once per frame, after the completed
+  // strokes were synced so they could still be copied out of the ring.
+  // tails, when given, holds one display only end point per live stroke.
+  void stream(const std::vector<pen_line::StrokeView> &live_strokes
+            , const std::vector<Leap::Vector> *tails = nullptr);
+  void draw();
+  void record(std::vector<draw_batch::DrawBatch> *batches);
+  // Fences the ranges released this frame.  Call after the last draw().
+  void end_frame();
+
+  // True when the ring holds straight lines through the start of the
+  // stroke as it is now: points streamed from the same revision, of
+  // which the stroke kept its first rest points and thinned out the
+  // others.  streamed is set to the points in the ring, which are its
+  // vertices, and the stroke goes on from points[rest].
+  bool holds(const pen_line::StrokeView &stroke
+           , pen_line::StrokeView *streamed, unsigned int *rest) const;
+  // Copies every vertex streamed for the stroke into dest_buffer on the
+  // GPU, starting at vertex dest_first.  Returns false when the ring has
+  // none of it.
+  bool copy_to(unsigned int stroke_id, GLuint dest_buffer
+             , GLsizei dest_first);
+
+  bool persistent() const { return mapped_ != nullptr; }
+  // Frames on which some points couldn't be streamed for lack of space.
+  unsigned long deferred_count() const { return deferred_count_; }  // NOLINT
+  int draw_call_count() const { return draw_calls_; }
+
+ private:
+  struct Segment {
+    GLint first;
+    GLsizei count;
+  };
+  struct Stream {
+    // Curve points in the ring, which for lines are its vertices, and the
+    // segments of the stroke they cover.
+    unsigned int streamed;
+    unsigned int tessellated;
+    // Revision of the stroke's points they were streamed from, and where
+    // they were last read; the store keeps old points in place.
+    unsigned int revision;
+    const Leap::Vector *points;
+    bool live;
+    std::vector<Segment> segments;
+    // What the streamed vertices came out of, to carry on from.
+    stroke_mesh::MeshBuilder mesh;
+  };
+  // One contiguous ring range in allocation order.
+  struct Allocation {
+    GLint first;
+    GLsizei count;
+    int owner;
+    bool released;
+    unsigned long release_frame;  // NOLINT
+  };
+  struct FrameFence {
+    GLsync fence;
+    unsigned long frame;  // NOLINT
+  };
+
+  GLenum mode_() const {
+    return shape_.style == stroke_mesh::kLines ? GL_LINE_STRIP
+                                               : GL_TRIANGLE_STRIP;
+  }
+  void initialize_();
+  void collect_segments_();
+  // Segments of a stroke with count points that won't change any more.
+  unsigned int final_segments_(unsigned int count) const;
+  void stream_tails_(const std::vector<pen_line::StrokeView> &live_strokes
+                    , const std::vector<Leap::Vector> *tails);
+  void reclaim_();
+  bool allocate_(GLsizei count, bool allow_wrap, GLint *first);
+  bool extend_(int owner, GLsizei count);
+  void release_(int owner);
+  void write_(GLint first, const stroke_buffer::StrokeVertex *vertices
+            , GLsizei count);
+  void append_points_(int id, Stream *stream
+                    , const pen_line::StrokeView &stroke);
+
+  float tolerance_;
+  stroke_mesh::Shape shape_;
+  GLuint buffer_id_;
+  stroke_buffer::StrokeVertex *mapped_;
+  GLint head_;
+  std::deque<Allocation> allocations_;
+  std::deque<FrameFence> fences_;
+  std::map<int, Stream> streams_;
+  std::vector<stroke_buffer::StrokeVertex> staging_;
+  std::vector<Leap::Vector> controls_;
+  std::vector<Leap::Vector> curve_;
+  std::vector<GLint> first_indexes_;
+  std::vector<GLsizei> count_indexes_;
+  GLuint tail_buffer_id_;
+  std::vector<stroke_buffer::StrokeVertex> tail_vertices_;
+  std::vector<GLint> tail_first_indexes_;
+  std::vector<GLsizei> tail_count_indexes_;
+  unsigned long frame_;  // NOLINT
+  unsigned long completed_frame_;  // NOLINT
+  unsigned long deferred_count_;  // NOLINT
+  bool released_this_frame_;
+  int draw_calls_;
+};
+
+}  // namespace stroke_stream
+
+#endif  // HEADERS_STROKE_STREAM_H_
@@ -0,0 +1,71 @@
+// Copyright 2015 Makoto Yano
+
+#ifndef HEADERS_TRIPLE_BUFFER_H_
+#define HEADERS_TRIPLE_BUFFER_H_
+
+#include <atomic>
+
+namespace triple_buffer {
+
+// Wait-free single-writer / single-reader triple buffer.
+// The writer fills back() and calls publish(); the reader calls update()
+// and then reads front().  Neither side ever waits for the other, the
+// reader always sees the most recently published slot.
+template <typename T>
+class TripleBuffer {
+ public:
+  TripleBuffer()
+    : back_(0), middle_(1), front_(2)
+    , published_count_(0), overwritten_count_(0) {}
+
+  // Writer side.
+  T &back() { return slots_[back_]; }
+  const T &back() const { return slots_[back_]; }
+
+  void publish() {
+    int previous = middle_.exchange(back_ | kFreshBit
+                                    , std::memory_order_acq_rel);
+    back_ = previous & kIndexMask;
+    published_count_.fetch_add(1, std::memory_order_relaxed);
+    if (previous & kFreshBit) {
+      // The reader never saw the slot we just took back.
+      overwritten_count_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  // Reader side.  Returns true when a newer slot became front().
+  bool update() {
+    if (!(middle_.load(std::memory_order_relaxed) & kFreshBit)) {
+      return false;
+    }
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndexMask;
+    return true;
+  }
+
+  const T &front() const { return slots_[front_]; }
+
+  unsigned long published_count() const {  // NOLINT
+    return published_count_.load(std::memory_order_relaxed);
+  }
+  unsigned long overwritten_count() const {  // NOLINT
+    return overwritten_count_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  static const int kIndexMask = 0x3;
+  static const int kFreshBit = 0x4;
+
+  T slots_[3];
+  int back_;
+  std::atomic<int> middle_;
+  int front_;
+  std::atomic<unsigned long> published_count_;  // NOLINT
+  std::atomic<unsigned long> overwritten_count_;  // NOLINT
+
+  TripleBuffer(const TripleBuffer &);
+  TripleBuffer &operator=(const TripleBuffer &);
+};
+
+}  // namespace triple_buffer
+
+#endif  // HEADERS_TRIPLE_BUFFER_H_
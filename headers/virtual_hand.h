@@ -6,37 +6,48 @@
 #include <eigen3/Eigen/Core>
 #include <eigen3/Eigen/Geometry>
 
+#include "./frame_record.h"
+
 namespace virtual_hand {
 
-struct SkeletonHand {
-  // Hand Id from Leap API
-  int id;
+static const int kMaxHands = frame_record::kMaxHands;
+// Three per finger, five knuckles, the wrist and two on the elbow.
+static const int kJointCount = 23;
 
-  float confidence;
+// Skeletons of the hands in one frame, field by field.  Points are
+// Eigen::Vector4f with w = 0, so each one is a single aligned SSE
+// register and Eigen vectorizes the arithmetic on them.  Capacity is
+// fixed at kMaxHands, so filling and copying it never allocates.
+struct HandBuffer {
+  HandBuffer() : count(0) {}
 
-  // Pinch strength, from API
-  float grabStrength;
+  int count;
 
-  // Palm's position
-  Eigen::Vector3f center;
+  // Hand Id from Leap API
+  int id[kMaxHands];
 
-  // Palm's rotation/basis -- it's reversed for the left hand
-  Eigen::Matrix3f rotationButNotReally;
+  float confidence[kMaxHands];
 
-  // Eigen::stdvectorV3f tips[5];
-  Eigen::Vector3f joints[23];
-  Eigen::Vector3f jointConnections[23];
-  Eigen::Vector3f avgExtended;
+  // Pinch strength, from API
+  float grab_strength[kMaxHands];
 
-  Eigen::Vector3f getManipulationPoint() const {
-                                      return 0.5f * (joints[0] + joints[3]); }
+  // Palm's position
+  Eigen::Vector4f center[kMaxHands];
 
-  Eigen::Matrix3f arbitraryRelatedRotation() const;
+  // Palm's rotation/basis with the scale taken out -- it's reversed for
+  // the left hand
+  Eigen::Matrix3f basis[kMaxHands];
 
+  // Bone i of hand h runs from joints[h][i] to joint_connections[h][i].
+  Eigen::Vector4f joints[kMaxHands][kJointCount];
+  Eigen::Vector4f joint_connections[kMaxHands][kJointCount];
 
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 };
 
+// Fills hands with the skeletons of the frame's hands, in Leap space.
+void BuildHands(const frame_record::FrameRecord &frame, HandBuffer *hands);
+
 }  // namespace virtual_hand
 
 #endif  // HEADERS_VIRTUAL_HAND_H_
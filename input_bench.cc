@@ -0,0 +1,206 @@
+// Copyright 2015 Makoto Yano
+//
+// Feeds frames of a hand drawing through the input thread the way the
+// Leap thread does and reports:
+//   push cost      what queueing a frame costs the producer, against
+//                  processing it right there as onFrame used to
+//   latency        from a frame being queued to the hand processor being
+//                  done with it, with frames at about 110 Hz
+//   overload       a producer far quicker than a slow consumer, which
+//                  must drop frames rather than wait and must process the
+//                  ones it keeps in order
+// Fails when a paced frame is dropped, frames go missing or come out of
+// order, or pushing costs more than processing.
+//
+//   input_bench [--frames N]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "headers/bench_util.h"
+#include "headers/frame_record.h"
+#include "headers/hand_input_processor.h"
+#include "headers/input_thread.h"
+#include "headers/motion_predictor.h"
+
+namespace {
+
+const int64_t kFrameMicros = 9091;
+
+// A frame with one hand whose index finger traces a figure eight, as
+// the Leap sends them while the user draws.
+void MakeFrame(int64_t id, frame_record::FrameRecord *frame) {
+  memset(frame, 0, sizeof(*frame));
+  frame->id = id;
+  frame->timestamp = id * kFrameMicros;
+  frame->hand_count = 1;
+  frame_record::HandRecord &hand = frame->hands[0];
+  hand.id = 1;
+  hand.confidence = 1.0f;
+  hand.extended_finger_count = 1;
+  hand.fingers[1].id = 11;
+  hand.fingers[1].valid = 1;
+  hand.fingers[1].extended = 1;
+  const float phase = 2.0f * frame->timestamp * 1e-6f;
+  float *tip_position = hand.fingers[1].tip_position;
+  tip_position[0] = 70.0f * sinf(phase);
+  tip_position[1] = 200.0f + 40.0f * sinf(2.0f * phase);
+  tip_position[2] = 15.0f * cosf(phase);
+}
+
+void PrintStats(const char *name, const hand_listener::InputStats &stats) {
+  printf("%-9s received %lu  processed %lu  dropped %lu  max queued %lu"
+         "  process %.1f us  queue wait %.1f us\n"
+        , name, stats.received, stats.processed, stats.dropped
+        , static_cast<unsigned long>(stats.max_queue_depth)  // NOLINT
+        , stats.mean_process_us, stats.mean_queue_wait_us);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  int frame_count = 1000;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+      frame_count = std::max(1, atoi(argv[++i]));
+    } else {
+      printf("Unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+  bool ok = true;
+
+  // Push cost, with a consumer that keeps up.
+  {
+    hand_listener::HandInputProcessor direct;
+    frame_record::FrameRecord frame;
+    std::chrono::steady_clock::time_point start =
+                                      std::chrono::steady_clock::now();
+    for (int i = 0; i < frame_count; i++) {
+      MakeFrame(i, &frame);
+      direct.process_frame(frame);
+    }
+    const double direct_ns = bench_util::Seconds(start) * 1e9 / frame_count;
+
+    hand_listener::HandInputProcessor processor;
+    hand_listener::InputThread input(
+          [&processor](const frame_record::FrameRecord &record
+                     , double received_time) {
+            processor.process_frame(record, received_time);
+          });
+    input.Start();
+    double push_ns = 0.0;
+    int pushed = 0;
+    for (int i = 0; i < frame_count; i++) {
+      start = std::chrono::steady_clock::now();
+      frame_record::FrameRecord *slot = input.BeginPush();
+      if (slot) {
+        MakeFrame(i, slot);
+        input.EndPush();
+        push_ns += bench_util::Seconds(start) * 1e9;
+        ++pushed;
+      }
+      // Give the worker time to catch up, as the gaps between Leap
+      // frames would.
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    input.Stop();
+    push_ns /= std::max(1, pushed);
+    printf("producer cost per frame  process inline %8.0f ns"
+           "  push to queue %8.0f ns\n", direct_ns, push_ns);
+    if (!(push_ns < direct_ns)) {
+      printf("pushing a frame costs more than processing it\n");
+      ok = false;
+    }
+  }
+
+  // Frames at the Leap's pace.
+  {
+    hand_listener::HandInputProcessor processor;
+    std::vector<double> latencies;
+    latencies.reserve(frame_count);
+    hand_listener::InputThread input(
+          [&processor, &latencies](const frame_record::FrameRecord &record
+                                 , double received_time) {
+            processor.process_frame(record, received_time);
+            latencies.push_back(
+                (motion_predictor::MonotonicSeconds() - received_time) * 1e6);
+          });
+    input.Start();
+    std::chrono::steady_clock::time_point next =
+                                      std::chrono::steady_clock::now();
+    for (int i = 0; i < frame_count; i++) {
+      next += std::chrono::microseconds(kFrameMicros);
+      std::this_thread::sleep_until(next);
+      frame_record::FrameRecord *slot = input.BeginPush();
+      if (slot) {
+        MakeFrame(i, slot);
+        input.EndPush();
+      }
+    }
+    input.Stop();
+    hand_listener::InputStats stats;
+    input.GetStats(&stats);
+    PrintStats("paced", stats);
+    printf("queued to processed  p50 %.1f us  p99 %.1f us  max %.1f us\n"
+          , bench_util::Percentile(latencies, 0.5)
+          , bench_util::Percentile(latencies, 0.99)
+          , bench_util::Percentile(latencies, 1.0));
+    if (stats.dropped != 0 || stats.processed != stats.received) {
+      printf("frames at 110 Hz were dropped\n");
+      ok = false;
+    }
+  }
+
+  // A consumer that can't keep up.
+  {
+    std::vector<int64_t> ids;
+    ids.reserve(frame_count);
+    hand_listener::InputThread input(
+          [&ids](const frame_record::FrameRecord &record, double) {
+            ids.push_back(record.id);
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+          });
+    input.Start();
+    for (int i = 0; i < frame_count; i++) {
+      frame_record::FrameRecord *slot = input.BeginPush();
+      if (slot) {
+        MakeFrame(i, slot);
+        input.EndPush();
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(20));
+    }
+    input.Stop();
+    hand_listener::InputStats stats;
+    input.GetStats(&stats);
+    PrintStats("overload", stats);
+    if (stats.dropped == 0) {
+      printf("the slow consumer never fell a queue behind\n");
+    }
+    if (stats.received != stats.processed + stats.dropped
+        || ids.size() != stats.processed) {
+      printf("frames went missing\n");
+      ok = false;
+    }
+    if (stats.max_queue_depth > hand_listener::kInputQueueFrames) {
+      printf("the queue held more than its capacity\n");
+      ok = false;
+    }
+    for (size_t i = 1; i < ids.size(); i++) {
+      if (ids[i] <= ids[i - 1]) {
+        printf("frame %ld was processed after frame %ld\n"
+              , static_cast<long>(ids[i]), static_cast<long>(ids[i - 1]));  // NOLINT
+        ok = false;
+        break;
+      }
+    }
+  }
+  return ok ? 0 : 1;
+}
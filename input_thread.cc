@@ -0,0 +1,161 @@
+// Copyright 2015 Makoto Yano
+
+#include <algorithm>
+
+#include "headers/frame_record.h"
+#include "headers/frame_trace.h"
+#include "headers/input_thread.h"
+
+namespace hand_listener {
+
+namespace {
+
+// How long the worker polls for the next frame before it goes to sleep.
+// A frame pushed while it polls costs the producer no wake up, which
+// takes the mutex and a futex call and costs more than processing a
+// frame without hands.  At 110 Hz this keeps the worker busy for about
+// 2% of the time.
+const int64_t kPollNanoseconds = 200000;
+
+// The steady clock in seconds, the same clock as
+// motion_predictor::MonotonicSeconds().
+double NowSeconds() {
+  return frame_trace::Now() / 1e9;
+}
+
+// Raises max to value unless another thread raised it further.
+template <typename T>
+void StoreMax(std::atomic<T> *max, T value) {
+  T current = max->load(std::memory_order_relaxed);
+  while (value > current
+        && !max->compare_exchange_weak(current, value
+                                     , std::memory_order_relaxed)) {
+  }
+}
+
+}  // namespace
+
+InputThread::InputThread(const FrameHandler &on_frame)
+  : on_frame_(on_frame), recorder_(NULL), pushing_(NULL)
+  , sleeping_(false), stopping_(false)
+  , received_(0), dropped_(0), processed_(0), max_queue_depth_(0)
+  , last_process_time_(0), max_process_time_(0), total_process_time_(0)
+  , total_queue_wait_(0) {
+}
+
+InputThread::~InputThread() {
+  Stop();
+}
+
+void InputThread::Start() {
+  if (worker_.joinable()) {
+    return;
+  }
+  stopping_ = false;
+  worker_ = std::thread(&InputThread::Run_, this);
+}
+
+void InputThread::Stop() {
+  if (!worker_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_one();
+  worker_.join();
+}
+
+frame_record::FrameRecord *InputThread::BeginPush() {
+  received_.fetch_add(1, std::memory_order_relaxed);
+  pushing_ = queue_.reserve();
+  if (!pushing_) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return NULL;
+  }
+  pushing_->received_time = NowSeconds();
+  return &pushing_->record;
+}
+
+void InputThread::EndPush() {
+  if (!pushing_) {
+    return;
+  }
+  pushing_ = NULL;
+  queue_.commit();
+  StoreMax(&max_queue_depth_, queue_.size());
+  // Pairs with the worker setting sleeping_ before it looks at the queue
+  // a last time: either it sees this frame or this sees it asleep.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (sleeping_.load(std::memory_order_relaxed)) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    wake_.notify_one();
+  }
+}
+
+void InputThread::GetStats(InputStats *stats) const {
+  stats->queue_depth = queue_.size();
+  stats->max_queue_depth = max_queue_depth_.load(std::memory_order_relaxed);
+  stats->received = received_.load(std::memory_order_relaxed);
+  stats->dropped = dropped_.load(std::memory_order_relaxed);
+  stats->processed = processed_.load(std::memory_order_relaxed);
+  stats->last_process_us =
+        last_process_time_.load(std::memory_order_relaxed) / 1000.0;
+  stats->max_process_us =
+        max_process_time_.load(std::memory_order_relaxed) / 1000.0;
+  const double processed = stats->processed > 0 ? stats->processed : 1;
+  stats->mean_process_us =
+        total_process_time_.load(std::memory_order_relaxed)
+        / 1000.0 / processed;
+  stats->mean_queue_wait_us =
+        total_queue_wait_.load(std::memory_order_relaxed)
+        / 1000.0 / processed;
+}
+
+void InputThread::Run_() {
+  frame_trace::SetThreadName("input");
+  while (true) {
+    QueuedFrame *frame = queue_.front();
+    if (!frame) {
+      const int64_t poll_end = frame_trace::Now() + kPollNanoseconds;
+      while (!(frame = queue_.front()) && !stopping_
+            && frame_trace::Now() < poll_end) {
+        std::this_thread::yield();
+      }
+    }
+    if (!frame) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      sleeping_.store(true, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      // The queue first, so frames pushed before Stop() still get done.
+      while (!(frame = queue_.front()) && !stopping_) {
+        wake_.wait(lock);
+      }
+      sleeping_.store(false, std::memory_order_relaxed);
+      if (!frame) {
+        // Stopping, and everything queued was processed.
+        return;
+      }
+    }
+
+    const int64_t start = frame_trace::Now();
+    total_queue_wait_.fetch_add(
+          start - static_cast<int64_t>(frame->received_time * 1e9)
+        , std::memory_order_relaxed);
+    if (recorder_ && recorder_->is_open()) {
+      FRAME_TRACE_SCOPE("record");
+      recorder_->Write(frame->record);
+    }
+    on_frame_(frame->record, frame->received_time);
+    queue_.pop();
+
+    const int64_t elapsed = frame_trace::Now() - start;
+    last_process_time_.store(elapsed, std::memory_order_relaxed);
+    StoreMax(&max_process_time_, elapsed);
+    total_process_time_.fetch_add(elapsed, std::memory_order_relaxed);
+    processed_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+}  // namespace hand_listener
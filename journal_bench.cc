@@ -0,0 +1,231 @@
+// Copyright 2015 Makoto Yano
+//
+// Measures the stroke journal and checks that it survives a crash.
+//
+// Throughput: strokes are appended one at a time, like they finish in
+// the app, and all at once, like a loaded scene.  Reports what Append()
+// costs the caller and how fast the writer gets them on disk.
+//
+// Crash: a child process journals strokes and is killed with SIGKILL in
+// the middle of it, after at least one checkpoint.  Recovery has to give
+// back a prefix of the strokes, each exactly as written.  Then half a
+// record and a record with a bad checksum are appended by hand, and
+// recovery has to drop them and cut the file back.
+//
+//   journal_bench [--strokes N] [--dir DIR]
+
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "headers/bench_strokes.h"
+#include "headers/bench_util.h"
+#include "headers/pen_line.h"
+#include "headers/stroke_journal.h"
+
+namespace {
+
+void Generate(int count, pen_line::StrokeStore *store) {
+  std::minstd_rand random(1);
+  std::uniform_real_distribution<float> position(-2000.0f, 2000.0f);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  std::uniform_int_distribution<int> length(20, 200);
+  for (int i = 0; i < count; i++) {
+    pen_line::Color color = { unit(random), unit(random), unit(random) };
+    Leap::Vector center(position(random), position(random), position(random));
+    int points = length(random);
+    unsigned int id = store->begin_stroke(color);
+    for (int j = 0; j < points; j++) {
+      float angle = 2.0f * M_PI * j / points;
+      store->append(id, center + Leap::Vector(100.0f * cos(angle)
+                                            , 100.0f * sin(angle)
+                                            , 10.0f * unit(random)));
+    }
+    store->finish(id);
+  }
+}
+
+void Remove(const std::string &journal, const std::string &checkpoint) {
+  unlink(journal.c_str());
+  unlink(checkpoint.c_str());
+}
+
+long FileSize(const std::string &path) {  // NOLINT
+  struct stat file_stat;
+  return stat(path.c_str(), &file_stat) == 0 ? file_stat.st_size : -1;
+}
+
+// Recovers into a fresh store and checks it against the first strokes of
+// expected.  Returns the number recovered, or -1 when they differ.
+long RecoverAndCheck(const std::string &journal  // NOLINT
+                   , const std::string &checkpoint
+                   , const std::vector<pen_line::StrokeView> &expected) {
+  pen_line::StrokeStore store;
+  if (!stroke_journal::Recover(journal.c_str(), checkpoint.c_str(), &store)) {
+    printf("recovery failed\n");
+    return -1;
+  }
+  std::vector<pen_line::StrokeView> recovered = bench_strokes::Completed(store);
+  if (recovered.size() > expected.size()) {
+    printf("recovered %lu strokes, only %lu were written\n"
+          , static_cast<unsigned long>(recovered.size())  // NOLINT
+          , static_cast<unsigned long>(expected.size()));  // NOLINT
+    return -1;
+  }
+  for (size_t i = 0; i < recovered.size(); i++) {
+    if (recovered[i].count != expected[i].count
+        || memcmp(&recovered[i].color, &expected[i].color
+                , sizeof(expected[i].color))
+        || memcmp(recovered[i].points, expected[i].points
+                , expected[i].count * sizeof(Leap::Vector))) {
+      printf("recovered stroke %lu differs\n"
+            , static_cast<unsigned long>(i));  // NOLINT
+      return -1;
+    }
+  }
+  return recovered.size();
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  int stroke_count = 20000;
+  std::string dir = "/tmp";
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--strokes") == 0 && i + 1 < argc) {
+      stroke_count = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc) {
+      dir = argv[++i];
+    } else {
+      printf("Unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+  const std::string journal = dir + "/journal_bench.owlj";
+  const std::string checkpoint = dir + "/journal_bench.owls";
+
+  pen_line::StrokeStore store;
+  Generate(stroke_count, &store);
+  std::vector<pen_line::StrokeView> strokes = bench_strokes::Completed(store);
+  printf("%d strokes, %lu points\n", stroke_count
+        , static_cast<unsigned long>(store.point_count()));  // NOLINT
+
+  // First one stroke per Append(), as the render loop hands them over,
+  // then everything in one call.
+  for (int pass = 0; pass < 2; pass++) {
+    Remove(journal, checkpoint);
+    stroke_journal::StrokeJournal writer;
+    if (!writer.Open(journal.c_str(), checkpoint.c_str(), 0)) {
+      return 2;
+    }
+    std::vector<pen_line::StrokeView> growing;
+    double append_ms = 0.0;
+    std::chrono::steady_clock::time_point start =
+                                      std::chrono::steady_clock::now();
+    if (pass == 0) {
+      for (size_t i = 0; i < strokes.size(); i++) {
+        growing.push_back(strokes[i]);
+        std::chrono::steady_clock::time_point call =
+                                      std::chrono::steady_clock::now();
+        writer.Append(growing);
+        append_ms += bench_util::Seconds(call) * 1e3;
+      }
+    } else {
+      writer.Append(strokes);
+      append_ms = bench_util::Seconds(start) * 1e3;
+    }
+    while (writer.written_record_count() < strokes.size()) {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    double total_ms = bench_util::Seconds(start) * 1e3;
+    size_t checkpoints = writer.checkpoint_count();
+    writer.Close();
+    printf("%-14s append %.3f us/stroke on the caller, on disk after"
+           " %.1f ms: %.0f strokes/s, %.1f MB/s, %lu checkpoints\n"
+          , pass == 0 ? "one by one" : "all at once"
+          , append_ms * 1000.0 / strokes.size(), total_ms
+          , strokes.size() / (total_ms / 1000.0)
+          , store.point_count() * sizeof(Leap::Vector) / (total_ms * 1000.0)
+          , static_cast<unsigned long>(checkpoints));  // NOLINT
+  }
+
+  // The writer is killed while it is writing.
+  Remove(journal, checkpoint);
+  pid_t child = fork();
+  if (child == 0) {
+    stroke_journal::StrokeJournal writer;
+    if (!writer.Open(journal.c_str(), checkpoint.c_str(), 0)) {
+      _exit(2);
+    }
+    std::vector<pen_line::StrokeView> growing;
+    for (size_t i = 0; i < strokes.size(); i++) {
+      growing.push_back(strokes[i]);
+      writer.Append(growing);
+      if (i % 16 == 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+      }
+    }
+    writer.Close();
+    _exit(0);
+  }
+  // Kill it once it has checkpointed and is well into the journal again.
+  while (FileSize(checkpoint) <= 0 || FileSize(journal) < 256 * 1024) {
+    int status;
+    if (waitpid(child, &status, WNOHANG) == child) {
+      printf("the writer finished before it could be killed,"
+             " use more strokes\n");
+      return 2;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+  }
+  kill(child, SIGKILL);
+  waitpid(child, NULL, 0);
+  long torn_size = FileSize(journal);  // NOLINT
+  long recovered = RecoverAndCheck(journal, checkpoint, strokes);  // NOLINT
+  if (recovered <= 0) {
+    printf("nothing recovered after the kill\n");
+    return 1;
+  }
+  printf("killed writer: recovered %ld strokes, journal %ld -> %ld bytes\n"
+        , recovered, torn_size, FileSize(journal));
+
+  // Half a record, then a whole record with a checksum that is wrong.
+  long clean_size = FileSize(journal);  // NOLINT
+  std::vector<unsigned char> record(sizeof(stroke_journal::RecordHeader)
+                                  + strokes[0].count * sizeof(Leap::Vector));
+  stroke_journal::RecordHeader header;
+  memset(&header, 0, sizeof(header));
+  header.point_count = strokes[0].count;
+  header.sequence = recovered;
+  memcpy(&record[0], &header, sizeof(header));
+  FILE *file = fopen(journal.c_str(), "ab");
+  fwrite(&record[0], 1, record.size() / 2, file);
+  fclose(file);
+  if (RecoverAndCheck(journal, checkpoint, strokes) != recovered
+      || FileSize(journal) != clean_size) {
+    printf("a half written record was not dropped\n");
+    return 1;
+  }
+  file = fopen(journal.c_str(), "ab");
+  fwrite(&record[0], 1, record.size(), file);
+  fclose(file);
+  if (RecoverAndCheck(journal, checkpoint, strokes) != recovered
+      || FileSize(journal) != clean_size) {
+    printf("a record with a bad checksum was not dropped\n");
+    return 1;
+  }
+  printf("torn and corrupt tails dropped, recovery ok\n");
+  Remove(journal, checkpoint);
+  return 0;
+}
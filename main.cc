@@ -18,6 +18,8 @@
 #include <math.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #define GL_DO_NOT_WARN_IF_MULTI_GL_VERSION_HEADERS_INCLUDED
 #define GLFW_INCLUDE_GLCOREARB
@@ -31,111 +33,194 @@
 #include <GL/gl.h>
 #endif
 #include <LeapMath.h>
-#include <OVR_CAPI_GL.h>
-#include <boost/optional.hpp>
+#include <atomic>
+#include <chrono>
 #include <memory>
+#include <string>
+#include <thread>
 
 #include "headers/pen_line.h"
 #include "headers/field_line.h"
 #include "headers/Quaternion.h"
+#include "headers/frame_history.h"
+#include "headers/frame_record.h"
+#include "headers/frame_trace.h"
+#include "headers/gpu_timer.h"
 #include "headers/hand_input_listener.h"
+#include "headers/hand_input_processor.h"
+#include "headers/hmd_backend.h"
+#include "headers/input_thread.h"
+#include "headers/motion_predictor.h"
+#ifdef HAVE_OVR
 #include "headers/oculus.h"
+#endif
+#include "headers/scene_file.h"
+#include "headers/scene_renderer.h"
+#include "headers/scene_snapshot.h"
+#include "headers/simulated_hmd.h"
+#include "headers/stroke_journal.h"
+#include "headers/stroke_mesh.h"
+#include "headers/stroke_spline.h"
 
 field_line::FieldLine *background_line;
-oculus_vr::OculusHmd *hmd;
+hmd_backend::HmdBackend *hmd;
+scene_renderer::SceneRenderer *renderer;
+gpu_timer::GpuTimer *gpu_timing;
 
 /////////////////////////////////
 // for Leap
 
-hand_listener::HandInputListener listener;
+hand_listener::HandInputProcessor processor;
+// The Leap thread only queues frames; they are processed here.
+hand_listener::InputThread input_thread(
+      [](const frame_record::FrameRecord &record, double received_time) {
+        processor.process_frame(record, received_time);
+      });
+hand_listener::HandInputListener listener(&input_thread);
+// With --poll-input the render loop reads the Leap frames itself instead,
+// poll_lead seconds before each frame's display time, and samples the
+// hands poll_sample_delay seconds behind the Leap clock.
+hand_listener::InputPoller *poller = NULL;
+double poll_lead = frame_history::kDefaultPollLead;
+double poll_sample_delay = frame_history::kDefaultSampleDelay;
+int64_t last_sample_time = -1;
+unsigned long held_sample_count = 0;  // NOLINT
+frame_record::FrameRecorder recorder;
+frame_record::FrameReplay replay;
+std::atomic<bool> replay_running(true);
+// Where S and quitting save the completed strokes.
+const char *save_path = NULL;
+bool save_requested = false;
+// Completed strokes go to disk as they come when --journal is given.
+stroke_journal::StrokeJournal journal;
+// Live stroke ends and hands are drawn where they will be at scanout,
+// this far behind the Leap frame they came from.
+bool predict_motion = true;
+float hand_latency = motion_predictor::kDefaultTrackingLatency;
+// T toggles the frame trace; it is written here on quitting when given.
+const char *trace_path = NULL;
 
 void reshape_func(int width, int height) {
   glViewport(0, 0, width, height);
 }
 
-void apply_world_quaternion(const Quaternion &q) {
-  GLfloat m[16];
-  float x2 = q[1] * q[1] * 2.0f;
-  float y2 = q[2] * q[2] * 2.0f;
-  float z2 = q[3] * q[3] * 2.0f;
-  float xy = q[1] * q[2] * 2.0f;
-  float yz = q[2] * q[3] * 2.0f;
-  float zx = q[3] * q[1] * 2.0f;
-  float xw = q[1] * q[0] * 2.0f;
-  float yw = q[2] * q[0] * 2.0f;
-  float zw = q[3] * q[0] * 2.0f;
-
-  m[0] = 1.0f - y2 - z2;
-  m[1] = xy + zw;
-  m[2] = zx - yw;
-  m[3] = 0.0f;
-
-  m[4] = xy - zw;
-  m[5] = 1.0 - z2 - x2;
-  m[6] = yz + xw;
-  m[7] = 0.0f;
-
-  m[8] = zx + yw;
-  m[9] = yz - xw;
-  m[10] = 1.0f - x2 - y2;
-  m[11] = 0.0f;
-
-  m[12] = 0.0f;
-  m[13] = 0.0f;
-  m[14] = 0.0f;
-  m[15] = 1.0f;
-  glMultMatrixf(m);
+// Samples the hands for the frame shown at timing.display_time.  Since
+// the poll is always the same time before the display and the sample the
+// same time behind the poll, every frame shows hands equally old.
+void poll_input(const hmd_backend::FrameTiming &timing) {
+  FRAME_TRACE_SCOPE("poll input");
+  const double wait = timing.display_time - poll_lead - hmd->Now();
+  if (wait > 0.0) {
+    FRAME_TRACE_SCOPE("wait for poll");
+    std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+  }
+  const int64_t leap_now = poller->Poll();
+  const int64_t sample_time =
+              leap_now - static_cast<int64_t>(poll_sample_delay * 1e6);
+  frame_record::FrameRecord sample;
+  if (!poller->history().Sample(sample_time, &sample)) {
+    return;
+  }
+  if (sample.timestamp < sample_time) {
+    // The frames after the sample time haven't come yet.
+    ++held_sample_count;
+  }
+  if (sample.timestamp <= last_sample_time) {
+    return;
+  }
+  last_sample_time = sample.timestamp;
+  // The sample's age is known on the Leap clock, capture included.
+  processor.process_frame(sample, motion_predictor::MonotonicSeconds()
+                                  - (leap_now - sample.timestamp) * 1e-6);
 }
 
 void display_func(GLFWwindow *window) {
+  FRAME_TRACE_SCOPE("frame");
   float ratio;
   int width, height;
 
   glfwGetFramebufferSize(window, &width, &height);
   ratio = width / static_cast<float>(height);
 
-  listener.lock();
+  hmd_backend::FrameTiming timing;
+  {
+    FRAME_TRACE_SCOPE("begin frame");
+    hmd->BeginFrame(&timing);
+  }
+  if (poller) {
+    poll_input(timing);
+  }
+
+  const scene_snapshot::SceneSnapshot &scene = processor.acquire_snapshot();
+  {
+    FRAME_TRACE_SCOPE("journal");
+    journal.Append(scene.strokes);
+  }
+  if (save_requested) {
+    save_requested = false;
+    if (scene_file::Save(save_path, scene.strokes)) {
+      printf("Saved %lu strokes to %s.\n"
+            , static_cast<unsigned long>(scene.strokes.size())  // NOLINT
+            , save_path);
+    }
+  }
 
-  hmd->FrameInit();
+  // Frames a few frames old are read back here, while tracing.
+  gpu_timing->BeginFrame();
+  gpu_timing->Begin("gpu frame");
+  renderer->SetPredictionHorizon(predict_motion
+                    ? motion_predictor::Horizon(scene.received_time
+                                              , timing.display_time
+                                                - hmd->Now()
+                                              , poller ? 0.0f : hand_latency)
+                    : 0.0f);
 
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-  glMatrixMode(GL_PROJECTION);
-  glLoadIdentity();
-  gluPerspective(
-    60.0f,
-    static_cast<float>(width)
-    / static_cast<float>(height), 2.0f, 200000.0f);
-  gluLookAt(0, 0, 0
-      , 0, 0,  -300, 0, 1, 0);
-
-  glMatrixMode(GL_MODELVIEW);
-  glLoadIdentity();
-
-  boost::optional<ovrPoseStatef> pose = hmd->Track();
-
-  if (pose) {
-    Quaternion hmd_quart((*pose).ThePose.Orientation.w
-                      , - (*pose).ThePose.Orientation.x
-                      , - (*pose).ThePose.Orientation.y
-                      , - (*pose).ThePose.Orientation.z);
-    apply_world_quaternion(hmd_quart);
-  } else {
-    Quaternion hmd_quart(1, 0, 0, 0);
-    apply_world_quaternion(hmd_quart);
+  stereo_renderer::EyeViewport eye_viewport[hmd_backend::kEyeCount];
+  int eye_count = 0;
+  if (hmd->connected()) {
+    hmd_backend::EyeDesc eye_desc[hmd_backend::kEyeCount];
+    hmd->GetEyeDescs(eye_desc);
+    for (int eye = 0; eye < hmd_backend::kEyeCount; eye++) {
+      eye_viewport[eye] = eye_desc[eye].viewport;
+    }
+    eye_count = hmd_backend::kEyeCount;
+    ratio = eye_viewport[0].width / static_cast<float>(eye_viewport[0].height);
+  }
+  renderer->Prepare(scene, ratio);
+
+  // The head pose is sampled last, for when the frame is on the display,
+  // so it is as fresh as it can be when the frame goes out.
+  hmd_backend::Pose pose;
+  Quaternion hmd_quart(1, 0, 0, 0);
+  {
+    FRAME_TRACE_SCOPE("track");
+    if (hmd->Track(timing.display_time, &pose)) {
+      hmd_quart = conj(pose.orientation);
+    }
+  }
+  renderer->Render(background_line, hmd_quart
+                 , eye_count > 0 ? eye_viewport : NULL, eye_count);
+
+  gpu_timing->End();
+  {
+    FRAME_TRACE_SCOPE("end frame");
+    GPU_TIMER_SCOPE(gpu_timing, "gpu end frame");
+    hmd->EndFrame();
+  }
+  gpu_timing->EndFrame();
+  if (!hmd->presents_frame()) {
+    FRAME_TRACE_SCOPE("swap buffers");
+    glfwSwapBuffers(window);
+  }
+  {
+    FRAME_TRACE_SCOPE("poll events");
+    glfwPollEvents();
+  }
+  if (frame_trace::Enabled()) {
+    frame_trace::Collect();
   }
-  glTranslated(listener.camera_x_position
-      , -listener.camera_y_position
-      , -listener.camera_z_position);
-  apply_world_quaternion(listener.world_x_quaternion);
-  apply_world_quaternion(listener.world_y_quaternion);
-
-  hmd->FrameRender(background_line, listener);
-
-  hmd->FrameEnd();
-  listener.unlock();
-  glfwSwapBuffers(window);
-  glfwPollEvents();
 }
 
 void key_func(unsigned char key, int x, int y) {
@@ -144,7 +229,7 @@ void key_func(unsigned char key, int x, int y) {
     exit(0);
     break;
   case 'I':
-    listener.initialize_world_position();
+    processor.initialize_world_position();
     break;
   }
 }
@@ -160,6 +245,12 @@ static void key_callback(GLFWwindow* window
                         , int mods) {
   if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
     glfwSetWindowShouldClose(window, GL_TRUE);
+  if (key == GLFW_KEY_S && action == GLFW_PRESS && save_path)
+    save_requested = true;
+  if (key == GLFW_KEY_T && action == GLFW_PRESS) {
+    frame_trace::SetEnabled(!frame_trace::Enabled());
+    printf("Frame trace %s.\n", frame_trace::Enabled() ? "on" : "off");
+  }
 }
 
 void init_opengl() {
@@ -183,26 +274,156 @@ void init_opengl() {
   glEnable(GL_LIGHT0);
   glEnable(GL_COLOR_MATERIAL);
   background_line = new field_line::FieldLine();
-  listener.initialize_world_position();
+  processor.initialize_world_position();
   float hard = Leap::PI / 32;
   float s = sin(hard);
   Quaternion rotate_quaternion(cos(hard), 1*s, 0*s, 0*s);
 }
 
+void print_usage(const char *program) {
+  printf("Usage: %s [--two-pass-stereo] [--record FILE] [--replay FILE]\n"
+         "    [--replay-max-speed] [--load SCENE] [--save SCENE]\n"
+         "    [--journal FILE] [--simulated-hmd] [--refresh-hz HZ]\n"
+         "    [--tracking-latency-ms MS] [--stroke-start-ms MS]\n"
+         "    [--hand-latency-ms MS] [--spline-tolerance-mm MM]\n"
+         "    [--stroke-style lines|ribbon|tube] [--stroke-radius-mm MM]\n"
+         "    [--tube-sides N] [--no-prediction] [--poll-input]\n"
+         "    [--poll-lead-ms MS] [--poll-sample-delay-ms MS]\n"
+         "    [--trace FILE]\n", program);
+}
+
 int main(int argc, char** argv) {
-  if (!oculus_vr::Initialize()) {
-    printf("Oculus initialize failed.\n");
-    return -1;
+  const char *record_path = NULL;
+  const char *replay_path = NULL;
+  const char *load_path = NULL;
+  const char *journal_path = NULL;
+  bool replay_realtime = true;
+  bool simulated = false;
+  bool poll = false;
+  // 0 draws strokes as straight lines between their points.
+  float spline_tolerance = stroke_spline::kDefaultTolerance;
+  stroke_mesh::Shape stroke_shape = stroke_mesh::DefaultShape();
+  scene_renderer::StereoMode stereo_mode = scene_renderer::kStereoSinglePass;
+  simulated_hmd::Config simulated_config = simulated_hmd::DefaultConfig();
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--two-pass-stereo") == 0) {
+      stereo_mode = scene_renderer::kStereoTwoPass;
+    } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+      record_path = argv[++i];
+    } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      replay_path = argv[++i];
+    } else if (strcmp(argv[i], "--load") == 0 && i + 1 < argc) {
+      load_path = argv[++i];
+    } else if (strcmp(argv[i], "--save") == 0 && i + 1 < argc) {
+      save_path = argv[++i];
+    } else if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc) {
+      journal_path = argv[++i];
+    } else if (strcmp(argv[i], "--replay-max-speed") == 0) {
+      replay_realtime = false;
+    } else if (strcmp(argv[i], "--simulated-hmd") == 0) {
+      simulated = true;
+    } else if (strcmp(argv[i], "--refresh-hz") == 0 && i + 1 < argc) {
+      simulated_config.refresh_hz = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--tracking-latency-ms") == 0 && i + 1 < argc) {
+      simulated_config.tracking_latency = atof(argv[++i]) / 1000.0;
+    } else if (strcmp(argv[i], "--stroke-start-ms") == 0 && i + 1 < argc) {
+      processor.stroke_start_delay =
+                          static_cast<int64_t>(atof(argv[++i]) * 1000.0);
+    } else if (strcmp(argv[i], "--hand-latency-ms") == 0 && i + 1 < argc) {
+      hand_latency = atof(argv[++i]) / 1000.0f;
+    } else if (strcmp(argv[i], "--spline-tolerance-mm") == 0
+               && i + 1 < argc) {
+      spline_tolerance = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--stroke-style") == 0 && i + 1 < argc) {
+      const char *name = argv[++i];
+      if (strcmp(name, "lines") == 0) {
+        stroke_shape.style = stroke_mesh::kLines;
+      } else if (strcmp(name, "ribbon") == 0) {
+        stroke_shape.style = stroke_mesh::kRibbon;
+      } else if (strcmp(name, "tube") == 0) {
+        stroke_shape.style = stroke_mesh::kTube;
+      } else {
+        printf("Unknown stroke style %s\n", name);
+        print_usage(argv[0]);
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--stroke-radius-mm") == 0 && i + 1 < argc) {
+      stroke_shape.radius = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--tube-sides") == 0 && i + 1 < argc) {
+      stroke_shape.sides = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--no-prediction") == 0) {
+      predict_motion = false;
+    } else if (strcmp(argv[i], "--poll-input") == 0) {
+      poll = true;
+    } else if (strcmp(argv[i], "--poll-lead-ms") == 0 && i + 1 < argc) {
+      poll_lead = atof(argv[++i]) / 1000.0;
+    } else if (strcmp(argv[i], "--poll-sample-delay-ms") == 0
+               && i + 1 < argc) {
+      poll_sample_delay = atof(argv[++i]) / 1000.0;
+    } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+      trace_path = argv[++i];
+      frame_trace::SetEnabled(true);
+    } else {
+      printf("Unknown option %s\n", argv[i]);
+      print_usage(argv[0]);
+      return -1;
+    }
   }
 
-  hmd = new oculus_vr::OculusHmd();
+#ifdef HAVE_OVR
+  if (!simulated) {
+    if (!oculus_vr::Initialize()) {
+      printf("Oculus initialize failed.\n");
+      return -1;
+    }
+    hmd = new oculus_vr::OculusHmd();
+  }
+#else
+  simulated = true;
+#endif
+  if (simulated) {
+    hmd = new simulated_hmd::SimulatedHmd(simulated_config);
+  }
+
+  if (replay_path && !replay.Open(replay_path)) {
+    return -1;
+  }
+  // Before any input thread writes to the store.  The journal's scene
+  // comes back first, so its strokes keep their place in the journal.
+  std::string checkpoint_path;
+  if (journal_path) {
+    checkpoint_path = std::string(journal_path) + ".scene";
+    if (!stroke_journal::Recover(journal_path, checkpoint_path.c_str()
+                                , &processor.strokes)) {
+      return -1;
+    }
+  }
+  size_t durable_count = processor.strokes.completed().size();
+  if (load_path && !scene_file::Load(load_path, &processor.strokes)) {
+    return -1;
+  }
+  if (journal_path && !journal.Open(journal_path, checkpoint_path.c_str()
+                                  , durable_count)) {
+    return -1;
+  }
+  if (record_path && !replay_path) {
+    if (!recorder.Open(record_path)) {
+      return -1;
+    }
+    input_thread.set_recorder(&recorder);
+  }
 
   glfwSetErrorCallback(error_callback);
 
   if (!glfwInit())
     exit(EXIT_FAILURE);
 
-  GLFWmonitor* monitor = hmd->Monitor();
+  GLFWmonitor* monitor = nullptr;
+#ifdef HAVE_OVR
+  if (!simulated) {
+    monitor = static_cast<oculus_vr::OculusHmd *>(hmd)->Monitor();
+  }
+#endif
 
   GLFWwindow *window = nullptr;
 
@@ -214,8 +435,12 @@ int main(int argc, char** argv) {
                                       , "My Title"
                                       , monitor
                                       , NULL);
-
-    hmd->SetupOvrConfig();
+  } else if (simulated) {
+    window = glfwCreateWindow(simulated_config.width
+                                      , simulated_config.height
+                                      , "My Title"
+                                      , NULL
+                                      , NULL);
   } else {
     printf("Cannot get monitor.\n");
     window = glfwCreateWindow(1440
@@ -226,28 +451,108 @@ int main(int argc, char** argv) {
   }
 
   glfwMakeContextCurrent(window);
-  glfwSwapInterval(1);
+  // The simulated HMD paces frames itself.
+  glfwSwapInterval(simulated ? 0 : 1);
   glfwSetKeyCallback(window, key_callback);
 
   init_opengl();
+  hmd->SetupRendering();
+  renderer = new scene_renderer::SceneRenderer();
+  renderer->SetStereoMode(stereo_mode);
+  renderer->SetSplineTolerance(spline_tolerance);
+  renderer->SetStrokeShape(stroke_shape);
+  gpu_timing = new gpu_timer::GpuTimer();
+  if (gpu_timing->Initialize()) {
+    renderer->SetGpuTimer(gpu_timing);
+  } else {
+    printf("No GPU timer queries, the trace has CPU stages only.\n");
+  }
   Leap::Controller controller;
-  controller.setPolicyFlags(
-        static_cast<Leap::Controller::PolicyFlag>(
-          Leap::Controller::PolicyFlag::POLICY_IMAGES |
-          Leap::Controller::PolicyFlag::POLICY_OPTIMIZE_HMD));
-  controller.addListener(listener);
+  std::thread replay_thread;
+  if (replay_path) {
+    // Recorded frames stand in for the Leap thread.
+    replay_thread = std::thread([replay_realtime]() {
+      frame_trace::SetThreadName("replay");
+      replay.Play([](const frame_record::FrameRecord &record) {
+        processor.process_frame(record);
+        return replay_running.load();
+      }, replay_realtime);
+    });
+  } else {
+    controller.setPolicyFlags(
+          static_cast<Leap::Controller::PolicyFlag>(
+            Leap::Controller::PolicyFlag::POLICY_IMAGES |
+            Leap::Controller::PolicyFlag::POLICY_OPTIMIZE_HMD));
+    if (poll) {
+      poller = new hand_listener::InputPoller(&controller);
+      poller->set_recorder(&recorder);
+    } else {
+      input_thread.Start();
+      controller.addListener(listener);
+    }
+  }
 
+  frame_trace::SetThreadName("render");
   while (!glfwWindowShouldClose(window)) {
     display_func(window);
   }
 
   printf("finish\n");
 
+  if (replay_thread.joinable()) {
+    replay_running = false;
+    replay_thread.join();
+  } else if (poller) {
+    printf("polls %lu, frames %lu, missed %lu, held samples %lu\n"
+          , poller->poll_count(), poller->frame_count()
+          , poller->missed_frame_count(), held_sample_count);
+  } else {
+    controller.removeListener(listener);
+    input_thread.Stop();
+    hand_listener::InputStats input_stats;
+    input_thread.GetStats(&input_stats);
+    printf("input frames %lu, dropped %lu, max queued %lu"
+           ", process mean %.1f us max %.1f us, queue wait mean %.1f us\n"
+          , input_stats.received, input_stats.dropped
+          , static_cast<unsigned long>(input_stats.max_queue_depth)  // NOLINT
+          , input_stats.mean_process_us, input_stats.max_process_us
+          , input_stats.mean_queue_wait_us);
+  }
+  recorder.Close();
+  // Input has stopped, so this snapshot has every completed stroke.
+  const scene_snapshot::SceneSnapshot &scene = processor.acquire_snapshot();
+  journal.Append(scene.strokes);
+  journal.Close();
+  if (save_path) {
+    scene_file::Save(save_path, scene.strokes);
+  }
+
+  if (simulated) {
+    simulated_hmd::SimulatedHmd *simulated_hmd =
+                            static_cast<simulated_hmd::SimulatedHmd *>(hmd);
+    printf("frames %lu, missed refreshes %lu\n"
+          , simulated_hmd->frame_count()
+          , simulated_hmd->missed_frame_count());
+  }
+  frame_trace::Collect();
+  frame_trace::PrintStageStats();
+  if (trace_path) {
+    frame_trace::WriteChromeTrace(trace_path);
+  }
+
+  // These own GL objects, release them while the context is still alive.
+  delete gpu_timing;
+  delete renderer;
+  delete hmd;
+
   glfwDestroyWindow(window);
   glfwTerminate();
 
-  delete hmd;
-  oculus_vr::Shutdown();
+#ifdef HAVE_OVR
+  if (!simulated) {
+    oculus_vr::Shutdown();
+  }
+#endif
 
   return 0;
 }
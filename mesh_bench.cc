@@ -0,0 +1,229 @@
+// Copyright 2015 Makoto Yano
+//
+// Builds stroke meshes the way they are uploaded and reports, for lines,
+// ribbons and tubes of a few sides:
+//   build   points and vertices per second for whole strokes, from the
+//           tessellated curve to the StrokeVertex buffer the pool uploads
+//   memory  bytes of vertex buffer per curve point and per control point
+//           the stroke keeps, and per stroke
+//   live    per frame cost of a stroke being traced, one control point a
+//           frame: extending its mesh and building the end that still
+//           changes, as the stream ring does, against building the whole
+//           stroke again every frame
+// Fails when a mesh built a few points at a time differs from the one
+// built in one go, or extending the live stroke costs no less than
+// rebuilding it.
+//
+//   mesh_bench [--strokes N] [--radius MM]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "headers/bench_strokes.h"
+#include "headers/bench_util.h"
+#include "headers/stroke_buffer.h"
+#include "headers/stroke_mesh.h"
+#include "headers/stroke_simplifier.h"
+#include "headers/stroke_spline.h"
+
+namespace {
+
+const int kRuns = 10;
+
+bool SameVertices(const std::vector<stroke_buffer::StrokeVertex> &a
+                , const std::vector<stroke_buffer::StrokeVertex> &b) {
+  return a.size() == b.size()
+      && (a.empty() || memcmp(&a[0], &b[0], a.size() * sizeof(a[0])) == 0);
+}
+
+const char *StyleName(stroke_mesh::Style style) {
+  switch (style) {
+    case stroke_mesh::kRibbon:
+      return "ribbon";
+    case stroke_mesh::kTube:
+      return "tube";
+    default:
+      return "lines";
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  int stroke_count = 100;
+  float radius = stroke_mesh::DefaultShape().radius;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--strokes") == 0 && i + 1 < argc) {
+      stroke_count = std::max(1, atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--radius") == 0 && i + 1 < argc) {
+      radius = atof(argv[++i]);
+    } else {
+      printf("Unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+  bool ok = true;
+
+  // Control points the way the processor keeps them, and the curves the
+  // pool builds the meshes around.
+  const int samples = bench_strokes::kStrokeSamples;
+  std::vector<std::vector<Leap::Vector> > controls(stroke_count);
+  std::vector<std::vector<Leap::Vector> > curves(stroke_count);
+  std::vector<Leap::Vector> path;
+  size_t control_points = 0;
+  size_t curve_points = 0;
+  for (int s = 0; s < stroke_count; s++) {
+    path.clear();
+    for (int i = 0; i < samples; i++) {
+      path.push_back(bench_strokes::Path(i / bench_strokes::kSampleHz, s));
+    }
+    stroke_simplifier::Simplify(&path[0], path.size(), 0.5f, &controls[s]);
+    stroke_spline::Tessellate(&controls[s][0], controls[s].size()
+                            , stroke_spline::kDefaultTolerance, &curves[s]);
+    control_points += controls[s].size();
+    curve_points += curves[s].size();
+  }
+  printf("%d strokes, %.1f control points and %.1f curve points each\n"
+        , stroke_count, control_points / static_cast<double>(stroke_count)
+        , curve_points / static_cast<double>(stroke_count));
+
+  struct Case {
+    stroke_mesh::Style style;
+    int sides;
+  };
+  const Case cases[] = {
+    { stroke_mesh::kLines, 0 }, { stroke_mesh::kRibbon, 0 }
+  , { stroke_mesh::kTube, 4 }, { stroke_mesh::kTube, 6 }
+  , { stroke_mesh::kTube, 8 }
+  };
+  const pen_line::Color color = { 0.9f, 0.4f, 0.2f };
+  std::vector<stroke_buffer::StrokeVertex> mesh;
+  std::vector<stroke_buffer::StrokeVertex> pieces;
+  std::vector<stroke_buffer::StrokeVertex> tail;
+  for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+    stroke_mesh::Shape shape = stroke_mesh::DefaultShape();
+    shape.style = cases[c].style;
+    shape.radius = radius;
+    if (cases[c].sides > 0) {
+      shape.sides = cases[c].sides;
+    }
+    char name[32];
+    snprintf(name, sizeof(name), cases[c].sides > 0 ? "%s %d" : "%s"
+           , StyleName(shape.style), cases[c].sides);
+
+    // Whole strokes, reusing the output like the stroke pool does.
+    size_t vertices = 0;
+    double best = 1e30;
+    for (int run = 0; run < kRuns; run++) {
+      vertices = 0;
+      std::chrono::steady_clock::time_point start =
+                                      std::chrono::steady_clock::now();
+      for (int s = 0; s < stroke_count; s++) {
+        stroke_mesh::BuildMesh(shape, &curves[s][0], curves[s].size()
+                             , color, &mesh);
+        vertices += mesh.size();
+      }
+      best = std::min(best, bench_util::Seconds(start));
+    }
+    const double bytes = vertices * sizeof(stroke_buffer::StrokeVertex);
+    printf("%-8s build %6.2f M points/s  %6.2f M vertices/s  %7.1f MB/s"
+           "  %5.1f ns per point\n"
+          , name, curve_points / best / 1e6, vertices / best / 1e6
+          , bytes / best / 1e6, best * 1e9 / curve_points);
+    printf("         memory %5.1f vertices  %5.0f bytes per curve point"
+           "  %5.0f bytes per control point  %5.1f KB per stroke\n"
+          , vertices / static_cast<double>(curve_points)
+          , bytes / curve_points, bytes / control_points
+          , bytes / stroke_count / 1024.0);
+
+    // A few points at a time has to come out the same as in one go.
+    for (int s = 0; s < stroke_count; s++) {
+      const std::vector<Leap::Vector> &curve = curves[s];
+      stroke_mesh::BuildMesh(shape, &curve[0], curve.size(), color, &mesh);
+      stroke_mesh::MeshBuilder builder;
+      builder.Reset(shape, color);
+      pieces.clear();
+      for (size_t i = 0; i < curve.size(); ) {
+        const size_t count = std::min(curve.size() - i, 1 + (i + s) % 5);
+        builder.Add(&curve[i], count, &pieces);
+        i += count;
+      }
+      builder.Finish(&pieces);
+      if (!SameVertices(mesh, pieces)) {
+        printf("%s stroke %d built in pieces differs from in one go\n"
+              , name, s);
+        ok = false;
+        break;
+      }
+    }
+
+    // The stroke being traced, a control point a frame.  The curve of a
+    // segment is final once the next control point is in.
+    const std::vector<Leap::Vector> &points = controls[0];
+    std::vector<Leap::Vector> curve;
+    double extend_seconds = 1e30;
+    double rebuild_seconds = 1e30;
+    size_t extend_vertices = 0;
+    for (int run = 0; run < kRuns; run++) {
+      stroke_mesh::MeshBuilder builder;
+      builder.Reset(shape, color);
+      pieces.clear();
+      extend_vertices = 0;
+      std::chrono::steady_clock::time_point start =
+                                      std::chrono::steady_clock::now();
+      for (unsigned int count = 2; count <= points.size(); count++) {
+        curve.clear();
+        if (builder.empty()) {
+          curve.push_back(points[0]);
+        }
+        if (count > 2) {
+          stroke_spline::TessellateSegments(&points[0], count, count - 3
+                                          , count - 2
+                                          , stroke_spline::kDefaultTolerance
+                                          , &curve);
+        }
+        const size_t streamed = pieces.size();
+        builder.Add(&curve[0], curve.size(), &pieces);
+        // The end, from a copy.
+        curve.clear();
+        stroke_spline::TessellateSegments(&points[0], count, count - 2
+                                        , count - 1
+                                        , stroke_spline::kDefaultTolerance
+                                        , &curve);
+        stroke_mesh::MeshBuilder end = builder;
+        tail.clear();
+        end.Restart();
+        end.Add(&curve[0], curve.size(), &tail);
+        end.Finish(&tail);
+        extend_vertices += pieces.size() - streamed + tail.size();
+      }
+      extend_seconds = std::min(extend_seconds, bench_util::Seconds(start));
+
+      start = std::chrono::steady_clock::now();
+      for (unsigned int count = 2; count <= points.size(); count++) {
+        stroke_spline::Tessellate(&points[0], count
+                                , stroke_spline::kDefaultTolerance, &curve);
+        stroke_mesh::BuildMesh(shape, &curve[0], curve.size(), color, &mesh);
+      }
+      rebuild_seconds = std::min(rebuild_seconds, bench_util::Seconds(start));
+    }
+    const double frames = static_cast<double>(points.size() - 1);
+    printf("         live   %6.2f us and %5.0f vertices per frame extended"
+           ", %6.2f us rebuilt at %lu control points\n"
+          , extend_seconds * 1e6 / frames, extend_vertices / frames
+          , rebuild_seconds * 1e6 / frames
+          , static_cast<unsigned long>(points.size()));  // NOLINT
+    if (!(extend_seconds < rebuild_seconds)) {
+      printf("%s extending the live stroke is no cheaper than rebuilding"
+             " it\n", name);
+      ok = false;
+    }
+  }
+  return ok ? 0 : 1;
+}
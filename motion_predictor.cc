@@ -0,0 +1,68 @@
+// Copyright 2015 Makoto Yano
+
+#include <algorithm>
+#include <chrono>
+
+#include "headers/fingertip_filter.h"
+#include "headers/motion_predictor.h"
+
+namespace motion_predictor {
+
+const int64_t MotionTracker::kMaxGap;
+const float MotionTracker::kVelocityCutoff = 8.0f;
+const float MotionTracker::kAccelerationCutoff = 2.0f;
+
+Motion Still(const Leap::Vector &position) {
+  Motion motion;
+  motion.position = position;
+  return motion;
+}
+
+Leap::Vector Predict(const Motion &motion, float horizon) {
+  const float t = std::max(0.0f, std::min(horizon, kMaxHorizon));
+  return motion.position + motion.velocity * t
+       + motion.acceleration * (0.5f * t * t);
+}
+
+double MonotonicSeconds() {
+  return std::chrono::duration<double>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+float Horizon(double received_time, double display_delay
+            , float tracking_latency) {
+  const double horizon = tracking_latency
+                       + (MonotonicSeconds() - received_time)
+                       + display_delay;
+  return static_cast<float>(std::max(0.0, std::min<double>(horizon
+                                                         , kMaxHorizon)));
+}
+
+MotionTracker::MotionTracker()
+  : primed_(false), timestamp_(0) {
+}
+
+void MotionTracker::update(const Leap::Vector &position, int64_t timestamp) {
+  const int64_t step = timestamp - timestamp_;
+  if (primed_ && step == 0) {
+    return;
+  }
+  if (!primed_ || step < 0 || step > kMaxGap) {
+    primed_ = true;
+    timestamp_ = timestamp;
+    motion_ = Still(position);
+    return;
+  }
+  timestamp_ = timestamp;
+  const float dt = step * 1e-6f;
+  const Leap::Vector velocity = motion_.velocity
+      + ((position - motion_.position) / dt - motion_.velocity)
+        * fingertip_filter::SmoothingFactor(kVelocityCutoff, dt);
+  motion_.acceleration += ((velocity - motion_.velocity) / dt
+                           - motion_.acceleration)
+      * fingertip_filter::SmoothingFactor(kAccelerationCutoff, dt);
+  motion_.velocity = velocity;
+  motion_.position = position;
+}
+
+}  // namespace motion_predictor
@@ -27,13 +27,12 @@
 #endif
 #include <OVR_CAPI_GL.h>
 
+#include <math.h>
 #include <stdio.h>
 #include <unistd.h>
-#include <boost/optional.hpp>
 
-#include "headers/field_line.h"
-#include "headers/hand_input_listener.h"
-#include "headers/pen_line.h"
+#include "headers/Quaternion.h"
+#include "headers/hmd_backend.h"
 #include "headers/oculus.h"
 
 namespace oculus_vr {
@@ -49,7 +48,28 @@ void Shutdown() {
   ovr_Shutdown();
 }
 
-OculusHmd::OculusHmd() {
+namespace {
+
+hmd_backend::Pose ToPose(const ovrPosef &ovr_pose, double time
+                       , double sample_time) {
+  hmd_backend::Pose pose;
+  pose.orientation = Quaternion(ovr_pose.Orientation.w
+                              , ovr_pose.Orientation.x
+                              , ovr_pose.Orientation.y
+                              , ovr_pose.Orientation.z);
+  pose.position[0] = ovr_pose.Position.x;
+  pose.position[1] = ovr_pose.Position.y;
+  pose.position[2] = ovr_pose.Position.z;
+  pose.time = time;
+  pose.sample_time = sample_time;
+  return pose;
+}
+
+}  // namespace
+
+OculusHmd::OculusHmd()
+  : sample_time_(0.0), rendering_(false), frameBuffer_(0), vaoHandle_(0)
+  , texture_(0), renderBuffer_(0) {
   InitializeHmd_();
 }
 
@@ -59,18 +79,60 @@ OculusHmd::~OculusHmd() {
   }
 }
 
-boost::optional<ovrPoseStatef> OculusHmd::Track() {
-  ovrPoseStatef pose;
+double OculusHmd::Now() const {
+  return ovr_GetTimeInSeconds();
+}
+
+bool OculusHmd::Track(double display_time, hmd_backend::Pose *pose) {
   if (hmd_) {
-    tracking_state_ = ovrHmd_GetTrackingState(hmd_, ovr_GetTimeInSeconds());
+    sample_time_ = ovr_GetTimeInSeconds();
+    if (rendering_) {
+      // One sample for the head and both eyes, predicted to the
+      // mid-scanout of the frame BeginFrame() started; the same eye
+      // poses go to time warp in EndFrame().
+      ovrVector3f eyeRenderOffset[2];
+      eyeRenderOffset[ovrEye_Left] =
+                        eye_render_desc_[ovrEye_Left].HmdToEyeViewOffset;
+      eyeRenderOffset[ovrEye_Right] =
+                        eye_render_desc_[ovrEye_Right].HmdToEyeViewOffset;
+      ovrHmd_GetEyePoses(hmd_, 0, eyeRenderOffset, eyeRenderPose_
+                        , &tracking_state_);
+    } else {
+      tracking_state_ = ovrHmd_GetTrackingState(hmd_, display_time);
+    }
     if (tracking_state_.StatusFlags & (ovrStatus_OrientationTracked |
                                         ovrStatus_PositionTracked)) {
-      return boost::optional<ovrPoseStatef>(tracking_state_.HeadPose);
+      *pose = ToPose(tracking_state_.HeadPose.ThePose
+                    , tracking_state_.HeadPose.TimeInSeconds
+                    , sample_time_);
+      return true;
     } else {
       printf("Failed to get HMD status\n");
     }
   }
-  return boost::none;
+  return false;
+}
+
+void OculusHmd::GetEyeDescs(
+              hmd_backend::EyeDesc eye_desc[hmd_backend::kEyeCount]) const {
+  for (int eye = 0; eye < ovrEye_Count; eye++) {
+    eye_desc[eye].viewport.x = eyeRenderViewport_[eye].Pos.x;
+    eye_desc[eye].viewport.y = eyeRenderViewport_[eye].Pos.y;
+    eye_desc[eye].viewport.width = eyeRenderViewport_[eye].Size.w;
+    eye_desc[eye].viewport.height = eyeRenderViewport_[eye].Size.h;
+    eye_desc[eye].view_offset[0] = eye_render_desc_[eye].HmdToEyeViewOffset.x;
+    eye_desc[eye].view_offset[1] = eye_render_desc_[eye].HmdToEyeViewOffset.y;
+    eye_desc[eye].view_offset[2] = eye_render_desc_[eye].HmdToEyeViewOffset.z;
+  }
+}
+
+void OculusHmd::GetEyePoses(
+                        hmd_backend::Pose eye_pose[hmd_backend::kEyeCount]) {
+  for (int eye = 0; eye < ovrEye_Count; eye++) {
+    eye_pose[eye] = ToPose(eyeRenderPose_[eye]
+                          , tracking_state_.HeadPose.TimeInSeconds
+                          , sample_time_);
+  }
 }
 
 GLFWmonitor *OculusHmd::Monitor() {
@@ -96,7 +158,7 @@ GLFWmonitor *OculusHmd::Monitor() {
     glfwGetMonitorPos(monitors[i], &xpos, &ypos);
 
     if (hmd_->WindowsPos.x == xpos &&
-        hmd_->WindowsPos.y == ypys &&
+        hmd_->WindowsPos.y == ypos &&
         hmd_->Resolution.w == mode->width &&
         hmd_->Resolution.h == mode->height) {
       return monitors[i];
@@ -106,101 +168,35 @@ GLFWmonitor *OculusHmd::Monitor() {
   return nullptr;
 }
 
-void OculusHmd::FrameInit() {
-  if (hmd_) {
+void OculusHmd::BeginFrame(hmd_backend::FrameTiming *timing) {
+  if (!rendering_) {
+    timing->begin_time = ovr_GetTimeInSeconds();
+    timing->display_time = timing->begin_time;
     return;
   }
   // フレームの開始
   ovrFrameTiming frameTiming = ovrHmd_BeginFrame(hmd_, 0);
+  timing->begin_time = frameTiming.ThisFrameSeconds;
+  timing->display_time = frameTiming.ScanoutMidpointSeconds;
   // FBOのバインド
   glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer_);
 
   return;
 }
 
-void OculusHmd::FrameRender(field_line::FieldLine *bg_line
-                , hand_listener::HandInputListener &listener_for_draw) {  // NOLINT
-  auto Draw = [&bg_line, &listener_for_draw]() -> void {
-    bg_line->draw();
-
-    glPushAttrib(GL_LIGHTING_BIT);
-    GLfloat lmodel_ambient[] = { 1.0, 1.0, 1.0, 1.0 };
-    glLightModelfv(GL_LIGHT_MODEL_AMBIENT, lmodel_ambient);
-    for (pen_line::LineList::iterator line =
-                            listener_for_draw.penline_list.begin()
-        ; line != listener_for_draw.penline_list.end(); line++) {
-      if (line->size() > 3) {
-        glPushMatrix();
-        glLineWidth(3);
-        pen_line::Line::iterator point = line->begin();
-        glColor3f(point->x, point->y, point->z);
-        ++point;
-        glBegin(GL_LINE_STRIP);
-        for (; point != line->end(); point++) {
-          glVertex3f(point->x, point->y, point->z);
-        }
-        glEnd();
-        glPopMatrix();
-      }
-    }
-    glPopAttrib();
-
-    glPushAttrib(GL_LIGHTING_BIT);
-    glLightModelfv(GL_LIGHT_MODEL_AMBIENT, lmodel_ambient);
-    for (std::map<int, pen_line::TracingLine>::iterator tracing_line_map
-          = listener_for_draw.tracing_lines.begin()
-        ; tracing_line_map != listener_for_draw.tracing_lines.end()
-        ; tracing_line_map++) {
-      if ((*tracing_line_map).second.line.size() > 3) {
-        glPushMatrix();
-        glLineWidth(3);
-        pen_line::Line::iterator point =
-                        (*tracing_line_map).second.line.begin();
-        glColor3f(point->x, point->y, point->z);
-        ++point;
-        glBegin(GL_LINE_STRIP);
-        for (; point != (*tracing_line_map).second.line.end(); point++) {
-          glVertex3f(point->x, point->y, point->z);
-        }
-        glEnd();
-        glPopMatrix();
-      }
-    }
-
-    glPopAttrib();
-    return;
-  };
-
-  if (hmd_) {
-    ovrPosef eyeRenderPose[2];
-    ovrVector3f eyeRenderOffset[2];
-    eyeRenderOffset[ovrEye_Left] =
-                      eye_render_desc_[ovrEye_Left].HmdToEyeViewOffset;
-    eyeRenderOffset[ovrEye_Right] =
-                      eye_render_desc_[ovrEye_Right].HmdToEyeViewOffset;
-    ovrHmd_GetEyePoses(hmd_, 0, eyeRenderOffset, eyeRenderPose, NULL);
-    for (int eyeIndex = 0; eyeIndex < ovrEye_Count; eyeIndex++) {
-      ovrEyeType eye = hmd_->EyeRenderOrder[eyeIndex];
-
-      // ビューポートの設定
-      glViewport(eyeRenderViewport_[eye].Pos.x
-              , eyeRenderViewport_[eye].Pos.y
-              , eyeRenderViewport_[eye].Size.w
-              , eyeRenderViewport_[eye].Size.h);
-      Draw();
-    }
-  } else {
-    Draw();
-  }
-  return;
-}
-
-void OculusHmd::FrameEnd() {
+void OculusHmd::EndFrame() {
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  if (rendering_) {
+    // Distortion, time warp and the buffer swap happen in here.
+    ovrHmd_EndFrame(hmd_, eyeRenderPose_, &eyeTexture_[0].Texture);
+  }
   return;
 }
 
-void OculusHmd::SetupOvrConfig() {
+void OculusHmd::SetupRendering() {
+  if (!hmd_) {
+    return;
+  }
   union ovrGLConfig config;
   config.OGL.Header.API = ovrRenderAPI_OpenGL;
   config.OGL.Header.BackBufferSize = hmd_->Resolution;
@@ -227,6 +223,10 @@ void OculusHmd::SetupOvrConfig() {
   ovrHmd_SetEnabledCaps(hmd_, ovrHmdCap_LowPersistence |
                               ovrHmdCap_DynamicPrediction |
                               ovrHmdCap_ExtendDesktop);
+  rendering_ = result;
+  if (!rendering_) {
+    printf("Cannot configure HMD rendering.\n");
+  }
   return;
 }
 
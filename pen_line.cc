@@ -1,5 +1,176 @@
+#include <string.h>
+
+#include <algorithm>
+
 #include "headers/pen_line.h"
 
 namespace pen_line {
 
+const unsigned int StrokeStore::kChunkPoints;
+const unsigned int StrokeStore::kMinReserve;
+
+StrokeStore::StrokeStore() {
+}
+
+unsigned int StrokeStore::begin_stroke(const Color &color) {
+  Header header;
+  header.color = color;
+  header.count = 0;
+  header.capacity = kMinReserve;
+  header.revision = 0;
+  allocate_(header.capacity, &header.chunk, &header.offset);
+  headers_.push_back(header);
+  return headers_.size() - 1;
+}
+
+void StrokeStore::append(unsigned int id, const Leap::Vector &point) {
+  Header &header = headers_[id];
+  if (header.count == header.capacity) {
+    grow_(&header);
+  }
+  chunks_[header.chunk].storage[header.offset + header.count] = point;
+  ++header.count;
+}
+
+void StrokeStore::rewrite(unsigned int id, const Leap::Vector *points
+                        , unsigned int count) {
+  Header &header = headers_[id];
+  replace_(&header, points, count);
+  ++header.revision;
+}
+
+void StrokeStore::thin(unsigned int id, const Leap::Vector *points
+                     , unsigned int count) {
+  replace_(&headers_[id], points, count);
+}
+
+void StrokeStore::finish(unsigned int id) {
+  Header &header = headers_[id];
+  Chunk &chunk = chunks_[header.chunk];
+  // Give the unused tail of the reservation back if nobody allocated
+  // behind us.
+  if (header.offset + header.capacity == chunk.size) {
+    chunk.size = header.offset + header.count;
+  }
+  header.capacity = header.count;
+  completed_.push_back(id);
+}
+
+void StrokeStore::discard(unsigned int id) {
+  // The points are not reclaimed: the render thread may still be drawing
+  // a snapshot that shows this stroke.
+  Header &header = headers_[id];
+  header.count = 0;
+  header.capacity = 0;
+}
+
+unsigned int StrokeStore::add_external_chunk(const Leap::Vector *points
+                                          , unsigned int count
+                                          , std::shared_ptr<const void> owner) {
+  Chunk chunk;
+  chunk.owner = owner;
+  chunk.points = points;
+  chunk.size = count;
+  chunk.capacity = count;
+  chunks_.push_back(std::move(chunk));
+  return chunks_.size() - 1;
 }
+
+unsigned int StrokeStore::add_finished(unsigned int chunk
+                                     , unsigned int offset
+                                     , unsigned int count
+                                     , const Color &color) {
+  Header header;
+  header.chunk = chunk;
+  header.offset = offset;
+  header.count = count;
+  header.capacity = count;
+  header.revision = 0;
+  header.color = color;
+  headers_.push_back(header);
+  completed_.push_back(headers_.size() - 1);
+  return headers_.size() - 1;
+}
+
+StrokeView StrokeStore::view(unsigned int id) const {
+  const Header &header = headers_[id];
+  StrokeView view;
+  view.id = id;
+  view.color = header.color;
+  view.points = chunks_[header.chunk].points + header.offset;
+  view.count = header.count;
+  view.revision = header.revision;
+  return view;
+}
+
+size_t StrokeStore::point_count() const {
+  size_t count = 0;
+  for (std::vector<Header>::const_iterator header = headers_.begin()
+      ; header != headers_.end(); header++) {
+    count += header->count;
+  }
+  return count;
+}
+
+size_t StrokeStore::reserved_bytes() const {
+  size_t bytes = headers_.capacity() * sizeof(Header)
+                + completed_.capacity() * sizeof(unsigned int);
+  for (std::vector<Chunk>::const_iterator chunk = chunks_.begin()
+      ; chunk != chunks_.end(); chunk++) {
+    if (chunk->storage) {
+      bytes += chunk->capacity * sizeof(Leap::Vector);
+    }
+  }
+  return bytes;
+}
+
+void StrokeStore::grow_(Header *header) {
+  Chunk &chunk = chunks_[header->chunk];
+  unsigned int extra = std::max(header->capacity, kMinReserve);
+
+  // Still the last reservation in its chunk: just push the end out.
+  if (header->offset + header->capacity == chunk.size
+      && chunk.size + extra <= chunk.capacity) {
+    chunk.size += extra;
+    header->capacity += extra;
+    return;
+  }
+
+  unsigned int new_chunk;
+  unsigned int new_offset;
+  allocate_(header->capacity + extra, &new_chunk, &new_offset);
+  memcpy(chunks_[new_chunk].storage.get() + new_offset
+        , chunks_[header->chunk].points + header->offset
+        , header->count * sizeof(Leap::Vector));
+  header->chunk = new_chunk;
+  header->offset = new_offset;
+  header->capacity += extra;
+}
+
+void StrokeStore::replace_(Header *header, const Leap::Vector *points
+                         , unsigned int count) {
+  header->capacity = std::max(count, kMinReserve);
+  allocate_(header->capacity, &header->chunk, &header->offset);
+  memcpy(chunks_[header->chunk].storage.get() + header->offset, points
+        , count * sizeof(Leap::Vector));
+  header->count = count;
+}
+
+void StrokeStore::allocate_(unsigned int count
+                          , unsigned int *chunk
+                          , unsigned int *offset) {
+  if (chunks_.empty()
+      || chunks_.back().size + count > chunks_.back().capacity) {
+    Chunk new_chunk;
+    new_chunk.capacity = std::max(count, kChunkPoints);
+    new_chunk.storage.reset(new Leap::Vector[new_chunk.capacity]);
+    new_chunk.points = new_chunk.storage.get();
+    new_chunk.size = 0;
+    chunks_.push_back(std::move(new_chunk));
+  }
+  *chunk = chunks_.size() - 1;
+  *offset = chunks_.back().size;
+  chunks_.back().size += count;
+}
+
+}  // namespace pen_line
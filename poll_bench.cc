@@ -0,0 +1,220 @@
+// Copyright 2015 Makoto Yano
+//
+// Compares the two ways the render loop can get hands, on the same
+// frames and the same display refreshes:
+//   listener  each frame shows the newest Leap frame that reached the
+//             listener by the time the frame began, as onFrame feeds it
+//   poll      each frame polls the frame history --lead-ms before its
+//             display time and samples it --sample-delay-ms behind,
+//             interpolating between the frames around that time
+// Reports for each, over the fingertip shown on every refresh:
+//   age       from the Leap capturing what is shown to it reaching the
+//             display, mean, spread and 99th percentile
+//   judder    RMS of the change in the tip's step from one refresh to
+//             the next, which a tip moving smoothly keeps near 0
+// The history is fed exactly as main.cc feeds it.  Fails when polling
+// does not show the hands both more evenly aged and with less judder.
+//
+//   poll_bench [--replay FILE] [--strokes N] [--noise MM]
+//              [--refresh-hz HZ] [--lead-ms MS] [--sample-delay-ms MS]
+//
+// Frames reach the listener motion_predictor::kDefaultTrackingLatency
+// after their timestamp plus up to two milliseconds of jitter.  Without
+// --replay they are made up at about 110 Hz with uneven spacing: a hand
+// sweeps figure eights, with Gaussian noise of --noise mm on every axis
+// of the tip.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "headers/bench_frames.h"
+#include "headers/bench_util.h"
+#include "headers/frame_history.h"
+#include "headers/frame_record.h"
+#include "headers/motion_predictor.h"
+
+namespace {
+
+const int64_t kDeliveryJitterMicros = 2000;
+
+// What one refresh shows.
+struct Shown {
+  bool valid;
+  int32_t finger_id;
+  Leap::Vector tip;
+  // Microseconds from the capture of what is shown to the display.
+  int64_t age;
+};
+
+struct Result {
+  std::vector<double> ages;
+  std::vector<double> judder;
+  unsigned long held;  // NOLINT
+};
+
+Shown Show(const frame_record::FrameRecord &frame, int64_t display_time) {
+  Shown shown;
+  shown.valid = frame.hand_count > 0 && frame.hands[0].fingers[1].valid;
+  shown.finger_id = frame.hands[0].fingers[1].id;
+  const float *tip = frame.hands[0].fingers[1].tip_position;
+  shown.tip = Leap::Vector(tip[0], tip[1], tip[2]);
+  shown.age = display_time - frame.timestamp;
+  return shown;
+}
+
+// Adds one refresh, with the two before it for the judder.
+void Score(const Shown &shown, Shown history[2], Result *result) {
+  if (!shown.valid) {
+    history[0].valid = false;
+    history[1].valid = false;
+    return;
+  }
+  result->ages.push_back(shown.age / 1000.0);
+  if (history[0].valid && history[1].valid
+      && history[0].finger_id == shown.finger_id
+      && history[1].finger_id == shown.finger_id) {
+    const Leap::Vector change = shown.tip - history[0].tip * 2.0f
+                              + history[1].tip;
+    result->judder.push_back(change.magnitude());
+  }
+  history[1] = history[0];
+  history[0] = shown;
+}
+
+void Report(const char *name, const Result &result) {
+  printf("%-8s age mean %5.1f  sd %4.2f  p99 %5.1f ms"
+         "  judder rms %5.3f mm  held %lu\n"
+        , name, bench_util::Mean(result.ages)
+        , bench_util::StandardDeviation(result.ages)
+        , bench_util::Percentile(result.ages, 0.99)
+        , bench_util::Rms(result.judder), result.held);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const char *replay_path = NULL;
+  bench_frames::Script script = bench_frames::DefaultScript();
+  double refresh_hz = 90.0;
+  double lead = frame_history::kDefaultPollLead;
+  double sample_delay = frame_history::kDefaultSampleDelay;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      replay_path = argv[++i];
+    } else if (strcmp(argv[i], "--strokes") == 0 && i + 1 < argc) {
+      script.strokes = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--noise") == 0 && i + 1 < argc) {
+      script.noise = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--refresh-hz") == 0 && i + 1 < argc) {
+      refresh_hz = std::max(1.0, atof(argv[++i]));
+    } else if (strcmp(argv[i], "--lead-ms") == 0 && i + 1 < argc) {
+      lead = atof(argv[++i]) / 1000.0;
+    } else if (strcmp(argv[i], "--sample-delay-ms") == 0 && i + 1 < argc) {
+      sample_delay = atof(argv[++i]) / 1000.0;
+    } else {
+      printf("Unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  std::vector<frame_record::FrameRecord> frames;
+  if (replay_path) {
+    frame_record::FrameReplay replay;
+    if (!replay.Open(replay_path)) {
+      return 2;
+    }
+    frames.resize(replay.frame_count());
+    for (size_t i = 0; i < frames.size(); i++) {
+      replay.Read(i, &frames[i]);
+    }
+  } else {
+    bench_frames::MakeFrames(script, &frames);
+  }
+  if (frames.size() < 2) {
+    printf("not enough frames\n");
+    return 2;
+  }
+
+  // When each frame reaches the listener, or a poll.
+  std::minstd_rand random(2);
+  std::uniform_int_distribution<int> jitter(0, kDeliveryJitterMicros);
+  const int64_t latency = static_cast<int64_t>(
+                      motion_predictor::kDefaultTrackingLatency * 1e6);
+  std::vector<int64_t> delivered(frames.size());
+  for (size_t i = 0; i < frames.size(); i++) {
+    delivered[i] = frames[i].timestamp + latency + jitter(random);
+    if (i > 0) {
+      delivered[i] = std::max(delivered[i], delivered[i - 1]);
+    }
+  }
+
+  const int64_t period = static_cast<int64_t>(1e6 / refresh_hz);
+  const int64_t lead_micros = static_cast<int64_t>(lead * 1e6);
+  const int64_t delay_micros = static_cast<int64_t>(sample_delay * 1e6);
+  Result listener_result;
+  Result poll_result;
+  listener_result.held = 0;
+  poll_result.held = 0;
+  Shown listener_history[2] = {};
+  Shown poll_history[2] = {};
+  frame_history::FrameHistory history;
+  size_t listened = 0;
+  size_t polled = 0;
+  frame_record::FrameRecord sample;
+  for (int64_t display = delivered[0] + 2 * period
+      ; display < delivered.back(); display += period) {
+    // The listener's newest frame as the frame began.
+    const int64_t begin = display - period;
+    while (listened < frames.size() && delivered[listened] <= begin) {
+      ++listened;
+    }
+    if (listened > 0) {
+      Score(Show(frames[listened - 1], display), listener_history
+          , &listener_result);
+    }
+
+    // What poll_input() in main.cc does.
+    const int64_t poll_time = display - lead_micros;
+    while (polled < frames.size() && delivered[polled] <= poll_time) {
+      history.Add(frames[polled++]);
+    }
+    const int64_t sample_time = poll_time - delay_micros;
+    if (!history.Sample(sample_time, &sample)) {
+      continue;
+    }
+    if (sample.timestamp < sample_time) {
+      ++poll_result.held;
+    }
+    Score(Show(sample, display), poll_history, &poll_result);
+  }
+
+  printf("%lu frames, %s, %.0f Hz display, poll %.1f ms before display"
+         ", sample %.1f ms behind\n"
+        , static_cast<unsigned long>(frames.size())  // NOLINT
+        , replay_path ? "replayed" : "made up", refresh_hz
+        , lead * 1000.0, sample_delay * 1000.0);
+  Report("listener", listener_result);
+  Report("poll", poll_result);
+
+  if (listener_result.judder.empty() || poll_result.judder.empty()) {
+    printf("no fingertip was shown\n");
+    return 1;
+  }
+  bool ok = true;
+  if (!(bench_util::StandardDeviation(poll_result.ages)
+        < bench_util::StandardDeviation(listener_result.ages))) {
+    printf("polled hands are not more evenly aged\n");
+    ok = false;
+  }
+  if (!(bench_util::Rms(poll_result.judder)
+        < bench_util::Rms(listener_result.judder))) {
+    printf("polled hands judder no less\n");
+    ok = false;
+  }
+  return ok ? 0 : 1;
+}
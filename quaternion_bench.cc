@@ -0,0 +1,165 @@
+// Copyright 2015 Makoto Yano
+//
+// Compares the inline SIMD quaternion code with the scalar out of line
+// version it replaced, on what the app does with it: products, moving
+// fingertips into world space and re-projecting stored strokes.
+//
+//   quaternion_bench [--points N]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "headers/Quaternion.h"
+#include "headers/bench_util.h"
+
+namespace {
+
+// The previous operator * and conj, which lived in Quaternion.cc and so
+// were never inlined into their callers.
+BENCH_NOINLINE Quaternion ScalarMultiply(const Quaternion &a
+                                       , const Quaternion &b) {
+  Quaternion r(0, 0, 0, 0);
+  r[0] = a[0] * b[0] - a[1] * b[1] - a[2] * b[2] - a[3] * b[3];
+  r[1] = a[0] * b[1] + a[1] * b[0] + a[2] * b[3] - a[3] * b[2];
+  r[2] = a[0] * b[2] - a[1] * b[3] + a[2] * b[0] + a[3] * b[1];
+  r[3] = a[0] * b[3] + a[1] * b[2] - a[2] * b[1] + a[3] * b[0];
+  return r;
+}
+
+BENCH_NOINLINE Quaternion ScalarConj(const Quaternion &a) {
+  return Quaternion(a[0], -a[1], -a[2], -a[3]);
+}
+
+// What convert_to_world_position_ did for every point.
+void ScalarConvert(const Quaternion &x, const Quaternion &y
+                 , const float offset[3], const float in[3], float out[3]) {
+  Quaternion q(0.0f, in[0] + offset[0], in[1] + offset[1], in[2] + offset[2]);
+  q = ScalarMultiply(ScalarMultiply(ScalarConj(x), q), x);
+  q = ScalarMultiply(ScalarMultiply(ScalarConj(y), q), y);
+  out[0] = q[1];
+  out[1] = q[2];
+  out[2] = q[3];
+}
+
+Quaternion AxisAngle(float angle, float x, float y, float z) {
+  float s = sin(angle / 2);
+  return Quaternion(cos(angle / 2), x * s, y * s, z * s);
+}
+
+void Report(const char *name, double old_seconds, double new_seconds
+          , size_t count, const char *unit) {
+  printf("%-28s scalar %8.2f ns/%s   simd %8.2f ns/%s   x%.1f\n"
+        , name
+        , old_seconds * 1e9 / count, unit
+        , new_seconds * 1e9 / count, unit
+        , old_seconds / new_seconds);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  size_t points = 1000000;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--points") == 0 && i + 1 < argc) {
+      points = atol(argv[++i]);
+    }
+  }
+#if defined(QUATERNION_SSE)
+  printf("Quaternion uses SSE\n");
+#elif defined(QUATERNION_NEON)
+  printf("Quaternion uses NEON\n");
+#else
+  printf("Quaternion has no SIMD path on this target\n");
+#endif
+
+  // Products, chained so the compiler can't drop them.
+  const size_t products = 10000000;
+  const Quaternion step = AxisAngle(0.001f, 0.0f, 1.0f, 0.0f);
+  Quaternion old_q;
+  Quaternion new_q;
+  std::chrono::steady_clock::time_point start =
+                                    std::chrono::steady_clock::now();
+  for (size_t i = 0; i < products; i++) {
+    old_q = ScalarMultiply(old_q, step);
+  }
+  double old_seconds = bench_util::Seconds(start);
+  start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < products; i++) {
+    new_q = new_q * step;
+  }
+  double new_seconds = bench_util::Seconds(start);
+  Report("quaternion product", old_seconds, new_seconds, products, "op");
+
+  // Fingertips into world space, one point at a time.
+  const Quaternion world_x = AxisAngle(0.3f, 1.0f, 0.0f, 0.0f);
+  const Quaternion world_y = AxisAngle(-0.8f, 0.0f, 1.0f, 0.0f);
+  const float offset[3] = { 10.0f, -300.0f, 150.0f };
+  std::vector<float> in(points * 3);
+  std::vector<float> old_out(points * 3);
+  std::vector<float> new_out(points * 3);
+  for (size_t i = 0; i < in.size(); i++) {
+    in[i] = static_cast<float>((i * 7919) % 1000) - 500.0f;
+  }
+
+  start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < points; i++) {
+    ScalarConvert(world_x, world_y, offset, &in[i * 3], &old_out[i * 3]);
+  }
+  old_seconds = bench_util::Seconds(start);
+  start = std::chrono::steady_clock::now();
+  const PointTransform transform =
+            MakePointTransform(conj(world_x * world_y), offset);
+  for (size_t i = 0; i < points; i++) {
+    TransformPoint(transform, &in[i * 3], &new_out[i * 3]);
+  }
+  new_seconds = bench_util::Seconds(start);
+  Report("single point to world", old_seconds, new_seconds, points, "pt");
+
+  // Re-projecting every stored stroke point after the world turned.
+  start = std::chrono::steady_clock::now();
+  TransformPoints(MakePointTransform(conj(world_x * world_y), offset)
+                , &in[0], &new_out[0], points);
+  new_seconds = bench_util::Seconds(start);
+  Report("batch stroke re-projection", old_seconds, new_seconds, points, "pt");
+
+  float max_error = 0.0f;
+  for (size_t i = 0; i < in.size(); i++) {
+    max_error = std::max(max_error, fabsf(old_out[i] - new_out[i]));
+  }
+
+  // Matrices for the view: three quaternions, or the world pair composed
+  // first.
+  const size_t views = 1000000;
+  float matrix[16];
+  float sum = 0.0f;
+  start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < views; i++) {
+    ToMatrix(step, matrix);
+    sum += matrix[1];
+    ToMatrix(world_x, matrix);
+    sum += matrix[1];
+    ToMatrix(world_y, matrix);
+    sum += matrix[1];
+  }
+  old_seconds = bench_util::Seconds(start);
+  start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < views; i++) {
+    ToMatrix(step, matrix);
+    sum += matrix[1];
+    ToMatrix(world_x * world_y, matrix);
+    sum += matrix[1];
+  }
+  new_seconds = bench_util::Seconds(start);
+  Report("view matrices", old_seconds, new_seconds, views, "view");
+
+  printf("%lu points, max difference %g, checksum %g %g\n"
+        , static_cast<unsigned long>(points), max_error  // NOLINT
+        , old_q[0] + new_q[0], sum);
+  return 0;
+}
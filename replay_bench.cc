@@ -0,0 +1,171 @@
+// Copyright 2015 Makoto Yano
+//
+// Replays a recording through the hand processor twice, as fast as the
+// processor goes, and compares the strokes the two runs leave point for
+// point.  Reports the frames per second replayed and the strokes and
+// points drawn.
+// Fails when the two runs differ in any stroke, color or point, or, with
+// made up frames, when the replays differ from feeding the frames to the
+// processor directly.
+//
+//   replay_bench [--replay FILE] [--strokes N]
+//
+// Without --replay the frames are made up at about 110 Hz: the hand shows
+// up, holds the finger still, draws a circle with a shaky tip and leaves.
+// They are recorded to a temporary file first, the way --record writes
+// them.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "headers/bench_frames.h"
+#include "headers/bench_util.h"
+#include "headers/frame_record.h"
+#include "headers/hand_input_processor.h"
+
+namespace {
+
+// True when both stores hold the same completed strokes, in the same
+// order, with the same colors and bit for bit the same points.
+bool SameStrokes(const pen_line::StrokeStore &a, const char *a_name
+               , const pen_line::StrokeStore &b, const char *b_name) {
+  if (a.completed().size() != b.completed().size()) {
+    printf("%s has %lu strokes, %s %lu\n"
+          , a_name, static_cast<unsigned long>(a.completed().size())  // NOLINT
+          , b_name, static_cast<unsigned long>(b.completed().size()));  // NOLINT
+    return false;
+  }
+  for (size_t i = 0; i < a.completed().size(); i++) {
+    const pen_line::StrokeView x = a.view(a.completed()[i]);
+    const pen_line::StrokeView y = b.view(b.completed()[i]);
+    if (x.count != y.count) {
+      printf("stroke %lu has %u points in %s, %u in %s\n"
+            , static_cast<unsigned long>(i), x.count, a_name  // NOLINT
+            , y.count, b_name);
+      return false;
+    }
+    if (memcmp(&x.color, &y.color, sizeof(x.color)) != 0) {
+      printf("stroke %lu has a different color in %s and %s\n"
+            , static_cast<unsigned long>(i), a_name, b_name);  // NOLINT
+      return false;
+    }
+    for (unsigned int j = 0; j < x.count; j++) {
+      if (memcmp(&x.points[j], &y.points[j], sizeof(x.points[j])) != 0) {
+        printf("stroke %lu point %u is (%f, %f, %f) in %s"
+               ", (%f, %f, %f) in %s\n"
+              , static_cast<unsigned long>(i), j  // NOLINT
+              , x.points[j].x, x.points[j].y, x.points[j].z, a_name
+              , y.points[j].x, y.points[j].y, y.points[j].z, b_name);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const char *replay_path = NULL;
+  int stroke_count = 20;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      replay_path = argv[++i];
+    } else if (strcmp(argv[i], "--strokes") == 0 && i + 1 < argc) {
+      stroke_count = std::max(1, atoi(argv[++i]));
+    } else {
+      printf("Unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  bool ok = true;
+  std::vector<frame_record::FrameRecord> frames;
+  char temporary_path[] = "/tmp/replay_bench_XXXXXX";
+  if (!replay_path) {
+    bench_frames::Script script = bench_frames::DefaultScript();
+    script.strokes = stroke_count;
+    script.absent_frames = 30;
+    script.present_frames = 260;
+    script.path = bench_frames::kHeldCircle;
+    script.noise = 0.5f;
+    bench_frames::MakeFrames(script, &frames);
+    const int fd = mkstemp(temporary_path);
+    if (fd < 0) {
+      printf("Cannot make a temporary recording.\n");
+      return 2;
+    }
+    close(fd);
+    frame_record::FrameRecorder recorder;
+    if (!recorder.Open(temporary_path)) {
+      return 2;
+    }
+    for (size_t i = 0; i < frames.size(); i++) {
+      recorder.Write(frames[i]);
+    }
+    recorder.Close();
+    replay_path = temporary_path;
+  }
+
+  frame_record::FrameReplay replay;
+  const bool opened = replay.Open(replay_path);
+  if (replay_path == temporary_path) {
+    // Mapped already, the file can go.
+    unlink(temporary_path);
+  }
+  if (!opened) {
+    return 2;
+  }
+  if (replay.frame_count() == 0) {
+    printf("%s has no frames.\n", replay_path);
+    return 2;
+  }
+
+  hand_listener::HandInputProcessor runs[2];
+  for (int run = 0; run < 2; run++) {
+    hand_listener::HandInputProcessor &processor = runs[run];
+    std::chrono::steady_clock::time_point start =
+                                      std::chrono::steady_clock::now();
+    replay.Play([&processor](const frame_record::FrameRecord &record) {
+      processor.process_frame(record);
+      return true;
+    }, false);
+    const double seconds = bench_util::Seconds(start);
+    printf("replay %d  %lu frames  %8.0f frames/s  strokes %lu"
+           "  points %lu\n", run + 1
+          , static_cast<unsigned long>(replay.frame_count())  // NOLINT
+          , replay.frame_count() / seconds
+          , static_cast<unsigned long>(  // NOLINT
+                                  processor.strokes.completed().size())
+          , static_cast<unsigned long>(  // NOLINT
+                                  processor.strokes.point_count()));
+  }
+  if (!SameStrokes(runs[0].strokes, "replay 1", runs[1].strokes
+                 , "replay 2")) {
+    ok = false;
+  }
+
+  if (!frames.empty()) {
+    hand_listener::HandInputProcessor direct;
+    for (size_t i = 0; i < frames.size(); i++) {
+      direct.process_frame(frames[i]);
+    }
+    if (!SameStrokes(direct.strokes, "the frames fed directly"
+                   , runs[0].strokes, "replay 1")) {
+      ok = false;
+    }
+  }
+  if (runs[0].strokes.completed().empty()) {
+    printf("the replay drew no strokes to compare\n");
+  }
+  if (ok) {
+    printf("both replays drew the same strokes point for point\n");
+  }
+  return ok ? 0 : 1;
+}
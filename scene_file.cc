@@ -0,0 +1,177 @@
+// Copyright 2015 Makoto Yano
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+
+#include "headers/scene_file.h"
+
+namespace scene_file {
+
+namespace {
+
+const char kMagic[4] = { 'O', 'W', 'L', 'S' };
+const size_t kPointAlignment = 16;
+
+}  // namespace
+
+bool Save(const char *path, const std::vector<pen_line::StrokeView> &strokes) {
+  FileHeader header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kFileVersion;
+  header.point_size = sizeof(Leap::Vector);
+  header.stroke_count = strokes.size();
+  header.point_count = 0;
+
+  std::vector<StrokeEntry> entries(strokes.size());
+  for (size_t i = 0; i < strokes.size(); i++) {
+    entries[i].first_point = header.point_count;
+    entries[i].point_count = strokes[i].count;
+    entries[i].color[0] = strokes[i].color.r;
+    entries[i].color[1] = strokes[i].color.g;
+    entries[i].color[2] = strokes[i].color.b;
+    header.point_count += strokes[i].count;
+  }
+  size_t table_end = sizeof(header) + entries.size() * sizeof(StrokeEntry);
+  header.points_offset = (table_end + kPointAlignment - 1)
+                         / kPointAlignment * kPointAlignment;
+
+  std::string temporary_path = std::string(path) + ".tmp";
+  FILE *file = fopen(temporary_path.c_str(), "wb");
+  if (!file) {
+    printf("Cannot open %s for saving.\n", temporary_path.c_str());
+    return false;
+  }
+  static const char kPadding[kPointAlignment] = { 0 };
+  bool written = fwrite(&header, sizeof(header), 1, file) == 1
+              && (entries.empty()
+                  || fwrite(&entries[0], sizeof(StrokeEntry), entries.size()
+                          , file) == entries.size())
+              && fwrite(kPadding, 1, header.points_offset - table_end, file)
+                   == header.points_offset - table_end;
+  for (size_t i = 0; written && i < strokes.size(); i++) {
+    written = fwrite(strokes[i].points, sizeof(Leap::Vector)
+                   , strokes[i].count, file) == strokes[i].count;
+  }
+  // The data has to be on disk before the rename makes it the scene.
+  written = written && fflush(file) == 0 && fsync(fileno(file)) == 0;
+  if (fclose(file) != 0 || !written) {
+    printf("Cannot write %s.\n", temporary_path.c_str());
+    unlink(temporary_path.c_str());
+    return false;
+  }
+  if (rename(temporary_path.c_str(), path) != 0) {
+    printf("Cannot replace %s.\n", path);
+    unlink(temporary_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+SceneFile::SceneFile()
+  : data_(NULL), size_(0), strokes_(NULL), stroke_count_(0)
+  , points_(NULL), point_count_(0) {
+}
+
+SceneFile::~SceneFile() {
+  Close();
+}
+
+bool SceneFile::Open(const char *path) {
+  Close();
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    printf("Cannot open scene %s.\n", path);
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0
+      || static_cast<size_t>(file_stat.st_size) < sizeof(FileHeader)) {
+    printf("Scene %s is too short.\n", path);
+    close(fd);
+    return false;
+  }
+  size_ = file_stat.st_size;
+  void *mapped = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    printf("Cannot map scene %s.\n", path);
+    size_ = 0;
+    return false;
+  }
+  data_ = static_cast<const unsigned char *>(mapped);
+
+  FileHeader header;
+  memcpy(&header, data_, sizeof(header));
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0
+      || header.version != kFileVersion
+      || header.point_size != sizeof(Leap::Vector)) {
+    printf("%s is not a scene this build can read.\n", path);
+    Close();
+    return false;
+  }
+  size_t table_end = sizeof(header)
+                   + header.stroke_count * sizeof(StrokeEntry);
+  if (table_end > size_
+      || header.points_offset % kPointAlignment != 0
+      || header.points_offset < table_end
+      || header.points_offset > size_
+      || header.point_count > (size_ - header.points_offset)
+                              / sizeof(Leap::Vector)
+      || header.point_count > UINT_MAX) {
+    printf("Scene %s is truncated.\n", path);
+    Close();
+    return false;
+  }
+  strokes_ = reinterpret_cast<const StrokeEntry *>(data_ + sizeof(header));
+  stroke_count_ = header.stroke_count;
+  points_ = reinterpret_cast<const Leap::Vector *>(
+                                          data_ + header.points_offset);
+  point_count_ = header.point_count;
+  for (size_t i = 0; i < stroke_count_; i++) {
+    if (strokes_[i].first_point > point_count_
+        || strokes_[i].point_count > point_count_ - strokes_[i].first_point) {
+      printf("Scene %s has a stroke outside its points.\n", path);
+      Close();
+      return false;
+    }
+  }
+  return true;
+}
+
+void SceneFile::Close() {
+  if (data_) {
+    munmap(const_cast<unsigned char *>(data_), size_);
+    data_ = NULL;
+  }
+  size_ = 0;
+  strokes_ = NULL;
+  stroke_count_ = 0;
+  points_ = NULL;
+  point_count_ = 0;
+}
+
+bool Load(const char *path, pen_line::StrokeStore *store) {
+  std::shared_ptr<SceneFile> file(new SceneFile());
+  if (!file->Open(path)) {
+    return false;
+  }
+  unsigned int chunk = store->add_external_chunk(file->points()
+                                               , file->point_count(), file);
+  for (size_t i = 0; i < file->stroke_count(); i++) {
+    const StrokeEntry &entry = file->stroke(i);
+    pen_line::Color color = { entry.color[0], entry.color[1]
+                            , entry.color[2] };
+    store->add_finished(chunk, entry.first_point, entry.point_count, color);
+  }
+  return true;
+}
+
+}  // namespace scene_file
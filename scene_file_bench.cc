@@ -0,0 +1,119 @@
+// Copyright 2015 Makoto Yano
+//
+// Saves a generated drawing, loads it back into a fresh StrokeStore and
+// checks that every stroke came back the same.  Reports the save time,
+// the load time and the time of the first pass over the loaded points,
+// which is when the mapped pages are actually read.
+//
+//   scene_file_bench [--points N] [--path FILE]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "headers/bench_strokes.h"
+#include "headers/bench_util.h"
+#include "headers/pen_line.h"
+#include "headers/scene_file.h"
+
+namespace {
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  size_t points = 1000000;
+  const char *path = "scene_file_bench.owls";
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--points") == 0 && i + 1 < argc) {
+      points = atol(argv[++i]);
+    } else if (strcmp(argv[i], "--path") == 0 && i + 1 < argc) {
+      path = argv[++i];
+    } else {
+      printf("Unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  // Loops of 50 to 300 points, like simplified traced strokes.
+  pen_line::StrokeStore store;
+  std::minstd_rand random(1);
+  std::uniform_real_distribution<float> position(-2000.0f, 2000.0f);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  std::uniform_int_distribution<int> length(50, 300);
+  size_t generated = 0;
+  while (generated < points) {
+    pen_line::Color color = { unit(random), unit(random), unit(random) };
+    Leap::Vector center(position(random), position(random), position(random));
+    unsigned int count = std::min<size_t>(length(random), points - generated);
+    unsigned int id = store.begin_stroke(color);
+    for (unsigned int j = 0; j < count; j++) {
+      float angle = 2.0f * M_PI * j / count;
+      store.append(id, center + Leap::Vector(100.0f * cos(angle)
+                                           , 100.0f * sin(angle)
+                                           , 10.0f * unit(random)));
+    }
+    store.finish(id);
+    generated += count;
+  }
+  std::vector<pen_line::StrokeView> saved = bench_strokes::Completed(store);
+
+  std::chrono::steady_clock::time_point start =
+                                    std::chrono::steady_clock::now();
+  if (!scene_file::Save(path, saved)) {
+    return 2;
+  }
+  double save_ms = bench_util::Seconds(start) * 1e3;
+
+  pen_line::StrokeStore loaded_store;
+  start = std::chrono::steady_clock::now();
+  if (!scene_file::Load(path, &loaded_store)) {
+    return 2;
+  }
+  double load_ms = bench_util::Seconds(start) * 1e3;
+  std::vector<pen_line::StrokeView> loaded =
+                                    bench_strokes::Completed(loaded_store);
+
+  // What the renderer's first upload does to the points.
+  start = std::chrono::steady_clock::now();
+  float sum = 0.0f;
+  for (size_t i = 0; i < loaded.size(); i++) {
+    for (unsigned int j = 0; j < loaded[i].count; j++) {
+      sum += loaded[i].points[j].x;
+    }
+  }
+  double touch_ms = bench_util::Seconds(start) * 1e3;
+
+  int result = 0;
+  if (loaded.size() != saved.size()) {
+    printf("saved %lu strokes, loaded %lu\n"
+          , static_cast<unsigned long>(saved.size())  // NOLINT
+          , static_cast<unsigned long>(loaded.size()));  // NOLINT
+    result = 1;
+  }
+  for (size_t i = 0; result == 0 && i < saved.size(); i++) {
+    if (loaded[i].count != saved[i].count
+        || memcmp(&loaded[i].color, &saved[i].color, sizeof(saved[i].color))
+        || memcmp(loaded[i].points, saved[i].points
+                , saved[i].count * sizeof(Leap::Vector))) {
+      printf("stroke %lu differs after loading\n"
+            , static_cast<unsigned long>(i));  // NOLINT
+      result = 1;
+    }
+  }
+
+  printf("%lu strokes, %lu points, %s\n"
+        , static_cast<unsigned long>(saved.size())  // NOLINT
+        , static_cast<unsigned long>(points)  // NOLINT
+        , result == 0 ? "round trip ok" : "round trip FAILED");
+  printf("save %.2f ms, load %.2f ms, first pass over points %.2f ms"
+         " (checksum %g)\n"
+        , save_ms, load_ms, touch_ms, sum);
+  unlink(path);
+  return result;
+}
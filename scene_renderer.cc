@@ -0,0 +1,288 @@
+// Copyright 2015 Makoto Yano
+
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#elif __linux__
+#include <GL/gl.h>
+#endif
+
+#include <math.h>
+#include <stdio.h>
+
+#include "headers/frame_trace.h"
+#include "headers/scene_renderer.h"
+
+namespace scene_renderer {
+
+namespace {
+
+// out = a * b, all column major.
+void MultiplyMatrix(const GLfloat a[16], const GLfloat b[16], GLfloat out[16]) {
+  for (int column = 0; column < 4; column++) {
+    for (int row = 0; row < 4; row++) {
+      GLfloat sum = 0.0f;
+      for (int k = 0; k < 4; k++) {
+        sum += a[k * 4 + row] * b[column * 4 + k];
+      }
+      out[column * 4 + row] = sum;
+    }
+  }
+}
+
+// Moves each hand rigidly by how far its palm is predicted to move.
+void PredictHands(const virtual_hand::HandBuffer &hands
+                , const motion_predictor::Motion motion[]
+                , float horizon
+                , virtual_hand::HandBuffer *predicted) {
+  *predicted = hands;
+  for (int h = 0; h < hands.count; h++) {
+    const Leap::Vector move = motion_predictor::Predict(motion[h], horizon)
+                            - motion[h].position;
+    const Eigen::Vector4f offset(move.x, move.y, move.z, 0.0f);
+    predicted->center[h] += offset;
+    for (int i = 0; i < virtual_hand::kJointCount; i++) {
+      predicted->joints[h][i] += offset;
+      predicted->joint_connections[h][i] += offset;
+    }
+  }
+}
+
+}  // namespace
+
+void ProjectionMatrix(float aspect, GLfloat out[16]) {
+  // What gluPerspective(60, aspect, 2, 200000) loads.
+  const GLfloat kNear = 2.0f;
+  const GLfloat kFar = 200000.0f;
+  const GLfloat f = 1.0f / tan(60.0f * M_PI / 360.0f);
+  for (int i = 0; i < 16; i++) {
+    out[i] = 0.0f;
+  }
+  out[0] = f / aspect;
+  out[5] = f;
+  out[10] = (kFar + kNear) / (kNear - kFar);
+  out[11] = -1.0f;
+  out[14] = 2.0f * kFar * kNear / (kNear - kFar);
+}
+
+void WorldMatrix(const scene_snapshot::SceneSnapshot &scene, GLfloat out[16]) {
+  // R(x) * R(y) == R(x * y), one matrix instead of two.
+  ToMatrix(scene.world_x_quaternion * scene.world_y_quaternion, out);
+  // Then the camera translation in front of it.
+  const GLfloat translation[3] = { scene.camera_x_position
+                                 , -scene.camera_y_position
+                                 , -scene.camera_z_position };
+  for (int row = 0; row < 3; row++) {
+    out[12 + row] += translation[row];
+  }
+}
+
+void MakeView(const GLfloat projection[16], const GLfloat world[16]
+            , const Quaternion &head_orientation, View *view) {
+  GLfloat head[16];
+  ToMatrix(head_orientation, head);
+  MultiplyMatrix(head, world, view->modelview);
+  for (int i = 0; i < 16; i++) {
+    view->projection[i] = projection[i];
+  }
+  MultiplyMatrix(projection, view->modelview, view->view_projection);
+}
+
+SceneRenderer::SceneRenderer()
+  : stereo_mode_(kStereoSinglePass), stereo_initialized_(false)
+  , frustum_culling_(true), level_of_detail_(true)
+  , hands_(true), hands_initialized_(false), prediction_horizon_(0.0f)
+  , hands_prepared_(false), gpu_timer_(NULL) {
+  stats_.draw_calls = 0;
+  stats_.vertices = 0;
+  stats_.visible_strokes = 0;
+  stats_.hand_instances = 0;
+}
+
+void SceneRenderer::Prepare(const scene_snapshot::SceneSnapshot &scene
+                          , float aspect) {
+  FRAME_TRACE_SCOPE("prepare");
+  {
+    FRAME_TRACE_SCOPE("upload strokes");
+    // Completed strokes are tessellated and uploaded once and then drawn
+    // from the GPU.  Straight line strokes that just finished are copied
+    // out of the stream ring before the ring lets go of them.
+    stroke_buffer_.sync(scene.strokes, &stroke_stream_);
+    const std::vector<Leap::Vector> *tails = &scene.tracing_tails;
+    if (prediction_horizon_ > 0.0f) {
+      display_tails_.clear();
+      for (size_t i = 0; i < scene.tracing_motion.size(); i++) {
+        display_tails_.push_back(motion_predictor::Predict(
+                            scene.tracing_motion[i], prediction_horizon_));
+      }
+      tails = &display_tails_;
+    }
+    stroke_stream_.stream(scene.tracing_lines, tails);
+  }
+
+  hands_prepared_ = hands_ && HandsReady_();
+  if (hands_prepared_) {
+    FRAME_TRACE_SCOPE("update hands");
+    const virtual_hand::HandBuffer *hands = &scene.skeleton_hands;
+    if (prediction_horizon_ > 0.0f) {
+      PredictHands(scene.skeleton_hands, scene.hand_motion
+                 , prediction_horizon_, &display_hands_);
+      hands = &display_hands_;
+    }
+    hand_renderer_.Update(*hands, scene.hand_to_world);
+  }
+
+  ProjectionMatrix(aspect, projection_);
+  WorldMatrix(scene, world_);
+}
+
+void SceneRenderer::Render(field_line::FieldLine *bg_line
+                , const Quaternion &head_orientation
+                , const stereo_renderer::EyeViewport *eye_viewport
+                , int eye_count) {
+  FRAME_TRACE_SCOPE("render");
+  MakeView(projection_, world_, head_orientation, &view_);
+
+  // Both eyes currently share the view, so one frustum culls the strokes
+  // for both of them.
+  stroke_bvh::Frustum frustum
+      = stroke_bvh::FrustumFromMatrix(view_.view_projection);
+  stroke_buffer::LodView lod;
+  if (level_of_detail_) {
+    // The eye is at -R^T * t of the modelview.
+    const GLfloat *modelview = view_.modelview;
+    for (int axis = 0; axis < 3; axis++) {
+      lod.eye[axis] = -(modelview[axis * 4] * modelview[12]
+                      + modelview[axis * 4 + 1] * modelview[13]
+                      + modelview[axis * 4 + 2] * modelview[14]);
+    }
+    GLint viewport[4];
+    if (eye_count > 0) {
+      viewport[3] = eye_viewport[0].height;
+    } else {
+      glGetIntegerv(GL_VIEWPORT, viewport);
+    }
+    lod.pixel_scale = view_.projection[5] * viewport[3] / 2.0f;
+  }
+  if (frustum_culling_ || level_of_detail_) {
+    FRAME_TRACE_SCOPE("cull strokes");
+    stroke_buffer_.cull(&frustum, frustum_culling_ ? 1 : 0
+                      , level_of_detail_ ? &lod : nullptr);
+  } else {
+    stroke_buffer_.uncull();
+  }
+
+  batches_.clear();
+  bg_line->record(&batches_);
+  stroke_buffer_.record(&batches_);
+  stroke_stream_.record(&batches_);
+  stats_.draw_calls = 0;
+  stats_.vertices = RecordedVertexCount_() * (eye_count > 0 ? eye_count : 1);
+  stats_.visible_strokes = stroke_buffer_.visible_stroke_count();
+  stats_.hand_instances = 0;
+
+  GLfloat eye_view_projection[2][16];
+  for (int eye = 0; eye < 2; eye++) {
+    for (int i = 0; i < 16; i++) {
+      eye_view_projection[eye][i] = view_.view_projection[i];
+    }
+  }
+  if (eye_count == 2 && SinglePassReady_()) {
+    FRAME_TRACE_SCOPE("draw both eyes");
+    GPU_TIMER_SCOPE(gpu_timer_, "gpu both eyes");
+    stereo_renderer_.Render(batches_, eye_view_projection, eye_viewport);
+    stats_.draw_calls = stereo_renderer_.draw_call_count();
+  } else if (eye_count > 0) {
+    LoadFixedFunctionView_();
+    for (int eye = 0; eye < eye_count; eye++) {
+      FRAME_TRACE_SCOPE("draw eye");
+      GPU_TIMER_SCOPE(gpu_timer_
+                    , eye == 0 ? "gpu left eye" : "gpu right eye");
+      glViewport(eye_viewport[eye].x
+              , eye_viewport[eye].y
+              , eye_viewport[eye].width
+              , eye_viewport[eye].height);
+      Draw_(bg_line);
+    }
+  } else {
+    FRAME_TRACE_SCOPE("draw");
+    LoadFixedFunctionView_();
+    Draw_(bg_line);
+  }
+
+  // All hands, both eyes, one draw, whichever way the scene went out.
+  if (hands_ && hands_prepared_) {
+    FRAME_TRACE_SCOPE("draw hands");
+    GPU_TIMER_SCOPE(gpu_timer_, "gpu hands");
+    hand_renderer_.Render(eye_view_projection, eye_viewport, eye_count);
+    stats_.hand_instances = hand_renderer_.instance_count();
+    stats_.draw_calls += hand_renderer_.draw_call_count();
+    stats_.vertices += hand_renderer_.vertex_count();
+  }
+  stroke_stream_.end_frame();
+}
+
+void SceneRenderer::LoadFixedFunctionView_() {
+  glMatrixMode(GL_PROJECTION);
+  glLoadMatrixf(view_.projection);
+  glMatrixMode(GL_MODELVIEW);
+  glLoadMatrixf(view_.modelview);
+}
+
+void SceneRenderer::Draw_(field_line::FieldLine *bg_line) {
+  {
+    GPU_TIMER_SCOPE(gpu_timer_, "gpu grid");
+    bg_line->draw();
+  }
+
+  GPU_TIMER_SCOPE(gpu_timer_, "gpu strokes");
+  // Stroke colors are drawn as they are; meshes come with their lighting
+  // baked in.
+  glPushAttrib(GL_LIGHTING_BIT);
+  GLfloat lmodel_ambient[] = { 1.0, 1.0, 1.0, 1.0 };
+  glLightModelfv(GL_LIGHT_MODEL_AMBIENT, lmodel_ambient);
+  stroke_buffer_.draw();
+  stroke_stream_.draw();
+  glPopAttrib();
+
+  // One glMultiDrawArrays for the field lines.
+  stats_.draw_calls += 1 + stroke_buffer_.draw_call_count()
+                         + stroke_stream_.draw_call_count();
+}
+
+unsigned long SceneRenderer::RecordedVertexCount_() const {  // NOLINT
+  unsigned long vertices = 0;  // NOLINT
+  for (std::vector<draw_batch::DrawBatch>::const_iterator batch
+          = batches_.begin()
+      ; batch != batches_.end()
+      ; batch++) {
+    for (GLsizei i = 0; i < (*batch).draw_count; i++) {
+      vertices += (*batch).count_indexes[i];
+    }
+  }
+  return vertices;
+}
+
+bool SceneRenderer::SinglePassReady_() {
+  if (stereo_mode_ != kStereoSinglePass) {
+    return false;
+  }
+  if (!stereo_initialized_) {
+    stereo_initialized_ = true;
+    if (!stereo_renderer_.Initialize()) {
+      printf("Single pass stereo is not supported, drawing each eye.\n");
+    }
+  }
+  return stereo_renderer_.supported();
+}
+
+bool SceneRenderer::HandsReady_() {
+  if (!hands_initialized_) {
+    hands_initialized_ = true;
+    if (!hand_renderer_.Initialize()) {
+      printf("Instanced drawing is not supported, hands are not drawn.\n");
+    }
+  }
+  return hand_renderer_.supported();
+}
+
+}  // namespace scene_renderer
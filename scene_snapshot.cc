@@ -0,0 +1,20 @@
+// Copyright 2015 Makoto Yano
+
+#include "headers/hand_input_processor.h"
+#include "headers/scene_snapshot.h"
+
+namespace scene_snapshot {
+
+SceneSnapshot::SceneSnapshot()
+  : sequence(0)
+  , received_time(0.0)
+  , world_x_quaternion(1.0f, 0.0f, 0.0f, 0.0f)
+  , world_y_quaternion(1.0f, 0.0f, 0.0f, 0.0f)
+  , camera_x_position(DEFAULT_CAMERA_X)
+  , camera_y_position(DEFAULT_CAMERA_Y)
+  , camera_z_position(DEFAULT_CAMERA_Z) {
+  const float no_offset[3] = { 0.0f, 0.0f, 0.0f };
+  hand_to_world = MakePointTransform(world_x_quaternion, no_offset);
+}
+
+}  // namespace scene_snapshot
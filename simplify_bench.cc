@@ -0,0 +1,249 @@
+// Copyright 2015 Makoto Yano
+//
+// Simplifies strokes of 110 Hz tip samples the way the input processor
+// does, a streaming pass while the stroke is traced and a Douglas-Peucker
+// pass over the whole stroke when it ends, and reports for a few
+// tolerances:
+//   reduction  samples per stroke vertex kept
+//   cost       ns per sample for the streaming pass and per streamed
+//              vertex for the last pass
+//   error      the farthest any sample strays from the finished stroke
+// both with the tolerance split between the passes, as the processor
+// does, and with the whole tolerance given to each.
+// Fails when a split stroke strays farther than the tolerance from its
+// samples.
+//
+//   simplify_bench [--replay FILE] [--strokes N]
+//
+// With --replay the strokes are the tips of the pointing finger the
+// processor would trace, one stroke for as long as the same finger
+// points.  Without it they are made up: figure eights at 110 Hz with
+// hand tremor.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "headers/bench_frames.h"
+#include "headers/bench_strokes.h"
+#include "headers/bench_util.h"
+#include "headers/frame_record.h"
+#include "headers/stroke_simplifier.h"
+
+namespace {
+
+// Hand tremor added to the samples, in Leap millimeters.
+const float kJitter = 0.3f;
+const float kTolerances[] = { 0.25f, 0.5f, 1.0f, 2.0f };
+const int kRuns = 5;
+
+// Uniform in [-1, 1], the same on every run.
+float Noise(unsigned int *state) {
+  *state = *state * 1664525u + 1013904223u;
+  return (*state >> 8) / static_cast<float>(1 << 23) - 1.0f;
+}
+
+float DistanceToSegment(const Leap::Vector &point, const Leap::Vector &begin
+                      , const Leap::Vector &end) {
+  const Leap::Vector segment = end - begin;
+  const float length = segment.magnitudeSquared();
+  float t = length > 0.0f ? (point - begin).dot(segment) / length : 0.0f;
+  t = std::max(0.0f, std::min(1.0f, t));
+  return point.distanceTo(begin + segment * t);
+}
+
+// The pointing fingertips of the recording at path, one stroke per run of
+// frames the same finger points in.  False when it cannot be read.
+bool ReadStrokes(const char *path
+               , std::vector<std::vector<Leap::Vector> > *strokes) {
+  frame_record::FrameReplay replay;
+  if (!replay.Open(path)) {
+    return false;
+  }
+  std::vector<Leap::Vector> stroke;
+  int pointing_id = -1;
+  frame_record::FrameRecord frame;
+  for (size_t i = 0; i <= replay.frame_count(); i++) {
+    const frame_record::FingerRecord *finger = NULL;
+    if (i < replay.frame_count()) {
+      replay.Read(i, &frame);
+      finger = bench_frames::PointingFinger(frame);
+    }
+    if (!finger || finger->id != pointing_id) {
+      if (stroke.size() >= 2) {
+        strokes->push_back(stroke);
+      }
+      stroke.clear();
+      pointing_id = finger ? finger->id : -1;
+    }
+    if (finger) {
+      const float *tip = finger->tip_position;
+      stroke.push_back(Leap::Vector(tip[0], tip[1], tip[2]));
+    }
+  }
+  return true;
+}
+
+// Farthest any sample is from the polyline.
+float MaxDeviation(const std::vector<Leap::Vector> &samples
+                 , const std::vector<Leap::Vector> &line) {
+  float farthest = 0.0f;
+  for (size_t i = 0; i < samples.size(); i++) {
+    float nearest = samples[i].distanceTo(line[0]);
+    for (size_t j = 1; j < line.size(); j++) {
+      nearest = std::min(nearest
+                       , DistanceToSegment(samples[i], line[j - 1], line[j]));
+    }
+    farthest = std::max(farthest, nearest);
+  }
+  return farthest;
+}
+
+// The streaming pass, as HandInputProcessor feeds it.
+void Stream(const std::vector<Leap::Vector> &samples, float tolerance
+          , stroke_simplifier::StreamingSimplifier *simplifier
+          , std::vector<Leap::Vector> *out) {
+  out->clear();
+  simplifier->set_tolerance(tolerance);
+  simplifier->reset(samples[0]);
+  out->push_back(samples[0]);
+  Leap::Vector committed;
+  for (size_t i = 1; i < samples.size(); i++) {
+    if (simplifier->add(samples[i], &committed)) {
+      out->push_back(committed);
+    }
+  }
+  if (simplifier->has_tail()) {
+    out->push_back(simplifier->tail());
+  }
+}
+
+struct Result {
+  size_t samples;
+  size_t streamed;
+  size_t vertices;
+  double stream_seconds;
+  double final_seconds;
+  float max_deviation;
+};
+
+Result Run(const std::vector<std::vector<Leap::Vector> > &strokes
+         , float stream_tolerance, float final_tolerance) {
+  stroke_simplifier::StreamingSimplifier simplifier;
+  std::vector<std::vector<Leap::Vector> > streamed(strokes.size());
+  std::vector<Leap::Vector> simplified;
+  Result result;
+  result.stream_seconds = 1e30;
+  result.final_seconds = 1e30;
+  for (int run = 0; run < kRuns; run++) {
+    std::chrono::steady_clock::time_point start =
+                                      std::chrono::steady_clock::now();
+    for (size_t s = 0; s < strokes.size(); s++) {
+      Stream(strokes[s], stream_tolerance, &simplifier, &streamed[s]);
+    }
+    result.stream_seconds = std::min(result.stream_seconds
+                                   , bench_util::Seconds(start));
+    start = std::chrono::steady_clock::now();
+    for (size_t s = 0; s < strokes.size(); s++) {
+      stroke_simplifier::Simplify(&streamed[s][0], streamed[s].size()
+                                , final_tolerance, &simplified);
+    }
+    result.final_seconds = std::min(result.final_seconds
+                                   , bench_util::Seconds(start));
+  }
+  result.samples = 0;
+  result.streamed = 0;
+  result.vertices = 0;
+  result.max_deviation = 0.0f;
+  for (size_t s = 0; s < strokes.size(); s++) {
+    stroke_simplifier::Simplify(&streamed[s][0], streamed[s].size()
+                              , final_tolerance, &simplified);
+    result.samples += strokes[s].size();
+    result.streamed += streamed[s].size();
+    result.vertices += simplified.size();
+    result.max_deviation = std::max(result.max_deviation
+                                  , MaxDeviation(strokes[s], simplified));
+  }
+  return result;
+}
+
+void Print(const char *name, const Result &result) {
+  printf("  %-6s %5.1f samples per vertex  %6.1f ns per sample"
+         "  %6.1f ns per streamed vertex  max error %.3f mm\n"
+        , name, result.samples / static_cast<double>(result.vertices)
+        , result.stream_seconds * 1e9 / result.samples
+        , result.final_seconds * 1e9 / result.streamed
+        , result.max_deviation);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const char *replay_path = NULL;
+  int stroke_count = 100;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      replay_path = argv[++i];
+    } else if (strcmp(argv[i], "--strokes") == 0 && i + 1 < argc) {
+      stroke_count = std::max(1, atoi(argv[++i]));
+    } else {
+      printf("Unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  std::vector<std::vector<Leap::Vector> > strokes;
+  if (replay_path) {
+    if (!ReadStrokes(replay_path, &strokes)) {
+      return 2;
+    }
+    if (strokes.empty()) {
+      printf("%s has no pointing finger to trace.\n", replay_path);
+      return 2;
+    }
+    size_t samples = 0;
+    for (size_t s = 0; s < strokes.size(); s++) {
+      samples += strokes[s].size();
+    }
+    printf("%lu strokes of %.1f samples on average, replayed\n"
+          , static_cast<unsigned long>(strokes.size())  // NOLINT
+          , samples / static_cast<double>(strokes.size()));
+  } else {
+    const int samples = bench_strokes::kStrokeSamples;
+    strokes.resize(stroke_count);
+    unsigned int noise = 1;
+    for (int s = 0; s < stroke_count; s++) {
+      for (int i = 0; i < samples; i++) {
+        const Leap::Vector jitter(Noise(&noise), Noise(&noise)
+                                , Noise(&noise));
+        strokes[s].push_back(
+                  bench_strokes::Path(i / bench_strokes::kSampleHz, s)
+                  + jitter * kJitter);
+      }
+    }
+    printf("%d strokes of %d samples, %.1f mm of jitter\n"
+          , stroke_count, samples, kJitter);
+  }
+
+  bool ok = true;
+  for (size_t t = 0; t < sizeof(kTolerances) / sizeof(kTolerances[0]); t++) {
+    const float tolerance = kTolerances[t];
+    printf("tolerance %.2f mm\n", tolerance);
+    const Result split = Run(strokes, tolerance / 2.0f, tolerance / 2.0f);
+    const Result full = Run(strokes, tolerance, tolerance);
+    Print("split", split);
+    Print("full", full);
+    // A little slack for float rounding.
+    if (split.max_deviation > tolerance * 1.001f) {
+      printf("split strokes stray %.3f mm from their samples, more than"
+             " %.2f mm\n", split.max_deviation, tolerance);
+      ok = false;
+    }
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,260 @@
+// Copyright 2015 Makoto Yano
+
+#include <math.h>
+
+#include <thread>
+
+#include "headers/Quaternion.h"
+#include "headers/hmd_backend.h"
+#include "headers/simulated_hmd.h"
+
+namespace simulated_hmd {
+
+namespace {
+
+const double kPi = 3.14159265358979;
+// The angular velocity used for prediction is taken over this long.
+const double kVelocityWindow = 0.005;
+
+// Rotation by angle radians around the unit axis (x, y, z).
+Quaternion AxisAngle(float angle, float x, float y, float z) {
+  float s = sin(angle / 2);
+  return Quaternion(cos(angle / 2), x * s, y * s, z * s);
+}
+
+// 0 to 1 with zero slope at both ends.
+double SmoothStep(double x) {
+  if (x <= 0.0) {
+    return 0.0;
+  }
+  if (x >= 1.0) {
+    return 1.0;
+  }
+  return x * x * (3.0 - 2.0 * x);
+}
+
+// Half the angle of the rotation q and the length of its axis part.
+// atan2 keeps small angles exact where acos of w would round them away.
+double HalfAngle(const Quaternion &q, double *axis_length) {
+  *axis_length = sqrt(static_cast<double>(q[1]) * q[1]
+                    + static_cast<double>(q[2]) * q[2]
+                    + static_cast<double>(q[3]) * q[3]);
+  return atan2(*axis_length, fabs(q[0]));
+}
+
+// Angle of the rotation between a and b, radians.
+double AngleBetween(const Quaternion &a, const Quaternion &b) {
+  double axis_length;
+  return 2.0 * HalfAngle(a * conj(b), &axis_length);
+}
+
+// Where the head ends up after turning from before to now, and as much
+// again for every further span.
+Quaternion Extrapolate(const Quaternion &before, const Quaternion &now
+                     , double spans) {
+  Quaternion turn = now * conj(before);
+  if (turn[0] < 0.0f) {
+    turn = Quaternion(-turn[0], -turn[1], -turn[2], -turn[3]);
+  }
+  double axis_length;
+  const double half_angle = HalfAngle(turn, &axis_length);
+  if (axis_length < 1e-12) {
+    return now;
+  }
+  return AxisAngle(2.0 * half_angle * spans
+                 , turn[1] / axis_length
+                 , turn[2] / axis_length
+                 , turn[3] / axis_length) * now;
+}
+
+}  // namespace
+
+Config DefaultConfig() {
+  Config config;
+  config.width = 1920;
+  config.height = 1080;
+  config.refresh_hz = 75.0;
+  config.tracking_latency = 0.002;
+  config.vsync = true;
+  config.trajectory = kTrajectoryLookAround;
+  config.ipd = 0.064f;
+  return config;
+}
+
+SimulatedHmd::SimulatedHmd(const Config &config)
+  : config_(config)
+  , start_(std::chrono::steady_clock::now())
+  , frame_period_(1.0 / config.refresh_hz)
+  , framebuffer_(0), texture_(0), depth_buffer_(0)
+  , latest_pose_time_(0.0), last_display_time_(-1.0), last_pose_age_(0.0)
+  , last_submit_pose_age_(0.0), last_pose_error_(0.0)
+  , frame_count_(0), missed_frames_(0) {
+  latched_pose_ = PoseAt(0.0);
+  latched_pose_.sample_time = 0.0;
+}
+
+SimulatedHmd::~SimulatedHmd() {
+  if (framebuffer_) {
+    glDeleteFramebuffers(1, &framebuffer_);
+    glDeleteTextures(1, &texture_);
+    glDeleteRenderbuffers(1, &depth_buffer_);
+  }
+}
+
+void SimulatedHmd::SetupRendering() {
+  glGenFramebuffers(1, &framebuffer_);
+  glGenTextures(1, &texture_);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glBindTexture(GL_TEXTURE_2D, texture_);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA
+              , config_.width, config_.height, 0
+              , GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0
+                        , GL_TEXTURE_2D, texture_, 0);
+
+  glGenRenderbuffers(1, &depth_buffer_);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24
+                      , config_.width, config_.height);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT
+                          , GL_RENDERBUFFER, depth_buffer_);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+double SimulatedHmd::Now() const {
+  return std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start_).count();
+}
+
+hmd_backend::Pose SimulatedHmd::PoseAt(double t) const {
+  hmd_backend::Pose pose;
+  pose.time = t;
+  pose.sample_time = t;
+  pose.position[0] = 0.0f;
+  pose.position[1] = 0.0f;
+  pose.position[2] = 0.0f;
+  switch (config_.trajectory) {
+  case kTrajectoryStill:
+    pose.orientation = Quaternion(1.0f, 0.0f, 0.0f, 0.0f);
+    break;
+  case kTrajectoryLookAround: {
+    float yaw = 0.6f * sin(2.0 * kPi * t / 6.0);
+    float pitch = 0.2f * sin(2.0 * kPi * t / 4.3);
+    pose.orientation = AxisAngle(yaw, 0.0f, 1.0f, 0.0f)
+                     * AxisAngle(pitch, 1.0f, 0.0f, 0.0f);
+    pose.position[0] = 0.02f * sin(2.0 * kPi * t / 6.0);
+    break;
+  }
+  case kTrajectoryQuickTurns: {
+    // Every two seconds, a quarter second turn one way then the other.
+    double phase = fmod(t, 4.0);
+    double turn = phase < 2.0 ? SmoothStep(phase / 0.25)
+                              : 1.0 - SmoothStep((phase - 2.0) / 0.25);
+    pose.orientation = AxisAngle(turn * kPi / 3.0, 0.0f, 1.0f, 0.0f);
+    break;
+  }
+  }
+  return pose;
+}
+
+bool SimulatedHmd::Track(double display_time, hmd_backend::Pose *pose) {
+  const double sample_time = Now() - config_.tracking_latency;
+  const hmd_backend::Pose before = PoseAt(sample_time - kVelocityWindow);
+  *pose = PoseAt(sample_time);
+  const double spans = (display_time - sample_time) / kVelocityWindow;
+  if (spans > 0.0) {
+    pose->orientation = Extrapolate(before.orientation, pose->orientation
+                                  , spans);
+    for (int i = 0; i < 3; i++) {
+      pose->position[i] += (pose->position[i] - before.position[i]) * spans;
+    }
+    pose->time = display_time;
+  }
+  latched_pose_ = *pose;
+  if (sample_time > latest_pose_time_) {
+    latest_pose_time_ = sample_time;
+  }
+  return true;
+}
+
+void SimulatedHmd::GetEyeDescs(
+              hmd_backend::EyeDesc eye_desc[hmd_backend::kEyeCount]) const {
+  for (int eye = 0; eye < hmd_backend::kEyeCount; eye++) {
+    eye_desc[eye].viewport.x = eye == hmd_backend::kEyeLeft
+                             ? 0 : (config_.width + 1) / 2;
+    eye_desc[eye].viewport.y = 0;
+    eye_desc[eye].viewport.width = config_.width / 2;
+    eye_desc[eye].viewport.height = config_.height;
+    eye_desc[eye].view_offset[0] = (eye == hmd_backend::kEyeLeft ? 0.5f : -0.5f)
+                                 * config_.ipd;
+    eye_desc[eye].view_offset[1] = 0.0f;
+    eye_desc[eye].view_offset[2] = 0.0f;
+  }
+}
+
+void SimulatedHmd::GetEyePoses(
+                        hmd_backend::Pose eye_pose[hmd_backend::kEyeCount]) {
+  const hmd_backend::Pose &head = latched_pose_;
+  hmd_backend::EyeDesc eye_desc[hmd_backend::kEyeCount];
+  GetEyeDescs(eye_desc);
+  for (int eye = 0; eye < hmd_backend::kEyeCount; eye++) {
+    // Same convention as the OVR runtime: the offset goes from the eye to
+    // the head center, so it is subtracted.
+    Quaternion offset(0.0f
+                    , -eye_desc[eye].view_offset[0]
+                    , -eye_desc[eye].view_offset[1]
+                    , -eye_desc[eye].view_offset[2]);
+    offset = head.orientation * offset * conj(head.orientation);
+    eye_pose[eye] = head;
+    for (int i = 0; i < 3; i++) {
+      eye_pose[eye].position[i] += offset[i + 1];
+    }
+  }
+}
+
+void SimulatedHmd::BeginFrame(hmd_backend::FrameTiming *timing) {
+  timing->begin_time = Now();
+  timing->display_time = NextRefresh_(timing->begin_time);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+}
+
+void SimulatedHmd::EndFrame() {
+  last_submit_pose_age_ = Now() - latest_pose_time_;
+  // Stands in for distortion: one full screen pass over the eye texture.
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+  glBlitFramebuffer(0, 0, config_.width, config_.height
+                  , 0, 0, config_.width, config_.height
+                  , GL_COLOR_BUFFER_BIT, GL_NEAREST);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  // A synced swap can't happen before the GPU is done.
+  glFinish();
+
+  double display_time = NextRefresh_(Now());
+  if (config_.vsync) {
+    std::this_thread::sleep_until(start_
+            + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                  std::chrono::duration<double>(display_time)));
+  }
+  if (last_display_time_ >= 0.0) {
+    long refreshes = lround((display_time - last_display_time_)  // NOLINT
+                           / frame_period_);
+    if (refreshes > 1) {
+      missed_frames_ += refreshes - 1;
+    }
+  }
+  last_display_time_ = display_time;
+  last_pose_age_ = display_time - latest_pose_time_;
+  last_pose_error_ = AngleBetween(latched_pose_.orientation
+                                , PoseAt(display_time).orientation)
+                   * 180.0 / kPi;
+  ++frame_count_;
+}
+
+double SimulatedHmd::NextRefresh_(double t) const {
+  return ceil(t / frame_period_) * frame_period_;
+}
+
+}  // namespace simulated_hmd
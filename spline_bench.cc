@@ -0,0 +1,249 @@
+// Copyright 2015 Makoto Yano
+//
+// Tessellates strokes the way they are uploaded and reports:
+//   kernel      points per second out of EvaluateCubic
+//   tessellate  segments and points per second for whole strokes, from
+//               the control points to the drawn points
+//   quality     for control points simplified out of 110 Hz tip samples
+//               with a few tolerances: how far the drawn lines stray
+//               from the path the tip really took and how sharply they
+//               kink, with straight lines between the points and with
+//               the curve through them
+// Fails when the curve does not follow the path closer than straight
+// lines from the same control points once they are a millimeter apart or
+// more.
+//
+//   spline_bench [--strokes N] [--tolerance MM]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "headers/bench_strokes.h"
+#include "headers/bench_util.h"
+#include "headers/stroke_simplifier.h"
+#include "headers/stroke_spline.h"
+
+namespace {
+
+// Path samples per tip sample for measuring how far lines stray.
+const int kTruthOversampling = 16;
+const float kSimplifyTolerances[] = { 0.5f, 1.0f, 2.0f, 4.0f };
+const int kSimplifyToleranceCount =
+        sizeof(kSimplifyTolerances) / sizeof(kSimplifyTolerances[0]);
+
+struct Stroke {
+  std::vector<Leap::Vector> samples;
+  // The path between the samples.
+  std::vector<Leap::Vector> truth;
+};
+
+void MakeStrokes(int count, std::vector<Stroke> *strokes) {
+  const int samples = bench_strokes::kStrokeSamples;
+  strokes->resize(count);
+  for (int s = 0; s < count; s++) {
+    Stroke &stroke = (*strokes)[s];
+    for (int i = 0; i < samples; i++) {
+      stroke.samples.push_back(
+                bench_strokes::Path(i / bench_strokes::kSampleHz, s));
+    }
+    for (int i = 0; i <= (samples - 1) * kTruthOversampling; i++) {
+      stroke.truth.push_back(
+                bench_strokes::Path(i / (bench_strokes::kSampleHz
+                                         * kTruthOversampling), s));
+    }
+  }
+}
+
+float SegmentDistance(const Leap::Vector &point, const Leap::Vector &a
+                    , const Leap::Vector &b) {
+  const Leap::Vector ab = b - a;
+  const float length = ab.dot(ab);
+  float t = length > 0.0f ? (point - a).dot(ab) / length : 0.0f;
+  t = std::max(0.0f, std::min(1.0f, t));
+  return point.distanceTo(a + ab * t);
+}
+
+// Largest and RMS distance of the path from the drawn lines.  Both run
+// the same way, so each path point only looks at lines near the last
+// closest one.
+void Deviation(const std::vector<Leap::Vector> &truth
+             , const std::vector<Leap::Vector> &drawn
+             , double *max_distance, double *sum_squares, size_t *count) {
+  size_t closest = 0;
+  for (size_t i = 0; i < truth.size(); i++) {
+    float best = 1e30f;
+    const size_t end = std::min(drawn.size() - 1, closest + 64);
+    for (size_t j = closest; j < end; j++) {
+      const float distance = SegmentDistance(truth[i], drawn[j]
+                                           , drawn[j + 1]);
+      if (distance < best) {
+        best = distance;
+        closest = j;
+      }
+    }
+    *max_distance = std::max(*max_distance, static_cast<double>(best));
+    *sum_squares += best * best;
+    ++*count;
+  }
+}
+
+// Turn between consecutive drawn lines, in degrees.
+void Kinks(const std::vector<Leap::Vector> &drawn
+         , std::vector<double> *kinks) {
+  for (size_t i = 1; i + 1 < drawn.size(); i++) {
+    const Leap::Vector a = drawn[i] - drawn[i - 1];
+    const Leap::Vector b = drawn[i + 1] - drawn[i];
+    const float lengths = a.magnitude() * b.magnitude();
+    if (lengths > 0.0f) {
+      const float cosine = std::max(-1.0f, std::min(1.0f
+                                            , a.dot(b) / lengths));
+      kinks->push_back(acos(cosine) * 180.0 / M_PI);
+    }
+  }
+}
+
+struct Quality {
+  double max_distance;
+  double sum_squares;
+  size_t count;
+  std::vector<double> kinks;
+  size_t vertices;
+};
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  int stroke_count = 50;
+  float tolerance = stroke_spline::kDefaultTolerance;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--strokes") == 0 && i + 1 < argc) {
+      stroke_count = std::max(1, atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+      tolerance = atof(argv[++i]);
+    } else {
+      printf("Unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+  bool ok = true;
+
+  std::vector<Stroke> strokes;
+  MakeStrokes(stroke_count, &strokes);
+  // Control points the way the processor keeps them.
+  std::vector<std::vector<Leap::Vector> > controls(strokes.size());
+  for (size_t s = 0; s < strokes.size(); s++) {
+    stroke_simplifier::Simplify(&strokes[s].samples[0]
+                              , strokes[s].samples.size(), 0.5f
+                              , &controls[s]);
+  }
+
+  // The cubics of every segment.
+  std::vector<stroke_spline::Cubic> cubics;
+  std::vector<int> subdivisions;
+  size_t kernel_points = 0;
+  for (size_t s = 0; s < controls.size(); s++) {
+    const std::vector<Leap::Vector> &points = controls[s];
+    for (size_t i = 0; i + 1 < points.size(); i++) {
+      const Leap::Vector before = i > 0 ? points[i - 1]
+                                         : points[0] * 2.0f - points[1];
+      const Leap::Vector after = i + 2 < points.size() ? points[i + 2]
+                               : points[i + 1] * 2.0f - points[i];
+      cubics.push_back(stroke_spline::SegmentCubic(before, points[i]
+                                                 , points[i + 1], after));
+      subdivisions.push_back(std::max(2, stroke_spline::Subdivisions(
+                                              cubics.back(), tolerance)));
+      kernel_points += subdivisions.back() - 1;
+    }
+  }
+  std::vector<Leap::Vector> out(stroke_spline::kMaxSubdivisions);
+  const int kRuns = 20;
+  double best_kernel = 1e30;
+  for (int run = 0; run < kRuns; run++) {
+    std::chrono::steady_clock::time_point start =
+                                      std::chrono::steady_clock::now();
+    for (size_t i = 0; i < cubics.size(); i++) {
+      stroke_spline::EvaluateCubic(cubics[i], subdivisions[i], &out[0]);
+    }
+    best_kernel = std::min(best_kernel, bench_util::Seconds(start));
+  }
+  printf("kernel      %7.1f M points/s  %.1f points per segment\n"
+        , kernel_points / best_kernel / 1e6
+        , kernel_points / static_cast<double>(cubics.size()));
+
+  // Whole strokes, reusing the output like the stroke pool does.
+  std::vector<Leap::Vector> curve;
+  size_t segments = 0;
+  size_t points = 0;
+  double best = 1e30;
+  for (int run = 0; run < kRuns; run++) {
+    segments = 0;
+    points = 0;
+    std::chrono::steady_clock::time_point start =
+                                      std::chrono::steady_clock::now();
+    for (size_t s = 0; s < controls.size(); s++) {
+      stroke_spline::Tessellate(&controls[s][0], controls[s].size()
+                              , tolerance, &curve);
+      segments += controls[s].size() - 1;
+      points += curve.size();
+    }
+    best = std::min(best, bench_util::Seconds(start));
+  }
+  printf("tessellate  %7.2f M segments/s  %7.2f M points/s  %6.1f ns"
+         " per segment, %.1f points per segment at %.3f mm\n"
+        , segments / best / 1e6, points / best / 1e6, best * 1e9 / segments
+        , points / static_cast<double>(segments), tolerance);
+
+  // Straight lines against the curve through the same control points.
+  printf("quality     %d strokes of %d tip samples\n"
+        , stroke_count, bench_strokes::kStrokeSamples);
+  std::vector<Leap::Vector> simplified;
+  for (int t = 0; t < kSimplifyToleranceCount; t++) {
+    Quality lines = Quality();
+    Quality curves = Quality();
+    size_t control_points = 0;
+    for (size_t s = 0; s < strokes.size(); s++) {
+      stroke_simplifier::Simplify(&strokes[s].samples[0]
+                                , strokes[s].samples.size()
+                                , kSimplifyTolerances[t], &simplified);
+      control_points += simplified.size();
+      stroke_spline::Tessellate(&simplified[0], simplified.size()
+                              , tolerance, &curve);
+      Deviation(strokes[s].truth, simplified, &lines.max_distance
+              , &lines.sum_squares, &lines.count);
+      Deviation(strokes[s].truth, curve, &curves.max_distance
+              , &curves.sum_squares, &curves.count);
+      Kinks(simplified, &lines.kinks);
+      Kinks(curve, &curves.kinks);
+      lines.vertices += simplified.size();
+      curves.vertices += curve.size();
+    }
+    const double line_rms = sqrt(lines.sum_squares / lines.count);
+    const double curve_rms = sqrt(curves.sum_squares / curves.count);
+    printf("  simplified to %.1f mm, %5.1f points per stroke\n"
+          , kSimplifyTolerances[t]
+          , control_points / static_cast<double>(strokes.size()));
+    printf("    lines   error rms %6.3f  max %6.3f mm  kink p95 %5.1f"
+           "  max %5.1f deg  %6.1f vertices per stroke\n"
+          , line_rms, lines.max_distance
+          , bench_util::Percentile(lines.kinks, 0.95)
+          , bench_util::Percentile(lines.kinks, 1.0)
+          , lines.vertices / static_cast<double>(strokes.size()));
+    printf("    curve   error rms %6.3f  max %6.3f mm  kink p95 %5.1f"
+           "  max %5.1f deg  %6.1f vertices per stroke\n"
+          , curve_rms, curves.max_distance
+          , bench_util::Percentile(curves.kinks, 0.95)
+          , bench_util::Percentile(curves.kinks, 1.0)
+          , curves.vertices / static_cast<double>(strokes.size()));
+    if (kSimplifyTolerances[t] >= 1.0f && !(curve_rms < line_rms)) {
+      printf("the curve strays further than straight lines\n");
+      ok = false;
+    }
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,227 @@
+// Copyright 2015 Makoto Yano
+
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "headers/stereo_renderer.h"
+
+#define BUFFER_OFFSET(bytes) ((GLubyte*) NULL + (bytes))
+
+namespace stereo_renderer {
+
+namespace {
+
+const char *kVertexShader =
+  "#version 150 compatibility\n"
+  "uniform mat4 eye_view_projection[2];\n"
+  "uniform vec4 eye_viewport[2];\n"
+  "out vec4 vertex_color;\n"
+  "void main() {\n"
+  "  int eye = gl_InstanceID;\n"
+  "  vec4 clip = eye_view_projection[eye] * gl_Vertex;\n"
+  "  gl_ClipDistance[0] = clip.w - clip.x;\n"
+  "  gl_ClipDistance[1] = clip.w + clip.x;\n"
+  "  gl_ClipDistance[2] = clip.w - clip.y;\n"
+  "  gl_ClipDistance[3] = clip.w + clip.y;\n"
+  "  clip.xy = clip.xy * eye_viewport[eye].xy\n"
+  "          + eye_viewport[eye].zw * clip.w;\n"
+  "  gl_Position = clip;\n"
+  "  vertex_color = gl_Color;\n"
+  "}\n";
+
+const char *kFragmentShader =
+  "#version 150 compatibility\n"
+  "in vec4 vertex_color;\n"
+  "void main() {\n"
+  "  gl_FragColor = vertex_color;\n"
+  "}\n";
+
+const int kClipDistanceCount = 4;
+
+GLuint CompileShader(GLenum type, const char *source) {
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 1, &source, NULL);
+  glCompileShader(shader);
+  GLint compiled = GL_FALSE;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+  if (!compiled) {
+    char log[1024];
+    glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+    printf("Stereo shader compile failed: %s\n", log);
+    glDeleteShader(shader);
+    return 0;
+  }
+  return shader;
+}
+
+}  // namespace
+
+void CombineEyeViewports(const EyeViewport eye_viewport[2]
+                       , EyeViewport *combined
+                       , GLfloat viewport_transform[2][4]) {
+  GLint left = std::min(eye_viewport[0].x, eye_viewport[1].x);
+  GLint bottom = std::min(eye_viewport[0].y, eye_viewport[1].y);
+  GLint right = std::max(eye_viewport[0].x + eye_viewport[0].width
+                        , eye_viewport[1].x + eye_viewport[1].width);
+  GLint top = std::max(eye_viewport[0].y + eye_viewport[0].height
+                      , eye_viewport[1].y + eye_viewport[1].height);
+  for (int eye = 0; eye < 2; eye++) {
+    const EyeViewport &viewport = eye_viewport[eye];
+    viewport_transform[eye][0] =
+                  viewport.width / static_cast<GLfloat>(right - left);
+    viewport_transform[eye][1] =
+                  viewport.height / static_cast<GLfloat>(top - bottom);
+    viewport_transform[eye][2] =
+                  (2.0f * (viewport.x - left) + viewport.width)
+                  / (right - left) - 1.0f;
+    viewport_transform[eye][3] =
+                  (2.0f * (viewport.y - bottom) + viewport.height)
+                  / (top - bottom) - 1.0f;
+  }
+  combined->x = left;
+  combined->y = bottom;
+  combined->width = right - left;
+  combined->height = top - bottom;
+}
+
+StereoRenderer::StereoRenderer()
+  : program_(0), indirect_buffer_(0)
+  , eye_view_projection_location_(-1), eye_viewport_location_(-1)
+  , draw_calls_(0) {
+}
+
+StereoRenderer::~StereoRenderer() {
+  if (program_) {
+    glDeleteProgram(program_);
+  }
+  if (indirect_buffer_) {
+    glDeleteBuffers(1, &indirect_buffer_);
+  }
+}
+
+bool StereoRenderer::Initialize() {
+#ifdef GL_DRAW_INDIRECT_BUFFER
+  int major = 0;
+  int minor = 0;
+  const char *version =
+              reinterpret_cast<const char *>(glGetString(GL_VERSION));
+  if (!version || sscanf(version, "%d.%d", &major, &minor) != 2
+      || major < 4 || (major == 4 && minor < 3)) {
+    return false;
+  }
+
+  GLuint vertex_shader = CompileShader(GL_VERTEX_SHADER, kVertexShader);
+  GLuint fragment_shader = CompileShader(GL_FRAGMENT_SHADER
+                                        , kFragmentShader);
+  if (!vertex_shader || !fragment_shader) {
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+    return false;
+  }
+  program_ = glCreateProgram();
+  glAttachShader(program_, vertex_shader);
+  glAttachShader(program_, fragment_shader);
+  glLinkProgram(program_);
+  glDeleteShader(vertex_shader);
+  glDeleteShader(fragment_shader);
+  GLint linked = GL_FALSE;
+  glGetProgramiv(program_, GL_LINK_STATUS, &linked);
+  if (!linked) {
+    printf("Stereo shader link failed.\n");
+    glDeleteProgram(program_);
+    program_ = 0;
+    return false;
+  }
+  eye_view_projection_location_ =
+                  glGetUniformLocation(program_, "eye_view_projection");
+  eye_viewport_location_ = glGetUniformLocation(program_, "eye_viewport");
+  glGenBuffers(1, &indirect_buffer_);
+  return true;
+#else
+  return false;
+#endif
+}
+
+void StereoRenderer::Render(
+                    const std::vector<draw_batch::DrawBatch> &batches
+                  , const GLfloat eye_view_projection[2][16]
+                  , const EyeViewport eye_viewport[2]) {
+  draw_calls_ = 0;
+#ifdef GL_DRAW_INDIRECT_BUFFER
+  if (!program_) {
+    return;
+  }
+
+  EyeViewport combined;
+  GLfloat viewport_transform[2][4];
+  CombineEyeViewports(eye_viewport, &combined, viewport_transform);
+
+  commands_.clear();
+  for (std::vector<draw_batch::DrawBatch>::const_iterator batch =
+                                                        batches.begin()
+      ; batch != batches.end(); batch++) {
+    for (GLsizei i = 0; i < batch->draw_count; i++) {
+      DrawCommand command;
+      command.count = batch->count_indexes[i];
+      command.instance_count = 2;
+      command.first = batch->first_indexes[i];
+      command.base_instance = 0;
+      commands_.push_back(command);
+    }
+  }
+  if (commands_.empty()) {
+    return;
+  }
+
+  glViewport(combined.x, combined.y, combined.width, combined.height);
+  glUseProgram(program_);
+  glUniformMatrix4fv(eye_view_projection_location_, 2, GL_FALSE
+                    , &eye_view_projection[0][0]);
+  glUniform4fv(eye_viewport_location_, 2, &viewport_transform[0][0]);
+  for (int i = 0; i < kClipDistanceCount; i++) {
+    glEnable(GL_CLIP_DISTANCE0 + i);
+  }
+
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer_);
+  glBufferData(GL_DRAW_INDIRECT_BUFFER, commands_.size() * sizeof(DrawCommand)
+              , &commands_[0], GL_STREAM_DRAW);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  size_t command_offset = 0;
+  for (std::vector<draw_batch::DrawBatch>::const_iterator batch =
+                                                        batches.begin()
+      ; batch != batches.end(); batch++) {
+    if (batch->draw_count == 0) {
+      continue;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, batch->buffer_id);
+    glVertexPointer(3, GL_FLOAT, batch->stride, BUFFER_OFFSET(0));
+    if (batch->color_offset >= 0) {
+      glEnableClientState(GL_COLOR_ARRAY);
+      glColorPointer(3, GL_FLOAT, batch->stride
+                    , BUFFER_OFFSET(batch->color_offset));
+    } else {
+      glDisableClientState(GL_COLOR_ARRAY);
+      glColor3fv(batch->color);
+    }
+    glLineWidth(batch->line_width);
+    glMultiDrawArraysIndirect(batch->mode
+                            , BUFFER_OFFSET(command_offset
+                                            * sizeof(DrawCommand))
+                            , batch->draw_count, 0);
+    command_offset += batch->draw_count;
+    ++draw_calls_;
+  }
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+  for (int i = 0; i < kClipDistanceCount; i++) {
+    glDisable(GL_CLIP_DISTANCE0 + i);
+  }
+  glUseProgram(0);
+#endif
+}
+
+}  // namespace stereo_renderer
@@ -0,0 +1,202 @@
+// Copyright 2015 Makoto Yano
+//
+// Traces strokes into a StrokeStore and into the std::list of std::list
+// of points it replaced, two strokes at a time as with both hands
+// drawing, and reports for each:
+//   build      ns per point appended, including finishing the strokes
+//   memory     heap bytes held once every stroke is finished, per point
+//   traversal  ms to read every point of every finished stroke, as a
+//              frame that draws them all would
+// Fails when the store takes more memory or longer to traverse than the
+// lists, or the two hold different points.
+//
+//   store_bench [--strokes N] [--points N]
+
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <list>
+#include <new>
+#include <vector>
+
+#include "headers/bench_util.h"
+#include "headers/pen_line.h"
+
+namespace {
+
+// Heap bytes in use, with the allocator's header of every block.
+size_t heap_bytes = 0;
+
+}  // namespace
+
+void *operator new(size_t size) {
+  void *memory = malloc(size ? size : 1);
+  if (!memory) {
+    throw std::bad_alloc();
+  }
+  heap_bytes += malloc_usable_size(memory) + sizeof(size_t);
+  return memory;
+}
+
+void operator delete(void *memory) noexcept {
+  if (memory) {
+    heap_bytes -= malloc_usable_size(memory) + sizeof(size_t);
+  }
+  free(memory);
+}
+
+namespace {
+
+const int kRuns = 5;
+
+// The old pen_line::Line: the stroke color went in as the first point.
+typedef std::list<Leap::Vector> Line;
+typedef std::list<Line> LineList;
+
+Leap::Vector Point(int stroke, int i) {
+  return Leap::Vector(stroke * 0.25f + i * 0.5f, 200.0f + (i % 40)
+                    , stroke % 100 - 50.0f);
+}
+
+struct Result {
+  double build_seconds;
+  size_t bytes;
+  double traverse_seconds;
+  // Sum of every coordinate, to compare and to keep the reads.
+  double sum;
+};
+
+Result RunStore(int stroke_count, int point_count) {
+  Result result;
+  const size_t bytes_before = heap_bytes;
+  std::chrono::steady_clock::time_point start =
+                                      std::chrono::steady_clock::now();
+  pen_line::StrokeStore *store = new pen_line::StrokeStore();
+  for (int s = 0; s + 1 < stroke_count; s += 2) {
+    const pen_line::Color color = { 1.0f, 0.5f, 0.0f };
+    const unsigned int a = store->begin_stroke(color);
+    const unsigned int b = store->begin_stroke(color);
+    for (int i = 0; i < point_count; i++) {
+      store->append(a, Point(s, i));
+      store->append(b, Point(s + 1, i));
+    }
+    store->finish(a);
+    store->finish(b);
+  }
+  result.build_seconds = bench_util::Seconds(start);
+  result.bytes = heap_bytes - bytes_before;
+
+  result.traverse_seconds = 1e30;
+  for (int run = 0; run < kRuns; run++) {
+    start = std::chrono::steady_clock::now();
+    double sum = 0.0;
+    const std::vector<unsigned int> &completed = store->completed();
+    for (size_t i = 0; i < completed.size(); i++) {
+      const pen_line::StrokeView view = store->view(completed[i]);
+      for (unsigned int j = 0; j < view.count; j++) {
+        sum += view.points[j].x + view.points[j].y + view.points[j].z;
+      }
+    }
+    result.traverse_seconds = std::min(result.traverse_seconds
+                                     , bench_util::Seconds(start));
+    result.sum = sum;
+  }
+  delete store;
+  return result;
+}
+
+Result RunLists(int stroke_count, int point_count) {
+  Result result;
+  const size_t bytes_before = heap_bytes;
+  std::chrono::steady_clock::time_point start =
+                                      std::chrono::steady_clock::now();
+  LineList *lines = new LineList();
+  Line a;
+  Line b;
+  for (int s = 0; s + 1 < stroke_count; s += 2) {
+    a.push_back(Leap::Vector(1.0f, 0.5f, 0.0f));
+    b.push_back(Leap::Vector(1.0f, 0.5f, 0.0f));
+    for (int i = 0; i < point_count; i++) {
+      a.push_back(Point(s, i));
+      b.push_back(Point(s + 1, i));
+    }
+    // Finishing copied the stroke into the list of lines.
+    lines->push_back(a);
+    lines->push_back(b);
+    a.clear();
+    b.clear();
+  }
+  result.build_seconds = bench_util::Seconds(start);
+  result.bytes = heap_bytes - bytes_before;
+
+  result.traverse_seconds = 1e30;
+  for (int run = 0; run < kRuns; run++) {
+    start = std::chrono::steady_clock::now();
+    double sum = 0.0;
+    for (LineList::const_iterator line = lines->begin()
+        ; line != lines->end(); line++) {
+      Line::const_iterator point = line->begin();
+      // Past the color.
+      for (++point; point != line->end(); point++) {
+        sum += point->x + point->y + point->z;
+      }
+    }
+    result.traverse_seconds = std::min(result.traverse_seconds
+                                     , bench_util::Seconds(start));
+    result.sum = sum;
+  }
+  delete lines;
+  return result;
+}
+
+void Print(const char *name, const Result &result, size_t points) {
+  printf("%-12s build %6.1f ns per point  memory %7.1f MB  %5.1f bytes"
+         " per point  traversal %7.2f ms\n"
+        , name, result.build_seconds * 1e9 / points, result.bytes / 1e6
+        , result.bytes / static_cast<double>(points)
+        , result.traverse_seconds * 1e3);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  int stroke_count = 10000;
+  int point_count = 500;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--strokes") == 0 && i + 1 < argc) {
+      stroke_count = std::max(2, atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--points") == 0 && i + 1 < argc) {
+      point_count = std::max(1, atoi(argv[++i]));
+    } else {
+      printf("Unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+  stroke_count -= stroke_count % 2;
+  const size_t points = static_cast<size_t>(stroke_count) * point_count;
+  printf("%d strokes of %d points\n", stroke_count, point_count);
+
+  const Result store = RunStore(stroke_count, point_count);
+  Print("StrokeStore", store, points);
+  const Result lists = RunLists(stroke_count, point_count);
+  Print("std::list", lists, points);
+
+  bool ok = true;
+  if (store.sum != lists.sum) {
+    printf("the store and the lists hold different points\n");
+    ok = false;
+  }
+  if (!(store.bytes < lists.bytes)) {
+    printf("the store takes no less memory than the lists\n");
+    ok = false;
+  }
+  if (!(store.traverse_seconds < lists.traverse_seconds)) {
+    printf("the store is no quicker to traverse than the lists\n");
+    ok = false;
+  }
+  return ok ? 0 : 1;
+}
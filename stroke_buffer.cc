@@ -0,0 +1,316 @@
+// Copyright 2015 Makoto Yano
+
+#include <float.h>
+
+#include <algorithm>
+
+#include "headers/stroke_buffer.h"
+#include "headers/stroke_mesh.h"
+#include "headers/stroke_simplifier.h"
+#include "headers/stroke_spline.h"
+#include "headers/stroke_stream.h"
+
+#define BUFFER_OFFSET(bytes) ((GLubyte*) NULL + (bytes))
+
+namespace stroke_buffer {
+
+namespace {
+
+// Simplification tolerance of each level of detail, in Leap millimeters.
+// Level 0 is the stroke as traced.
+const float kLodTolerances[StrokeBufferPool::kLodLevels] = {
+  0.0f, 2.0f, 8.0f, 32.0f
+};
+
+// Largest on screen deviation from the traced stroke a level may show.
+const float kLodPixelError = 1.0f;
+
+float SquaredDistance(const stroke_bvh::Aabb &box, const float point[3]) {
+  float distance = 0.0f;
+  for (int axis = 0; axis < 3; axis++) {
+    float outside = std::max(box.min[axis] - point[axis]
+                           , point[axis] - box.max[axis]);
+    if (outside > 0.0f) {
+      distance += outside * outside;
+    }
+  }
+  return distance;
+}
+
+}  // namespace
+
+const GLsizei StrokeBufferPool::kPageVertices;
+const int StrokeBufferPool::kLodLevels;
+
+StrokeBufferPool::StrokeBufferPool()
+  : tolerance_(stroke_spline::kDefaultTolerance)
+  , shape_(stroke_mesh::DefaultShape()), uploaded_strokes_(0)
+  , uploaded_vertices_(0), migrated_strokes_(0), lod_vertices_(0)
+  , draw_calls_(0), culled_(false), visible_vertices_(0) {
+}
+
+StrokeBufferPool::~StrokeBufferPool() {
+  for (std::vector<Page>::iterator page = pages_.begin()
+      ; page != pages_.end(); page++) {
+    glDeleteBuffers(1, &page->buffer_id);
+  }
+}
+
+void StrokeBufferPool::sync(
+                    const std::vector<pen_line::StrokeView> &strokes
+                  , stroke_stream::StrokeStreamRing *stream) {
+  if (uploaded_strokes_ >= strokes.size()) {
+    return;
+  }
+
+  // New strokes are collected in staging_ and sent to their page with a
+  // single glBufferSubData, or one per page when a page fills up.  The
+  // coarser levels of a stroke follow it in the same page.
+  Page *page = pages_.empty() ? nullptr : &pages_.back();
+  GLsizei first = page ? page->size : 0;
+  staging_.clear();
+  for (size_t i = uploaded_strokes_; i < strokes.size(); i++) {
+    const pen_line::StrokeView &stroke = strokes[i];
+    // Level 0 is the curve, the coarser levels simplify the points.
+    const Leap::Vector *points = stroke.points;
+    unsigned int point_count = stroke.count;
+    if (tolerance_ > 0.0f && stroke.count > 0) {
+      stroke_spline::Tessellate(stroke.points, stroke.count, tolerance_
+                              , &curve_);
+      points = &curve_[0];
+      point_count = static_cast<unsigned int>(curve_.size());
+    }
+    // Straight lines come out of the ring as they were streamed, and
+    // only the points after those are uploaded.  The streamed points the
+    // final simplification thinned out stay in.
+    pen_line::StrokeView streamed;
+    unsigned int rest = 0;
+    const bool migrate = stream && stream->holds(stroke, &streamed, &rest);
+    GLsizei count = 0;
+    if (migrate) {
+      points = stroke.points + rest;
+      point_count = stroke.count - rest;
+      count = static_cast<GLsizei>(streamed.count);
+    }
+    stroke_mesh::BuildMesh(shape_, points, point_count, stroke.color
+                         , &mesh_);
+    count += static_cast<GLsizei>(mesh_.size());
+    GLsizei lod_count = build_levels_(stroke);
+    if (!page || page->size + count + lod_count > page->capacity) {
+      flush_(page, first);
+      page = new_page_(count + lod_count);
+      first = 0;
+    }
+    page->first_indexes.push_back(page->size);
+    page->count_indexes.push_back(count);
+    uploaded_vertices_ += count;
+    lod_vertices_ += lod_count;
+
+    Location location;
+    location.page = static_cast<unsigned int>(pages_.size() - 1);
+    // Leap::Vector is three packed floats.
+    location.box = stroke_bvh::PointBounds(&points[0].x, point_count);
+    if (migrate) {
+      const stroke_bvh::Aabb box =
+                stroke_bvh::PointBounds(&streamed.points[0].x, streamed.count);
+      for (int axis = 0; axis < 3; axis++) {
+        location.box.min[axis] = std::min(location.box.min[axis]
+                                        , box.min[axis]);
+        location.box.max[axis] = std::max(location.box.max[axis]
+                                        , box.max[axis]);
+      }
+    }
+    if (shape_.style != stroke_mesh::kLines) {
+      for (int axis = 0; axis < 3; axis++) {
+        location.box.min[axis] -= shape_.radius;
+        location.box.max[axis] += shape_.radius;
+      }
+    }
+    location.first[0] = page->size;
+    location.count[0] = count;
+    if (migrate) {
+      // Staged strokes before this one have to land first so the staged
+      // range stays contiguous.
+      flush_(page, first);
+      stream->copy_to(stroke.id, page->buffer_id, page->size);
+      page->size += static_cast<GLsizei>(streamed.count);
+      first = page->size;
+      ++migrated_strokes_;
+    }
+    page->size += static_cast<GLsizei>(mesh_.size());
+    staging_.insert(staging_.end(), mesh_.begin(), mesh_.end());
+    for (int level = 1; level < kLodLevels; level++) {
+      const std::vector<StrokeVertex> &mesh = lod_meshes_[level];
+      if (mesh.empty()) {
+        location.first[level] = location.first[level - 1];
+        location.count[level] = location.count[level - 1];
+        continue;
+      }
+      location.first[level] = page->size;
+      location.count[level] = static_cast<GLsizei>(mesh.size());
+      page->size += location.count[level];
+      staging_.insert(staging_.end(), mesh.begin(), mesh.end());
+    }
+    locations_.push_back(location);
+    bvh_.insert(location.box, static_cast<int>(locations_.size()) - 1);
+  }
+  flush_(page, first);
+  uploaded_strokes_ = strokes.size();
+}
+
+void StrokeBufferPool::draw() {
+  draw_calls_ = 0;
+  if (pages_.empty()) {
+    return;
+  }
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+  if (shape_.style == stroke_mesh::kLines) {
+    glLineWidth(3);
+  }
+  for (std::vector<Page>::iterator page = pages_.begin()
+      ; page != pages_.end(); page++) {
+    const std::vector<GLint> &firsts = drawn_firsts_(*page);
+    if (firsts.empty()) {
+      continue;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, page->buffer_id);
+    glVertexPointer(3, GL_FLOAT, sizeof(StrokeVertex), BUFFER_OFFSET(0));
+    glColorPointer(3, GL_FLOAT, sizeof(StrokeVertex)
+                  , BUFFER_OFFSET(sizeof(GLfloat) * 3));
+    glMultiDrawArrays(mode_(), &firsts[0]
+                    , &drawn_counts_(*page)[0], firsts.size());
+    ++draw_calls_;
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+void StrokeBufferPool::record(
+                    std::vector<draw_batch::DrawBatch> *batches) const {
+  for (std::vector<Page>::const_iterator page = pages_.begin()
+      ; page != pages_.end(); page++) {
+    const std::vector<GLint> &firsts = drawn_firsts_(*page);
+    if (firsts.empty()) {
+      continue;
+    }
+    draw_batch::DrawBatch batch;
+    batch.mode = mode_();
+    batch.buffer_id = page->buffer_id;
+    batch.stride = sizeof(StrokeVertex);
+    batch.color_offset = sizeof(GLfloat) * 3;
+    batch.line_width = 3;
+    batch.first_indexes = &firsts[0];
+    batch.count_indexes = &drawn_counts_(*page)[0];
+    batch.draw_count = firsts.size();
+    batches->push_back(batch);
+  }
+}
+
+void StrokeBufferPool::cull(const stroke_bvh::Frustum *frusta
+                          , int frustum_count, const LodView *lod) {
+  for (std::vector<Page>::iterator page = pages_.begin()
+      ; page != pages_.end(); page++) {
+    page->visible_first_indexes.clear();
+    page->visible_count_indexes.clear();
+  }
+  visible_.clear();
+  if (frustum_count > 0) {
+    bvh_.query(frusta, frustum_count, &visible_);
+  } else {
+    for (size_t i = 0; i < locations_.size(); i++) {
+      visible_.push_back(static_cast<int>(i));
+    }
+  }
+
+  // A level is good enough from the distance at which its tolerance
+  // shrinks to kLodPixelError on screen.
+  float level_distances[kLodLevels];
+  for (int level = 0; level < kLodLevels; level++) {
+    float distance = lod ? kLodTolerances[level] * lod->pixel_scale
+                           / kLodPixelError
+                         : FLT_MAX;
+    level_distances[level] = level == 0 ? 0.0f : distance * distance;
+  }
+  visible_vertices_ = 0;
+  for (std::vector<int>::const_iterator stroke = visible_.begin()
+      ; stroke != visible_.end(); stroke++) {
+    const Location &location = locations_[*stroke];
+    int level = 0;
+    if (lod) {
+      float distance = SquaredDistance(location.box, lod->eye);
+      while (level + 1 < kLodLevels
+          && distance >= level_distances[level + 1]) {
+        ++level;
+      }
+    }
+    Page &page = pages_[location.page];
+    page.visible_first_indexes.push_back(location.first[level]);
+    page.visible_count_indexes.push_back(location.count[level]);
+    visible_vertices_ += location.count[level];
+  }
+  culled_ = true;
+}
+
+void StrokeBufferPool::uncull() {
+  culled_ = false;
+}
+
+size_t StrokeBufferPool::visible_stroke_count() const {
+  return culled_ ? visible_.size() : locations_.size();
+}
+
+size_t StrokeBufferPool::visible_vertex_count() const {
+  return culled_ ? visible_vertices_ : uploaded_vertices_;
+}
+
+GLsizei StrokeBufferPool::build_levels_(const pen_line::StrokeView &stroke) {
+  // Each level simplifies the one before it and gets a mesh of its own.
+  // A level that would keep most of the points is left empty and the
+  // finer one is used instead.
+  const Leap::Vector *points = stroke.points;
+  unsigned int count = stroke.count;
+  GLsizei vertices = 0;
+  for (int level = 1; level < kLodLevels; level++) {
+    std::vector<Leap::Vector> *out = &lod_points_[level];
+    stroke_simplifier::Simplify(points, count, kLodTolerances[level], out);
+    if (out->size() * 4 > count * 3) {
+      out->clear();
+      lod_meshes_[level].clear();
+      continue;
+    }
+    points = &(*out)[0];
+    count = static_cast<unsigned int>(out->size());
+    stroke_mesh::BuildMesh(shape_, points, count, stroke.color
+                         , &lod_meshes_[level]);
+    vertices += static_cast<GLsizei>(lod_meshes_[level].size());
+  }
+  return vertices;
+}
+
+StrokeBufferPool::Page *StrokeBufferPool::new_page_(GLsizei vertex_count) {
+  Page page;
+  page.capacity = std::max(vertex_count, kPageVertices);
+  page.size = 0;
+  glGenBuffers(1, &page.buffer_id);
+  glBindBuffer(GL_ARRAY_BUFFER, page.buffer_id);
+  glBufferData(GL_ARRAY_BUFFER, page.capacity * sizeof(StrokeVertex)
+              , NULL, GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  pages_.push_back(page);
+  return &pages_.back();
+}
+
+void StrokeBufferPool::flush_(Page *page, GLsizei first) {
+  if (!page || staging_.empty()) {
+    return;
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, page->buffer_id);
+  glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(StrokeVertex)
+                , staging_.size() * sizeof(StrokeVertex), &staging_[0]);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  staging_.clear();
+}
+
+}  // namespace stroke_buffer
@@ -0,0 +1,320 @@
+// Copyright 2015 Makoto Yano
+
+#include <float.h>
+#include <math.h>
+
+#include <algorithm>
+
+#include "headers/stroke_bvh.h"
+
+namespace stroke_bvh {
+
+namespace {
+
+enum Containment {
+  kOutside,
+  kIntersecting,
+  kInside
+};
+
+Aabb Union(const Aabb &a, const Aabb &b) {
+  Aabb box;
+  for (int i = 0; i < 3; i++) {
+    box.min[i] = std::min(a.min[i], b.min[i]);
+    box.max[i] = std::max(a.max[i], b.max[i]);
+  }
+  return box;
+}
+
+// Half the surface area, the insertion cost.
+float Cost(const Aabb &box) {
+  float dx = box.max[0] - box.min[0];
+  float dy = box.max[1] - box.min[1];
+  float dz = box.max[2] - box.min[2];
+  return dx * dy + dy * dz + dz * dx;
+}
+
+Containment Classify(const Frustum &frustum, const Aabb &box) {
+  Containment result = kInside;
+  for (int i = 0; i < 6; i++) {
+    const float *plane = frustum.planes[i];
+    // Corners furthest along and against the plane normal.
+    float far_distance = plane[3];
+    float near_distance = plane[3];
+    for (int axis = 0; axis < 3; axis++) {
+      if (plane[axis] >= 0.0f) {
+        far_distance += plane[axis] * box.max[axis];
+        near_distance += plane[axis] * box.min[axis];
+      } else {
+        far_distance += plane[axis] * box.min[axis];
+        near_distance += plane[axis] * box.max[axis];
+      }
+    }
+    if (far_distance < 0.0f) {
+      return kOutside;
+    }
+    if (near_distance < 0.0f) {
+      result = kIntersecting;
+    }
+  }
+  return result;
+}
+
+}  // namespace
+
+Aabb PointBounds(const float *points, size_t count) {
+  Aabb box;
+  for (int axis = 0; axis < 3; axis++) {
+    box.min[axis] = FLT_MAX;
+    box.max[axis] = -FLT_MAX;
+  }
+  for (size_t i = 0; i < count; i++) {
+    for (int axis = 0; axis < 3; axis++) {
+      box.min[axis] = std::min(box.min[axis], points[i * 3 + axis]);
+      box.max[axis] = std::max(box.max[axis], points[i * 3 + axis]);
+    }
+  }
+  return box;
+}
+
+Frustum FrustumFromMatrix(const float m[16]) {
+  // Row r of the matrix is (m[r], m[4 + r], m[8 + r], m[12 + r]); the
+  // planes are w +- x, w +- y and w +- z.
+  Frustum frustum;
+  for (int i = 0; i < 6; i++) {
+    int row = i / 2;
+    float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+    float length = 0.0f;
+    for (int column = 0; column < 4; column++) {
+      frustum.planes[i][column] = m[column * 4 + 3]
+                                + sign * m[column * 4 + row];
+    }
+    for (int axis = 0; axis < 3; axis++) {
+      length += frustum.planes[i][axis] * frustum.planes[i][axis];
+    }
+    length = sqrt(length);
+    if (length > 0.0f) {
+      for (int column = 0; column < 4; column++) {
+        frustum.planes[i][column] /= length;
+      }
+    }
+  }
+  return frustum;
+}
+
+const size_t StrokeBvh::kMaxPendingLeaves;
+
+StrokeBvh::StrokeBvh() : root_(-1), leaf_count_(0) {
+}
+
+void StrokeBvh::clear() {
+  nodes_.clear();
+  root_ = -1;
+  leaf_count_ = 0;
+  flat_.clear();
+  flat_items_.clear();
+  pending_.clear();
+}
+
+int StrokeBvh::height() const {
+  return root_ < 0 ? 0 : nodes_[root_].height;
+}
+
+int StrokeBvh::allocate_() {
+  Node node;
+  node.parent = -1;
+  node.left = -1;
+  node.right = -1;
+  node.item = -1;
+  node.height = 0;
+  nodes_.push_back(node);
+  return static_cast<int>(nodes_.size()) - 1;
+}
+
+void StrokeBvh::insert(const Aabb &box, int item) {
+  int leaf = allocate_();
+  nodes_[leaf].box = box;
+  nodes_[leaf].item = item;
+  ++leaf_count_;
+  pending_.push_back(leaf);
+  if (root_ < 0) {
+    root_ = leaf;
+    return;
+  }
+
+  // Walk down while going deeper is cheaper than pairing up here.
+  int index = root_;
+  while (nodes_[index].item < 0) {
+    const Node &node = nodes_[index];
+    float area = Cost(node.box);
+    float combined = Cost(Union(node.box, box));
+    float cost = 2.0f * combined;
+    float inherited = 2.0f * (combined - area);
+    float child_cost[2];
+    int children[2] = { node.left, node.right };
+    for (int i = 0; i < 2; i++) {
+      const Node &child = nodes_[children[i]];
+      float grown = Cost(Union(child.box, box));
+      child_cost[i] = (child.item >= 0 ? grown : grown - Cost(child.box))
+                    + inherited;
+    }
+    if (cost < child_cost[0] && cost < child_cost[1]) {
+      break;
+    }
+    index = child_cost[0] < child_cost[1] ? children[0] : children[1];
+  }
+
+  int sibling = index;
+  int old_parent = nodes_[sibling].parent;
+  int new_parent = allocate_();
+  nodes_[new_parent].parent = old_parent;
+  nodes_[new_parent].box = Union(box, nodes_[sibling].box);
+  nodes_[new_parent].height = nodes_[sibling].height + 1;
+  nodes_[new_parent].left = sibling;
+  nodes_[new_parent].right = leaf;
+  nodes_[sibling].parent = new_parent;
+  nodes_[leaf].parent = new_parent;
+  if (old_parent < 0) {
+    root_ = new_parent;
+  } else if (nodes_[old_parent].left == sibling) {
+    nodes_[old_parent].left = new_parent;
+  } else {
+    nodes_[old_parent].right = new_parent;
+  }
+
+  // Refit and rebalance up to the root.
+  index = nodes_[leaf].parent;
+  while (index >= 0) {
+    index = balance_(index);
+    Node &node = nodes_[index];
+    node.height = 1 + std::max(nodes_[node.left].height
+                             , nodes_[node.right].height);
+    node.box = Union(nodes_[node.left].box, nodes_[node.right].box);
+    index = node.parent;
+  }
+}
+
+// Rotates the taller child of a up when the children differ in height by
+// more than one.  Returns the index now at a's place.
+int StrokeBvh::balance_(int a) {
+  if (nodes_[a].item >= 0 || nodes_[a].height < 2) {
+    return a;
+  }
+  int b = nodes_[a].left;
+  int c = nodes_[a].right;
+  int difference = nodes_[c].height - nodes_[b].height;
+  if (difference > -2 && difference < 2) {
+    return a;
+  }
+  // up is the taller child, stay is the other one.
+  int up = difference > 0 ? c : b;
+  int stay = difference > 0 ? b : c;
+  int f = nodes_[up].left;
+  int g = nodes_[up].right;
+
+  nodes_[up].left = a;
+  nodes_[up].parent = nodes_[a].parent;
+  nodes_[a].parent = up;
+  if (nodes_[up].parent < 0) {
+    root_ = up;
+  } else if (nodes_[nodes_[up].parent].left == a) {
+    nodes_[nodes_[up].parent].left = up;
+  } else {
+    nodes_[nodes_[up].parent].right = up;
+  }
+
+  // The taller grandchild stays under up, the other one moves to a.
+  int keep = nodes_[f].height > nodes_[g].height ? f : g;
+  int move = keep == f ? g : f;
+  nodes_[up].right = keep;
+  if (difference > 0) {
+    nodes_[a].right = move;
+  } else {
+    nodes_[a].left = move;
+  }
+  nodes_[move].parent = a;
+  nodes_[a].box = Union(nodes_[stay].box, nodes_[move].box);
+  nodes_[a].height = 1 + std::max(nodes_[stay].height, nodes_[move].height);
+  nodes_[up].box = Union(nodes_[a].box, nodes_[keep].box);
+  nodes_[up].height = 1 + std::max(nodes_[a].height, nodes_[keep].height);
+  return up;
+}
+
+void StrokeBvh::flatten_() const {
+  flat_.clear();
+  flat_items_.clear();
+  flat_.reserve(nodes_.size());
+  flat_items_.reserve(leaf_count_);
+  stack_.clear();
+  if (root_ >= 0) {
+    stack_.push_back(root_);
+  }
+  // Nodes go out in pre-order.  An inner node's skip and item count are
+  // filled in once its subtree is done, which a negative entry on the
+  // stack marks.
+  while (!stack_.empty()) {
+    int entry = stack_.back();
+    stack_.pop_back();
+    if (entry < 0) {
+      FlatNode &done = flat_[-entry - 1];
+      done.skip = static_cast<int>(flat_.size());
+      done.item_count = static_cast<int>(flat_items_.size())
+                      - done.first_item;
+      continue;
+    }
+    const Node &node = nodes_[entry];
+    FlatNode flat;
+    flat.box = node.box;
+    flat.first_item = static_cast<int>(flat_items_.size());
+    flat.skip = static_cast<int>(flat_.size()) + 1;
+    flat.item_count = 1;
+    flat_.push_back(flat);
+    if (node.item >= 0) {
+      flat_items_.push_back(node.item);
+    } else {
+      stack_.push_back(-static_cast<int>(flat_.size()));
+      stack_.push_back(node.right);
+      stack_.push_back(node.left);
+    }
+  }
+  pending_.clear();
+}
+
+void StrokeBvh::query(const Frustum *frusta, int frustum_count
+                    , std::vector<int> *items) const {
+  if (pending_.size() > kMaxPendingLeaves) {
+    flatten_();
+  }
+  for (std::vector<int>::const_iterator leaf = pending_.begin()
+      ; leaf != pending_.end(); leaf++) {
+    const Node &node = nodes_[*leaf];
+    for (int i = 0; i < frustum_count; i++) {
+      if (Classify(frusta[i], node.box) != kOutside) {
+        items->push_back(node.item);
+        break;
+      }
+    }
+  }
+
+  const int size = static_cast<int>(flat_.size());
+  int index = 0;
+  while (index < size) {
+    const FlatNode &node = flat_[index];
+    Containment containment = kOutside;
+    for (int i = 0; i < frustum_count && containment != kInside; i++) {
+      containment = std::max(containment, Classify(frusta[i], node.box));
+    }
+    if (containment == kIntersecting && node.skip != index + 1) {
+      // Inner node across a plane, look at its children.
+      ++index;
+      continue;
+    }
+    if (containment != kOutside) {
+      items->insert(items->end(), flat_items_.begin() + node.first_item
+                  , flat_items_.begin() + node.first_item + node.item_count);
+    }
+    index = node.skip;
+  }
+}
+
+}  // namespace stroke_bvh
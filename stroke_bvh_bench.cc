@@ -0,0 +1,202 @@
+// Copyright 2015 Makoto Yano
+//
+// Builds the stroke BVH over a large drawing and compares its visible set
+// query with testing every stroke's box, for a few views of the scene.
+// Also reports how much of the drawing is left to draw after culling.
+//
+//   stroke_bvh_bench [--strokes N] [--queries N]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "headers/Quaternion.h"
+#include "headers/bench_util.h"
+#include "headers/stroke_bvh.h"
+
+namespace {
+
+// Same projection as scene_renderer::ProjectionMatrix.
+const float kFieldOfView = 60.0f;
+const float kNear = 2.0f;
+const float kFar = 200000.0f;
+const float kAspect = 960.0f / 1080.0f;
+
+struct View {
+  const char *name;
+  // Yaw of the head in degrees, and the camera position.
+  float yaw;
+  float camera[3];
+};
+
+// out = a * b, all column major.
+void MultiplyMatrix(const float a[16], const float b[16], float out[16]) {
+  for (int column = 0; column < 4; column++) {
+    for (int row = 0; row < 4; row++) {
+      float sum = 0.0f;
+      for (int k = 0; k < 4; k++) {
+        sum += a[k * 4 + row] * b[column * 4 + k];
+      }
+      out[column * 4 + row] = sum;
+    }
+  }
+}
+
+// The projection and a view like scene_renderer::MakeView makes.
+void ViewProjection(const View &view, float out[16]) {
+  float f = 1.0f / tan(kFieldOfView * M_PI / 360.0f);
+  float projection[16] = { 0 };
+  projection[0] = f / kAspect;
+  projection[5] = f;
+  projection[10] = (kFar + kNear) / (kNear - kFar);
+  projection[11] = -1.0f;
+  projection[14] = 2.0f * kFar * kNear / (kNear - kFar);
+
+  float angle = view.yaw * M_PI / 180.0f;
+  float rotation[16];
+  ToMatrix(Quaternion(cos(angle / 2), 0.0f, sin(angle / 2), 0.0f), rotation);
+  float translation[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0
+                          , -view.camera[0], -view.camera[1]
+                          , -view.camera[2], 1 };
+  float modelview[16];
+  MultiplyMatrix(rotation, translation, modelview);
+  MultiplyMatrix(projection, modelview, out);
+}
+
+// The per stroke test the BVH saves.
+bool Touches(const stroke_bvh::Frustum &frustum, const stroke_bvh::Aabb &box) {
+  for (int i = 0; i < 6; i++) {
+    const float *plane = frustum.planes[i];
+    float distance = plane[3];
+    for (int axis = 0; axis < 3; axis++) {
+      distance += plane[axis] * (plane[axis] >= 0.0f ? box.max[axis]
+                                                     : box.min[axis]);
+    }
+    if (distance < 0.0f) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  int stroke_count = 100000;
+  int queries = 200;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--strokes") == 0 && i + 1 < argc) {
+      stroke_count = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--queries") == 0 && i + 1 < argc) {
+      queries = atoi(argv[++i]);
+    } else {
+      printf("Unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  // Random walks like traced strokes, spread over a room sized drawing
+  // that keeps growing as the world is turned and drawn into.
+  std::minstd_rand random(1);
+  std::uniform_real_distribution<float> position(-20000.0f, 20000.0f);
+  std::uniform_real_distribution<float> step(-8.0f, 8.0f);
+  std::uniform_int_distribution<int> length(20, 200);
+  std::vector<stroke_bvh::Aabb> boxes(stroke_count);
+  std::vector<int> vertex_counts(stroke_count);
+  std::vector<float> points;
+  unsigned long total_vertices = 0;  // NOLINT
+  for (int i = 0; i < stroke_count; i++) {
+    int count = length(random);
+    points.resize(count * 3);
+    float point[3] = { position(random), position(random), position(random) };
+    for (int j = 0; j < count; j++) {
+      for (int axis = 0; axis < 3; axis++) {
+        point[axis] += step(random);
+        points[j * 3 + axis] = point[axis];
+      }
+    }
+    boxes[i] = stroke_bvh::PointBounds(&points[0], count);
+    vertex_counts[i] = count;
+    total_vertices += count;
+  }
+
+  stroke_bvh::StrokeBvh bvh;
+  std::chrono::steady_clock::time_point start =
+                                    std::chrono::steady_clock::now();
+  for (int i = 0; i < stroke_count; i++) {
+    bvh.insert(boxes[i], i);
+  }
+  double insert_seconds = bench_util::Seconds(start);
+  printf("%d strokes, %lu vertices, insert %.2f us/stroke, height %d\n"
+        , stroke_count, total_vertices
+        , insert_seconds * 1e6 / stroke_count, bvh.height());
+
+  // The first query after this many inserts pays for the flat copy of the
+  // tree; the empty frustum keeps the query itself out of it.
+  stroke_bvh::Frustum nothing;
+  memset(&nothing, 0, sizeof(nothing));
+  nothing.planes[0][3] = -1.0f;
+  std::vector<int> visible;
+  visible.reserve(stroke_count);
+  start = std::chrono::steady_clock::now();
+  bvh.query(&nothing, 1, &visible);
+  printf("copy for queries %.1f us\n", bench_util::Seconds(start) * 1e6);
+
+  const View views[] = {
+    { "default", 0.0f, { 0.0f, 0.0f, 3000.0f } },
+    { "turned", 90.0f, { 0.0f, 0.0f, 3000.0f } },
+    { "inside, close far", 45.0f, { 0.0f, 0.0f, 0.0f } },
+    { "zoomed out", 0.0f, { 0.0f, 0.0f, 60000.0f } },
+    { "looking away", 180.0f, { 0.0f, 0.0f, 25000.0f } },
+  };
+  int result = 0;
+  for (size_t v = 0; v < sizeof(views) / sizeof(views[0]); v++) {
+    float view_projection[16];
+    ViewProjection(views[v], view_projection);
+    stroke_bvh::Frustum frustum =
+                          stroke_bvh::FrustumFromMatrix(view_projection);
+
+    start = std::chrono::steady_clock::now();
+    for (int q = 0; q < queries; q++) {
+      visible.clear();
+      bvh.query(&frustum, 1, &visible);
+    }
+    double bvh_seconds = bench_util::Seconds(start) / queries;
+    size_t bvh_visible = visible.size();
+    unsigned long visible_vertices = 0;  // NOLINT
+    for (std::vector<int>::const_iterator item = visible.begin()
+        ; item != visible.end(); item++) {
+      visible_vertices += vertex_counts[*item];
+    }
+
+    start = std::chrono::steady_clock::now();
+    for (int q = 0; q < queries; q++) {
+      visible.clear();
+      for (int i = 0; i < stroke_count; i++) {
+        if (Touches(frustum, boxes[i])) {
+          visible.push_back(i);
+        }
+      }
+    }
+    double linear_seconds = bench_util::Seconds(start) / queries;
+
+    printf("%-18s visible %6lu strokes (%5.1f%% of vertices)"
+           "  bvh %8.1f us  all boxes %8.1f us  x%.1f\n"
+          , views[v].name, static_cast<unsigned long>(bvh_visible)  // NOLINT
+          , 100.0 * visible_vertices / total_vertices
+          , bvh_seconds * 1e6, linear_seconds * 1e6
+          , linear_seconds / bvh_seconds);
+    if (bvh_visible != visible.size()) {
+      printf("  the BVH found %lu strokes, testing every box found %lu\n"
+            , static_cast<unsigned long>(bvh_visible)  // NOLINT
+            , static_cast<unsigned long>(visible.size()));  // NOLINT
+      result = 1;
+    }
+  }
+  return result;
+}
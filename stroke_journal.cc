@@ -0,0 +1,303 @@
+// Copyright 2015 Makoto Yano
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "headers/scene_file.h"
+#include "headers/stroke_journal.h"
+
+namespace stroke_journal {
+
+namespace {
+
+const char kMagic[4] = { 'O', 'W', 'L', 'J' };
+// Anything longer is taken as a corrupt header rather than a stroke.
+const uint32_t kMaxRecordPoints = 1 << 24;
+
+struct CrcTable {
+  CrcTable() {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t crc = i;
+      for (int bit = 0; bit < 8; bit++) {
+        crc = (crc & 1) ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+      }
+      entries[i] = crc;
+    }
+  }
+  uint32_t entries[256];
+};
+
+bool WriteAll(int fd, const void *data, size_t size) {
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  while (size > 0) {
+    ssize_t written = write(fd, bytes, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    bytes += written;
+    size -= written;
+  }
+  return true;
+}
+
+bool ReadAll(FILE *file, void *data, size_t size) {
+  return size == 0 || fread(data, size, 1, file) == 1;
+}
+
+uint32_t RecordCrc(const RecordHeader &header, const void *points) {
+  uint32_t crc = Crc32(&header.point_count
+                     , sizeof(header) - offsetof(RecordHeader, point_count));
+  return Crc32(points, header.point_count * sizeof(Leap::Vector), crc);
+}
+
+}  // namespace
+
+const size_t StrokeJournal::kCheckpointRecords;
+
+uint32_t Crc32(const void *data, size_t size, uint32_t crc) {
+  static const CrcTable table;
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  crc = ~crc;
+  for (size_t i = 0; i < size; i++) {
+    crc = table.entries[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+bool Recover(const char *journal_path, const char *checkpoint_path
+           , pen_line::StrokeStore *store) {
+  const size_t base = store->completed().size();
+  struct stat file_stat;
+  if (stat(checkpoint_path, &file_stat) == 0
+      && !scene_file::Load(checkpoint_path, store)) {
+    return false;
+  }
+
+  FILE *file = fopen(journal_path, "rb");
+  if (!file) {
+    return errno == ENOENT;
+  }
+  JournalHeader header;
+  if (!ReadAll(file, &header, sizeof(header))
+      || memcmp(header.magic, kMagic, sizeof(kMagic)) != 0
+      || header.version != kJournalVersion) {
+    printf("%s is not a journal this build can read.\n", journal_path);
+    fclose(file);
+    return false;
+  }
+
+  // Records the checkpoint already has are skipped; the journal is cut
+  // at the first record that is torn, corrupt or out of order.
+  long good_end = ftell(file);  // NOLINT
+  size_t replayed = 0;
+  std::vector<Leap::Vector> points;
+  RecordHeader record;
+  while (ReadAll(file, &record, sizeof(record))) {
+    if (record.point_count > kMaxRecordPoints) {
+      break;
+    }
+    points.resize(record.point_count);
+    if (!ReadAll(file, points.data(), points.size() * sizeof(Leap::Vector))
+        || RecordCrc(record, points.data()) != record.crc) {
+      break;
+    }
+    size_t next = store->completed().size() - base;
+    if (record.sequence > next) {
+      break;
+    }
+    if (record.sequence == next) {
+      pen_line::Color color = { record.color[0], record.color[1]
+                              , record.color[2] };
+      unsigned int id = store->begin_stroke(color);
+      store->rewrite(id, points.data(), record.point_count);
+      store->finish(id);
+      ++replayed;
+    }
+    good_end = ftell(file);
+  }
+  fseek(file, 0, SEEK_END);
+  long end = ftell(file);  // NOLINT
+  fclose(file);
+  if (end != good_end) {
+    printf("Dropped %ld bytes of torn journal.\n", end - good_end);
+    if (truncate(journal_path, good_end) != 0) {
+      printf("Cannot cut %s back to its last record.\n", journal_path);
+      return false;
+    }
+  }
+  if (store->completed().size() > base) {
+    unsigned long recovered = store->completed().size() - base;  // NOLINT
+    printf("Recovered %lu strokes, %lu of them from the journal.\n"
+          , recovered, static_cast<unsigned long>(replayed));  // NOLINT
+  }
+  return true;
+}
+
+StrokeJournal::StrokeJournal()
+  : fd_(-1), stopping_(false), queued_(0), written_(0), checkpoints_(0)
+  , durable_count_(0), records_since_checkpoint_(0) {
+}
+
+StrokeJournal::~StrokeJournal() {
+  Close();
+}
+
+bool StrokeJournal::Open(const char *journal_path, const char *checkpoint_path
+                       , size_t durable_count) {
+  Close();
+  fd_ = open(journal_path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd_ < 0) {
+    printf("Cannot open journal %s.\n", journal_path);
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(fd_, &file_stat) == 0 && file_stat.st_size == 0) {
+    JournalHeader header;
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kJournalVersion;
+    if (!WriteAll(fd_, &header, sizeof(header))) {
+      printf("Cannot write journal %s.\n", journal_path);
+      close(fd_);
+      fd_ = -1;
+      return false;
+    }
+  }
+  journal_path_ = journal_path;
+  checkpoint_path_ = checkpoint_path;
+  durable_count_ = durable_count;
+  queue_.clear();
+  scene_.clear();
+  stopping_ = false;
+  queued_ = 0;
+  written_ = 0;
+  checkpoints_ = 0;
+  records_since_checkpoint_ = 0;
+  writer_ = std::thread(&StrokeJournal::Run_, this);
+  return true;
+}
+
+void StrokeJournal::Close() {
+  if (!writer_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_one();
+  writer_.join();
+  close(fd_);
+  fd_ = -1;
+}
+
+void StrokeJournal::Append(const std::vector<pen_line::StrokeView> &strokes) {
+  if (!writer_.joinable() || queued_ >= strokes.size()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.insert(queue_.end(), strokes.begin() + queued_, strokes.end());
+  }
+  queued_ = strokes.size();
+  wake_.notify_one();
+}
+
+size_t StrokeJournal::written_record_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return written_;
+}
+
+size_t StrokeJournal::checkpoint_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return checkpoints_;
+}
+
+void StrokeJournal::Run_() {
+  std::vector<pen_line::StrokeView> batch;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    while (queue_.empty() && !stopping_) {
+      wake_.wait(lock);
+    }
+    if (queue_.empty()) {
+      break;
+    }
+    batch.swap(queue_);
+    lock.unlock();
+
+    size_t records = 0;
+    if (Write_(batch, &records)
+        && records_since_checkpoint_ >= kCheckpointRecords) {
+      Checkpoint_();
+    }
+    batch.clear();
+
+    lock.lock();
+    written_ += records;
+  }
+}
+
+bool StrokeJournal::Write_(const std::vector<pen_line::StrokeView> &strokes
+                         , size_t *records) {
+  buffer_.clear();
+  for (std::vector<pen_line::StrokeView>::const_iterator stroke
+          = strokes.begin()
+      ; stroke != strokes.end(); stroke++) {
+    uint64_t sequence = scene_.size();
+    scene_.push_back(*stroke);
+    if (sequence < durable_count_) {
+      continue;
+    }
+    RecordHeader header;
+    header.point_count = stroke->count;
+    header.sequence = sequence;
+    header.color[0] = stroke->color.r;
+    header.color[1] = stroke->color.g;
+    header.color[2] = stroke->color.b;
+    header.padding = 0;
+    header.crc = RecordCrc(header, stroke->points);
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(
+                                                                  &header);
+    buffer_.insert(buffer_.end(), bytes, bytes + sizeof(header));
+    bytes = reinterpret_cast<const unsigned char *>(stroke->points);
+    buffer_.insert(buffer_.end(), bytes
+                 , bytes + stroke->count * sizeof(Leap::Vector));
+    ++*records;
+  }
+  if (buffer_.empty()) {
+    return true;
+  }
+  if (!WriteAll(fd_, buffer_.data(), buffer_.size()) || fdatasync(fd_) != 0) {
+    printf("Cannot write journal %s.\n", journal_path_.c_str());
+    return false;
+  }
+  records_since_checkpoint_ += *records;
+  return true;
+}
+
+bool StrokeJournal::Checkpoint_() {
+  // The checkpoint replaces the old one by rename, and the journal is
+  // only cut after that.  A crash in between leaves records the
+  // checkpoint already has, which recovery skips by sequence.
+  if (!scene_file::Save(checkpoint_path_.c_str(), scene_)) {
+    return false;
+  }
+  if (ftruncate(fd_, sizeof(JournalHeader)) != 0) {
+    printf("Cannot cut journal %s.\n", journal_path_.c_str());
+    return false;
+  }
+  records_since_checkpoint_ = 0;
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++checkpoints_;
+  return true;
+}
+
+}  // namespace stroke_journal
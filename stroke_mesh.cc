@@ -0,0 +1,244 @@
+// Copyright 2015 Makoto Yano
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "headers/stroke_buffer.h"
+#include "headers/stroke_mesh.h"
+
+namespace stroke_mesh {
+
+namespace {
+
+const float kDefaultRadius = 1.0f;
+const int kDefaultTubeSides = 6;
+
+// Points closer than this to the previous one, in Leap millimeters, are
+// skipped; they have no direction of their own.
+const float kMinSpacing = 1e-3f;
+
+// The light the hands are lit with (see hand_renderer.cc), fixed in the
+// world like the strokes, so it can be baked in once.
+const Leap::Vector kLightDirection(0.26f, 0.86f, 0.43f);
+const float kAmbient = 0.45f;
+const float kDiffuse = 0.55f;
+
+// Square to the tangent and as close as it gets to facing +z, where the
+// user is seen from the Leap.
+Leap::Vector InitialNormal(const Leap::Vector &tangent) {
+  Leap::Vector normal = Leap::Vector(0.0f, 0.0f, 1.0f)
+                      - tangent * tangent.z;
+  if (normal.magnitudeSquared() < 0.01f) {
+    normal = Leap::Vector(0.0f, 1.0f, 0.0f) - tangent * tangent.y;
+  }
+  return normal.normalized();
+}
+
+void Write(const Leap::Vector &position, const pen_line::Color &color
+         , float shade, std::vector<stroke_buffer::StrokeVertex> *out) {
+  stroke_buffer::StrokeVertex vertex;
+  vertex.position[0] = position.x;
+  vertex.position[1] = position.y;
+  vertex.position[2] = position.z;
+  vertex.color[0] = color.r * shade;
+  vertex.color[1] = color.g * shade;
+  vertex.color[2] = color.b * shade;
+  out->push_back(vertex);
+}
+
+}  // namespace
+
+Shape DefaultShape() {
+  Shape shape;
+  shape.style = kTube;
+  shape.radius = kDefaultRadius;
+  shape.sides = kDefaultTubeSides;
+  return shape;
+}
+
+int VerticesPerPoint(const Shape &shape) {
+  switch (shape.style) {
+    case kRibbon:
+      return 2;
+    case kTube:
+      // Both rings of a band, one vertex per side and the seam again.
+      return 2 * (shape.sides + 1);
+    default:
+      return 1;
+  }
+}
+
+MeshBuilder::MeshBuilder()
+  : point_count_(0), has_ring_(false), newest_ring_(0), restart_(false)
+  , strip_bands_(0) {
+  Reset(DefaultShape(), pen_line::Color());
+}
+
+void MeshBuilder::Reset(const Shape &shape, const pen_line::Color &color) {
+  shape_ = shape;
+  shape_.sides = std::max(3, std::min(shape.sides, kMaxTubeSides));
+  color_ = color;
+  for (int k = 0; k <= shape_.sides; k++) {
+    const float angle = 2.0f * static_cast<float>(M_PI) * k / shape_.sides;
+    cosines_[k] = cosf(angle);
+    sines_[k] = sinf(angle);
+  }
+  // Exactly the first side again, so the seam closes.
+  cosines_[shape_.sides] = cosines_[0];
+  sines_[shape_.sides] = sines_[0];
+  point_count_ = 0;
+  has_ring_ = false;
+  newest_ring_ = 0;
+  restart_ = false;
+  strip_bands_ = 0;
+}
+
+void MeshBuilder::Add(const Leap::Vector *points, unsigned int count
+                    , std::vector<stroke_buffer::StrokeVertex> *out) {
+  for (unsigned int i = 0; i < count; i++) {
+    add_point_(points[i], out);
+  }
+}
+
+void MeshBuilder::Finish(std::vector<stroke_buffer::StrokeVertex> *out) {
+  if (shape_.style != kLines && point_count_ > 1) {
+    ring_(pending_ - before_, out);
+  }
+}
+
+void MeshBuilder::Restart() {
+  restart_ = true;
+  strip_bands_ = 0;
+}
+
+void MeshBuilder::add_point_(const Leap::Vector &point
+                           , std::vector<stroke_buffer::StrokeVertex> *out) {
+  if (shape_.style == kLines) {
+    if (restart_ && point_count_ > 0) {
+      Write(pending_, color_, 1.0f, out);
+    }
+    restart_ = false;
+    Write(point, color_, 1.0f, out);
+    pending_ = point;
+    ++point_count_;
+    return;
+  }
+  if (point_count_ > 0 && point.distanceTo(pending_) < kMinSpacing) {
+    return;
+  }
+  if (point_count_ > 0) {
+    // The direction at the pending point is taken across it, from the
+    // point before to this one.
+    Leap::Vector tangent = point - (point_count_ > 1 ? before_ : pending_);
+    if (tangent.magnitudeSquared() < kMinSpacing * kMinSpacing) {
+      tangent = point - pending_;
+    }
+    ring_(tangent, out);
+    before_ = pending_;
+  }
+  pending_ = point;
+  ++point_count_;
+}
+
+void MeshBuilder::ring_(const Leap::Vector &direction
+                      , std::vector<stroke_buffer::StrokeVertex> *out) {
+  const Leap::Vector tangent = direction.normalized();
+  Leap::Vector normal;
+  if (!has_ring_) {
+    normal = InitialNormal(tangent);
+  } else {
+    // Double reflection (Wang et al., "Computation of rotation minimizing
+    // frames"): mirror the last frame onto this point, then mirror its
+    // tangent onto this one.
+    normal = normal_;
+    Leap::Vector reflected = tangent_;
+    const Leap::Vector step = pending_ - ring_point_;
+    const float step_squared = step.magnitudeSquared();
+    if (step_squared > 0.0f) {
+      normal -= step * (2.0f * step.dot(normal) / step_squared);
+      reflected -= step * (2.0f * step.dot(reflected) / step_squared);
+    }
+    const Leap::Vector turn = tangent - reflected;
+    const float turn_squared = turn.magnitudeSquared();
+    if (turn_squared > 0.0f) {
+      normal -= turn * (2.0f * turn.dot(normal) / turn_squared);
+    }
+    // Square to the tangent again against rounding.
+    normal = normal - tangent * tangent.dot(normal);
+    normal = normal.magnitudeSquared() > 1e-6f ? normal.normalized()
+                                               : InitialNormal(tangent);
+  }
+  const Leap::Vector binormal = tangent.cross(normal);
+  ring_point_ = pending_;
+  tangent_ = tangent;
+  normal_ = normal;
+
+  newest_ring_ = has_ring_ ? 1 - newest_ring_ : 0;
+  Leap::Vector *ring = rings_[newest_ring_];
+  float *shades = shades_[newest_ring_];
+  if (shape_.style == kRibbon) {
+    // Lit the same from either side.
+    const float shade = kAmbient
+                      + kDiffuse * fabsf(normal.dot(kLightDirection));
+    ring[0] = pending_ - binormal * shape_.radius;
+    ring[1] = pending_ + binormal * shape_.radius;
+    shades[0] = shade;
+    shades[1] = shade;
+  } else {
+    for (int k = 0; k <= shape_.sides; k++) {
+      const Leap::Vector out_of_tube = normal * cosines_[k]
+                                     + binormal * sines_[k];
+      ring[k] = pending_ + out_of_tube * shape_.radius;
+      shades[k] = kAmbient
+                + kDiffuse * std::max(0.0f
+                                    , out_of_tube.dot(kLightDirection));
+    }
+  }
+
+  if (shape_.style == kRibbon) {
+    if (restart_ && has_ring_) {
+      const int older = 1 - newest_ring_;
+      Write(rings_[older][0], color_, shades_[older][0], out);
+      Write(rings_[older][1], color_, shades_[older][1], out);
+    }
+    restart_ = false;
+    write_ring_(out);
+  } else if (has_ring_) {
+    write_band_(out);
+  }
+  has_ring_ = true;
+}
+
+void MeshBuilder::write_ring_(std::vector<stroke_buffer::StrokeVertex> *out) {
+  Write(rings_[newest_ring_][0], color_, shades_[newest_ring_][0], out);
+  Write(rings_[newest_ring_][1], color_, shades_[newest_ring_][1], out);
+}
+
+void MeshBuilder::write_band_(std::vector<stroke_buffer::StrokeVertex> *out) {
+  // Every other band runs around the tube backwards, so it starts on the
+  // vertex the one before ended on and the strip carries on from there
+  // through two empty triangles.
+  const int older = 1 - newest_ring_;
+  const int newer = newest_ring_;
+  const bool forward = strip_bands_ % 2 == 0;
+  for (int i = 0; i <= shape_.sides; i++) {
+    const int k = forward ? i : shape_.sides - i;
+    Write(rings_[older][k], color_, shades_[older][k], out);
+    Write(rings_[newer][k], color_, shades_[newer][k], out);
+  }
+  ++strip_bands_;
+  restart_ = false;
+}
+
+void BuildMesh(const Shape &shape, const Leap::Vector *points
+             , unsigned int count, const pen_line::Color &color
+             , std::vector<stroke_buffer::StrokeVertex> *out) {
+  out->clear();
+  MeshBuilder builder;
+  builder.Reset(shape, color);
+  builder.Add(points, count, out);
+  builder.Finish(out);
+}
+
+}  // namespace stroke_mesh
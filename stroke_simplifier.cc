@@ -0,0 +1,112 @@
+// Copyright 2015 Makoto Yano
+
+#include "headers/stroke_simplifier.h"
+
+namespace stroke_simplifier {
+
+namespace {
+
+float SquaredDistanceToSegment(const Leap::Vector &point
+                              , const Leap::Vector &begin
+                              , const Leap::Vector &end) {
+  const Leap::Vector segment = end - begin;
+  const Leap::Vector offset = point - begin;
+  const float length = segment.magnitudeSquared();
+  if (length <= 0.0f) {
+    return offset.magnitudeSquared();
+  }
+  float t = offset.dot(segment) / length;
+  if (t < 0.0f) {
+    t = 0.0f;
+  } else if (t > 1.0f) {
+    t = 1.0f;
+  }
+  return (offset - segment * t).magnitudeSquared();
+}
+
+void SimplifyRange(const Leap::Vector *points
+                  , unsigned int first, unsigned int last
+                  , float squared_tolerance, std::vector<bool> *keep) {
+  // Explicit stack: strokes can be long enough to make recursion deep.
+  std::vector<std::pair<unsigned int, unsigned int> > ranges;
+  ranges.push_back(std::make_pair(first, last));
+  while (!ranges.empty()) {
+    unsigned int begin = ranges.back().first;
+    unsigned int end = ranges.back().second;
+    ranges.pop_back();
+    float farthest = squared_tolerance;
+    unsigned int split = begin;
+    for (unsigned int i = begin + 1; i < end; i++) {
+      float distance = SquaredDistanceToSegment(points[i]
+                                              , points[begin], points[end]);
+      if (distance > farthest) {
+        farthest = distance;
+        split = i;
+      }
+    }
+    if (split != begin) {
+      (*keep)[split] = true;
+      ranges.push_back(std::make_pair(begin, split));
+      ranges.push_back(std::make_pair(split, end));
+    }
+  }
+}
+
+}  // namespace
+
+StreamingSimplifier::StreamingSimplifier(float tolerance
+                                        , unsigned int max_window)
+  : tolerance_(tolerance), max_window_(max_window) {
+  window_.reserve(max_window_);
+}
+
+void StreamingSimplifier::reset(const Leap::Vector &first) {
+  anchor_ = first;
+  window_.clear();
+}
+
+bool StreamingSimplifier::add(const Leap::Vector &point
+                            , Leap::Vector *committed) {
+  if (window_.size() < max_window_ && window_fits_(point)) {
+    window_.push_back(point);
+    return false;
+  }
+  // The window can't be stretched to the new point: its last point is
+  // the end of the segment that still fits.
+  anchor_ = window_.back();
+  *committed = anchor_;
+  window_.clear();
+  window_.push_back(point);
+  return true;
+}
+
+bool StreamingSimplifier::window_fits_(const Leap::Vector &end) const {
+  const float squared_tolerance = tolerance_ * tolerance_;
+  for (std::vector<Leap::Vector>::const_iterator point = window_.begin()
+      ; point != window_.end(); point++) {
+    if (SquaredDistanceToSegment(*point, anchor_, end) > squared_tolerance) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void Simplify(const Leap::Vector *points, unsigned int count
+            , float tolerance, std::vector<Leap::Vector> *out) {
+  out->clear();
+  if (count <= 2) {
+    out->assign(points, points + count);
+    return;
+  }
+  std::vector<bool> keep(count, false);
+  keep[0] = true;
+  keep[count - 1] = true;
+  SimplifyRange(points, 0, count - 1, tolerance * tolerance, &keep);
+  for (unsigned int i = 0; i < count; i++) {
+    if (keep[i]) {
+      out->push_back(points[i]);
+    }
+  }
+}
+
+}  // namespace stroke_simplifier
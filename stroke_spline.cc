@@ -0,0 +1,133 @@
+// Copyright 2015 Makoto Yano
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "headers/stroke_spline.h"
+
+namespace stroke_spline {
+
+static_assert(sizeof(Leap::Vector) == 3 * sizeof(float)
+            , "Leap::Vector has to be three packed floats");
+
+namespace {
+
+// Knot spacing below this is taken for two points in the same place.
+const float kMinKnotSpacing = 1e-4f;
+
+// Control point i, continued straight past either end.
+Leap::Vector ControlPoint(const Leap::Vector *points, unsigned int count
+                        , int i) {
+  if (i < 0) {
+    return points[0] * 2.0f - points[1];
+  }
+  if (i >= static_cast<int>(count)) {
+    return points[count - 1] * 2.0f - points[count - 2];
+  }
+  return points[i];
+}
+
+float KnotSpacing(const Leap::Vector &a, const Leap::Vector &b) {
+  // Centripetal: the square root of the distance.
+  return sqrtf(a.distanceTo(b));
+}
+
+}  // namespace
+
+Cubic SegmentCubic(const Leap::Vector &p0, const Leap::Vector &p1
+                 , const Leap::Vector &p2, const Leap::Vector &p3) {
+  float d1 = KnotSpacing(p1, p2);
+  if (d1 < kMinKnotSpacing) {
+    d1 = 1.0f;
+  }
+  float d0 = KnotSpacing(p0, p1);
+  if (d0 < kMinKnotSpacing) {
+    d0 = d1;
+  }
+  float d2 = KnotSpacing(p2, p3);
+  if (d2 < kMinKnotSpacing) {
+    d2 = d1;
+  }
+  // Tangents at p1 and p2 on the non-uniform knots, scaled to t in [0, 1].
+  const Leap::Vector m1 = ((p1 - p0) / d0 - (p2 - p0) / (d0 + d1)
+                         + (p2 - p1) / d1) * d1;
+  const Leap::Vector m2 = ((p2 - p1) / d1 - (p3 - p1) / (d1 + d2)
+                         + (p3 - p2) / d2) * d1;
+  // Hermite form to powers of t.
+  const Leap::Vector c2 = (p2 - p1) * 3.0f - m1 * 2.0f - m2;
+  const Leap::Vector c3 = (p1 - p2) * 2.0f + m1 + m2;
+  Cubic cubic;
+  for (int axis = 0; axis < 3; axis++) {
+    float *c = axis == 0 ? cubic.x : axis == 1 ? cubic.y : cubic.z;
+    c[0] = p1[axis];
+    c[1] = m1[axis];
+    c[2] = c2[axis];
+    c[3] = c3[axis];
+  }
+  return cubic;
+}
+
+int Subdivisions(const Cubic &cubic, float tolerance) {
+  if (tolerance <= 0.0f) {
+    return 1;
+  }
+  // A chord of parameter length h strays at most max|p''| h^2 / 8 from
+  // the curve, and p'' = 2 c2 + 6 c3 t is largest at an end.
+  const Leap::Vector c2(cubic.x[2], cubic.y[2], cubic.z[2]);
+  const Leap::Vector c3(cubic.x[3], cubic.y[3], cubic.z[3]);
+  const float bend = std::max((c2 * 2.0f).magnitude()
+                            , (c2 * 2.0f + c3 * 6.0f).magnitude());
+  const int subdivisions =
+            static_cast<int>(ceilf(sqrtf(bend / (8.0f * tolerance))));
+  return std::max(1, std::min(subdivisions, kMaxSubdivisions));
+}
+
+void EvaluateCubic(const Cubic &cubic, int subdivisions, Leap::Vector *out) {
+  const float step = 1.0f / subdivisions;
+  float *dst = &out[0].x;
+  for (int k = 1; k < subdivisions; k++, dst += 3) {
+    const float t = k * step;
+    dst[0] = ((cubic.x[3] * t + cubic.x[2]) * t + cubic.x[1]) * t
+           + cubic.x[0];
+    dst[1] = ((cubic.y[3] * t + cubic.y[2]) * t + cubic.y[1]) * t
+           + cubic.y[0];
+    dst[2] = ((cubic.z[3] * t + cubic.z[2]) * t + cubic.z[1]) * t
+           + cubic.z[0];
+  }
+}
+
+void TessellateSegments(const Leap::Vector *points, unsigned int count
+                      , unsigned int first, unsigned int end
+                      , float tolerance, std::vector<Leap::Vector> *out) {
+  end = std::min(end, count > 0 ? count - 1 : 0);
+  for (unsigned int i = first; i < end; i++) {
+    if (tolerance <= 0.0f) {
+      out->push_back(points[i + 1]);
+      continue;
+    }
+    const int segment = static_cast<int>(i);
+    const Cubic cubic = SegmentCubic(ControlPoint(points, count, segment - 1)
+                                   , points[i], points[i + 1]
+                                   , ControlPoint(points, count
+                                                , segment + 2));
+    const int subdivisions = Subdivisions(cubic, tolerance);
+    const size_t size = out->size();
+    out->resize(size + subdivisions);
+    EvaluateCubic(cubic, subdivisions, &(*out)[size]);
+    // The end exactly, so neighbouring segments and the polyline agree.
+    out->back() = points[i + 1];
+  }
+}
+
+void Tessellate(const Leap::Vector *points, unsigned int count
+              , float tolerance, std::vector<Leap::Vector> *out) {
+  out->clear();
+  if (count == 0) {
+    return;
+  }
+  out->push_back(points[0]);
+  TessellateSegments(points, count, 0, count - 1, tolerance, out);
+}
+
+}  // namespace stroke_spline
@@ -0,0 +1,510 @@
+// Copyright 2015 Makoto Yano
+
+#include <stdio.h>
+#include <string.h>
+
+#include "headers/stroke_spline.h"
+#include "headers/stroke_stream.h"
+
+#define BUFFER_OFFSET(bytes) ((GLubyte*) NULL + (bytes))
+
+namespace stroke_stream {
+
+const GLsizei StrokeStreamRing::kRingVertices;
+
+namespace {
+
+bool has_buffer_storage() {
+#ifdef GL_MAP_PERSISTENT_BIT
+  int major = 0;
+  int minor = 0;
+  const char *version =
+              reinterpret_cast<const char *>(glGetString(GL_VERSION));
+  if (version && sscanf(version, "%d.%d", &major, &minor) == 2
+      && (major > 4 || (major == 4 && minor >= 4))) {
+    return true;
+  }
+  GLint extension_count = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
+  for (GLint i = 0; i < extension_count; i++) {
+    const char *extension = reinterpret_cast<const char *>(
+                                      glGetStringi(GL_EXTENSIONS, i));
+    if (extension && strcmp(extension, "GL_ARB_buffer_storage") == 0) {
+      return true;
+    }
+  }
+#endif
+  return false;
+}
+
+}  // namespace
+
+StrokeStreamRing::StrokeStreamRing()
+  : tolerance_(stroke_spline::kDefaultTolerance)
+  , shape_(stroke_mesh::DefaultShape()), buffer_id_(0), mapped_(nullptr)
+  , head_(0), tail_buffer_id_(0), frame_(1), completed_frame_(0)
+  , deferred_count_(0), released_this_frame_(false), draw_calls_(0) {
+}
+
+StrokeStreamRing::~StrokeStreamRing() {
+  for (std::deque<FrameFence>::iterator fence = fences_.begin()
+      ; fence != fences_.end(); fence++) {
+    glDeleteSync(fence->fence);
+  }
+  if (buffer_id_) {
+    if (mapped_) {
+      glBindBuffer(GL_ARRAY_BUFFER, buffer_id_);
+      glUnmapBuffer(GL_ARRAY_BUFFER);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &buffer_id_);
+    glDeleteBuffers(1, &tail_buffer_id_);
+  }
+}
+
+void StrokeStreamRing::stream(
+                  const std::vector<pen_line::StrokeView> &live_strokes
+                , const std::vector<Leap::Vector> *tails) {
+  if (!buffer_id_) {
+    initialize_();
+  }
+  reclaim_();
+
+  for (std::map<int, Stream>::iterator stream = streams_.begin()
+      ; stream != streams_.end(); stream++) {
+    stream->second.live = false;
+  }
+  for (std::vector<pen_line::StrokeView>::const_iterator stroke =
+                                                  live_strokes.begin()
+      ; stroke != live_strokes.end(); stroke++) {
+    int id = static_cast<int>(stroke->id);
+    std::map<int, Stream>::iterator stream = streams_.find(id);
+    if (stream != streams_.end()
+        && stream->second.revision != stroke->revision) {
+      // The points were rewritten under what was streamed; start over.
+      release_(id);
+      streams_.erase(stream);
+      stream = streams_.end();
+    }
+    if (stream == streams_.end()) {
+      Stream new_stream;
+      new_stream.streamed = 0;
+      new_stream.tessellated = 0;
+      new_stream.revision = stroke->revision;
+      new_stream.points = stroke->points;
+      new_stream.mesh.Reset(shape_, stroke->color);
+      stream = streams_.insert(std::make_pair(id, new_stream)).first;
+    }
+    stream->second.live = true;
+    append_points_(id, &stream->second, *stroke);
+  }
+  // Finished or dropped strokes leave the ring.  Finished ones were
+  // already copied out by StrokeBufferPool::sync.
+  for (std::map<int, Stream>::iterator stream = streams_.begin()
+      ; stream != streams_.end(); ) {
+    if (!stream->second.live) {
+      release_(stream->first);
+      streams_.erase(stream++);
+    } else {
+      ++stream;
+    }
+  }
+
+  tail_first_indexes_.clear();
+  tail_count_indexes_.clear();
+  stream_tails_(live_strokes, tails);
+}
+
+void StrokeStreamRing::draw() {
+  draw_calls_ = 0;
+  collect_segments_();
+  if (first_indexes_.empty() && tail_first_indexes_.empty()) {
+    return;
+  }
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+  if (shape_.style == stroke_mesh::kLines) {
+    glLineWidth(3);
+  }
+  if (!first_indexes_.empty()) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer_id_);
+    glVertexPointer(3, GL_FLOAT, sizeof(stroke_buffer::StrokeVertex)
+                  , BUFFER_OFFSET(0));
+    glColorPointer(3, GL_FLOAT, sizeof(stroke_buffer::StrokeVertex)
+                  , BUFFER_OFFSET(sizeof(GLfloat) * 3));
+    glMultiDrawArrays(mode_(), &first_indexes_[0], &count_indexes_[0]
+                    , first_indexes_.size());
+    ++draw_calls_;
+  }
+  if (!tail_first_indexes_.empty()) {
+    glBindBuffer(GL_ARRAY_BUFFER, tail_buffer_id_);
+    glVertexPointer(3, GL_FLOAT, sizeof(stroke_buffer::StrokeVertex)
+                  , BUFFER_OFFSET(0));
+    glColorPointer(3, GL_FLOAT, sizeof(stroke_buffer::StrokeVertex)
+                  , BUFFER_OFFSET(sizeof(GLfloat) * 3));
+    glMultiDrawArrays(mode_(), &tail_first_indexes_[0]
+                    , &tail_count_indexes_[0], tail_first_indexes_.size());
+    ++draw_calls_;
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+void StrokeStreamRing::record(
+                        std::vector<draw_batch::DrawBatch> *batches) {
+  collect_segments_();
+  draw_batch::DrawBatch batch;
+  batch.mode = mode_();
+  batch.buffer_id = buffer_id_;
+  batch.stride = sizeof(stroke_buffer::StrokeVertex);
+  batch.color_offset = sizeof(GLfloat) * 3;
+  batch.line_width = 3;
+  if (!first_indexes_.empty()) {
+    batch.first_indexes = &first_indexes_[0];
+    batch.count_indexes = &count_indexes_[0];
+    batch.draw_count = first_indexes_.size();
+    batches->push_back(batch);
+  }
+  if (!tail_first_indexes_.empty()) {
+    batch.buffer_id = tail_buffer_id_;
+    batch.first_indexes = &tail_first_indexes_[0];
+    batch.count_indexes = &tail_count_indexes_[0];
+    batch.draw_count = tail_first_indexes_.size();
+    batches->push_back(batch);
+  }
+}
+
+void StrokeStreamRing::end_frame() {
+  if (released_this_frame_) {
+    if (mapped_) {
+      FrameFence fence;
+      fence.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      fence.frame = frame_;
+      fences_.push_back(fence);
+    } else {
+      // glBufferSubData is ordered by the driver.
+      completed_frame_ = frame_;
+    }
+    released_this_frame_ = false;
+  }
+  ++frame_;
+}
+
+bool StrokeStreamRing::holds(const pen_line::StrokeView &stroke
+                           , pen_line::StrokeView *streamed
+                           , unsigned int *rest) const {
+  std::map<int, Stream>::const_iterator stream =
+                              streams_.find(static_cast<int>(stroke.id));
+  if (shape_.style != stroke_mesh::kLines || tolerance_ > 0.0f
+      || stream == streams_.end()
+      || stream->second.revision != stroke.revision
+      || stream->second.streamed < 2 || stroke.count == 0) {
+    return false;
+  }
+  // Thinning keeps points in order, so walking both finds the ones the
+  // stroke still has.
+  const Leap::Vector *points = stream->second.points;
+  if (memcmp(&points[0], &stroke.points[0], sizeof(points[0])) != 0) {
+    return false;
+  }
+  unsigned int kept = 0;
+  for (unsigned int i = 0; i < stream->second.streamed; i++) {
+    if (kept < stroke.count
+        && memcmp(&points[i], &stroke.points[kept], sizeof(points[i])) == 0) {
+      ++kept;
+    }
+  }
+  *streamed = stroke;
+  streamed->points = points;
+  streamed->count = stream->second.streamed;
+  *rest = kept;
+  return true;
+}
+
+bool StrokeStreamRing::copy_to(unsigned int stroke_id, GLuint dest_buffer
+                            , GLsizei dest_first) {
+  std::map<int, Stream>::const_iterator stream =
+                              streams_.find(static_cast<int>(stroke_id));
+  if (stream == streams_.end() || stream->second.segments.empty()) {
+    return false;
+  }
+  const GLsizei vertex_size = sizeof(stroke_buffer::StrokeVertex);
+  glBindBuffer(GL_COPY_READ_BUFFER, buffer_id_);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, dest_buffer);
+  GLsizei written = 0;
+  for (size_t i = 0; i < stream->second.segments.size(); i++) {
+    // Every segment after the first starts with a copy of the previous
+    // segment's last point.
+    const Segment &segment = stream->second.segments[i];
+    GLint skip = i > 0 ? 1 : 0;
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER
+                      , (segment.first + skip) * vertex_size
+                      , (dest_first + written) * vertex_size
+                      , (segment.count - skip) * vertex_size);
+    written += segment.count - skip;
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  return true;
+}
+
+void StrokeStreamRing::initialize_() {
+  const GLsizeiptr size =
+                    kRingVertices * sizeof(stroke_buffer::StrokeVertex);
+  glGenBuffers(1, &buffer_id_);
+  glBindBuffer(GL_ARRAY_BUFFER, buffer_id_);
+#ifdef GL_MAP_PERSISTENT_BIT
+  if (has_buffer_storage()) {
+    const GLbitfield flags = GL_MAP_WRITE_BIT
+                            | GL_MAP_PERSISTENT_BIT
+                            | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_ARRAY_BUFFER, size, NULL, flags);
+    mapped_ = static_cast<stroke_buffer::StrokeVertex *>(
+                      glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags));
+  }
+#endif
+  if (!mapped_) {
+    glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glGenBuffers(1, &tail_buffer_id_);
+}
+
+unsigned int StrokeStreamRing::final_segments_(unsigned int count) const {
+  // A curved segment also depends on the point after its end.
+  const unsigned int pending = tolerance_ > 0.0f ? 2 : 1;
+  return count > pending ? count - pending : 0;
+}
+
+void StrokeStreamRing::stream_tails_(
+                  const std::vector<pen_line::StrokeView> &live_strokes
+                , const std::vector<Leap::Vector> *tails) {
+  // Each stroke's end is drawn as one strip from where the ring leaves
+  // off through its last points to the tail, which stands in for the
+  // next point.  It is built by a copy of the stroke's builder, which
+  // already has the last streamed point.
+  tail_vertices_.clear();
+  for (size_t i = 0; i < live_strokes.size(); i++) {
+    const pen_line::StrokeView &stroke = live_strokes[i];
+    std::map<int, Stream>::const_iterator stream =
+                            streams_.find(static_cast<int>(stroke.id));
+    if (stream == streams_.end() || stroke.count == 0) {
+      continue;
+    }
+    const unsigned int from = stream->second.tessellated;
+    const unsigned int base = from > 0 ? from - 1 : 0;
+    controls_.assign(stroke.points + base, stroke.points + stroke.count);
+    if (tails && i < tails->size()) {
+      controls_.push_back((*tails)[i]);
+    }
+    if (controls_.size() < from - base + 2) {
+      continue;
+    }
+    curve_.clear();
+    stroke_mesh::MeshBuilder mesh = stream->second.mesh;
+    if (mesh.empty()) {
+      curve_.push_back(controls_[from - base]);
+    }
+    stroke_spline::TessellateSegments(&controls_[0], controls_.size()
+                                    , from - base, controls_.size() - 1
+                                    , tolerance_, &curve_);
+    const size_t first = tail_vertices_.size();
+    mesh.Restart();
+    mesh.Add(&curve_[0], curve_.size(), &tail_vertices_);
+    mesh.Finish(&tail_vertices_);
+    if (tail_vertices_.size() > first) {
+      tail_first_indexes_.push_back(first);
+      tail_count_indexes_.push_back(tail_vertices_.size() - first);
+    }
+  }
+  if (tail_vertices_.empty()) {
+    return;
+  }
+  // Orphan the buffer every frame so the driver never has to wait for the
+  // previous frame's tails.
+  glBindBuffer(GL_ARRAY_BUFFER, tail_buffer_id_);
+  glBufferData(GL_ARRAY_BUFFER
+              , tail_vertices_.size() * sizeof(stroke_buffer::StrokeVertex)
+              , &tail_vertices_[0], GL_STREAM_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void StrokeStreamRing::collect_segments_() {
+  first_indexes_.clear();
+  count_indexes_.clear();
+  for (std::map<int, Stream>::const_iterator stream = streams_.begin()
+      ; stream != streams_.end(); stream++) {
+    if (stream->second.streamed < 2) {
+      continue;
+    }
+    for (std::vector<Segment>::const_iterator segment =
+                                  stream->second.segments.begin()
+        ; segment != stream->second.segments.end(); segment++) {
+      first_indexes_.push_back(segment->first);
+      count_indexes_.push_back(segment->count);
+    }
+  }
+}
+
+void StrokeStreamRing::reclaim_() {
+  while (!fences_.empty()) {
+    GLenum result = glClientWaitSync(fences_.front().fence, 0, 0);
+    if (result != GL_ALREADY_SIGNALED
+        && result != GL_CONDITION_SATISFIED) {
+      break;
+    }
+    completed_frame_ = fences_.front().frame;
+    glDeleteSync(fences_.front().fence);
+    fences_.pop_front();
+  }
+  while (!allocations_.empty()
+        && allocations_.front().released
+        && allocations_.front().release_frame <= completed_frame_) {
+    allocations_.pop_front();
+  }
+}
+
+bool StrokeStreamRing::allocate_(GLsizei count, bool allow_wrap
+                              , GLint *first) {
+  if (count > kRingVertices) {
+    return false;
+  }
+  if (allocations_.empty()) {
+    head_ = 0;
+  }
+  GLint tail = allocations_.empty() ? 0 : allocations_.front().first;
+  if (allocations_.empty() || head_ > tail) {
+    if (head_ + count > kRingVertices) {
+      if (!allow_wrap || count > tail) {
+        return false;
+      }
+      // Nothing will ever read the end of the ring we skip, so it can be
+      // reclaimed as soon as it reaches the front.
+      Allocation padding;
+      padding.first = head_;
+      padding.count = kRingVertices - head_;
+      padding.owner = pen_line::kNoStroke;
+      padding.released = true;
+      padding.release_frame = completed_frame_;
+      allocations_.push_back(padding);
+      head_ = 0;
+    }
+  } else if (head_ == tail || head_ + count > tail) {
+    return false;
+  }
+  *first = head_;
+  head_ += count;
+  return true;
+}
+
+bool StrokeStreamRing::extend_(int owner, GLsizei count) {
+  if (allocations_.empty()) {
+    return false;
+  }
+  Allocation &last = allocations_.back();
+  if (last.owner != owner || last.first + last.count != head_) {
+    return false;
+  }
+  GLint first;
+  if (!allocate_(count, false, &first)) {
+    return false;
+  }
+  last.count += count;
+  return true;
+}
+
+void StrokeStreamRing::release_(int owner) {
+  for (std::deque<Allocation>::iterator allocation = allocations_.begin()
+      ; allocation != allocations_.end(); allocation++) {
+    if (allocation->owner == owner && !allocation->released) {
+      allocation->released = true;
+      allocation->release_frame = frame_;
+      released_this_frame_ = true;
+    }
+  }
+}
+
+void StrokeStreamRing::write_(GLint first
+                            , const stroke_buffer::StrokeVertex *vertices
+                            , GLsizei count) {
+  if (mapped_) {
+    memcpy(mapped_ + first, vertices
+          , count * sizeof(stroke_buffer::StrokeVertex));
+    return;
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, buffer_id_);
+  glBufferSubData(GL_ARRAY_BUFFER
+                , first * sizeof(stroke_buffer::StrokeVertex)
+                , count * sizeof(stroke_buffer::StrokeVertex), vertices);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void StrokeStreamRing::append_points_(int id, Stream *stream
+                                    , const pen_line::StrokeView &stroke) {
+  const unsigned int final_segments = final_segments_(stroke.count);
+  if (final_segments <= stream->tessellated) {
+    return;
+  }
+
+  curve_.clear();
+  if (stream->mesh.empty()) {
+    curve_.push_back(stroke.points[0]);
+  }
+  stroke_spline::TessellateSegments(stroke.points, stroke.count
+                                  , stream->tessellated, final_segments
+                                  , tolerance_, &curve_);
+  const unsigned int added = static_cast<unsigned int>(curve_.size());
+  // The builder only moves on once the vertices are in the ring, so
+  // points that have to wait for space are built again next time.
+  stroke_mesh::MeshBuilder mesh = stream->mesh;
+  staging_.clear();
+  mesh.Add(&curve_[0], curve_.size(), &staging_);
+  if (staging_.empty()) {
+    // A mesh's first point only shows up with the next one.
+    stream->mesh = mesh;
+    stream->points = stroke.points;
+    stream->streamed += added;
+    stream->tessellated = final_segments;
+    return;
+  }
+  GLsizei count = static_cast<GLsizei>(staging_.size());
+  // A new segment is a new strip, which has to pick up where the last
+  // one ended so the stroke stays connected across segments.
+  bool extended = !stream->segments.empty() && extend_(id, count);
+  if (!extended && !stream->segments.empty()) {
+    mesh = stream->mesh;
+    mesh.Restart();
+    staging_.clear();
+    mesh.Add(&curve_[0], curve_.size(), &staging_);
+    count = static_cast<GLsizei>(staging_.size());
+  }
+
+  if (extended) {
+    Segment &segment = stream->segments.back();
+    write_(segment.first + segment.count, &staging_[0], count);
+    segment.count += count;
+  } else {
+    GLint first;
+    if (!allocate_(count, true, &first)) {
+      ++deferred_count_;
+      return;
+    }
+    Allocation allocation;
+    allocation.first = first;
+    allocation.count = count;
+    allocation.owner = id;
+    allocation.released = false;
+    allocation.release_frame = 0;
+    allocations_.push_back(allocation);
+    write_(first, &staging_[0], count);
+    Segment segment = { first, count };
+    stream->segments.push_back(segment);
+  }
+  stream->mesh = mesh;
+  stream->points = stroke.points;
+  stream->streamed += added;
+  stream->tessellated = final_segments;
+}
+
+}  // namespace stroke_stream
@@ -0,0 +1,170 @@
+// Copyright 2015 Makoto Yano
+//
+// Measures what a FRAME_TRACE_SCOPE costs with tracing off and on, and
+// checks the trace end to end: threads record scopes while the main
+// thread collects them like the render loop does, then the histograms
+// must have seen the writers' scopes and the Chrome trace must hold what
+// the rings hold.  Fails when an enabled scope costs
+// a microsecond or more.
+//
+//   trace_bench [--scopes N] [--threads N] [--out FILE]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "headers/bench_util.h"
+#include "headers/frame_trace.h"
+
+namespace {
+
+int sink = 0;
+
+BENCH_NOINLINE void Traced(int i) {
+  FRAME_TRACE_SCOPE("bench scope");
+  sink += i;
+}
+
+BENCH_NOINLINE void Untraced(int i) {
+  sink += i;
+}
+
+// Nanoseconds per call of f, best of a few runs.
+template <typename F>
+double NanosecondsPerCall(F f, int calls) {
+  double best = 1e30;
+  for (int run = 0; run < 5; run++) {
+    std::chrono::steady_clock::time_point start =
+                                      std::chrono::steady_clock::now();
+    for (int i = 0; i < calls; i++) {
+      f(i);
+    }
+    best = std::min(best, bench_util::Seconds(start) * 1e9 / calls);
+  }
+  return best;
+}
+
+int CountEvents(const char *path) {
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    return -1;
+  }
+  int count = 0;
+  char line[512];
+  while (fgets(line, sizeof(line), file)) {
+    if (strstr(line, "\"ph\":\"X\"")) {
+      ++count;
+    }
+  }
+  fclose(file);
+  return count;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  int scopes = 2000000;
+  int thread_count = 3;
+  const char *out_path = "/tmp/trace_bench.json";
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--scopes") == 0 && i + 1 < argc) {
+      scopes = std::max(1, atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      thread_count = std::max(1, atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+      out_path = argv[++i];
+    } else {
+      printf("Unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  // Cost of a scope, over the call it wraps.
+  const double bare = NanosecondsPerCall(Untraced, scopes);
+  frame_trace::SetEnabled(false);
+  const double off = NanosecondsPerCall(Traced, scopes) - bare;
+  frame_trace::SetEnabled(true);
+  const double on = NanosecondsPerCall(Traced, scopes) - bare;
+  printf("scope cost  off %6.1f ns  on %6.1f ns\n", off, on);
+  frame_trace::Collect();
+
+  // Writers on their own threads, collected while they run.
+  const int per_thread = 200000;
+  std::atomic<int> running(thread_count);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_count; t++) {
+    threads.push_back(std::thread([&running, per_thread]() {
+      frame_trace::SetThreadName("writer");
+      for (int i = 0; i < per_thread; i++) {
+        FRAME_TRACE_SCOPE("writer scope");
+        if (i % 1000 == 0) {
+          std::this_thread::yield();
+        }
+      }
+      running.fetch_sub(1);
+    }));
+  }
+  frame_trace::SetThreadName("collector");
+  int collects = 0;
+  while (running.load() > 0) {
+    frame_trace::Collect();
+    ++collects;
+    std::this_thread::sleep_for(std::chrono::microseconds(500));
+  }
+  for (size_t t = 0; t < threads.size(); t++) {
+    threads[t].join();
+  }
+  frame_trace::Collect();
+  {
+    FRAME_TRACE_SCOPE("collector scope");
+  }
+  frame_trace::Collect();
+  frame_trace::PrintStageStats();
+
+  std::vector<frame_trace::StageStats> stats;
+  frame_trace::GetStageStats(&stats);
+  unsigned long writer_scopes = 0;  // NOLINT
+  for (size_t i = 0; i < stats.size(); i++) {
+    if (stats[i].name == "writer scope") {
+      writer_scopes = stats[i].total_count;
+    }
+  }
+  const unsigned long written =  // NOLINT
+      static_cast<unsigned long>(thread_count) * per_thread;  // NOLINT
+  printf("writer scopes collected %lu of %lu over %d collects\n"
+        , writer_scopes, written, collects);
+
+  std::chrono::steady_clock::time_point start =
+                                      std::chrono::steady_clock::now();
+  if (!frame_trace::WriteChromeTrace(out_path)) {
+    return 2;
+  }
+  const double write_ms = bench_util::Seconds(start) * 1e3;
+  // The main thread's ring and each writer's are full.
+  const int expected = (thread_count + 1) * frame_trace::kRingEvents;
+  const int events = CountEvents(out_path);
+  printf("chrome trace %s: %d events in %.1f ms\n", out_path, events
+        , write_ms);
+
+  bool ok = true;
+  if (!(on < 1000.0)) {
+    printf("an enabled scope costs a microsecond or more\n");
+    ok = false;
+  }
+  if (writer_scopes == 0 || writer_scopes > written) {
+    printf("the histograms lost track of the writers\n");
+    ok = false;
+  }
+  if (events != expected) {
+    printf("the trace has %d events, the rings %d\n", events, expected);
+    ok = false;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,160 @@
+// Copyright 2015 Makoto Yano
+//
+// Hammers a TripleBuffer from a writer and a reader thread that both go
+// as fast as they can and reports:
+//   throughput  publishes and updates per second, and how many published
+//               slots the reader never saw
+//   staleness   how many publishes the slot the reader holds is behind
+//               the newest one once it has read it
+// Every slot is filled with its publish number throughout, so the reader
+// can tell a slot it reads while it is being written.
+// Fails when a slot read is torn, the reader goes back to an older slot,
+// or update() leaves it on a slot older than one already published when
+// it was called.
+//
+//   triple_buffer_bench [--seconds S] [--words N]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "headers/bench_util.h"
+#include "headers/triple_buffer.h"
+
+namespace {
+
+// About the size of a scene snapshot's header and hands.
+const int kDefaultWords = 1024;
+const int kMaxWords = 64 * 1024;
+
+struct Slot {
+  uint64_t sequence;
+  uint64_t words[kMaxWords];
+};
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  double seconds = 1.0;
+  int word_count = kDefaultWords;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+      seconds = std::max(0.01, atof(argv[++i]));
+    } else if (strcmp(argv[i], "--words") == 0 && i + 1 < argc) {
+      word_count = std::max(1, std::min(kMaxWords, atoi(argv[++i])));
+    } else {
+      printf("Unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  triple_buffer::TripleBuffer<Slot> *buffer =
+                                  new triple_buffer::TripleBuffer<Slot>();
+  // The newest publish number, set once publish() has returned.
+  std::atomic<uint64_t> published(0);
+  std::atomic<bool> stop(false);
+
+  std::thread writer([&]() {
+    uint64_t sequence = 0;
+    while (!stop.load(std::memory_order_relaxed)) {
+      ++sequence;
+      Slot &slot = buffer->back();
+      slot.sequence = sequence;
+      for (int i = 0; i < word_count; i++) {
+        slot.words[i] = sequence;
+      }
+      buffer->publish();
+      published.store(sequence, std::memory_order_release);
+    }
+  });
+
+  unsigned long updates = 0;  // NOLINT
+  unsigned long reads = 0;  // NOLINT
+  unsigned long torn = 0;  // NOLINT
+  unsigned long backwards = 0;  // NOLINT
+  unsigned long stale = 0;  // NOLINT
+  // Publishes behind, counted up to kMaxBehind.
+  const int kMaxBehind = 16;
+  std::vector<unsigned long> behind(kMaxBehind + 1, 0);  // NOLINT
+  uint64_t last_sequence = 0;
+  const std::chrono::steady_clock::time_point start =
+                                      std::chrono::steady_clock::now();
+  const std::chrono::steady_clock::time_point end = start
+      + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                    std::chrono::duration<double>(seconds));
+  while (std::chrono::steady_clock::now() < end) {
+    const uint64_t newest = published.load(std::memory_order_acquire);
+    if (buffer->update()) {
+      ++updates;
+    }
+    const Slot &slot = buffer->front();
+    const uint64_t sequence = slot.sequence;
+    if (sequence == 0) {
+      continue;
+    }
+    ++reads;
+    for (int i = 0; i < word_count; i++) {
+      if (slot.words[i] != sequence) {
+        ++torn;
+        break;
+      }
+    }
+    if (sequence < last_sequence) {
+      ++backwards;
+    }
+    if (sequence < newest) {
+      ++stale;
+    }
+    last_sequence = sequence;
+    const uint64_t now = published.load(std::memory_order_acquire);
+    ++behind[std::min<uint64_t>(now - std::min(now, sequence), kMaxBehind)];
+  }
+  stop = true;
+  writer.join();
+  const double elapsed = bench_util::Seconds(start);
+
+  // With a single hardware thread the two only meet where one of them is
+  // preempted.
+  printf("%d words per slot, %.2f s, %u hardware threads\n", word_count
+        , elapsed, std::thread::hardware_concurrency());
+  printf("publishes %8.2f M/s  updates %8.2f M/s  never seen %.1f%%\n"
+        , buffer->published_count() / elapsed / 1e6, updates / elapsed / 1e6
+        , 100.0 * buffer->overwritten_count()
+          / std::max(1ul, buffer->published_count()));
+  printf("reads %lu, publishes behind once read:", reads);
+  for (int i = 0; i <= kMaxBehind; i++) {
+    if (behind[i] > 0) {
+      printf("  %s%d %.2f%%", i == kMaxBehind ? ">=" : "", i
+            , 100.0 * behind[i] / std::max(1ul, reads));
+    }
+  }
+  printf("\n");
+
+  bool ok = true;
+  if (torn > 0) {
+    printf("%lu slots were read while being written\n", torn);
+    ok = false;
+  }
+  if (backwards > 0) {
+    printf("the reader went back to an older slot %lu times\n", backwards);
+    ok = false;
+  }
+  if (stale > 0) {
+    printf("update() left the reader behind a published slot %lu times\n"
+          , stale);
+    ok = false;
+  }
+  if (updates == 0) {
+    printf("the reader never got a slot\n");
+    ok = false;
+  }
+  delete buffer;
+  return ok ? 0 : 1;
+}
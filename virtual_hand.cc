@@ -1,7 +1,125 @@
 // Copyright 2015 Makoto Yano
 
+#include <algorithm>
+
 #include "headers/virtual_hand.h"
 
 namespace virtual_hand {
 
+namespace {
+
+// One point per hand, hand h in lane h, so the math that places the wrist
+// and the elbow runs for every hand of the frame in one go.
+struct Lanes {
+  Lanes()
+    : x(Eigen::Array4f::Zero()), y(Eigen::Array4f::Zero())
+    , z(Eigen::Array4f::Zero()) {}
+
+  void set(int lane, const float v[3]) {
+    x[lane] = v[0];
+    y[lane] = v[1];
+    z[lane] = v[2];
+  }
+  Eigen::Vector4f get(int lane) const {
+    return Eigen::Vector4f(x[lane], y[lane], z[lane], 0.0f);
+  }
+  Eigen::Array4f length() const { return (x * x + y * y + z * z).sqrt(); }
+  void scale(const Eigen::Array4f &factor) {
+    x *= factor;
+    y *= factor;
+    z *= factor;
+  }
+
+  Eigen::Array4f x;
+  Eigen::Array4f y;
+  Eigen::Array4f z;
+};
+
+inline Eigen::Vector4f Load(const float v[3]) {
+  return Eigen::Vector4f(v[0], v[1], v[2], 0.0f);
+}
+
+}  // namespace
+
+void BuildHands(const frame_record::FrameRecord &frame, HandBuffer *hands) {
+  hands->count = std::min<int>(frame.hand_count, kMaxHands);
+
+  // What comes straight from the records, and the inputs of the wrist
+  // and elbow math.  Lanes past count stay zero and are never read back.
+  Lanes palm;
+  Lanes direction;
+  Lanes normal;
+  Lanes thumb_knuckle;
+  Lanes basis_x;
+  Eigen::Array4f thumb_side = Eigen::Array4f::Zero();
+  for (int h = 0; h < hands->count; h++) {
+    const frame_record::HandRecord &hand = frame.hands[h];
+    Eigen::Vector4f *joints = hands->joints[h];
+    Eigen::Vector4f *connections = hands->joint_connections[h];
+    hands->id[h] = hand.id;
+    hands->confidence[h] = hand.confidence;
+    hands->grab_strength[h] = hand.grab_strength;
+    hands->center[h] = Load(hand.palm_position);
+    hands->basis[h] = Eigen::Map<const Eigen::Matrix3f>(hand.basis);
+
+    // Finger bones past the metacarpal, thumb to pinky.
+    for (int j = 0; j < frame_record::kFingerCount; j++) {
+      const frame_record::BoneRecord *bones = hand.fingers[j].bones;
+      for (int k = 0; k < 3; k++) {
+        joints[j * 3 + k] = Load(bones[k + 1].next_joint);
+        connections[j * 3 + k] = Load(bones[k + 1].prev_joint);
+      }
+    }
+
+    palm.set(h, hand.palm_position);
+    direction.set(h, hand.direction);
+    normal.set(h, hand.palm_normal);
+    thumb_knuckle.set(h, hand.fingers[0].bones[1].prev_joint);
+    basis_x.set(h, hand.basis);
+    thumb_side[h] = hand.is_left ? -0.5f : 0.5f;
+  }
+
+  // Every hand at once.  The wrist sits back from the palm and half a
+  // palm away from the thumb, scaled by the thumb's reach.
+  direction.scale(direction.length().inverse());
+  normal.scale(normal.length().inverse());
+  Lanes side;
+  side.x = direction.y * normal.z - direction.z * normal.y;
+  side.y = direction.z * normal.x - direction.x * normal.z;
+  side.z = direction.x * normal.y - direction.y * normal.x;
+  Lanes reach;
+  reach.x = thumb_knuckle.x - palm.x;
+  reach.y = thumb_knuckle.y - palm.y;
+  reach.z = thumb_knuckle.z - palm.z;
+  const Eigen::Array4f thumb_distance = reach.length();
+  side.scale(thumb_side * thumb_distance * side.length().inverse());
+  Lanes wrist;
+  wrist.x = palm.x - 0.8f * thumb_distance * direction.x - side.x;
+  wrist.y = palm.y - 0.8f * thumb_distance * direction.y - side.y;
+  wrist.z = palm.z - 0.8f * thumb_distance * direction.z - side.z;
+  const Eigen::Array4f basis_scale = basis_x.length().inverse();
+
+  // Across the knuckles, then the wrist and the forearm.
+  for (int h = 0; h < hands->count; h++) {
+    Eigen::Vector4f *joints = hands->joints[h];
+    Eigen::Vector4f *connections = hands->joint_connections[h];
+    hands->basis[h] *= basis_scale[h];
+    for (int j = 0; j < 4; j++) {
+      joints[15 + j] = connections[3 * j];
+      connections[15 + j] = connections[3 * (j + 1)];
+    }
+    const Eigen::Vector4f side_offset = side.get(h);
+    const Eigen::Vector4f wrist_point = wrist.get(h);
+    const Eigen::Vector4f elbow = Load(frame.hands[h].elbow_position);
+    joints[19] = connections[12];
+    connections[19] = wrist_point;
+    joints[20] = wrist_point;
+    connections[20] = connections[0];
+    joints[21] = elbow - side_offset;
+    connections[21] = wrist_point;
+    joints[22] = elbow + side_offset;
+    connections[22] = connections[0];
+  }
+}
+
 }  // namespace virtual_hand